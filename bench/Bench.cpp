@@ -0,0 +1,789 @@
+// Benchmarks for GalaxiC, run `galaxic_bench <benchmark> [options]`
+//
+//   compile-latency [file.gx] [runs]   time a full compile to an object file,
+//                                      once encoded directly and once through nasm
+//   exec-latency [runs]                time fork/exec/wait of a trivial program linked against
+//                                      libc and built with --freestanding
+//   run-latency [runs]                 time from starting the compiler until the program ended,
+//                                      for `GalaxiC run` and for building and running an executable
+//   interpret [iterations]             bytecodes per second of the interpreter on a loop
+//   emit [blocks]                      MB/s of turning the instruction stream into a .asm file,
+//                                      through the OutputBuffer and through stringstreams
+//   modules [modules] [blocks]         time loading and generating a program importing many modules
+//                                      with 1, 2, 4, ... threads
+//   server [runs]                      compile latency of starting the compiler (cold) against asking
+//                                      a running --server (warm), through --client and straight over the socket
+//   corpus <shape> [size] [seed]       print a generated program, see Corpus.h for the shapes
+//   micro [scale]                      time Tokenizer::tokenize, Parser::parse and Generator::GenerateCode
+//                                      on every corpus shape
+//   suite [out.json] [scale]           micro and end to end compiles of every shape, written as JSON
+//   compare <base.json> <new.json> [percent]
+//                                      compare two suite results, fails when anything got slower by more
+//                                      than percent (5 by default)
+//   slp [iterations] [runs]            run generated unrolled kernels of int16, int and long built with
+//                                      -fno-slp-vectorize, with SSE2 packs and with AVX2 packs when the machine has them
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <fcntl.h>
+#include "Tokenizer.h"
+#include "Parser.h"
+#include "Bytecode.h"
+#include "Interpreter.h"
+#include "Generator.h"
+#include "OutputBuffer.h"
+#include "ModuleGraph.h"
+#include "Server.h"
+#include "Corpus.h"
+
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+#ifndef GALAXIC_PATH
+    #define GALAXIC_PATH "./GalaxiC"
+#endif
+
+static int RunProcess(const std::vector<std::string>& args){
+    std::vector<char*> argv;
+    for(const std::string& arg : args)
+        argv.emplace_back(const_cast<char*>(arg.c_str()));
+    argv.emplace_back(nullptr);
+
+    // the compiler prints warnings and errors and the programs it runs print their own output
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid;
+    int status = -1;
+    if(posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0)
+        waitpid(pid, &status, 0);
+    posix_spawn_file_actions_destroy(&actions);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/// A program that uses every statement the generator knows, repeated so the compile is measurable
+static std::string SampleProgram(int blocks = 200){
+    std::string src;
+    for(int i = 0; i < blocks; i++){
+        std::string n = std::to_string(i);
+        src += "int a" + n + " = " + n + " * 3 + 1;\n";
+        src += "while(a" + n + " > 0){\n    a" + n + " = a" + n + " - 1;\n}\n";
+        src += "if(a" + n + " == 0 && a" + n + " < 5){\n    a" + n + " = 2;\n}\nelse{\n    a" + n + " = 3;\n}\n";
+    }
+    src += "exit(0);\n";
+    return src;
+}
+
+struct Stats{
+    double min, median, mean;
+};
+
+static Stats Summarize(std::vector<double> samples){
+    std::sort(samples.begin(), samples.end());
+    double sum = std::accumulate(samples.begin(), samples.end(), 0.0);
+    return {samples.front(), samples.at(samples.size() / 2), sum / samples.size()};
+}
+
+static bool MeasureCompile(const std::string& input, bool via_nasm, int runs, Stats& out){
+    std::vector<std::string> args = {GALAXIC_PATH, input, "-p", "linux64", "-c", "-o", "/tmp/galaxic_bench.o"};
+    if(via_nasm)
+        args.emplace_back("--via-nasm");
+
+    std::vector<double> samples;
+    for(int i = 0; i < runs; i++){
+        auto start = std::chrono::steady_clock::now();
+        int status = RunProcess(args);
+        auto end = std::chrono::steady_clock::now();
+        if(status != 0)
+            return false;
+        samples.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    out = Summarize(samples);
+    return true;
+}
+
+static int CompileLatency(int argc, char* argv[]){
+    std::string input = "/tmp/galaxic_bench.gx";
+    int runs = 50;
+
+    if(argc > 0)
+        input = argv[0];
+    else
+        std::ofstream(input) << SampleProgram();
+    if(argc > 1)
+        runs = std::max(1, std::atoi(argv[1]));
+
+    std::cout << "compile latency of `" << input << "` over " << runs << " runs (ms)\n";
+    for(bool via_nasm : {false, true}){
+        Stats stats{};
+        const char* name = via_nasm ? "nasm" : "direct";
+        if(!MeasureCompile(input, via_nasm, runs, stats)){
+            std::cout << "  " << name << ": failed (is " << (via_nasm ? "nasm" : GALAXIC_PATH) << " available?)\n";
+            continue;
+        }
+        std::cout << "  " << name << ": min " << stats.min << "  median " << stats.median << "  mean " << stats.mean << '\n';
+    }
+
+    std::remove("/tmp/galaxic_bench.o");
+    return 0;
+}
+
+/// Starts the program and waits for it, returns the time it took in microseconds or -1
+static double MeasureExec(const std::string& path){
+    char* argv[] = {const_cast<char*>(path.c_str()), nullptr};
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid == 0){
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    auto end = std::chrono::steady_clock::now();
+
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+static int ExecLatency(int argc, char* argv[]){
+    int runs = argc > 0 ? std::max(1, std::atoi(argv[0])) : 1000;
+    const std::string source = "/tmp/galaxic_exec.gx";
+    const std::string libc_program = "/tmp/galaxic_exec_libc";
+    const std::string freestanding_program = "/tmp/galaxic_exec_freestanding";
+
+    std::ofstream(source) << "int x = 1;\nx = x - 1;\nexit(x);\n";
+
+    // the libc version is linked by gcc like any C program, the compiler itself links the freestanding one
+    if(RunProcess({GALAXIC_PATH, source, "-p", "linux64", "-c", "-o", libc_program + ".o"}) != 0 ||
+       RunProcess({"/usr/bin/gcc", "-no-pie", libc_program + ".o", "-o", libc_program}) != 0){
+        std::cout << "failed to build the libc program (is gcc available?)\n";
+        return 1;
+    }
+    if(RunProcess({GALAXIC_PATH, source, "-p", "linux64", "--freestanding", "-o", freestanding_program}) != 0){
+        std::cout << "failed to build the freestanding program\n";
+        return 1;
+    }
+
+    std::cout << "fork/exec/wait latency over " << runs << " runs (us)\n";
+    for(const std::string& program : {libc_program, freestanding_program}){
+        std::vector<double> samples;
+        for(int i = 0; i < runs; i++){
+            double sample = MeasureExec(program);
+            if(sample < 0){
+                std::cout << "  `" << program << "` did not exit with 0\n";
+                return 1;
+            }
+            samples.emplace_back(sample);
+        }
+
+        Stats stats = Summarize(samples);
+        const char* name = program == libc_program ? "libc" : "freestanding";
+        std::cout << "  " << name << ": min " << stats.min << "  median " << stats.median << "  mean " << stats.mean
+                  << "  (" << static_cast<uint64_t>(1e6 / stats.mean) << " programs/s)\n";
+    }
+
+    for(const std::string& file : {source, libc_program, libc_program + ".o", freestanding_program})
+        std::remove(file.c_str());
+    return 0;
+}
+
+static int RunLatency(int argc, char* argv[]){
+    int runs = argc > 0 ? std::max(1, std::atoi(argv[0])) : 50;
+    const std::string source = "/tmp/galaxic_run.gx";
+    const std::string program = "/tmp/galaxic_run";
+
+    std::ofstream(source) << SampleProgram();
+
+    struct Pipeline{
+        const char* name;
+        std::vector<std::string> args;
+    };
+    const Pipeline pipelines[] = {
+        {"run (jit)", {GALAXIC_PATH, "run", source}},
+        {"build + run", {GALAXIC_PATH, source, "-p", "linux64", "-o", program}},
+        {"build + run (nasm)", {GALAXIC_PATH, source, "-p", "linux64", "-o", program, "--via-nasm"}},
+    };
+
+    std::cout << "compiler start to program exit over " << runs << " runs (ms)\n";
+    for(const Pipeline& pipeline : pipelines){
+        std::vector<double> samples;
+        for(int i = 0; i < runs; i++){
+            auto start = std::chrono::steady_clock::now();
+            int status = RunProcess(pipeline.args);
+            auto end = std::chrono::steady_clock::now();
+            if(status != 0)
+                break;
+            samples.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        if(samples.size() != static_cast<size_t>(runs)){
+            std::cout << "  " << pipeline.name << ": failed\n";
+            continue;
+        }
+        Stats stats = Summarize(samples);
+        std::cout << "  " << pipeline.name << ": min " << stats.min << "  median " << stats.median << "  mean " << stats.mean << '\n';
+    }
+
+    for(const std::string& file : {source, program})
+        std::remove(file.c_str());
+    return 0;
+}
+
+static int Interpret(int argc, char* argv[]){
+    int64_t iterations = argc > 0 ? std::max<int64_t>(1, std::atoll(argv[0])) : 10000000;
+
+    std::string source =
+        "long i = 0;\n"
+        "long sum = 0;\n"
+        "while(i < " + std::to_string(iterations) + "){\n"
+        "    sum = sum + i % 7 * 3;\n"
+        "    if(sum > 1000000){\n"
+        "        sum = sum - 1000000;\n"
+        "    }\n"
+        "    i = i + 1;\n"
+        "}\n"
+        "exit(sum % 256);\n ";
+
+    Tokenizer tokenizer(source);
+    Parser parser(tokenizer.tokenize());
+    BytecodeCompiler compiler(parser.parse());
+    Bytecode::Program program;
+    if(!compiler.Compile(program)){
+        std::cout << "failed to compile the benchmark, " << compiler.GetError() << '\n';
+        return 1;
+    }
+
+    Interpreter interpreter;
+    std::vector<double> rates;
+    for(int run = 0; run < 5; run++){
+        int64_t exit_code;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = interpreter.Run(program, exit_code);
+        auto end = std::chrono::steady_clock::now();
+        if(!ok){
+            std::cout << "interpreter failed, " << interpreter.GetError() << '\n';
+            return 1;
+        }
+        rates.emplace_back(interpreter.GetExecuted() / std::chrono::duration<double>(end - start).count());
+    }
+    parser.Clear();
+
+    Stats stats = Summarize(rates);
+    std::cout << program.code.size() << " bytecodes, " << interpreter.GetExecuted() << " executed per run\n"
+              << "  median " << stats.median / 1e6 << " M bytecodes/s  (best " << *std::max_element(rates.begin(), rates.end()) / 1e6 << ")\n";
+    return 0;
+}
+
+static int Emit(int argc, char* argv[]){
+    int blocks = argc > 0 ? std::max(1, std::atoi(argv[0])) : 1000;
+
+    std::string source = SampleProgram(blocks) + ' ';
+    Tokenizer tokenizer(source);
+    Parser parser(tokenizer.tokenize());
+    Generator generator(parser.parse(), PLATFORM_LINUX64);
+    const Asm::Module& module = generator.GenerateInstructions();
+    const std::string file = "galaxic_bench_emit.asm";
+
+    // the old way, every instruction is a temporary string copied into a stream and the stream into a string
+    auto streams = [&](){
+        std::stringstream external, data, bss, text;
+        for(const std::string& name : module.externs)
+            external << "extern " << name << '\n';
+        data << "section .data\n";
+        for(const std::string& line : module.data)
+            data << line << '\n';
+        bss << "section .bss\n";
+        for(const std::string& line : module.bss)
+            bss << line << '\n';
+        text << "section .text\n";
+        for(const std::string& name : module.globals)
+            text << "global " << name << '\n';
+        for(const Asm::Instr& instr : module.text)
+            text << Asm::InstrToString(instr) << '\n';
+        std::ofstream out(file);
+        out << external.str() + data.str() + bss.str() + text.str();
+        return out.good();
+    };
+    auto buffer = [&](){
+        OutputBuffer out;
+        Asm::WriteModule(out, module);
+        return out.WriteFile(file);
+    };
+
+    OutputBuffer sized;
+    Asm::WriteModule(sized, module);
+    double megabytes = sized.Size() / 1e6;
+    std::cout << module.text.size() << " instructions, " << megabytes << " MB of assembly\n";
+
+    struct Method{
+        const char* name;
+        std::function<bool()> emit;
+    };
+    for(const Method& method : {Method{"stringstream", streams}, Method{"OutputBuffer", buffer}}){
+        std::vector<double> rates;
+        for(int run = 0; run < 10; run++){
+            auto start = std::chrono::steady_clock::now();
+            bool ok = method.emit();
+            auto end = std::chrono::steady_clock::now();
+            if(!ok){
+                std::cout << "  " << method.name << ": failed to write `" << file << "`\n";
+                return 1;
+            }
+            rates.emplace_back(megabytes / std::chrono::duration<double>(end - start).count());
+        }
+        Stats stats = Summarize(rates);
+        std::cout << "  " << method.name << ": median " << stats.median << " MB/s  (best "
+                  << *std::max_element(rates.begin(), rates.end()) << ")\n";
+    }
+
+    std::remove(file.c_str());
+    parser.Clear();
+    return 0;
+}
+
+static int Modules(int argc, char* argv[]){
+    int count = argc > 0 ? std::max(1, std::atoi(argv[0])) : 64;
+    int blocks = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+
+    char dir_template[] = "/tmp/galaxic_modulesXXXXXX";
+    if(!mkdtemp(dir_template)){
+        std::cout << "failed to make a temporary directory\n";
+        return 1;
+    }
+    std::string dir = dir_template;
+
+    std::string main_source;
+    std::vector<std::string> files;
+    for(int i = 0; i < count; i++){
+        std::string name = "module" + std::to_string(i) + ".gx";
+        std::ofstream(dir + "/" + name) << SampleProgram(blocks);
+        main_source += "import \"" + name + "\";\n";
+        files.emplace_back(dir + "/" + name);
+    }
+    main_source += "exit(0);\n ";
+    files.emplace_back(dir + "/main.gx");
+    std::ofstream(files.back()) << main_source;
+
+    std::cout << count << " modules of " << blocks << " blocks, load and generate (ms)\n";
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for(unsigned threads = 1; ; threads = std::min(threads * 2, cores)){
+        std::vector<double> samples;
+        size_t instructions = 0;
+        for(int run = 0; run < 5; run++){
+            auto start = std::chrono::steady_clock::now();
+            ModuleGraph graph(threads);
+            graph.Load(files.back(), main_source);
+            instructions = graph.Generate(PLATFORM_LINUX64, Generator::Entry::main).GenerateInstructions().text.size();
+            graph.Clear();
+            auto end = std::chrono::steady_clock::now();
+            samples.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        Stats stats = Summarize(samples);
+        std::cout << "  " << threads << " threads: min " << stats.min << "  median " << stats.median
+                  << "  (" << instructions << " instructions)\n";
+        if(threads == cores)
+            break;
+    }
+
+    for(const std::string& file : files)
+        std::remove(file.c_str());
+    rmdir(dir.c_str());
+    return 0;
+}
+
+static int ServerLatency(int argc, char* argv[]){
+    int runs = argc > 0 ? std::max(1, std::atoi(argv[0])) : 50;
+    const std::string source = "/tmp/galaxic_server.gx";
+    const std::string object = "/tmp/galaxic_server.o";
+    const std::string socket = "/tmp/galaxic_bench-" + std::to_string(getpid()) + ".sock";
+    std::ofstream(source) << SampleProgram(20);
+
+    std::vector<std::string> server_args = {GALAXIC_PATH, "--server", "--socket", socket};
+    std::vector<char*> server_argv;
+    for(std::string& arg : server_args)
+        server_argv.emplace_back(arg.data());
+    server_argv.emplace_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t server;
+    bool started = posix_spawn(&server, server_argv[0], &actions, nullptr, server_argv.data(), environ) == 0;
+    posix_spawn_file_actions_destroy(&actions);
+
+    // the server is ready once a request goes through
+    const std::vector<std::string> compile = {source, "-p", "linux64", "-c", "-o", object};
+    int exit_code = -1;
+    for(int i = 0; started && i < 500 && !Server::Request(socket, compile, exit_code); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if(!started || exit_code != 0){
+        std::cout << "failed to start `" << GALAXIC_PATH << " --server`\n";
+        if(started){
+            kill(server, SIGTERM);
+            waitpid(server, nullptr, 0);
+        }
+        return 1;
+    }
+
+    std::vector<std::string> cold = {GALAXIC_PATH};
+    cold.insert(cold.end(), compile.begin(), compile.end());
+    std::vector<std::string> client = {GALAXIC_PATH, "--client", "--socket", socket};
+    client.insert(client.end(), compile.begin(), compile.end());
+
+    struct Mode{
+        const char* name;
+        std::function<int()> compile;
+    };
+    const Mode modes[] = {
+        {"cold (new process)", [&]{ return RunProcess(cold); }},
+        {"warm (--client)", [&]{ return RunProcess(client); }},
+        {"warm (socket)", [&]{
+            int code = -1;
+            return Server::Request(socket, compile, code) ? code : -1;
+        }},
+    };
+
+    std::cout << "compile latency over " << runs << " runs (ms)\n";
+    for(const Mode& mode : modes){
+        std::vector<double> samples;
+        for(int i = 0; i < runs; i++){
+            auto start = std::chrono::steady_clock::now();
+            int status = mode.compile();
+            auto end = std::chrono::steady_clock::now();
+            if(status != 0)
+                break;
+            samples.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        if(samples.size() != static_cast<size_t>(runs)){
+            std::cout << "  " << mode.name << ": failed\n";
+            continue;
+        }
+        Stats stats = Summarize(samples);
+        std::cout << "  " << mode.name << ": min " << stats.min << "  median " << stats.median << "  mean " << stats.mean << '\n';
+    }
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    std::remove(source.c_str());
+    std::remove(object.c_str());
+    return 0;
+}
+
+static int PrintCorpus(int argc, char* argv[]){
+    std::string shape = argc > 0 ? argv[0] : "mixed";
+    int size = argc > 1 ? std::max(1, std::atoi(argv[1])) : 100;
+    uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+
+    std::string program = Corpus::Generate(shape, size, seed);
+    if(program.empty()){
+        std::cout << "unknown shape `" << shape << "`\n";
+        return 1;
+    }
+    std::cout << program;
+    return 0;
+}
+
+/// The size of every shape that makes a program of a few hundred KB
+static int ShapeSize(const std::string& shape, double scale){
+    int size = 3000;
+    if(shape == "variables" || shape == "expressions")
+        size = 20000;
+    else if(shape == "nesting")
+        size = 200;
+    else if(shape == "chains" || shape == "loops")
+        size = 5000;
+    else if(shape == "unrolled")
+        size = 1000;
+    return std::max(1, static_cast<int>(size * scale));
+}
+
+/// Runs `fn` at least 5 times and for at least 200ms, in milliseconds
+static Stats TimeRuns(const std::function<void()>& fn){
+    std::vector<double> samples;
+    auto begin = std::chrono::steady_clock::now();
+    while(samples.size() < 5 || std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(200)){
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        samples.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return Summarize(samples);
+}
+
+struct Result{
+    std::string name;
+    Stats stats;
+    double megabytes; // of source, 0 when a rate makes no sense
+};
+
+static void PrintResult(const Result& result){
+    std::cout << "  " << std::left << std::setw(26) << result.name << std::right << std::fixed << std::setprecision(3)
+              << "median " << std::setw(10) << result.stats.median << " ms  min " << std::setw(10) << result.stats.min << " ms";
+    if(result.megabytes > 0)
+        std::cout << std::setprecision(1) << std::setw(10) << result.megabytes / (result.stats.median / 1e3) << " MB/s";
+    std::cout << '\n';
+}
+
+/// The three front stages on every shape, each stage gets the output of the one before it already made
+static std::vector<Result> MicroBenchmarks(double scale){
+    std::vector<Result> results;
+    for(const std::string& shape : Corpus::GetShapes()){
+        std::string source = Corpus::Generate(shape, ShapeSize(shape, scale)) + ' ';
+        double megabytes = source.size() / 1e6;
+
+        std::vector<Token> tokens = Tokenizer(source).tokenize();
+        Parser parser(tokens);
+        Node::Program* program = parser.parse();
+
+        results.push_back({"tokenize/" + shape, TimeRuns([&]{ Tokenizer(source).tokenize(); }), megabytes});
+        results.push_back({"parse/" + shape, TimeRuns([&]{
+            Parser timed(tokens);
+            timed.parse();
+            timed.Clear();
+        }), megabytes});
+        results.push_back({"generate/" + shape, TimeRuns([&]{
+            Generator generator(program, PLATFORM_LINUX64);
+            generator.GenerateCode();
+        }), megabytes});
+        parser.Clear();
+    }
+    return results;
+}
+
+static int Micro(int argc, char* argv[]){
+    double scale = argc > 0 ? std::max(0.001, std::atof(argv[0])) : 1.0;
+    for(const Result& result : MicroBenchmarks(scale))
+        PrintResult(result);
+    return 0;
+}
+
+static int Suite(int argc, char* argv[]){
+    std::string output = argc > 0 ? argv[0] : "galaxic_bench.json";
+    double scale = argc > 1 ? std::max(0.001, std::atof(argv[1])) : 1.0;
+
+    std::cout << "front end (scale " << scale << ")\n";
+    std::vector<Result> results = MicroBenchmarks(scale);
+    for(const Result& result : results)
+        PrintResult(result);
+
+    // whole compiles to an object file, process start included
+    std::cout << "end to end\n";
+    const std::string source = "/tmp/galaxic_suite.gx";
+    const std::string object = "/tmp/galaxic_suite.o";
+    for(const std::string& shape : Corpus::GetShapes()){
+        std::string program = Corpus::Generate(shape, ShapeSize(shape, scale));
+        std::ofstream(source) << program;
+        bool failed = false;
+        Stats stats = TimeRuns([&]{
+            failed |= RunProcess({GALAXIC_PATH, source, "-p", "linux64", "-c", "-o", object}) != 0;
+        });
+        if(failed){
+            std::cout << "  compile/" << shape << ": failed\n";
+            continue;
+        }
+        results.push_back({"compile/" + shape, stats, program.size() / 1e6});
+        PrintResult(results.back());
+    }
+    std::remove(source.c_str());
+    std::remove(object.c_str());
+
+    // one result per line, so `compare` and line based tools can read it without a json library
+    std::ofstream file(output);
+    file << std::fixed << std::setprecision(6);
+    file << "{\n  \"compiler\": \"" << GALAXIC_VERSION << "\",\n  \"scale\": " << scale << ",\n  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++){
+        const Result& result = results.at(i);
+        file << "    {\"name\": \"" << result.name << "\", \"median_ms\": " << result.stats.median
+             << ", \"min_ms\": " << result.stats.min << ", \"mean_ms\": " << result.stats.mean
+             << ", \"source_mb\": " << result.megabytes << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    file << "  ]\n}\n";
+    if(!file.good()){
+        std::cout << "failed to write `" << output << "`\n";
+        return 1;
+    }
+    std::cout << "wrote " << output << '\n';
+    return 0;
+}
+
+/// Reads the name and median of every result line written by `suite`
+static bool ReadSuite(const std::string& path, std::vector<std::pair<std::string, double>>& results){
+    std::ifstream file(path);
+    if(!file.is_open())
+        return false;
+
+    std::string line;
+    while(std::getline(file, line)){
+        size_t name = line.find("\"name\": \"");
+        size_t median = line.find("\"median_ms\": ");
+        if(name == std::string::npos || median == std::string::npos)
+            continue;
+        name += 9;
+        results.emplace_back(line.substr(name, line.find('"', name) - name), std::atof(line.c_str() + median + 13));
+    }
+    return true;
+}
+
+static int Compare(int argc, char* argv[]){
+    if(argc < 2){
+        std::cout << "usage: galaxic_bench compare <base.json> <new.json> [percent]\n";
+        return 1;
+    }
+    double threshold = argc > 2 ? std::atof(argv[2]) : 5.0;
+
+    std::vector<std::pair<std::string, double>> base, current;
+    if(!ReadSuite(argv[0], base) || !ReadSuite(argv[1], current)){
+        std::cout << "failed to read the results\n";
+        return 1;
+    }
+
+    int regressions = 0;
+    std::cout << std::fixed << std::setprecision(3);
+    for(const auto& [name, median] : current){
+        auto it = std::find_if(base.begin(), base.end(), [&](const auto& result){ return result.first == name; });
+        if(it == base.end() || it->second <= 0)
+            continue;
+
+        double change = 100 * (median - it->second) / it->second;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        std::cout << "  " << std::left << std::setw(26) << name << std::right << std::setw(10) << it->second << " -> "
+                  << std::setw(10) << median << " ms  " << std::showpos << std::setprecision(1) << std::setw(7) << change
+                  << std::noshowpos << std::setprecision(3) << "%" << (regressed ? "  slower" : "") << '\n';
+    }
+
+    std::cout << regressions << " of " << current.size() << " got slower by more than " << threshold << "%\n";
+    return regressions > 0 ? 1 : 0;
+}
+
+/// Starts the program and waits for it, returns the time it took in milliseconds and its exit code
+static double MeasureRun(const std::string& path, int& status){
+    auto start = std::chrono::steady_clock::now();
+    status = RunProcess({path});
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static int Slp(int argc, char* argv[]){
+    int iterations = argc > 0 ? std::max(1, std::atoi(argv[0])) : 2000000;
+    int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+    const std::string source = "/tmp/galaxic_slp.gx";
+    const std::string program = "/tmp/galaxic_slp";
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> builds = {
+            {"scalar", {"-fno-slp-vectorize"}}, {"sse2", {"-march=x86-64"}}};
+    if(Asm::HostLevel() >= Asm::Level::v3)
+        builds.push_back({"avx2", {"-march=x86-64-v3"}});
+
+    std::cout << "unrolled kernels, 4 groups of 32 bytes, " << iterations << " iterations, median of " << runs << " runs (ms)\n";
+    bool failed = false;
+    for(const char* type : {"int16", "int", "long"}){
+        std::ofstream(source) << Corpus::GenerateUnrolled(type, 4, iterations);
+        std::cout << "  " << std::left << std::setw(6) << type << std::right;
+
+        double scalar = 0;
+        int expected = -1;
+        for(const auto& [name, options] : builds){
+            std::vector<std::string> args = {GALAXIC_PATH, source, "-p", "linux64", "-o", program};
+            args.insert(args.end(), options.begin(), options.end());
+            if(RunProcess(args) != 0){
+                std::cout << "  " << name << ": failed to build";
+                failed = true;
+                continue;
+            }
+
+            std::vector<double> samples;
+            int status = -1;
+            for(int i = 0; i < runs; i++)
+                samples.emplace_back(MeasureRun(program, status));
+            double median = Summarize(samples).median;
+            if(name == "scalar"){
+                scalar = median;
+                expected = status;
+            }
+
+            std::cout << "  " << name << " " << std::fixed << std::setprecision(2) << std::setw(9) << median;
+            if(name != "scalar")
+                std::cout << " (" << scalar / median << "x)";
+            if(status != expected){
+                std::cout << " exit " << status << " != " << expected;
+                failed = true;
+            }
+        }
+        std::cout << '\n';
+    }
+
+    std::remove(source.c_str());
+    std::remove(program.c_str());
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        std::cout << "usage: galaxic_bench compile-latency [file.gx] [runs]\n"
+                     "       galaxic_bench exec-latency [runs]\n"
+                     "       galaxic_bench run-latency [runs]\n"
+                     "       galaxic_bench interpret [iterations]\n"
+                     "       galaxic_bench emit [blocks]\n"
+                     "       galaxic_bench modules [modules] [blocks]\n"
+                     "       galaxic_bench server [runs]\n"
+                     "       galaxic_bench corpus <shape> [size] [seed]\n"
+                     "       galaxic_bench micro [scale]\n"
+                     "       galaxic_bench suite [out.json] [scale]\n"
+                     "       galaxic_bench compare <base.json> <new.json> [percent]\n"
+                     "       galaxic_bench slp [iterations] [runs]\n";
+        return 1;
+    }
+
+    std::string benchmark = argv[1];
+    if(benchmark == "compile-latency")
+        return CompileLatency(argc - 2, argv + 2);
+    if(benchmark == "exec-latency")
+        return ExecLatency(argc - 2, argv + 2);
+    if(benchmark == "run-latency")
+        return RunLatency(argc - 2, argv + 2);
+    if(benchmark == "interpret")
+        return Interpret(argc - 2, argv + 2);
+    if(benchmark == "emit")
+        return Emit(argc - 2, argv + 2);
+    if(benchmark == "modules")
+        return Modules(argc - 2, argv + 2);
+    if(benchmark == "server")
+        return ServerLatency(argc - 2, argv + 2);
+    if(benchmark == "corpus")
+        return PrintCorpus(argc - 2, argv + 2);
+    if(benchmark == "micro")
+        return Micro(argc - 2, argv + 2);
+    if(benchmark == "suite")
+        return Suite(argc - 2, argv + 2);
+    if(benchmark == "compare")
+        return Compare(argc - 2, argv + 2);
+    if(benchmark == "slp")
+        return Slp(argc - 2, argv + 2);
+
+    std::cout << "unknown benchmark `" << benchmark << "`\n";
+    return 1;
+}
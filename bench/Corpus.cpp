@@ -0,0 +1,258 @@
+#include "Corpus.h"
+
+#include <algorithm>
+
+namespace Corpus{
+
+    /// splitmix64, the standard library engines are portable but their distributions are not
+    class Random{
+    public:
+        explicit Random(uint64_t seed) : state(seed) {}
+
+        uint64_t Next(){
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+        /// A number from 0 to count - 1
+        int Below(int count){ return static_cast<int>(Next() % static_cast<uint64_t>(count)); }
+        bool Chance(int percent){ return Below(100) < percent; }
+
+    private:
+        uint64_t state;
+    };
+
+    /// Writes statements with the variables that are visible where they are written
+    class Writer{
+    public:
+        explicit Writer(uint64_t seed) : random(seed) { scopes.emplace_back(); }
+
+        std::string Expr(int depth = 0){
+            if(depth > 2 || random.Chance(35))
+                return Term();
+
+            static const char* ops[] = {"+", "-", "*", "/", "%"};
+            const char* op = ops[random.Below(5)];
+            std::string left = Expr(depth + 1);
+            // only dividing by a literal that isn't 0 is sure to not fault when the program runs
+            std::string right = op[0] == '/' || op[0] == '%' ? std::to_string(1 + random.Below(9)) : Expr(depth + 1);
+            std::string expr = left + " " + op + " " + right;
+            return random.Chance(40) ? "(" + expr + ")" : expr;
+        }
+
+        /// One expression of `terms` terms, mostly flat so its length and not its depth grows
+        std::string LongExpr(int terms){
+            std::string expr = Term();
+            for(int i = 1; i < terms; i++){
+                static const char* ops[] = {"+", "-", "*"};
+                std::string term = random.Chance(10) ? "(" + Term() + " + " + Term() + ")" : Term();
+                expr += std::string(" ") + ops[random.Below(3)] + " " + term;
+            }
+            return expr;
+        }
+
+        std::string Cond(int depth = 0){
+            static const char* comparisons[] = {"==", "!=", ">", ">=", "<", "<="};
+            // a `(` that starts a condition opens a group of conditions, so each side starts with a term
+            std::string cond = Term() + " + " + Expr(1) + " " + comparisons[random.Below(6)] + " " + Term() + " - " + Expr(1);
+            if(depth < 1 && random.Chance(30))
+                cond += std::string(random.Chance(50) ? " && " : " || ") + Cond(depth + 1);
+            return cond;
+        }
+
+        void Line(const std::string& line){
+            out.append(4 * (scopes.size() - 1), ' ');
+            out += line;
+            out += '\n';
+        }
+
+        std::string Declare(const std::string& prefix, const std::string& value){
+            std::string name = prefix + std::to_string(names++);
+            Line("long " + name + " = " + value + ";");
+            scopes.back().emplace_back(name);
+            return name;
+        }
+
+        void Assign(){
+            if(Visible().empty())
+                Declare("v", Expr());
+            else
+                Line(Pick() + " = " + Expr() + ";");
+        }
+
+        void Open(const std::string& header){
+            Line(header + "{");
+            scopes.emplace_back();
+        }
+        void Close(const std::string& after = ""){
+            scopes.pop_back();
+            Line("}" + after);
+        }
+
+        /// A loop that runs `times` times, its counter is declared before it and never assigned by anything else
+        void OpenLoop(int times){
+            std::string counter = "c" + std::to_string(names++);
+            Line("long " + counter + " = 0;");
+            Open("while(" + counter + " < " + std::to_string(times) + ")");
+            Line(counter + " = " + counter + " + 1;");
+        }
+
+        std::string Pick(){
+            std::vector<std::string> visible = Visible();
+            return visible.at(random.Below(static_cast<int>(visible.size())));
+        }
+
+        Random random;
+        std::string out;
+
+    private:
+
+        std::string Term(){
+            std::vector<std::string> visible = Visible();
+            if(!visible.empty() && random.Chance(50))
+                return visible.at(random.Below(static_cast<int>(visible.size())));
+            return std::to_string(random.Below(100));
+        }
+
+        std::vector<std::string> Visible(){
+            std::vector<std::string> visible;
+            for(const std::vector<std::string>& scope : scopes)
+                visible.insert(visible.end(), scope.begin(), scope.end());
+            return visible;
+        }
+
+        std::vector<std::vector<std::string>> scopes;
+        int names = 0;
+    };
+
+    /// An if, an if/else or a short loop with a few statements, nested `depth` more times at most
+    static void Block(Writer& writer, int depth){
+        int kind = writer.random.Below(3);
+        if(kind == 2)
+            writer.OpenLoop(1 + writer.random.Below(3));
+        else
+            writer.Open("if(" + writer.Cond() + ")");
+
+        int statements = 1 + writer.random.Below(3);
+        for(int i = 0; i < statements; i++){
+            if(depth > 0 && writer.random.Chance(25))
+                Block(writer, depth - 1);
+            else if(writer.random.Chance(30))
+                writer.Declare("v", writer.Expr());
+            else
+                writer.Assign();
+        }
+
+        if(kind == 1){
+            writer.Close();
+            writer.Open("else");
+            writer.Assign();
+        }
+        writer.Close();
+    }
+
+    const std::vector<std::string>& GetShapes(){
+        static const std::vector<std::string> shapes = {"variables", "nesting", "expressions", "chains", "loops", "mixed", "unrolled"};
+        return shapes;
+    }
+
+    std::string Generate(const std::string& shape, int size, uint64_t seed){
+        if(shape == "unrolled")
+            return GenerateUnrolled("int", size, 10, seed);
+
+        Writer writer(seed);
+        for(int i = 0; i < 4; i++)
+            writer.Declare("v", std::to_string(writer.random.Below(100)));
+
+        if(shape == "variables"){
+            for(int i = 0; i < size; i++)
+                writer.Declare("v", writer.Expr());
+        }
+        else if(shape == "nesting"){
+            // every level is an if or a loop running once, so running it stays cheap however deep it is
+            for(int i = 0; i < size; i++){
+                if(i % 2 == 0)
+                    writer.Open("if(" + writer.Pick() + " >= 0 || " + writer.Pick() + " < 0)");
+                else
+                    writer.OpenLoop(1);
+                writer.Declare("n", writer.Expr());
+            }
+            for(int i = 0; i < size; i++)
+                writer.Close();
+        }
+        else if(shape == "expressions"){
+            for(int i = 0; i < 8; i++)
+                writer.Declare("e", writer.LongExpr(size));
+        }
+        else if(shape == "chains"){
+            std::string selector = writer.Pick();
+            for(int i = 0; i < size; i++){
+                writer.Open(std::string(i == 0 ? "if(" : "else if(") + selector + " == " + std::to_string(i) + ")");
+                writer.Assign();
+                writer.Close();
+            }
+            writer.Open("else");
+            writer.Assign();
+            writer.Close();
+        }
+        else if(shape == "loops"){
+            for(int i = 0; i < size; i++){
+                writer.OpenLoop(1 + writer.random.Below(4));
+                writer.Assign();
+                writer.Assign();
+                writer.Close();
+            }
+        }
+        else if(shape == "mixed"){
+            for(int i = 0; i < size; i++)
+                Block(writer, 3);
+        }
+        else
+            return "";
+
+        writer.Line("exit(" + writer.Pick() + " % 100);");
+        return writer.out;
+    }
+
+    std::string GenerateUnrolled(const std::string& type, int groups, int iterations, uint64_t seed){
+        static const std::vector<std::pair<std::string, int>> widths = {
+                {"uint8", 1}, {"short", 2}, {"int16", 2}, {"uint16", 2}, {"int", 4}, {"int32", 4}, {"uint32", 4},
+                {"long", 8}, {"int64", 8}, {"uint64", 8}};
+        auto width = std::find_if(widths.begin(), widths.end(), [&](const auto& entry){ return entry.first == type; });
+        if(width == widths.end())
+            return "";
+
+        int lanes = 32 / width->second;
+        Random random(seed);
+        std::string out;
+        auto name = [](char side, int group, int lane){
+            return std::string(1, side) + std::to_string(group) + "_" + std::to_string(lane);
+        };
+
+        // the variables of a side of a group are declared together, the way a generator allocates them
+        for(int g = 0; g < groups; g++)
+            for(char side : {'a', 'b'})
+                for(int lane = 0; lane < lanes; lane++)
+                    out += type + " " + name(side, g, lane) + " = " + std::to_string(1 + random.Below(100)) + ";\n";
+
+        out += "long i = 0;\nwhile(i < " + std::to_string(iterations) + "){\n";
+        for(int g = 0; g < groups; g++){
+            // there is no packed multiply of bytes or of 64 bit lanes before AVX-512
+            static const char* ops[] = {"+", "-", "^", "|", "*"};
+            const char* op = ops[random.Below(width->second == 2 || width->second == 4 ? 5 : 4)];
+            for(int lane = 0; lane < lanes; lane++)
+                out += "    " + name('a', g, lane) + " = " + name('a', g, lane) + " " + op + " " + name('b', g, lane) + ";\n";
+            for(int lane = 0; lane < lanes; lane++)
+                out += "    " + name('b', g, lane) + " = " + name('b', g, lane) + " + " + std::to_string(1 + random.Below(9)) + ";\n";
+        }
+        out += "    i = i + 1;\n}\n";
+
+        std::string sum = "0";
+        for(int g = 0; g < groups; g++)
+            for(int lane = 0; lane < lanes; lane++)
+                sum += " + " + name('a', g, lane);
+        out += "exit((" + sum + ") % 100);\n";
+        return out;
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Generates large .gx programs for the benchmarks. The same shape, size and seed always give the same program,
+/// on every machine, so results of different revisions compare the same inputs
+namespace Corpus{
+    /// variables, nesting, expressions, chains, loops, mixed and unrolled
+    const std::vector<std::string>& GetShapes();
+    /// `size` is how many of the shape's statements there are, an unknown shape gives an empty string
+    std::string Generate(const std::string& shape, int size, uint64_t seed = 1);
+    /// A loop running `iterations` times over `groups` groups of statements doing the same thing to as many variables
+    /// of `type` (int16, int, long, ...) as fill 32 bytes, like the unrolled kernels code generators write. An
+    /// unknown type gives an empty string
+    std::string GenerateUnrolled(const std::string& type, int groups, int iterations, uint64_t seed = 1);
+}
@@ -0,0 +1,289 @@
+// Measures how fast the programs GalaxiC generates run, run `galaxic_kernels [kernel ...] [--runs n]`
+//
+// Every kernel in this directory is a .gx program and a .c program computing the same exit code. The .gx
+// program is built with GalaxiC and the .c program with gcc at -O0, -O1 and -O2, every build runs `runs`
+// times (5 by default) and the median is reported with the ratio of GalaxiC to every gcc level.
+// Cycles and instructions are counted with perf_event_open, when the kernel doesn't allow it only the
+// time is measured and the ratios are of the time
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef GALAXIC_PATH
+    #define GALAXIC_PATH "./GalaxiC"
+#endif
+#ifndef KERNELS_DIR
+    #define KERNELS_DIR "benchmarks"
+#endif
+
+namespace fs = std::filesystem;
+
+struct Build{
+    std::string name;
+    std::string source_extension;
+    std::vector<std::string> command; // the source and `-o output` are added to it
+};
+
+struct Sample{
+    double ms = 0;
+    int64_t cycles = -1; // -1 when they couldn't be counted
+    int64_t instructions = -1;
+    int status = -1;
+};
+
+static bool use_counters = true;
+
+/// Cycles and instructions of user space of one process, counted from its exec until it exits
+class Counters{
+public:
+    ~Counters(){
+        if(instructions >= 0)
+            close(instructions);
+        if(cycles >= 0)
+            close(cycles);
+    }
+
+    bool Open(pid_t pid){
+        cycles = Event(PERF_COUNT_HW_CPU_CYCLES, pid, -1);
+        if(cycles < 0)
+            return false;
+        instructions = Event(PERF_COUNT_HW_INSTRUCTIONS, pid, cycles);
+        return instructions >= 0;
+    }
+
+    bool Read(Sample& sample) const{
+        // the group is read at once: the number of counters and then their values in the order they were opened
+        uint64_t values[3] = {};
+        if(read(cycles, values, sizeof(values)) != sizeof(values) || values[0] != 2)
+            return false;
+        sample.cycles = static_cast<int64_t>(values[1]);
+        sample.instructions = static_cast<int64_t>(values[2]);
+        return true;
+    }
+
+private:
+
+    static int Event(uint64_t config, pid_t pid, int group){
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = group < 0; // members follow the leader
+        attr.enable_on_exec = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, group, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    int cycles = -1;
+    int instructions = -1;
+};
+
+static int Spawn(const std::vector<std::string>& args){
+    pid_t pid = fork();
+    if(pid == 0){
+        std::vector<char*> argv;
+        for(const std::string& arg : args)
+            argv.emplace_back(const_cast<char*>(arg.c_str()));
+        argv.emplace_back(nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = -1;
+    if(pid < 0 || waitpid(pid, &status, 0) < 0)
+        return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/// Runs the program once, the child waits on a pipe until its counters are open so they see all of it
+static Sample Measure(const std::string& path){
+    Sample sample;
+    int gate[2];
+    if(pipe2(gate, O_CLOEXEC) != 0)
+        return sample;
+
+    pid_t pid = fork();
+    if(pid == 0){
+        char go;
+        close(gate[1]);
+        if(read(gate[0], &go, 1) != 1)
+            _exit(127);
+        execl(path.c_str(), path.c_str(), nullptr);
+        _exit(127);
+    }
+    close(gate[0]);
+    if(pid < 0){
+        close(gate[1]);
+        return sample;
+    }
+
+    Counters counters;
+    if(use_counters && !counters.Open(pid))
+        use_counters = false;
+
+    auto start = std::chrono::steady_clock::now();
+    ssize_t written = write(gate[1], "g", 1);
+    close(gate[1]);
+    int status = -1;
+    waitpid(pid, &status, 0);
+    auto end = std::chrono::steady_clock::now();
+
+    if(written != 1 || !WIFEXITED(status))
+        return sample;
+    sample.status = WEXITSTATUS(status);
+    sample.ms = std::chrono::duration<double, std::milli>(end - start).count();
+    if(use_counters && !counters.Read(sample))
+        sample.cycles = sample.instructions = -1;
+    return sample;
+}
+
+/// The median of every measurement, the exit code is of the first run
+static Sample Median(std::vector<Sample> samples){
+    Sample median = samples.front();
+    auto middle = [&](auto member){
+        std::sort(samples.begin(), samples.end(), [&](const Sample& a, const Sample& b){ return a.*member < b.*member; });
+        return samples.at(samples.size() / 2).*member;
+    };
+    median.ms = middle(&Sample::ms);
+    median.cycles = middle(&Sample::cycles);
+    median.instructions = middle(&Sample::instructions);
+    return median;
+}
+
+/// What the ratios compare, cycles when they were counted and the time otherwise
+static double Cost(const Sample& sample){
+    return sample.cycles > 0 ? static_cast<double>(sample.cycles) : sample.ms;
+}
+
+static std::vector<std::string> FindKernels(){
+    std::vector<std::string> kernels;
+    std::error_code error;
+    for(const fs::directory_entry& entry : fs::directory_iterator(KERNELS_DIR, error)){
+        fs::path path = entry.path();
+        if(path.extension() == ".gx" && fs::exists(fs::path(path).replace_extension(".c")))
+            kernels.emplace_back(path.stem().string());
+    }
+    std::sort(kernels.begin(), kernels.end());
+    return kernels;
+}
+
+int main(int argc, char* argv[]){
+    int runs = 5;
+    std::vector<std::string> kernels;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if(arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "-h" || arg == "--help"){
+            std::cout << "usage: galaxic_kernels [kernel ...] [--runs n]\n";
+            return 0;
+        }
+        else
+            kernels.emplace_back(arg);
+    }
+    if(kernels.empty())
+        kernels = FindKernels();
+    if(kernels.empty()){
+        std::cerr << "no kernels found in `" << KERNELS_DIR << "`\n";
+        return 1;
+    }
+    for(const std::string& kernel : kernels){
+        fs::path path = fs::path(KERNELS_DIR) / (kernel + ".gx");
+        if(!fs::exists(path) || !fs::exists(fs::path(path).replace_extension(".c"))){
+            std::cerr << "`" << kernel << "` needs a .gx and a .c program in `" << KERNELS_DIR << "`\n";
+            return 1;
+        }
+    }
+
+    // GalaxiC first, every gcc level is compared with it
+    const std::vector<Build> builds = {
+            {"galaxic", ".gx", {GALAXIC_PATH}},
+            {"gcc -O0", ".c", {"gcc", "-O0"}},
+            {"gcc -O1", ".c", {"gcc", "-O1"}},
+            {"gcc -O2", ".c", {"gcc", "-O2"}},
+    };
+
+    {
+        Counters probe;
+        use_counters = probe.Open(0);
+        if(!use_counters)
+            std::cout << "perf_event_open is not available (" << std::strerror(errno) << "), only measuring the time\n\n";
+    }
+
+    char dir_template[] = "/tmp/galaxic_kernels.XXXXXX";
+    if(!mkdtemp(dir_template)){
+        std::cerr << "failed to make a directory for the builds\n";
+        return 1;
+    }
+    fs::path dir = dir_template;
+
+    bool failed = false;
+    std::cout << std::fixed;
+    for(const std::string& kernel : kernels){
+        std::cout << kernel << " (" << runs << " runs)\n";
+        std::cout << "  build             exit      median ms          cycles    instructions     IPC\n";
+
+        std::vector<Sample> results;
+        for(size_t b = 0; b < builds.size(); b++){
+            const Build& build = builds.at(b);
+            std::string output = (dir / (kernel + "_" + std::to_string(b))).string();
+            std::vector<std::string> command = build.command;
+            command.insert(command.end(), {(fs::path(KERNELS_DIR) / (kernel + build.source_extension)).string(), "-o", output});
+
+            std::cout << "  " << std::left << std::setw(14) << build.name << std::right;
+            if(Spawn(command) != 0){
+                std::cout << "  failed to build\n";
+                failed = true;
+                results.emplace_back();
+                continue;
+            }
+
+            std::vector<Sample> samples;
+            for(int i = 0; i < runs; i++)
+                samples.emplace_back(Measure(output));
+            Sample median = Median(samples);
+            results.emplace_back(median);
+            fs::remove(output);
+
+            std::cout << std::setw(8) << median.status << std::setw(15) << std::setprecision(3) << median.ms;
+            if(median.cycles > 0)
+                std::cout << std::setw(16) << median.cycles << std::setw(16) << median.instructions << std::setw(8)
+                          << std::setprecision(2) << static_cast<double>(median.instructions) / median.cycles;
+            if(b > 0 && median.status != results.front().status){
+                std::cout << "  exit code differs from " << builds.front().name;
+                failed = true;
+            }
+            std::cout << '\n';
+        }
+
+        const Sample& galaxic = results.front();
+        std::cout << "  " << builds.front().name << (galaxic.cycles > 0 ? " cycles" : " time") << " per gcc";
+        for(size_t b = 1; b < builds.size(); b++){
+            const Sample& result = results.at(b);
+            std::cout << "  " << builds.at(b).name.substr(4) << ' ';
+            if(galaxic.status < 0 || result.status < 0 || Cost(result) <= 0)
+                std::cout << '-';
+            else
+                std::cout << std::setprecision(2) << Cost(galaxic) / Cost(result) << 'x';
+        }
+        std::cout << "\n\n";
+    }
+
+    fs::remove_all(dir);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+// Bit manipulation, a xorshift generator whose outputs are shifted, masked and mixed into a sum
+#include <stdlib.h>
+
+static volatile long count = 50000000;
+
+// a left shift of a negative long is undefined in C, GalaxiC shifts the bits like the cpu does
+static long shl(long x, int n){
+    return (long)((unsigned long)x << n);
+}
+
+int main(void){
+    long n = count;
+    long x = 88172645463325252;
+    long sum = 0;
+    long i = 0;
+    while(i < n){
+        x = x ^ shl(x, 13);
+        x = x ^ x >> 7;
+        x = x ^ shl(x, 17);
+        sum = (long)((unsigned long)sum + (unsigned long)(x >> 11 & 1023)) ^ (x & 255);
+        i = i + 1;
+    }
+    exit(sum & 255);
+}
@@ -0,0 +1,21 @@
+// Counting loops, a nest of two loops that only count
+#include <stdlib.h>
+
+// the bounds are read at run time like the .gx program has to, so the loops aren't computed while compiling
+static volatile long outer_count = 20000;
+static volatile long inner_count = 10000;
+
+int main(void){
+    long outers = outer_count, inners = inner_count;
+    long outer = 0;
+    long total = 0;
+    while(outer < outers){
+        long inner = 0;
+        while(inner < inners){
+            inner = inner + 1;
+            total = total + 1;
+        }
+        outer = outer + 1;
+    }
+    exit(total % 256);
+}
@@ -0,0 +1,21 @@
+// Hashing, FNV-1a of the two low bytes of a counter, every hash goes in a bucket by an unsigned modulo
+#include <stdint.h>
+#include <stdlib.h>
+
+static volatile uint32_t count = 20000000;
+
+int main(void){
+    uint32_t n = count;
+    uint64_t h = 14695981039346656037ull;
+    uint64_t buckets = 0;
+    uint32_t i = 0;
+    while(i < n){
+        h = h ^ (i & 255);
+        h = h * 1099511628211ull;
+        h = h ^ (i >> 8 & 255);
+        h = h * 1099511628211ull;
+        buckets = buckets + h % 1000 + (h >> 32) % 1024;
+        i = i + 1;
+    }
+    exit(buckets % 256);
+}
@@ -0,0 +1,23 @@
+// Modulo heavy code, counting the primes below 300000 by trial division
+#include <stdlib.h>
+
+static volatile long limit = 300000;
+
+int main(void){
+    long end = limit;
+    long n = 2;
+    long primes = 0;
+    while(n < end){
+        long d = 2;
+        long prime = 1;
+        while(d * d <= n && prime == 1){
+            if(n % d == 0){
+                prime = 0;
+            }
+            d = d + 1;
+        }
+        primes = primes + prime;
+        n = n + 1;
+    }
+    exit(primes % 256);
+}
@@ -0,0 +1,18 @@
+// An arithmetic reduction, a running sum kept below a prime so it never overflows
+#include <stdlib.h>
+
+static volatile long count = 100000000;
+
+int main(void){
+    long n = count;
+    long i = 0;
+    long sum = 0;
+    while(i < n){
+        sum = sum + i * 7 + 3;
+        if(sum >= 1000000007){
+            sum = sum - 1000000007;
+        }
+        i = i + 1;
+    }
+    exit(sum % 256);
+}
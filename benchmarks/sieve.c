@@ -0,0 +1,33 @@
+// Array heavy code, counting the primes below 1000000 with the sieve of Eratosthenes 20 times
+#include <stdlib.h>
+
+static unsigned char composite[1000000];
+static volatile long limit = 1000000;
+
+int main(void){
+    long end = limit;
+    long primes = 0;
+    long round = 0;
+    while(round < 20){
+        long i = 0;
+        while(i < end){
+            composite[i] = 0;
+            i = i + 1;
+        }
+        primes = 0;
+        i = 2;
+        while(i < end){
+            if(composite[i] == 0){
+                primes = primes + 1;
+                long m = i * i;
+                while(m < end){
+                    composite[m] = 1;
+                    m = m + i;
+                }
+            }
+            i = i + 1;
+        }
+        round = round + 1;
+    }
+    exit(primes % 256);
+}
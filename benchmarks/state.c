@@ -0,0 +1,43 @@
+// A branchy state machine, looking for the input 1 2 3 in a stream of random inputs from 0 to 3
+#include <stdlib.h>
+
+static volatile long count = 30000000;
+
+int main(void){
+    long n = count;
+    long x = 12345;
+    long state = 0;
+    long found = 0;
+    long i = 0;
+    while(i < n){
+        x = (x * 1103515245 + 12345) % 2147483648;
+        long input = x / 65536 % 4;
+        if(state == 0){
+            if(input == 1){
+                state = 1;
+            }
+        }
+        else if(state == 1){
+            if(input == 2){
+                state = 2;
+            }
+            else if(input != 1){
+                state = 0;
+            }
+        }
+        else{
+            if(input == 3){
+                found = found + 1;
+                state = 0;
+            }
+            else if(input == 1){
+                state = 1;
+            }
+            else{
+                state = 0;
+            }
+        }
+        i = i + 1;
+    }
+    exit(found % 256);
+}
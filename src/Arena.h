@@ -1,29 +1,105 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <vector>
+
 class ArenaAllocator{
 public:
     inline explicit ArenaAllocator(size_t bytes) : _bytes(bytes){
-        _buffer = static_cast<std::byte *>(malloc(_bytes));
-        _offset = _buffer;
+        NewBlock(_bytes);
     }
 
+    /// Nodes are constructed in place and never destroyed, they only own memory of the arena
     template<typename T>
     inline T* alloc(){
-        void* offset = _offset;
-        _offset += sizeof(T);
-        return static_cast<T*>(offset);
+        size_t align = alignof(T);
+        auto address = reinterpret_cast<uintptr_t>(_offset);
+        std::byte* start = _offset + ((align - address % align) % align);
+        if(start + sizeof(T) > _end){
+            // a new block keeps everything that was allocated before where it is
+            NewBlock(std::max(_bytes, sizeof(T) + align));
+            return alloc<T>();
+        }
+
+        _offset = start + sizeof(T);
+        _allocations++;
+        _used += sizeof(T);
+        return new (start) T();
+    }
+
+    /// How many nodes were allocated and how many bytes they take, for -ftime-report
+    inline size_t GetAllocations() const { return _allocations; }
+    inline size_t GetBytesUsed() const { return _used; }
+    inline size_t GetBytesReserved() const {
+        size_t bytes = 0;
+        for(size_t size : _block_sizes)
+            bytes += size;
+        return bytes;
     }
 
     inline ArenaAllocator(const ArenaAllocator& other) = delete;
     inline ArenaAllocator operator=(const ArenaAllocator& other) = delete;
 
+    inline ~ArenaAllocator(){
+        Delete();
+    }
+
+    /// The first block is kept for the next arena of the thread, its pages are already mapped in.
+    /// Compiling many files one after another then never allocates the arena again
     inline void Delete(){
-        free(_buffer);
+        for(size_t i = 0; i < _blocks.size(); i++){
+            Spare& spare = GetSpare();
+            if(i == 0 && !spare.data){
+                spare.data = _blocks.at(i);
+                spare.size = _block_sizes.at(i);
+            }
+            else
+                free(_blocks.at(i));
+        }
+        _blocks.clear();
+        _block_sizes.clear();
+        _offset = _end = nullptr;
     }
 
 private:
 
+    struct Spare{
+        std::byte* data = nullptr;
+        size_t size = 0;
+        inline ~Spare(){ free(data); }
+    };
+
+    inline void NewBlock(size_t bytes){
+        Spare& spare = GetSpare();
+        if(spare.data && spare.size >= bytes){
+            bytes = spare.size;
+            _offset = spare.data;
+            spare.data = nullptr;
+        }
+        else
+            _offset = static_cast<std::byte*>(malloc(bytes));
+        if(!_offset)
+            throw std::bad_alloc();
+        _end = _offset + bytes;
+        _blocks.emplace_back(_offset);
+        _block_sizes.emplace_back(bytes);
+    }
+
+    /// The block kept by the last arena of the thread
+    inline static Spare& GetSpare(){
+        static thread_local Spare spare;
+        return spare;
+    }
+
     size_t _bytes;
-    std::byte* _buffer;
-    std::byte* _offset;
-};
\ No newline at end of file
+    std::vector<std::byte*> _blocks;
+    std::vector<size_t> _block_sizes;
+    std::byte* _offset = nullptr;
+    std::byte* _end = nullptr;
+    size_t _allocations = 0;
+    size_t _used = 0;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PCH.h"
+#include "Core.h"
+#include "Instruction.h"
+
+struct Arguments{
+    int target = PLATFORM_DEFAULT;
+    std::string input_file;
+    std::string output_file;
+    bool via_nasm = false;     // --via-nasm, assemble the generated text with nasm instead of encoding it directly
+    bool compile_only = false; // -c, stop after writing the object file
+    std::string assembly_file; // -S, stop after writing the assembly to this file, `-` is stdout
+    bool freestanding = false; // --freestanding, start at _start and link without libc
+    Asm::Level march = Asm::Level::v1; // -march, the x86-64 level whose instructions the code may use
+    bool bounds_checks = false; // -fbounds-check, an array index out of bounds stops the program
+    bool vectorize = true; // -fno-slp-vectorize turns packing statements into vector instructions off
+    bool jit = false;          // `run`, run the program in memory instead of writing an executable
+    bool interpret = false;    // --interpret, `run` the program with the bytecode interpreter
+    bool check = false;        // --check, `run` with both the interpreter and native code and compare the results
+    bool debug_info = false;   // -g, a line table in the object and a perf map of the code `run` runs
+    bool gc_sections = true;   // --no-gc-sections, link the code and data nothing refers to as well
+    bool print_gc_sections = false; // --print-gc-sections, list what linking dropped and the bytes it saved
+    bool profile_generate = false; // -fprofile-generate[=file], the program writes how often its branches ran
+    bool profile_use = false;      // -fprofile-use[=file], lay out the branches by a written profile
+    std::string profile_file;      // <input>.gxprof when no file is given
+    unsigned threads = 0;      // -j, threads for compiling imported modules at once, 0 is one per core
+    bool time_report = false;  // -ftime-report, print how long every phase took and how much it worked on
+    std::string trace_file;    // --trace, write the phases as Chrome trace events
+    bool cache = false;        // --cache or --cache-dir, reuse the object of an unchanged program
+    std::string cache_dir;
+    uint64_t cache_size = 512 * 1024 * 1024; // --cache-size in MB, the least recently used entries are removed above it
+};
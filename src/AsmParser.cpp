@@ -0,0 +1,490 @@
+#include "AsmParser.h"
+
+static std::string Trim(const std::string& str){
+    size_t start = str.find_first_not_of(" \t\r");
+    if(start == std::string::npos)
+        return "";
+    size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(start, end - start + 1);
+}
+
+static std::string ToLower(std::string str){
+    for(char& c : str)
+        c = static_cast<char>(tolower(c));
+    return str;
+}
+
+static bool IsSymbolChar(char c){
+    return isalnum(c) || c == '_' || c == '.' || c == '$' || c == '@' || c == '?';
+}
+
+static bool IsSymbol(const std::string& str){
+    if(str.empty() || isdigit(str.at(0)))
+        return false;
+    for(char c : str)
+        if(!IsSymbolChar(c))
+            return false;
+    return true;
+}
+
+static std::string RemoveComment(const std::string& line){
+    bool quote = false;
+    for(size_t i = 0; i < line.length(); i++){
+        if(line.at(i) == '\'' || line.at(i) == '`')
+            quote = !quote;
+        else if(line.at(i) == ';' && !quote)
+            return line.substr(0, i);
+    }
+    return line;
+}
+
+bool AsmParser::Fail(const std::string& line, const std::string& msg) {
+    error = msg + " in `" + line + "`";
+    return false;
+}
+
+std::string AsmParser::QualifyLabel(const std::string& label) {
+    // nasm local labels belong to the last non-local label
+    if(!label.empty() && label.at(0) == '.')
+        return last_global_label + label;
+    return label;
+}
+
+std::string AsmParser::StripLabel(std::string& line) {
+    size_t i = 0;
+    while(i < line.length() && IsSymbolChar(line.at(i)))
+        i++;
+
+    if(i == 0 || i >= line.length() || line.at(i) != ':')
+        return "";
+
+    std::string label = line.substr(0, i);
+    line = Trim(line.substr(i + 1));
+
+    if(label.at(0) != '.')
+        last_global_label = label;
+    return QualifyLabel(label);
+}
+
+std::vector<std::string> AsmParser::SplitOperands(const std::string& str) {
+    std::vector<std::string> operands;
+    std::string buffer;
+    bool quote = false;
+    int brackets = 0;
+
+    for(char c : str){
+        if(c == '\'' || c == '`')
+            quote = !quote;
+        else if(!quote && c == '[')
+            brackets++;
+        else if(!quote && c == ']')
+            brackets--;
+
+        if(c == ',' && !quote && brackets == 0){
+            operands.emplace_back(Trim(buffer));
+            buffer.clear();
+        }
+        else
+            buffer += c;
+    }
+
+    if(!Trim(buffer).empty())
+        operands.emplace_back(Trim(buffer));
+
+    return operands;
+}
+
+bool AsmParser::ParseNumber(const std::string& str, int64_t& value) {
+    if(str.empty())
+        return false;
+
+    if(str.length() == 3 && (str.at(0) == '\'' || str.at(0) == '`') && str.at(2) == str.at(0)){
+        value = static_cast<unsigned char>(str.at(1));
+        return true;
+    }
+
+    std::string digits = ToLower(str);
+    bool negative = false;
+    if(digits.at(0) == '-' || digits.at(0) == '+'){
+        negative = digits.at(0) == '-';
+        digits = Trim(digits.substr(1));
+    }
+
+    int base = 10;
+    if(digits.length() > 2 && digits.at(0) == '0' && digits.at(1) == 'x'){
+        base = 16;
+        digits = digits.substr(2);
+    }
+    else if(digits.length() > 1 && digits.back() == 'h' && isdigit(digits.at(0))){
+        base = 16;
+        digits.pop_back();
+    }
+    else if(digits.length() > 2 && digits.at(0) == '0' && digits.at(1) == 'b'){
+        base = 2;
+        digits = digits.substr(2);
+    }
+
+    if(digits.empty())
+        return false;
+
+    uint64_t result = 0;
+    for(char c : digits){
+        int digit;
+        if(c == '_')
+            continue;
+        if(isdigit(c))
+            digit = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else
+            return false;
+
+        if(digit >= base)
+            return false;
+        result = result * base + digit;
+    }
+
+    value = negative ? -static_cast<int64_t>(result) : static_cast<int64_t>(result);
+    return true;
+}
+
+bool AsmParser::ParseRegister(const std::string& str, Asm::Reg& reg, uint8_t& size) {
+    static std::unordered_map<std::string, std::pair<Asm::Reg, uint8_t>> registers = [](){
+        std::unordered_map<std::string, std::pair<Asm::Reg, uint8_t>> map;
+        for(uint8_t id = 0; id < 16; id++){
+            for(uint8_t width : {1, 2, 4, 8, 16, 32})
+                map[Asm::RegToString(static_cast<Asm::Reg>(id), width)] = {static_cast<Asm::Reg>(id), width};
+        }
+        return map;
+    }();
+
+    auto it = registers.find(ToLower(str));
+    if(it == registers.end())
+        return false;
+
+    reg = it->second.first;
+    size = it->second.second;
+    return true;
+}
+
+bool AsmParser::ParseMemory(const std::string& str, Asm::Operand& op) {
+    std::string inside = Trim(str.substr(1, str.length() - 2));
+    op.kind = Asm::Operand::Kind::mem;
+    op.base = false;
+
+    std::string lower = ToLower(inside);
+    if(lower.rfind("rel ", 0) == 0){
+        op.rip = true;
+        inside = Trim(inside.substr(4));
+    }
+    else if(lower.rfind("abs ", 0) == 0){
+        inside = Trim(inside.substr(4));
+    }
+
+    // splits on + and - while keeping the sign with the term
+    std::vector<std::string> terms;
+    std::string buffer;
+    for(char c : inside){
+        if((c == '+' || c == '-') && !Trim(buffer).empty()){
+            terms.emplace_back(Trim(buffer));
+            buffer.clear();
+        }
+        buffer += c;
+    }
+    if(!Trim(buffer).empty())
+        terms.emplace_back(Trim(buffer));
+
+    for(std::string term : terms){
+        bool negative = false;
+        if(term.at(0) == '+' || term.at(0) == '-'){
+            negative = term.at(0) == '-';
+            term = Trim(term.substr(1));
+        }
+
+        Asm::Reg reg;
+        uint8_t size;
+        size_t star = term.find('*');
+        if(star != std::string::npos){
+            std::string lhs = Trim(term.substr(0, star));
+            std::string rhs = Trim(term.substr(star + 1));
+            int64_t scale;
+            if(ParseRegister(lhs, reg, size) && ParseNumber(rhs, scale)){}
+            else if(ParseRegister(rhs, reg, size) && ParseNumber(lhs, scale)){}
+            else return false;
+
+            if(negative || op.scale || size != 8 || reg == Asm::Reg::rsp ||
+               (scale != 1 && scale != 2 && scale != 4 && scale != 8))
+                return false;
+
+            op.index = reg;
+            op.scale = static_cast<uint8_t>(scale);
+        }
+        else if(ParseRegister(term, reg, size)){
+            if(negative || size != 8)
+                return false;
+
+            if(!op.base){
+                op.base = true;
+                op.reg = reg;
+            }
+            else if(!op.scale){
+                op.index = reg;
+                op.scale = 1;
+            }
+            else
+                return false;
+        }
+        else{
+            int64_t value;
+            if(ParseNumber(term, value))
+                op.value += negative ? -value : value;
+            else if(IsSymbol(term) && !negative && op.name.empty())
+                op.name = QualifyLabel(term);
+            else
+                return false;
+        }
+    }
+
+    if(op.rip && (op.base || op.scale))
+        return false;
+
+    return true;
+}
+
+bool AsmParser::ParseOperand(std::string str, Asm::Operand& op) {
+    uint8_t size = 0;
+    std::string lower = ToLower(str);
+    for(auto [word, bytes] : std::vector<std::pair<std::string, uint8_t>>{
+            {"byte", 1}, {"word", 2}, {"dword", 4}, {"qword", 8}}){
+        if(lower.rfind(word + ' ', 0) == 0 || lower.rfind(word + '[', 0) == 0){
+            size = bytes;
+            str = Trim(str.substr(word.length()));
+            if(ToLower(str).rfind("ptr ", 0) == 0)
+                str = Trim(str.substr(4));
+            break;
+        }
+    }
+
+    if(str.empty())
+        return false;
+
+    if(str.front() == '[' && str.back() == ']'){
+        if(!ParseMemory(str, op))
+            return false;
+        op.size = size;
+        return true;
+    }
+
+    Asm::Reg reg;
+    uint8_t reg_size;
+    if(ParseRegister(str, reg, reg_size)){
+        op = Asm::R(reg, reg_size);
+        return true;
+    }
+
+    int64_t value;
+    if(ParseNumber(str, value)){
+        op = Asm::Imm(value);
+        op.size = size;
+        return true;
+    }
+
+    if(IsSymbol(str)){
+        op = Asm::Label(QualifyLabel(str));
+        op.size = size;
+        return true;
+    }
+
+    return false;
+}
+
+bool AsmParser::ParseDirective(const std::string& word, const std::string& rest, std::vector<std::string>& globals, bool& handled) {
+    handled = true;
+
+    if(word == "global"){
+        for(const std::string& name : SplitOperands(rest)){
+            if(!IsSymbol(name))
+                return false;
+            globals.emplace_back(name);
+        }
+        return true;
+    }
+    if(word == "align" || word == "alignb"){
+        // only meaningful for the data lines, text keeps its natural layout. alignb is the one nasm wants in the bss
+        return true;
+    }
+
+    handled = false;
+    return true;
+}
+
+bool AsmParser::ParseText(const std::string& line_in, std::vector<Asm::Instr>& out, std::vector<std::string>& globals) {
+    std::string line = Trim(RemoveComment(line_in));
+    if(line.empty())
+        return true;
+
+    std::string label = StripLabel(line);
+    if(!label.empty()){
+        Asm::Instr instr{Asm::Op::label};
+        instr.dst = Asm::Label(label);
+        out.emplace_back(instr);
+    }
+    if(line.empty())
+        return true;
+
+    size_t space = line.find_first_of(" \t");
+    std::string mnemonic = ToLower(line.substr(0, space));
+    std::string rest = space == std::string::npos ? "" : Trim(line.substr(space));
+
+    // functions of a library can be put in their own sections, which the linker drops when nothing calls them
+    if(mnemonic == "section" || mnemonic == "segment"){
+        std::string name = rest.substr(0, rest.find_first_of(" \t"));
+        if(name != ".text" && name.compare(0, 6, ".text.") != 0)
+            return Fail(line_in, "Only code sections, `.text` and `.text.<name>`, can be used in assembly text");
+        Asm::Instr instr{Asm::Op::section};
+        instr.dst = Asm::Label(name);
+        out.emplace_back(instr);
+        return true;
+    }
+
+    bool handled;
+    if(!ParseDirective(mnemonic, rest, globals, handled))
+        return Fail(line_in, "Invalid directive");
+    if(handled)
+        return true;
+
+    static std::unordered_map<std::string, Asm::Op> ops = [](){
+        std::unordered_map<std::string, Asm::Op> map;
+        for(int i = 0; i < static_cast<int>(Asm::Op::label); i++)
+            map[Asm::OpToString(static_cast<Asm::Op>(i))] = static_cast<Asm::Op>(i);
+        // aliases nasm accepts
+        map["jz"] = Asm::Op::je;
+        map["jnz"] = Asm::Op::jne;
+        map["jnle"] = Asm::Op::jg;
+        map["jnl"] = Asm::Op::jge;
+        map["jnge"] = Asm::Op::jl;
+        map["jng"] = Asm::Op::jle;
+        map["jnbe"] = Asm::Op::ja;
+        map["jnb"] = Asm::Op::jae;
+        map["jnc"] = Asm::Op::jae;
+        map["jnae"] = Asm::Op::jb;
+        map["jc"] = Asm::Op::jb;
+        map["jna"] = Asm::Op::jbe;
+        map["movsxd"] = Asm::Op::movsx;
+        // the AVX forms, the operands tell them apart
+        for(int i = static_cast<int>(Asm::Op::movdqa); i <= static_cast<int>(Asm::Op::pmulld); i++)
+            map["v" + Asm::OpToString(static_cast<Asm::Op>(i))] = static_cast<Asm::Op>(i);
+        return map;
+    }();
+
+    auto it = ops.find(mnemonic);
+    if(it == ops.end())
+        return Fail(line_in, "Unsupported instruction `" + mnemonic + "`");
+
+    Asm::Instr instr{it->second};
+    std::vector<std::string> operands = SplitOperands(rest);
+    bool three_operands = (instr.op >= Asm::Op::andn && instr.op <= Asm::Op::mulx) || instr.op == Asm::Op::imul ||
+                          Asm::IsVector(instr.op);
+    if(operands.size() > (three_operands ? 3 : 2))
+        return Fail(line_in, "Too many operands");
+
+    if(operands.size() > 0 && !ParseOperand(operands.at(0), instr.dst))
+        return Fail(line_in, "Unsupported operand `" + operands.at(0) + "`");
+    if(operands.size() > 1 && !ParseOperand(operands.at(1), instr.src))
+        return Fail(line_in, "Unsupported operand `" + operands.at(1) + "`");
+    if(operands.size() > 2 && !ParseOperand(operands.at(2), instr.src2))
+        return Fail(line_in, "Unsupported operand `" + operands.at(2) + "`");
+
+    out.emplace_back(instr);
+    return true;
+}
+
+bool AsmParser::ParseData(const std::string& line_in, DataLine& out, std::vector<std::string>& globals) {
+    std::string line = Trim(RemoveComment(line_in));
+    if(line.empty())
+        return true;
+
+    out.label = StripLabel(line);
+
+    size_t space = line.find_first_of(" \t");
+    std::string word = ToLower(line.substr(0, space));
+    std::string rest = space == std::string::npos ? "" : Trim(line.substr(space));
+
+    bool handled;
+    if(!ParseDirective(word, rest, globals, handled))
+        return Fail(line_in, "Invalid directive");
+    if(handled){
+        if(word == "align" || word == "alignb"){
+            int64_t align;
+            if(!ParseNumber(rest, align) || align <= 0)
+                return Fail(line_in, "Invalid alignment");
+            out.align = static_cast<uint64_t>(align);
+        }
+        return true;
+    }
+
+    static std::unordered_map<std::string, uint8_t> widths = {
+            {"db", 1}, {"dw", 2}, {"dd", 4}, {"dq", 8},
+            {"resb", 1}, {"resw", 2}, {"resd", 4}, {"resq", 8},
+    };
+
+    // nasm also allows the label without a colon, `msg db 'hi'`
+    if(out.label.empty() && widths.find(word) == widths.end() && IsSymbol(word) && space != std::string::npos){
+        std::string next = ToLower(rest.substr(0, rest.find_first_of(" \t")));
+        if(widths.find(next) != widths.end()){
+            if(word.at(0) != '.')
+                last_global_label = line.substr(0, space);
+            out.label = QualifyLabel(line.substr(0, space));
+            line = rest;
+            space = line.find_first_of(" \t");
+            word = ToLower(line.substr(0, space));
+            rest = space == std::string::npos ? "" : Trim(line.substr(space));
+        }
+    }
+
+    if(word.empty())
+        return true;
+
+    auto it = widths.find(word);
+    if(it == widths.end())
+        return Fail(line_in, "Unsupported data directive `" + word + "`");
+    uint8_t width = it->second;
+
+    if(word.rfind("res", 0) == 0){
+        int64_t count;
+        if(!ParseNumber(rest, count) || count < 0)
+            return Fail(line_in, "Invalid reserve count");
+        out.reserve = static_cast<uint64_t>(count) * width;
+        return true;
+    }
+
+    for(const std::string& value : SplitOperands(rest)){
+        if(value.length() >= 2 && (value.front() == '\'' || value.front() == '`') && value.back() == value.front()){
+            // strings are padded to the width of the directive
+            std::string str = value.substr(1, value.length() - 2);
+            for(char c : str)
+                out.bytes.emplace_back(static_cast<uint8_t>(c));
+            while(out.bytes.size() % width)
+                out.bytes.emplace_back(0);
+            continue;
+        }
+
+        int64_t number;
+        if(ParseNumber(value, number)){
+            for(uint8_t i = 0; i < width; i++)
+                out.bytes.emplace_back(static_cast<uint8_t>(static_cast<uint64_t>(number) >> (i * 8)));
+            continue;
+        }
+
+        if(IsSymbol(value) && (width == 4 || width == 8)){
+            out.refs.emplace_back(SymbolRef{out.bytes.size(), width, QualifyLabel(value)});
+            for(uint8_t i = 0; i < width; i++)
+                out.bytes.emplace_back(0);
+            continue;
+        }
+
+        return Fail(line_in, "Unsupported data value `" + value + "`");
+    }
+
+    return true;
+}
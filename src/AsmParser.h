@@ -0,0 +1,44 @@
+#pragma once
+
+#include "PCH.h"
+#include "Instruction.h"
+
+/// Reads the assembly lines the user writes with `_asm_text`, `_asm_data` and `_asm_bss`
+/// so they can be encoded without nasm, only the subset the encoder supports is understood
+class AsmParser{
+public:
+    struct SymbolRef{
+        uint64_t offset; // offset in the bytes of the line
+        uint8_t size;
+        std::string symbol;
+    };
+
+    struct DataLine{
+        std::string label;
+        std::vector<uint8_t> bytes;
+        std::vector<SymbolRef> refs;
+        uint64_t reserve = 0; // bytes reserved by resb/resw/resd/resq
+        uint64_t align = 1;
+    };
+
+    /// Returns false when the line uses something that is not supported
+    bool ParseText(const std::string& line, std::vector<Asm::Instr>& out, std::vector<std::string>& globals);
+    bool ParseData(const std::string& line, DataLine& out, std::vector<std::string>& globals);
+
+    inline const std::string& GetError(){ return error; }
+
+private:
+
+    bool ParseOperand(std::string str, Asm::Operand& op);
+    bool ParseMemory(const std::string& str, Asm::Operand& op);
+    bool ParseNumber(const std::string& str, int64_t& value);
+    bool ParseRegister(const std::string& str, Asm::Reg& reg, uint8_t& size);
+    bool ParseDirective(const std::string& word, const std::string& rest, std::vector<std::string>& globals, bool& handled);
+    std::string StripLabel(std::string& line);
+    std::string QualifyLabel(const std::string& label);
+    std::vector<std::string> SplitOperands(const std::string& str);
+    bool Fail(const std::string& line, const std::string& msg);
+
+    std::string last_global_label;
+    std::string error;
+};
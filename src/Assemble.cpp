@@ -1,34 +1,207 @@
 #include "Assemble.h"
+#include "Linker.h"
 
-void Assemble::Store() {
-    std::ofstream file(output_path.substr(0, output_path.length() - 4) + ".asm");
-    file << content;
-    file.close();
+#include <cerrno>
+#include <cstring>
+
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+/// A file that only lives in memory, the tools the compiler starts open it as /dev/fd/<fd>.
+/// nasm opens its input again for every pass, so it can't be fed through a plain pipe
+class MemoryFile{
+public:
+    inline explicit MemoryFile(const char* name) : fd(memfd_create(name, 0)) {
+        if(fd < 0){
+            Log::Error(std::string("Failed to create an in memory file, ") + strerror(errno));
+            exit(1);
+        }
+    }
+    inline ~MemoryFile(){ close(fd); }
+    MemoryFile(const MemoryFile&) = delete;
+    MemoryFile& operator=(const MemoryFile&) = delete;
+
+    inline std::string Path() const { return "/dev/fd/" + std::to_string(fd); }
+    inline int Fd() const { return fd; }
+
+    bool Write(const std::vector<uint8_t>& bytes) const {
+        size_t done = 0;
+        while(done < bytes.size()){
+            ssize_t written = pwrite(fd, bytes.data() + done, bytes.size() - done, static_cast<off_t>(done));
+            if(written < 0 && errno == EINTR)
+                continue;
+            if(written <= 0)
+                return false;
+            done += written;
+        }
+        return true;
+    }
+
+    bool Read(std::vector<uint8_t>& bytes) const {
+        bytes.clear();
+        uint8_t buffer[1 << 16];
+        off_t offset = 0;
+        while(true){
+            ssize_t got = pread(fd, buffer, sizeof(buffer), offset);
+            if(got < 0 && errno == EINTR)
+                continue;
+            if(got < 0)
+                return false;
+            if(got == 0)
+                return true;
+            bytes.insert(bytes.end(), buffer, buffer + got);
+            offset += got;
+        }
+    }
+
+private:
+    int fd;
+};
+
+/// Runs the program found in PATH with `args` and waits for it, returns its exit code or -1 when it could not run
+static int Spawn(const std::vector<std::string>& args){
+    std::vector<char*> argv;
+    for(const std::string& arg : args)
+        argv.emplace_back(const_cast<char*>(arg.c_str()));
+    argv.emplace_back(nullptr);
+
+    // whatever the compiler printed so far has to come before what the tool prints
+    std::cout.flush();
+    pid_t pid;
+    if(posix_spawnp(&pid, argv.at(0), nullptr, nullptr, argv.data(), environ) != 0)
+        return -1;
+
+    int status = 0;
+    while(waitpid(pid, &status, 0) < 0){
+        if(errno != EINTR)
+            return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
 }
 
-void Assemble::AssembleFile() {
-    system(std::string("nasm -f " +
-        std::string((target == PLATFORM_WIN32) ? "win32 " : "win64 ") +
-        output_path.substr(0, output_path.length() - 4) + ".asm -o " +
-        output_path.substr(0, output_path.length() - 4) + ".o"
-    ).c_str());
+std::string Assemble::GetBasePath() {
+    size_t dot = output_path.find_last_of('.');
+    size_t slash = output_path.find_last_of("/\\");
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return output_path;
+    return output_path.substr(0, dot);
 }
 
-void Assemble::LinkFile() {
+void Assemble::AssembleFile(const OutputBuffer& src, bool debug_info) {
+    std::string format;
+    switch(target){
+        case PLATFORM_WIN32:
+            format = "win32";
+            break;
+        case PLATFORM_WIN64:
+            format = "win64";
+            break;
+        case PLATFORM_LINUX32:
+            format = "elf32";
+            break;
+        case PLATFORM_LINUX64:
+            format = "elf64";
+            break;
+    }
 
-    std::string command;
-    command = "gcc " + output_path.substr(0, output_path.length() - 4) + ".o -o " + output_path;
-    for(std::string str : links)
-        command += " -l" + str;
+    Profiler::Scope scope("nasm");
+    MemoryFile assembly("galaxic.asm");
+    MemoryFile output("galaxic.o");
+    if(!src.WriteFd(assembly.Fd())){
+        Log::Error("Failed to hand the assembly to nasm");
+        exit(1);
+    }
 
-    system(command.c_str());
+    std::vector<std::string> command = {"nasm", "-f", format, assembly.Path(), "-o", output.Path()};
+    if(debug_info && (target == PLATFORM_LINUX32 || target == PLATFORM_LINUX64))
+        command.insert(command.end(), {"-g", "-F", "dwarf"});
+    int status = Spawn(command);
+    if(status != 0){
+        Log::Error(status < 0 ? "Failed to start nasm, is it installed?" : "nasm failed to assemble the program");
+        exit(1);
+    }
+    if(!output.Read(object) || object.empty()){
+        Log::Error("Failed to read the object file nasm made");
+        exit(1);
+    }
 }
 
-void Assemble::Clean() {
-    system(std::string("del " + output_path.substr(0, output_path.length() - 4) + ".o")
-    .c_str());
+void Assemble::WriteObject() {
+    Profiler::Scope scope("write object");
+    if(!Elf::WriteFile(GetBasePath() + ".o", object)){
+        Log::Error("Failed to write the object file `" + GetBasePath() + ".o`");
+        exit(1);
+    }
+}
+
+bool Assemble::LinkStatic() {
+    Profiler::Scope scope("link");
+    Linker linker;
+    linker.SetGcSections(gc_sections, print_gc_sections);
+
+    if(!linker.AddObject(object, GetBasePath() + ".o")){
+        Log::Warning("Linking with gcc, " + linker.GetError());
+        return false;
+    }
+
+    for(const std::string& link : links){
+        std::string archive = Linker::FindArchive(link);
+        if(archive.empty())
+            return false; // a shared library, it needs the dynamic loader
+        if(!linker.AddArchive(archive)){
+            Log::Warning("Linking with gcc, " + linker.GetError());
+            return false;
+        }
+    }
+
+    if(!linker.Link(output_path)){
+        Log::Warning("Linking with gcc, " + linker.GetError());
+        return false;
+    }
+    Profiler::Count("bytes removed by gc-sections", static_cast<int64_t>(linker.GetRemovedBytes()));
+    return true;
+}
+
+void Assemble::LinkFile() {
+    if(Linker::SupportsTarget(target) && LinkStatic())
+        return;
+
+    // gcc hands a file without a known extension to the linker as an object
+    Profiler::Scope scope("gcc");
+    MemoryFile file("galaxic.o");
+    if(!file.Write(object)){
+        Log::Error("Failed to hand the object file to gcc");
+        exit(1);
+    }
+
+    std::vector<std::string> command = {"gcc", file.Path(), "-o", output_path};
+    if(target == PLATFORM_LINUX64 || target == PLATFORM_LINUX32)
+        command.emplace_back("-no-pie");
+    if(freestanding){
+        command.emplace_back("-nostdlib");
+        command.emplace_back("-static");
+    }
+    if(gc_sections)
+        command.emplace_back("-Wl,--gc-sections");
+    if(gc_sections && print_gc_sections)
+        command.emplace_back("-Wl,--print-gc-sections");
+    for(const std::string& link : links)
+        command.emplace_back("-l" + link);
+
+    if(Spawn(command) != 0){
+        Log::Error("Failed to link `" + output_path + "`");
+        exit(1);
+    }
 }
 
 void Assemble::Run(){
-    system(std::string(output_path).c_str());
-}
\ No newline at end of file
+    std::string path = output_path;
+    if(path.find_first_of("/\\") == std::string::npos && target != PLATFORM_WIN32 && target != PLATFORM_WIN64)
+        path = "./" + path;
+    Profiler::Scope scope("run program");
+    Spawn({path});
+}
@@ -3,30 +3,87 @@
 #include "PCH.h"
 #include "Core.h"
 #include "Log.h"
+#include "Arguments.h"
+#include "Encoder.h"
+#include "Elf.h"
+#include "OutputBuffer.h"
+#include "Profiler.h"
+
+#include <functional>
 
 class Assemble {
 public:
-    Assemble(const std::string& src, const std::vector<std::string>& link, const std::string& output,
-             int target) :
-             links(link), content(src), output_path(output), target(target)
+    /// Called with the object file before it is linked, used to store it in the cache
+    using ObjectCallback = std::function<void(const std::vector<uint8_t>& object)>;
+
+    /// Assembles the generated nasm text with nasm, the text is handed to nasm in memory
+    Assemble(const OutputBuffer& src, const std::vector<std::string>& link, const Arguments& args,
+             const ObjectCallback& assembled = {}) :
+             links(link), output_path(args.output_file), target(args.target), freestanding(args.freestanding),
+             gc_sections(args.gc_sections), print_gc_sections(args.print_gc_sections)
     {
-        Store();
-        AssembleFile();
-        LinkFile();
-        Clean();
-        Run();
+        AssembleFile(src, args.debug_info);
+        if(assembled)
+            assembled(object);
+        if(args.compile_only)
+            WriteObject();
+        Finish(args);
+    }
+
+    /// Writes the already encoded machine code as an object file, nasm is not needed
+    Assemble(const ObjectCode& code, const std::vector<std::string>& link, const Arguments& args,
+             const ObjectCallback& assembled = {}) :
+             links(link), output_path(args.output_file), target(args.target), freestanding(args.freestanding),
+             gc_sections(args.gc_sections), print_gc_sections(args.print_gc_sections)
+    {
+        {
+            Profiler::Scope scope("elf object");
+            object = Elf::WriteObject(code, args.input_file);
+        }
+        Profiler::Count("object bytes", static_cast<int64_t>(object.size()));
+        if(assembled)
+            assembled(object);
+        // the object only has to be on disk when it is the output or gcc links it
+        if(args.compile_only)
+            WriteObject();
+        Finish(args);
+    }
+
+    /// Links an object file that was made before, like one from the cache
+    Assemble(std::vector<uint8_t> code, const std::vector<std::string>& link, const Arguments& args) :
+             links(link), object(std::move(code)), output_path(args.output_file), target(args.target),
+             freestanding(args.freestanding), gc_sections(args.gc_sections), print_gc_sections(args.print_gc_sections)
+    {
+        if(args.compile_only)
+            WriteObject();
+        Finish(args);
     }
 
 private:
 
-    void Store();
-    void AssembleFile();
+    inline void Finish(const Arguments& args){
+        if(args.compile_only)
+            return;
+        LinkFile();
+        Run();
+    }
+
+    /// The output path without its extension, used for the .o file
+    std::string GetBasePath();
+    /// Runs nasm on the text and reads back the object it made, neither of them is ever on disk.
+    /// With `debug_info` nasm turns the %line directives into DWARF
+    void AssembleFile(const OutputBuffer& src, bool debug_info);
+    void WriteObject();
+    /// Links with the built-in linker, false when gcc has to do it (shared libraries or a C runtime are needed)
+    bool LinkStatic();
     void LinkFile();
-    void Clean();
     void Run();
 
     const std::vector<std::string> links;
-    const std::string content;
+    std::vector<uint8_t> object;
     std::string output_path;
     int target;
-};
\ No newline at end of file
+    bool freestanding;
+    bool gc_sections;
+    bool print_gc_sections;
+};
@@ -0,0 +1,158 @@
+#include "Batch.h"
+#include "Log.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iomanip>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr int32_t NOT_COMPILED = INT32_MIN;
+static constexpr int32_t IDLE = -1;
+
+/// Lives in memory shared with the workers, they take the next file with `next` and leave its exit code in `status`.
+/// `current` is the file each worker is compiling, so the file is known when the worker dies on it
+struct Batch::Shared{
+    std::atomic<uint32_t> next;
+    int32_t* current; // one per worker
+    int32_t* status;  // one per file
+};
+
+Batch::Batch(std::vector<std::string> input_files, std::vector<std::string> flags, unsigned workers) :
+    inputs(std::move(input_files)), arguments(std::move(flags)), worker_count(workers)
+{
+    if(worker_count == 0)
+        worker_count = std::max(1u, std::thread::hardware_concurrency());
+    worker_count = static_cast<unsigned>(std::min<size_t>(worker_count, std::max<size_t>(inputs.size(), 1)));
+}
+
+std::vector<std::string> Batch::ExpandResponseFiles(const std::vector<std::string>& args) {
+    std::vector<std::string> expanded;
+    for(const std::string& arg : args){
+        if(arg.size() < 2 || arg.front() != '@'){
+            expanded.emplace_back(arg);
+            continue;
+        }
+
+        std::ifstream file(arg.substr(1));
+        if(!file.is_open()){
+            Log::Error("Failed to open the response file `" + arg.substr(1) + "`");
+            exit(1);
+        }
+        std::string word;
+        while(file >> word)
+            expanded.emplace_back(word);
+    }
+    return expanded;
+}
+
+size_t Batch::Run(const Handler& handler) {
+    if(inputs.empty()){
+        Log::Error("No input files were given to the batch");
+        exit(1);
+    }
+
+    size_t bytes = sizeof(Shared) + sizeof(int32_t) * (worker_count + inputs.size());
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED){
+        Log::Error(std::string("Failed to map the memory shared with the workers, ") + strerror(errno));
+        exit(1);
+    }
+    shared = new (memory) Shared();
+    shared->next = 0;
+    shared->current = reinterpret_cast<int32_t*>(static_cast<char*>(memory) + sizeof(Shared));
+    shared->status = shared->current + worker_count;
+    std::fill(shared->current, shared->current + worker_count, IDLE);
+    std::fill(shared->status, shared->status + inputs.size(), NOT_COMPILED);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<pid_t> workers(worker_count, -1);
+    auto spawn = [&](unsigned worker){
+        std::cout.flush();
+        pid_t pid = fork();
+        if(pid == 0)
+            Work(worker, handler);
+        if(pid < 0){
+            Log::Error(std::string("Failed to start a batch worker, ") + strerror(errno));
+            exit(1);
+        }
+        workers.at(worker) = pid;
+    };
+    for(unsigned worker = 0; worker < worker_count; worker++)
+        spawn(worker);
+
+    size_t running = worker_count;
+    while(running > 0){
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if(pid < 0){
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        auto it = std::find(workers.begin(), workers.end(), pid);
+        if(it == workers.end())
+            continue;
+        auto worker = static_cast<unsigned>(it - workers.begin());
+        running--;
+
+        // a worker only ends in the middle of a file when that file failed, the rest go to a new worker
+        int32_t file = shared->current[worker];
+        if(file == IDLE)
+            continue;
+        shared->status[file] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        shared->current[worker] = IDLE;
+        if(shared->next.load() < inputs.size()){
+            spawn(worker);
+            running++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    size_t failed = 0;
+    for(size_t i = 0; i < inputs.size(); i++){
+        if(shared->status[i] == 0)
+            continue;
+        failed++;
+        if(shared->status[i] == NOT_COMPILED)
+            Log::Error("`" + inputs.at(i) + "` was never compiled");
+        else
+            Log::Error("`" + inputs.at(i) + "` failed with exit code " + std::to_string(shared->status[i]));
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::stringstream summary;
+    summary << std::fixed << std::setprecision(3) << "Compiled " << inputs.size() - failed << " of " << inputs.size()
+            << " files in " << seconds << "s, " << std::setprecision(0) << inputs.size() / std::max(seconds, 1e-9)
+            << " files/s with " << worker_count << (worker_count == 1 ? " worker" : " workers");
+    Log::Info(summary.str());
+
+    munmap(memory, bytes);
+    shared = nullptr;
+    return failed;
+}
+
+void Batch::Work(unsigned worker, const Handler& handler) {
+    std::string name = "GalaxiC";
+    while(true){
+        uint32_t file = shared->next.fetch_add(1);
+        if(file >= inputs.size())
+            break;
+        shared->current[worker] = static_cast<int32_t>(file);
+
+        std::vector<char*> argv = {name.data(), inputs.at(file).data()};
+        for(std::string& arg : arguments)
+            argv.emplace_back(arg.data());
+        argv.emplace_back(nullptr);
+
+        shared->status[file] = handler(static_cast<int>(argv.size() - 1), argv.data());
+        shared->current[worker] = IDLE;
+    }
+    exit(0);
+}
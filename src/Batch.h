@@ -0,0 +1,35 @@
+#pragma once
+
+#include "PCH.h"
+
+#include <functional>
+
+/// Compiles many programs with the same flags in one invocation. The files are shared out to worker processes
+/// forked from the warm compiler, each worker compiles one file after another with its arena and tables kept.
+/// An error only ends the worker compiling that file, a new worker carries on with the rest
+class Batch{
+public:
+    /// Compiles like main with the arguments of one file and returns its exit code
+    using Handler = std::function<int(int argc, char* argv[])>;
+
+    /// `flags` are passed to every file, 0 workers uses one per core
+    Batch(std::vector<std::string> input_files, std::vector<std::string> flags, unsigned workers);
+
+    /// Replaces every `@file` argument with the whitespace separated arguments in that file
+    static std::vector<std::string> ExpandResponseFiles(const std::vector<std::string>& args);
+
+    /// Compiles every file and prints how many files per second were compiled, returns how many failed
+    size_t Run(const Handler& handler);
+
+private:
+
+    struct Shared;
+
+    /// Runs in a worker, compiles files until none are left and never returns
+    [[noreturn]] void Work(unsigned worker, const Handler& handler);
+
+    std::vector<std::string> inputs;
+    std::vector<std::string> arguments;
+    unsigned worker_count;
+    Shared* shared = nullptr;
+};
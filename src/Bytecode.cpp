@@ -0,0 +1,519 @@
+#include "Bytecode.h"
+
+namespace Bytecode{
+    std::string OpToString(Op op) {
+        switch(op){
+            case Op::load_imm: return "load_imm";
+            case Op::move: return "move";
+            case Op::add: return "add";
+            case Op::sub: return "sub";
+            case Op::mul: return "mul";
+            case Op::div: return "div";
+            case Op::mod: return "mod";
+            case Op::udiv: return "udiv";
+            case Op::umod: return "umod";
+            case Op::popcount: return "popcount";
+            case Op::clz: return "clz";
+            case Op::ctz: return "ctz";
+            case Op::bit_and: return "bit_and";
+            case Op::bit_or: return "bit_or";
+            case Op::bit_xor: return "bit_xor";
+            case Op::bit_not: return "bit_not";
+            case Op::shl: return "shl";
+            case Op::sar: return "sar";
+            case Op::shr: return "shr";
+            case Op::sext: return "sext";
+            case Op::zext: return "zext";
+            case Op::cmp_eq: return "cmp_eq";
+            case Op::cmp_ne: return "cmp_ne";
+            case Op::cmp_gt: return "cmp_gt";
+            case Op::cmp_ge: return "cmp_ge";
+            case Op::cmp_lt: return "cmp_lt";
+            case Op::cmp_le: return "cmp_le";
+            case Op::cmp_ugt: return "cmp_ugt";
+            case Op::cmp_uge: return "cmp_uge";
+            case Op::cmp_ult: return "cmp_ult";
+            case Op::cmp_ule: return "cmp_ule";
+            case Op::array_clear: return "array_clear";
+            case Op::array_load: return "array_load";
+            case Op::array_store: return "array_store";
+            case Op::jump: return "jump";
+            case Op::jump_zero: return "jump_zero";
+            case Op::jump_not_zero: return "jump_not_zero";
+            case Op::exit: return "exit";
+            case Op::halt: return "halt";
+            case Op::count: break;
+        }
+        return "unknown";
+    }
+
+    std::string InstrToString(const Instr& instr) {
+        auto r = [](uint16_t reg){ return "r" + std::to_string(reg); };
+        std::string name = OpToString(instr.op);
+
+        switch(instr.op){
+            case Op::load_imm:
+                return name + " " + r(instr.dst) + ", " + std::to_string(instr.imm);
+            case Op::move:
+            case Op::popcount:
+            case Op::clz:
+            case Op::ctz:
+            case Op::bit_not:
+                return name + " " + r(instr.dst) + ", " + r(instr.lhs);
+            case Op::sext:
+            case Op::zext:
+                return name + " " + r(instr.dst) + ", " + r(instr.lhs) + ", " + std::to_string(instr.imm);
+            case Op::array_clear:
+                return name + " a" + std::to_string(instr.imm);
+            case Op::array_load:
+                return name + " " + r(instr.dst) + ", a" + std::to_string(instr.imm) + "[" + r(instr.lhs) + "]";
+            case Op::array_store:
+                return name + " a" + std::to_string(instr.imm) + "[" + r(instr.rhs) + "], " + r(instr.lhs);
+            case Op::jump:
+                return name + " " + std::to_string(instr.imm);
+            case Op::jump_zero:
+            case Op::jump_not_zero:
+                return name + " " + r(instr.lhs) + ", " + std::to_string(instr.imm);
+            case Op::exit:
+                return name + " " + r(instr.lhs);
+            case Op::halt:
+                return name;
+            default:
+                return name + " " + r(instr.dst) + ", " + r(instr.lhs) + ", " + r(instr.rhs);
+        }
+    }
+}
+
+bool BytecodeCompiler::Fail(const std::string& msg) {
+    error = msg;
+    return false;
+}
+
+uint16_t BytecodeCompiler::NewRegister() {
+    if(next_register == UINT16_MAX){
+        Log::Error("The program needs too many registers to be interpreted");
+        exit(1);
+    }
+    uint16_t reg = next_register++;
+    program->registers = std::max<uint16_t>(program->registers, next_register);
+    return reg;
+}
+
+BytecodeCompiler::Variable* BytecodeCompiler::FindVariable(const std::string& ident) {
+    // the newest variable with the name, so inner scopes shadow outer ones
+    for(auto it = variables.rbegin(); it != variables.rend(); it++)
+        if(it->ident == ident)
+            return &*it;
+    return nullptr;
+}
+
+bool BytecodeCompiler::CompileTerm(const Node::Term* term, uint16_t dst) {
+    if(std::holds_alternative<Node::LitInt*>(term->term)){
+        Emit(Bytecode::Op::load_imm, dst, 0, 0, std::get<Node::LitInt*>(term->term)->GetValue());
+        return true;
+    }
+    if(std::holds_alternative<Node::Ident*>(term->term)){
+        const std::string& ident = std::get<Node::Ident*>(term->term)->value;
+        Variable* var = FindVariable(ident);
+        if(!var)
+            return Fail("Identifier `" + ident + "` was never declared");
+        if(!var->init)
+            return Fail("Ident `" + ident + "` was used before it was initialized");
+
+        Emit(Bytecode::Op::move, dst, var->reg);
+        return true;
+    }
+    if(std::holds_alternative<Node::TermIndex*>(term->term)){
+        auto element = std::get<Node::TermIndex*>(term->term);
+        Variable* var = FindVariable(element->ident->value);
+        if(!var || var->array < 0)
+            return Fail("`" + element->ident->value + "` is not an array");
+        if(!CompileExpr(element->index, dst))
+            return false;
+        Emit(Bytecode::Op::array_load, dst, dst, 0, var->array);
+        return true;
+    }
+    if(std::holds_alternative<Node::TermBuiltin*>(term->term)){
+        auto builtin = std::get<Node::TermBuiltin*>(term->term);
+        if(!CompileExpr(builtin->expr, dst))
+            return false;
+        static const Bytecode::Op ops[] = {Bytecode::Op::popcount, Bytecode::Op::clz, Bytecode::Op::ctz};
+        Emit(ops[static_cast<int>(builtin->builtin)], dst, dst);
+        return true;
+    }
+    if(std::holds_alternative<Node::TermNot*>(term->term)){
+        if(!CompileTerm(std::get<Node::TermNot*>(term->term)->term, dst))
+            return false;
+        Emit(Bytecode::Op::bit_not, dst, dst);
+        return true;
+    }
+    return CompileExpr(std::get<Node::TermParen*>(term->term)->expr, dst);
+}
+
+bool BytecodeCompiler::CompileExpr(const Node::IntExpr* expr, uint16_t dst) {
+    if(std::holds_alternative<Node::Term*>(expr->var))
+        return CompileTerm(std::get<Node::Term*>(expr->var), dst);
+
+    struct BinExprVisitor{
+        BytecodeCompiler& compiler;
+        uint16_t dst;
+
+        bool Gen(Bytecode::Op op, const Node::IntExpr* lhs, const Node::IntExpr* rhs){
+            uint16_t temp = compiler.NewRegister();
+            bool ok = compiler.CompileExpr(lhs, dst) && compiler.CompileExpr(rhs, temp);
+            compiler.Emit(op, dst, dst, temp);
+            compiler.FreeRegister();
+            return ok;
+        }
+
+        bool operator()(const Node::BinExprAdd* expr){ return Gen(Bytecode::Op::add, expr->lhs, expr->rhs); }
+        bool operator()(const Node::BinExprSub* expr){ return Gen(Bytecode::Op::sub, expr->lhs, expr->rhs); }
+        bool operator()(const Node::BinExprMul* expr){ return Gen(Bytecode::Op::mul, expr->lhs, expr->rhs); }
+        bool operator()(const Node::BinExprDiv* expr){
+            bool is_unsigned = expr->lhs->is_unsigned || expr->rhs->is_unsigned;
+            return Gen(is_unsigned ? Bytecode::Op::udiv : Bytecode::Op::div, expr->lhs, expr->rhs);
+        }
+        bool operator()(const Node::BinExprMod* expr){
+            bool is_unsigned = expr->lhs->is_unsigned || expr->rhs->is_unsigned;
+            return Gen(is_unsigned ? Bytecode::Op::umod : Bytecode::Op::mod, expr->lhs, expr->rhs);
+        }
+        bool operator()(const Node::BinExprAnd* expr){ return Gen(Bytecode::Op::bit_and, expr->lhs, expr->rhs); }
+        bool operator()(const Node::BinExprOr* expr){ return Gen(Bytecode::Op::bit_or, expr->lhs, expr->rhs); }
+        bool operator()(const Node::BinExprXor* expr){ return Gen(Bytecode::Op::bit_xor, expr->lhs, expr->rhs); }
+        bool operator()(const Node::BinExprShl* expr){ return Gen(Bytecode::Op::shl, expr->lhs, expr->rhs); }
+        bool operator()(const Node::BinExprShr* expr){
+            return Gen(expr->lhs->is_unsigned ? Bytecode::Op::shr : Bytecode::Op::sar, expr->lhs, expr->rhs);
+        }
+    };
+
+    BinExprVisitor visitor{*this, dst};
+    return std::visit(visitor, std::get<Node::BinExpr*>(expr->var)->expr);
+}
+
+bool BytecodeCompiler::CompileBoolTerm(const Node::BoolTerm* term, uint16_t dst) {
+    // ordering comparisons are only allowed between integers
+    auto comparison = [](Node::Comparison comp, bool ints, Bytecode::Op& op){
+        switch(comp){
+            case Node::Comparison::equal: op = Bytecode::Op::cmp_eq; return true;
+            case Node::Comparison::not_equal: op = Bytecode::Op::cmp_ne; return true;
+            case Node::Comparison::greater: op = Bytecode::Op::cmp_gt; return ints;
+            case Node::Comparison::greater_equal: op = Bytecode::Op::cmp_ge; return ints;
+            case Node::Comparison::less: op = Bytecode::Op::cmp_lt; return ints;
+            case Node::Comparison::less_equal: op = Bytecode::Op::cmp_le; return ints;
+            default: return false;
+        }
+    };
+
+    if(std::holds_alternative<Node::BoolTermInt*>(term->term)){
+        auto int_term = std::get<Node::BoolTermInt*>(term->term);
+        Bytecode::Op op;
+        if(!comparison(int_term->comp, true, op))
+            return Fail("Expected a comparison operator in the boolean expression");
+        if(int_term->lhs->is_unsigned || int_term->rhs->is_unsigned){
+            switch(op){
+                case Bytecode::Op::cmp_gt: op = Bytecode::Op::cmp_ugt; break;
+                case Bytecode::Op::cmp_ge: op = Bytecode::Op::cmp_uge; break;
+                case Bytecode::Op::cmp_lt: op = Bytecode::Op::cmp_ult; break;
+                case Bytecode::Op::cmp_le: op = Bytecode::Op::cmp_ule; break;
+                default: break;
+            }
+        }
+
+        uint16_t temp = NewRegister();
+        bool ok = CompileExpr(int_term->lhs, dst) && CompileExpr(int_term->rhs, temp);
+        Emit(op, dst, dst, temp);
+        FreeRegister();
+        return ok;
+    }
+
+    if(std::holds_alternative<Node::BoolTermBool*>(term->term)){
+        auto bool_term = std::get<Node::BoolTermBool*>(term->term);
+        Bytecode::Op op;
+        if(!comparison(bool_term->comp, false, op))
+            return Fail("Booleans can only be compared with `==` or `!=`");
+
+        auto side = [this](const std::variant<Node::LitBool, Node::Ident*>& value, uint16_t reg){
+            if(std::holds_alternative<Node::LitBool>(value)){
+                Emit(Bytecode::Op::load_imm, reg, 0, 0, std::get<Node::LitBool>(value) == Node::LitBool::_true ? 1 : 0);
+                return true;
+            }
+            const std::string& ident = std::get<Node::Ident*>(value)->value;
+            Variable* var = FindVariable(ident);
+            if(!var || !var->init)
+                return Fail("Identifier \'" + ident + "\' was never initialized");
+            Emit(Bytecode::Op::move, reg, var->reg);
+            return true;
+        };
+
+        uint16_t temp = NewRegister();
+        bool ok = side(bool_term->lhs, dst) && side(bool_term->rhs, temp);
+        Emit(op, dst, dst, temp);
+        FreeRegister();
+        return ok;
+    }
+
+    return CompileBoolExpr(std::get<Node::BoolTermParen*>(term->term)->expr, dst);
+}
+
+bool BytecodeCompiler::CompileBoolSide(const std::variant<Node::BoolTerm*, Node::BoolExpr*>& side, uint16_t dst) {
+    if(std::holds_alternative<Node::BoolTerm*>(side))
+        return CompileBoolTerm(std::get<Node::BoolTerm*>(side), dst);
+    return CompileBoolExpr(std::get<Node::BoolExpr*>(side), dst);
+}
+
+/// `&&` and `||` only calculate the right hand side when the left hand side does not decide the result
+bool BytecodeCompiler::CompileBoolExpr(const Node::BoolExpr* expr, uint16_t dst) {
+    if(std::holds_alternative<Node::BoolTerm*>(expr->expr))
+        return CompileBoolTerm(std::get<Node::BoolTerm*>(expr->expr), dst);
+
+    Bytecode::Op jump;
+    const std::variant<Node::BoolTerm*, Node::BoolExpr*>* lhs;
+    const std::variant<Node::BoolTerm*, Node::BoolExpr*>* rhs;
+    if(std::holds_alternative<Node::BoolExprAnd*>(expr->expr)){
+        jump = Bytecode::Op::jump_zero;
+        lhs = &std::get<Node::BoolExprAnd*>(expr->expr)->lhs;
+        rhs = &std::get<Node::BoolExprAnd*>(expr->expr)->rhs;
+    }
+    else{
+        jump = Bytecode::Op::jump_not_zero;
+        lhs = &std::get<Node::BoolExprOr*>(expr->expr)->lhs;
+        rhs = &std::get<Node::BoolExprOr*>(expr->expr)->rhs;
+    }
+
+    if(!CompileBoolSide(*lhs, dst))
+        return false;
+    size_t end = Emit(jump, 0, dst);
+    if(!CompileBoolSide(*rhs, dst))
+        return false;
+    PatchJump(end);
+    return true;
+}
+
+bool BytecodeCompiler::CompileScope(const Node::Scope* scope) {
+    scopes.emplace_back(variables.size());
+    if(!CompileStmts(scope->stmts))
+        return false;
+
+    while(variables.size() > scopes.back()){
+        variables.pop_back();
+        FreeRegister();
+    }
+    scopes.pop_back();
+    return true;
+}
+
+bool BytecodeCompiler::CompileIfChain(const std::vector<const Node::Stmt*>& chain) {
+    std::vector<size_t> end_jumps;
+
+    for(size_t i = 0; i < chain.size(); i++){
+        const Node::Stmt* stmt = chain.at(i);
+
+        if(std::holds_alternative<Node::Else*>(stmt->stmt)){
+            if(!CompileScope(std::get<Node::Else*>(stmt->stmt)->stmt))
+                return false;
+            break;
+        }
+
+        Node::BoolExpr* expr;
+        Node::Scope* scope;
+        if(std::holds_alternative<Node::If*>(stmt->stmt)){
+            expr = std::get<Node::If*>(stmt->stmt)->expr;
+            scope = std::get<Node::If*>(stmt->stmt)->stmt;
+        }
+        else{
+            expr = std::get<Node::Elif*>(stmt->stmt)->expr;
+            scope = std::get<Node::Elif*>(stmt->stmt)->stmt;
+        }
+
+        uint16_t cond = NewRegister();
+        bool ok = CompileBoolExpr(expr, cond);
+        size_t next = Emit(Bytecode::Op::jump_zero, 0, cond);
+        FreeRegister();
+        if(!ok || !CompileScope(scope))
+            return false;
+
+        if(i != chain.size() - 1)
+            end_jumps.emplace_back(Emit(Bytecode::Op::jump));
+        PatchJump(next);
+    }
+
+    for(size_t jump : end_jumps)
+        PatchJump(jump);
+    return true;
+}
+
+bool BytecodeCompiler::CompileStmts(const std::vector<Node::Stmt*>& stmts) {
+    for(size_t i = 0; i < stmts.size(); i++){
+        if(!std::holds_alternative<Node::If*>(stmts.at(i)->stmt)){
+            if(!CompileStmt(stmts.at(i)))
+                return false;
+            continue;
+        }
+
+        std::vector<const Node::Stmt*> chain = {stmts.at(i)};
+        while(i + 1 < stmts.size()){
+            const Node::Stmt* next = stmts.at(i + 1);
+            if(!std::holds_alternative<Node::Elif*>(next->stmt) && !std::holds_alternative<Node::Else*>(next->stmt))
+                break;
+
+            chain.emplace_back(next);
+            i++;
+            if(std::holds_alternative<Node::Else*>(next->stmt))
+                break;
+        }
+
+        if(!CompileIfChain(chain))
+            return false;
+    }
+    return true;
+}
+
+bool BytecodeCompiler::CompileStmt(const Node::Stmt* stmt) {
+    struct StmtVisitor{
+        BytecodeCompiler& compiler;
+
+        bool operator()(const Node::Exit* stmt){
+            uint16_t temp = compiler.NewRegister();
+            bool ok = compiler.CompileExpr(stmt->expr, temp);
+            compiler.Emit(Bytecode::Op::exit, 0, temp);
+            compiler.FreeRegister();
+            return ok;
+        }
+
+        bool operator()(const Node::Variable* stmt){
+            // the value is calculated into the variable's register before the name exists, like the native code
+            uint16_t reg = compiler.NewRegister();
+            bool init = stmt->expr != NULL;
+            bool ok = true;
+            if(init && stmt->type == VarType::_bool)
+                ok = compiler.CompileBoolExpr(std::get<Node::BoolExpr*>(stmt->expr->expr), reg);
+            else if(init)
+                ok = compiler.CompileExpr(std::get<Node::IntExpr*>(stmt->expr->expr), reg);
+
+            Variable var{stmt->ident->value, reg, init, 64, IsUnsigned(stmt->type)};
+            switch(stmt->type){
+                case VarType::_char: case VarType::_uchar: var.bits = 8; break;
+                case VarType::_short: case VarType::_ushort: var.bits = 16; break;
+                case VarType::_int: case VarType::_uint: var.bits = 32; break;
+                default: break;
+            }
+            // every declaration gets memory of its own and starts at 0, like the native code clears its stack
+            if(stmt->length != 0){
+                Bytecode::Program& program = *compiler.program;
+                if(program.memory + stmt->length > MAX_MEMORY)
+                    return compiler.Fail("The arrays of the program are too large to be interpreted");
+                var.array = static_cast<int32_t>(program.arrays.size());
+                program.arrays.push_back(Bytecode::Array{program.memory, stmt->length});
+                program.memory += stmt->length;
+                compiler.Emit(Bytecode::Op::array_clear, 0, 0, 0, var.array);
+            }
+            if(init && var.bits < 64)
+                compiler.Emit(var.is_unsigned ? Bytecode::Op::zext : Bytecode::Op::sext, reg, reg, 0, var.bits);
+            compiler.variables.push_back(var);
+            return ok;
+        }
+
+        bool operator()(const Node::Reassign* stmt){
+            Variable* var = compiler.FindVariable(stmt->ident->value);
+            if(!var)
+                return compiler.Fail("Identifier `" + stmt->ident->value + "` was never declared");
+
+            // through a temporary so `x = 1 - x` still reads the old x
+            uint16_t temp = compiler.NewRegister();
+            bool ok = compiler.CompileExpr(stmt->expr, temp);
+            if(var->bits < 64)
+                compiler.Emit(var->is_unsigned ? Bytecode::Op::zext : Bytecode::Op::sext, var->reg, temp, 0, var->bits);
+            else
+                compiler.Emit(Bytecode::Op::move, var->reg, temp);
+            compiler.FreeRegister();
+            var->init = true;
+            return ok;
+        }
+
+        bool operator()(const Node::IndexAssign* stmt){
+            Variable* var = compiler.FindVariable(stmt->ident->value);
+            if(!var || var->array < 0)
+                return compiler.Fail("`" + stmt->ident->value + "` is not an array");
+
+            // the value first and the index after it, the order the native code calculates them in
+            uint16_t value = compiler.NewRegister();
+            uint16_t index = compiler.NewRegister();
+            bool ok = compiler.CompileExpr(stmt->expr, value) && compiler.CompileExpr(stmt->index, index);
+            if(var->bits < 64)
+                compiler.Emit(var->is_unsigned ? Bytecode::Op::zext : Bytecode::Op::sext, value, value, 0, var->bits);
+            compiler.Emit(Bytecode::Op::array_store, 0, value, index, var->array);
+            compiler.FreeRegister();
+            compiler.FreeRegister();
+            return ok;
+        }
+
+        bool operator()(const Node::Scope* stmt){
+            return compiler.CompileScope(stmt);
+        }
+
+        bool operator()(const Node::If* stmt){
+            Node::Stmt wrapped_stmt;
+            wrapped_stmt.stmt = const_cast<Node::If*>(stmt);
+            return compiler.CompileIfChain({&wrapped_stmt});
+        }
+
+        bool operator()(const Node::Elif*){
+            return compiler.Fail("An if statement is required before an else if condition statement");
+        }
+
+        bool operator()(const Node::Else*){
+            return compiler.Fail("An if statement is required before an else condition statement");
+        }
+
+        bool operator()(const Node::While* stmt){
+            auto start = static_cast<int64_t>(compiler.program->code.size());
+            uint16_t cond = compiler.NewRegister();
+            bool ok = compiler.CompileBoolExpr(stmt->expr, cond);
+            size_t end = compiler.Emit(Bytecode::Op::jump_zero, 0, cond);
+            compiler.FreeRegister();
+
+            if(ok && stmt->scope.has_value())
+                ok = compiler.CompileScope(stmt->scope.value());
+            compiler.Emit(Bytecode::Op::jump, 0, 0, 0, start);
+            compiler.PatchJump(end);
+            return ok;
+        }
+
+        bool operator()(const Node::Import*){
+            return true;
+        }
+
+        bool operator()(const Node::Link*){
+            return compiler.Fail("#link needs native code, it can't be interpreted");
+        }
+
+        bool operator()(const Node::Assembly*){
+            return compiler.Fail("Inline assembly and #extern need native code, they can't be interpreted");
+        }
+    };
+
+    StmtVisitor visitor{*this};
+    return std::visit(visitor, stmt->stmt);
+}
+
+bool BytecodeCompiler::Compile(Bytecode::Program& out) {
+    program = &out;
+    out.code.clear();
+    out.registers = 0;
+    out.arrays.clear();
+    out.memory = 0;
+
+    // imported modules run first, each with its variables in a scope of its own
+    for(size_t i = 0; i + 1 < programs.size(); i++){
+        Node::Scope scope;
+        scope.stmts = programs.at(i)->prg;
+        if(!CompileScope(&scope))
+            return false;
+    }
+    if(!CompileStmts(programs.back()->prg))
+        return false;
+    Emit(Bytecode::Op::halt);
+    // the interpreter always has at least one register so it never needs to check
+    out.registers = std::max<uint16_t>(out.registers, 1);
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "PCH.h"
+#include "Node.h"
+#include "Log.h"
+
+/// A register based bytecode the interpreter runs, every variable and temporary value has its own register
+namespace Bytecode{
+    enum class Op : uint8_t {
+        load_imm,   // dst = imm
+        move,       // dst = lhs
+        add, sub, mul,
+        div, mod,   // signed like the native idiv
+        udiv, umod, // of unsigned expressions
+        popcount, clz, ctz, // dst = the bits of lhs, the zeros of 0 are 64 like lzcnt and tzcnt
+        bit_and, bit_or, bit_xor,
+        bit_not,    // dst = ~lhs
+        shl, sar,   // the count is taken modulo 64 like the native shifts
+        shr,        // the `>>` of an unsigned expression
+        sext,       // dst = lhs sign extended from its low imm bits, what storing to a narrower variable keeps
+        zext,       // dst = the low imm bits of lhs, for unsigned variables
+        cmp_eq, cmp_ne, cmp_gt, cmp_ge, cmp_lt, cmp_le, // dst = lhs <comp> rhs, signed
+        cmp_ugt, cmp_uge, cmp_ult, cmp_ule,             // unsigned
+        array_clear, // every element of the array imm is 0
+        array_load,  // dst = element lhs of the array imm
+        array_store, // element rhs of the array imm = lhs
+        jump,       // ip = imm
+        jump_zero,  // if lhs == 0: ip = imm
+        jump_not_zero,
+        exit,       // ends with the value of lhs
+        halt,       // end of the program, ends with 0
+        count
+    };
+
+    struct Instr{
+        Op op;
+        uint16_t dst;
+        uint16_t lhs;
+        uint16_t rhs;
+        int64_t imm;
+    };
+
+    /// The elements of an array are `length` words of the memory from `offset`, narrower ones are kept extended
+    /// like the registers of variables
+    struct Array{
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct Program{
+        std::vector<Instr> code;
+        uint16_t registers = 0;
+        std::vector<Array> arrays;
+        uint64_t memory = 0; // words of all the arrays
+    };
+
+    std::string OpToString(Op op);
+    std::string InstrToString(const Instr& instr);
+}
+
+/// Compiles the AST into bytecode, it has the same semantics as the Generator so both can check each other
+class BytecodeCompiler{
+public:
+    inline BytecodeCompiler(Node::Program* p) : programs{p} {}
+    /// The imported modules in the order they run and the program importing them last
+    inline BytecodeCompiler(std::vector<Node::Program*> p) : programs(std::move(p)) {}
+
+    /// Returns false for programs the interpreter can't run, GetError tells why
+    bool Compile(Bytecode::Program& out);
+    inline const std::string& GetError(){ return error; }
+
+private:
+
+    struct Variable{
+        std::string ident;
+        uint16_t reg;
+        bool init;
+        uint8_t bits; // 64 unless the type is narrower
+        bool is_unsigned;
+        int32_t array = -1; // the index in Program::arrays of an array
+    };
+
+    bool CompileTerm(const Node::Term* term, uint16_t dst);
+    bool CompileExpr(const Node::IntExpr* expr, uint16_t dst);
+    bool CompileBoolTerm(const Node::BoolTerm* term, uint16_t dst);
+    bool CompileBoolExpr(const Node::BoolExpr* expr, uint16_t dst);
+    bool CompileBoolSide(const std::variant<Node::BoolTerm*, Node::BoolExpr*>& side, uint16_t dst);
+    bool CompileStmts(const std::vector<Node::Stmt*>& stmts);
+    bool CompileScope(const Node::Scope* scope);
+    bool CompileIfChain(const std::vector<const Node::Stmt*>& chain);
+    bool CompileStmt(const Node::Stmt* stmt);
+
+    inline size_t Emit(Bytecode::Op op, uint16_t dst = 0, uint16_t lhs = 0, uint16_t rhs = 0, int64_t imm = 0){
+        program->code.push_back(Bytecode::Instr{op, dst, lhs, rhs, imm});
+        return program->code.size() - 1;
+    }
+    /// Points the jump at `index` to the next instruction
+    inline void PatchJump(size_t index){
+        program->code.at(index).imm = static_cast<int64_t>(program->code.size());
+    }
+    uint16_t NewRegister();
+    inline void FreeRegister(){ next_register--; }
+    Variable* FindVariable(const std::string& ident);
+    bool Fail(const std::string& msg);
+
+    static constexpr uint64_t MAX_MEMORY = 1 << 27; // words, 1 GB of elements
+
+    std::vector<Node::Program*> programs;
+    Bytecode::Program* program = nullptr;
+    std::vector<Variable> variables;
+    std::vector<size_t> scopes; // how many variables there were when the scope started
+    uint16_t next_register = 0;
+    std::string error;
+};
@@ -0,0 +1,250 @@
+#include "Cache.h"
+#include "Sha256.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static const char* OBJECT_FILE = "object.o";
+static const char* LINKS_FILE = "links";
+static const char* STATS_FILE = "stats";
+
+static bool ReadFile(const fs::path& path, std::string& out){
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open())
+        return false;
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+static bool WriteFile(const fs::path& path, const char* data, size_t size){
+    std::ofstream file(path, std::ios::binary);
+    file.write(data, static_cast<std::streamsize>(size));
+    file.close();
+    return file.good();
+}
+
+/// Entries are the only directories named with 64 hex characters
+static bool IsEntry(const fs::directory_entry& entry){
+    std::string name = entry.path().filename().string();
+    return entry.is_directory() && name.size() == 64 &&
+           name.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+static uint64_t EntrySize(const fs::path& path){
+    uint64_t size = 0;
+    std::error_code error;
+    for(const fs::directory_entry& file : fs::directory_iterator(path, error)){
+        uint64_t file_size = file.file_size(error);
+        if(!error)
+            size += file_size;
+    }
+    return size;
+}
+
+Cache::Cache(const std::string& dir, uint64_t size_limit) : directory(dir), max_size(size_limit) {
+    std::error_code error;
+    fs::create_directories(directory, error);
+}
+
+std::string Cache::Key(const std::vector<std::string>& sources, const Arguments& args) {
+    Sha256 hash;
+    hash.Update(std::string("galaxic " GALAXIC_VERSION "\n"));
+
+    // a rebuilt compiler may generate different code for the same source
+    std::error_code error;
+    fs::path compiler = fs::read_symlink("/proc/self/exe", error);
+    if(!error){
+        auto size = fs::file_size(compiler, error);
+        auto time = fs::last_write_time(compiler, error).time_since_epoch().count();
+        if(!error)
+            hash.Update(std::to_string(size) + ' ' + std::to_string(time) + '\n');
+    }
+
+    // every flag that changes the object file, keep it up to date with Arguments
+    hash.Update("target " + std::to_string(args.target) + '\n');
+    hash.Update(std::string("via_nasm ") + (args.via_nasm ? "1" : "0") + '\n');
+    hash.Update(std::string("freestanding ") + (args.freestanding ? "1" : "0") + '\n');
+    hash.Update(std::string("march ") + Asm::LevelName(args.march) + '\n');
+    hash.Update(std::string("bounds_checks ") + (args.bounds_checks ? "1" : "0") + '\n');
+    hash.Update(std::string("vectorize ") + (args.vectorize ? "1" : "0") + '\n');
+    // the line table names the source files and the directory it was compiled in
+    if(args.debug_info){
+        hash.Update("debug " + fs::absolute(args.input_file, error).string() + '\n');
+        hash.Update("directory " + fs::current_path(error).string() + '\n');
+    }
+
+    // the program writes its profile to the path, a used profile decides the layout
+    if(args.profile_generate)
+        hash.Update("profile-generate " + args.profile_file + '\n');
+    if(args.profile_use){
+        std::ifstream profile(args.profile_file, std::ios::binary);
+        std::stringstream content;
+        content << profile.rdbuf();
+        hash.Update("profile-use " + std::to_string(content.str().size()) + '\n');
+        hash.Update(content.str());
+    }
+
+    for(const std::string& source : sources){
+        hash.Update("source " + std::to_string(source.size()) + '\n');
+        hash.Update(source);
+    }
+    return hash.HexDigest();
+}
+
+std::string Cache::DefaultDirectory() {
+    if(const char* dir = std::getenv("GALAXIC_CACHE_DIR"))
+        return dir;
+    if(const char* dir = std::getenv("XDG_CACHE_HOME"))
+        return (fs::path(dir) / "galaxic").string();
+    if(const char* dir = std::getenv("LOCALAPPDATA"))
+        return (fs::path(dir) / "galaxic").string();
+    if(const char* dir = std::getenv("HOME"))
+        return (fs::path(dir) / ".cache" / "galaxic").string();
+    return ".galaxic-cache";
+}
+
+bool Cache::Lookup(const std::string& key, Entry& entry) {
+    fs::path path = directory / key;
+
+    // an entry can be evicted by another compile while it is read, that is only a miss
+    std::string object, links;
+    if(!ReadFile(path / OBJECT_FILE, object) || !ReadFile(path / LINKS_FILE, links) || object.empty()){
+        Record(false);
+        return false;
+    }
+
+    entry.object.assign(object.begin(), object.end());
+    std::stringstream lines(links);
+    std::string link;
+    while(std::getline(lines, link)){
+        if(!link.empty())
+            entry.links.emplace_back(link);
+    }
+
+    // the modification time of the entry is when it was last used
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    Record(true);
+    return true;
+}
+
+void Cache::Store(const std::string& key, const Entry& entry) {
+    std::random_device random;
+    fs::path temp = directory / ("tmp-" + std::to_string(random()) + std::to_string(random()));
+    std::error_code error;
+
+    std::string links;
+    for(const std::string& link : entry.links)
+        links += link + '\n';
+
+    bool ok = fs::create_directory(temp, error) &&
+              WriteFile(temp / OBJECT_FILE, reinterpret_cast<const char*>(entry.object.data()), entry.object.size()) &&
+              WriteFile(temp / LINKS_FILE, links.data(), links.size());
+    if(!ok){
+        Log::Warning("Failed to write the cache entry in `" + temp.string() + "`");
+        fs::remove_all(temp, error);
+        return;
+    }
+
+    // another compile of the same program may have stored it first, both entries are the same
+    fs::rename(temp, directory / key, error);
+    if(error)
+        fs::remove_all(temp, error);
+
+    Evict();
+}
+
+void Cache::Evict() {
+    struct Used{
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+
+    std::vector<Used> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    for(const fs::directory_entry& entry : fs::directory_iterator(directory, error)){
+        if(!IsEntry(entry))
+            continue;
+
+        Used used{entry.path(), fs::last_write_time(entry.path(), error), EntrySize(entry.path())};
+        total += used.size;
+        entries.emplace_back(used);
+    }
+
+    if(total <= max_size)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const Used& a, const Used& b){ return a.time < b.time; });
+    for(const Used& entry : entries){
+        if(total <= max_size)
+            break;
+        fs::remove_all(entry.path, error);
+        total -= entry.size;
+    }
+}
+
+/// The hits and the misses, two counters at the start of the stats file. It is locked while it is used, so
+/// compiles running at once don't lose each other's counts
+struct Counts{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+void Cache::Record(bool hit) {
+    int file = open((directory / STATS_FILE).c_str(), O_RDWR | O_CREAT, 0644);
+    if(file < 0)
+        return;
+    if(flock(file, LOCK_EX) == 0){
+        // a new file, or the byte per compile older builds appended, starts again from 0
+        Counts stats;
+        struct stat info{};
+        bool valid = fstat(file, &info) == 0 && info.st_size == sizeof(stats);
+        if(!valid || pread(file, &stats, sizeof(stats), 0) != sizeof(stats))
+            stats = Counts{};
+        (hit ? stats.hits : stats.misses)++;
+        if((!valid && ftruncate(file, 0) != 0) || pwrite(file, &stats, sizeof(stats), 0) != sizeof(stats))
+            Log::Warning("Failed to update the cache stats in `" + (directory / STATS_FILE).string() + "`");
+    }
+    close(file);
+}
+
+void Cache::PrintStats() {
+    Counts stats;
+    int file = open((directory / STATS_FILE).c_str(), O_RDONLY);
+    if(file >= 0){
+        struct stat info{};
+        if(flock(file, LOCK_SH) != 0 || fstat(file, &info) != 0 || info.st_size != sizeof(stats) ||
+           pread(file, &stats, sizeof(stats), 0) != sizeof(stats))
+            stats = Counts{};
+        close(file);
+    }
+    uint64_t hits = stats.hits, misses = stats.misses;
+
+    uint64_t entries = 0, size = 0;
+    std::error_code error;
+    for(const fs::directory_entry& entry : fs::directory_iterator(directory, error)){
+        if(!IsEntry(entry))
+            continue;
+        entries++;
+        size += EntrySize(entry.path());
+    }
+
+    double rate = hits + misses > 0 ? 100.0 * static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+    std::cout << "cache directory: " << directory.string() << '\n'
+              << "hits:            " << hits << '\n'
+              << "misses:          " << misses << '\n'
+              << "hit rate:        " << std::fixed << std::setprecision(1) << rate << "%\n"
+              << "entries:         " << entries << '\n'
+              << "size:            " << std::setprecision(2) << static_cast<double>(size) / (1024 * 1024) << " MB of "
+              << static_cast<double>(max_size) / (1024 * 1024) << " MB\n";
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "PCH.h"
+#include "Log.h"
+#include "Arguments.h"
+
+#include <filesystem>
+
+/// An on-disk cache of compiled programs, each entry is named after the hash of everything that decides its contents.
+/// Entries are written to a temporary directory and renamed into place, so no compile ever sees half of one
+class Cache{
+public:
+    struct Entry{
+        std::vector<uint8_t> object;
+        std::vector<std::string> links;
+    };
+
+    Cache(const std::string& dir, uint64_t size_limit);
+
+    /// The key of compiling the modules with `sources` (the program last) with `args` by this build of the compiler
+    static std::string Key(const std::vector<std::string>& sources, const Arguments& args);
+    /// $GALAXIC_CACHE_DIR, otherwise galaxic in the user's cache directory
+    static std::string DefaultDirectory();
+
+    bool Lookup(const std::string& key, Entry& entry);
+    /// Failing to store only warns, the compile itself already worked
+    void Store(const std::string& key, const Entry& entry);
+    /// Prints the hits and misses of every compile that used the cache and how full it is
+    void PrintStats();
+
+private:
+
+    void Record(bool hit);
+    /// Removes the least recently used entries until the cache fits in its size limit
+    void Evict();
+
+    std::filesystem::path directory;
+    uint64_t max_size;
+};
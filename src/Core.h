@@ -2,11 +2,20 @@
 
 #include <iostream>
 
+// part of every cache key, so objects of an older compiler are never reused
+#define GALAXIC_VERSION     "0.2.0"
+
 #define PLATFORM_WIN32      0
 #define PLATFORM_WIN64      1
 #define PLATFORM_LINUX32    2
 #define PLATFORM_LINUX64    3
 
+#ifdef _WIN32
+    #define PLATFORM_DEFAULT    PLATFORM_WIN64
+#else
+    #define PLATFORM_DEFAULT    PLATFORM_LINUX64
+#endif
+
 #define ASSERT(msg) { \
     std::cerr << "[ASSERTION] from function " << __FUNCTION__ \
               << " at line " << __LINE__ \
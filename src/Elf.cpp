@@ -0,0 +1,440 @@
+#include "Elf.h"
+
+#include <filesystem>
+
+namespace Elf{
+    /// String table builder, the first byte is always the empty string
+    class StringTable{
+    public:
+        inline StringTable(){ data.emplace_back(0); }
+
+        inline uint32_t Add(const std::string& str){
+            if(str.empty())
+                return 0;
+            auto it = offsets.find(str);
+            if(it != offsets.end())
+                return it->second;
+
+            auto offset = static_cast<uint32_t>(data.size());
+            data.insert(data.end(), str.begin(), str.end());
+            data.emplace_back(0);
+            offsets[str] = offset;
+            return offset;
+        }
+
+        inline const std::vector<uint8_t>& Data(){ return data; }
+
+    private:
+        std::vector<uint8_t> data;
+        std::unordered_map<std::string, uint32_t> offsets;
+    };
+
+    void WriteHeader(Buffer& buf, uint16_t type, uint64_t entry, uint64_t phoff, uint16_t phnum,
+                     uint64_t shoff, uint16_t shnum, uint16_t shstrndx) {
+        buf.Put8(0x7F);
+        buf.Put8('E');
+        buf.Put8('L');
+        buf.Put8('F');
+        buf.Put8(2); // 64-bit
+        buf.Put8(1); // little endian
+        buf.Put8(1); // version
+        buf.Put8(0); // System V abi
+        for(int i = 0; i < 8; i++)
+            buf.Put8(0);
+
+        buf.Put16(type);
+        buf.Put16(EM_X86_64);
+        buf.Put32(1);
+        buf.Put64(entry);
+        buf.Put64(phoff);
+        buf.Put64(shoff);
+        buf.Put32(0);
+        buf.Put16(HEADER_SIZE);
+        buf.Put16(phnum ? PROGRAM_HEADER_SIZE : 0);
+        buf.Put16(phnum);
+        buf.Put16(shnum ? SECTION_HEADER_SIZE : 0);
+        buf.Put16(shnum);
+        buf.Put16(shstrndx);
+    }
+
+    void WriteSectionHeader(Buffer& buf, const SectionHeader& header) {
+        buf.Put32(header.name);
+        buf.Put32(header.type);
+        buf.Put64(header.flags);
+        buf.Put64(header.addr);
+        buf.Put64(header.offset);
+        buf.Put64(header.size);
+        buf.Put32(header.link);
+        buf.Put32(header.info);
+        buf.Put64(header.addralign);
+        buf.Put64(header.entsize);
+    }
+
+    void WriteProgramHeader(Buffer& buf, const ProgramHeader& header) {
+        buf.Put32(header.type);
+        buf.Put32(header.flags);
+        buf.Put64(header.offset);
+        buf.Put64(header.vaddr);
+        buf.Put64(header.vaddr); // physical address
+        buf.Put64(header.filesz);
+        buf.Put64(header.memsz);
+        buf.Put64(header.align);
+    }
+
+    uint32_t RelocTypeToElf(ObjectCode::RelocType type) {
+        switch(type){
+            case ObjectCode::RelocType::abs64: return R_X86_64_64;
+            case ObjectCode::RelocType::abs32: return R_X86_64_32;
+            case ObjectCode::RelocType::abs32s: return R_X86_64_32S;
+            case ObjectCode::RelocType::pc32: return R_X86_64_PC32;
+            case ObjectCode::RelocType::plt32: return R_X86_64_PLT32;
+        }
+        return R_X86_64_NONE;
+    }
+
+    struct DebugSections{
+        Buffer abbrev, info, rela_info, line, rela_line, ranges, rela_ranges;
+    };
+
+    /// The symbols the debug sections are relocated against, the ranges one only with more than one text section
+    struct DebugSymbols{
+        std::vector<uint32_t> texts;
+        uint32_t abbrev, line, ranges;
+    };
+
+    /// A DWARF 4 compile unit with only the line table of the text, which is all addr2line, gdb and perf need
+    /// to find the source line of an address. Addresses are relocated against .text and the offsets into the
+    /// other sections against them, so the linker can put the units of many objects together. With more text
+    /// sections the unit covers them with a range list and the line table has a sequence for each
+    static void WriteDebugSections(const ObjectCode& code, const std::string& source_name, const DebugSymbols& symbols,
+                                   DebugSections& out) {
+        constexpr uint8_t DW_TAG_compile_unit = 0x11, DW_CHILDREN_no = 0;
+        constexpr uint8_t DW_AT_name = 0x03, DW_AT_stmt_list = 0x10, DW_AT_low_pc = 0x11, DW_AT_high_pc = 0x12,
+                          DW_AT_comp_dir = 0x1B, DW_AT_producer = 0x25, DW_AT_ranges = 0x55;
+        constexpr uint8_t DW_FORM_addr = 0x01, DW_FORM_data8 = 0x07, DW_FORM_string = 0x08, DW_FORM_sec_offset = 0x17;
+        constexpr uint8_t DW_LNS_copy = 1, DW_LNS_advance_pc = 2, DW_LNS_advance_line = 3, DW_LNS_set_file = 4;
+        constexpr uint8_t DW_LNE_end_sequence = 1, DW_LNE_set_address = 2;
+
+        auto relocate = [](Buffer& rela, uint64_t offset, uint32_t symbol, uint32_t type, int64_t addend = 0){
+            rela.Put64(offset);
+            rela.Put64((static_cast<uint64_t>(symbol) << 32) | type);
+            rela.Put64(static_cast<uint64_t>(addend));
+        };
+        bool ranges = code.texts.size() > 1;
+
+        out.abbrev.PutUleb(1);
+        out.abbrev.PutUleb(DW_TAG_compile_unit);
+        out.abbrev.Put8(DW_CHILDREN_no);
+        for(uint8_t attribute : {DW_AT_producer, DW_FORM_string, DW_AT_name, DW_FORM_string, DW_AT_comp_dir, DW_FORM_string,
+                                 DW_AT_stmt_list, DW_FORM_sec_offset, DW_AT_low_pc, DW_FORM_addr})
+            out.abbrev.PutUleb(attribute);
+        out.abbrev.PutUleb(ranges ? DW_AT_ranges : DW_AT_high_pc);
+        out.abbrev.PutUleb(ranges ? DW_FORM_sec_offset : DW_FORM_data8);
+        out.abbrev.Put16(0); // the end of the attributes
+        out.abbrev.Put8(0);  // and of the abbreviations
+
+        std::error_code error;
+        std::string directory = std::filesystem::current_path(error).string();
+        out.info.Put32(0); // the length after this field
+        out.info.Put16(4);
+        relocate(out.rela_info, out.info.Size(), symbols.abbrev, R_X86_64_32);
+        out.info.Put32(0);
+        out.info.Put8(8);
+        out.info.PutUleb(1);
+        out.info.PutString("GalaxiC " GALAXIC_VERSION);
+        out.info.PutString(source_name);
+        out.info.PutString(directory);
+        relocate(out.rela_info, out.info.Size(), symbols.line, R_X86_64_32);
+        out.info.Put32(0);
+        if(ranges){
+            // the base of the range list is 0, its entries are the relocated addresses of the sections
+            out.info.Put64(0);
+            relocate(out.rela_info, out.info.Size(), symbols.ranges, R_X86_64_32);
+            out.info.Put32(0);
+            for(size_t i = 0; i < code.texts.size(); i++){
+                relocate(out.rela_ranges, out.ranges.Size(), symbols.texts.at(i), R_X86_64_64);
+                out.ranges.Put64(0);
+                relocate(out.rela_ranges, out.ranges.Size(), symbols.texts.at(i), R_X86_64_64,
+                         static_cast<int64_t>(code.texts.at(i).bytes.size()));
+                out.ranges.Put64(0);
+            }
+            out.ranges.Put64(0);
+            out.ranges.Put64(0);
+        }
+        else{
+            relocate(out.rela_info, out.info.Size(), symbols.texts.at(0), R_X86_64_64);
+            out.info.Put64(0);
+            out.info.Put64(code.texts.at(0).bytes.size());
+        }
+        out.info.Patch32(0, static_cast<uint32_t>(out.info.Size() - 4));
+
+        Buffer& line = out.line;
+        line.Put32(0); // the length after this field
+        line.Put16(4);
+        line.Put32(0); // the length of the header after this field
+        uint64_t header_start = line.Size();
+        line.Put8(1);  // minimum instruction length
+        line.Put8(1);  // operations per instruction
+        line.Put8(1);  // every row is the start of a statement
+        line.Put8(static_cast<uint8_t>(-5)); // line base and range of the special opcodes, which aren't used
+        line.Put8(14);
+        line.Put8(13); // the first special opcode
+        for(uint8_t operands : {0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1})
+            line.Put8(operands);
+        line.Put8(0); // no include directories, the files are relative to the compile directory
+        for(const std::string& file : code.files){
+            line.PutString(file);
+            line.PutUleb(0); // directory, modification time and size
+            line.PutUleb(0);
+            line.PutUleb(0);
+        }
+        line.Put8(0);
+        line.Patch32(6, static_cast<uint32_t>(line.Size() - header_start));
+
+        // a sequence of rows for the code of each section, every sequence starts over at line 1 of the first file
+        auto write_sequence = [&](const std::vector<ObjectCode::Line>& rows, uint32_t section_symbol, uint64_t size){
+            line.Put8(0);
+            line.PutUleb(9);
+            line.Put8(DW_LNE_set_address);
+            relocate(out.rela_line, line.Size(), section_symbol, R_X86_64_64);
+            line.Put64(0);
+
+            uint64_t address = 0;
+            int64_t current_line = 1;
+            uint32_t current_file = 1;
+            for(const ObjectCode::Line& row : rows){
+                if(row.file + 1 != current_file){
+                    current_file = row.file + 1;
+                    line.Put8(DW_LNS_set_file);
+                    line.PutUleb(current_file);
+                }
+                if(row.offset != address){
+                    line.Put8(DW_LNS_advance_pc);
+                    line.PutUleb(row.offset - address);
+                    address = row.offset;
+                }
+                if(row.line != current_line){
+                    line.Put8(DW_LNS_advance_line);
+                    line.PutSleb(static_cast<int64_t>(row.line) - current_line);
+                    current_line = row.line;
+                }
+                line.Put8(DW_LNS_copy);
+            }
+            if(size > address){
+                line.Put8(DW_LNS_advance_pc);
+                line.PutUleb(size - address);
+            }
+            line.Put8(0);
+            line.PutUleb(1);
+            line.Put8(DW_LNE_end_sequence);
+        };
+        for(size_t i = 0; i < code.texts.size(); i++){
+            if(i == 0 || !code.texts.at(i).lines.empty())
+                write_sequence(code.texts.at(i).lines, symbols.texts.at(i), code.texts.at(i).bytes.size());
+        }
+        line.Patch32(0, static_cast<uint32_t>(line.Size() - 4));
+    }
+
+    std::vector<uint8_t> WriteObject(const ObjectCode& code, const std::string& source_name) {
+        enum : uint16_t {
+            null_index, text_index, data_index, bss_index, rela_text_index, rela_data_index,
+            note_stack_index, symtab_index, strtab_index, shstrtab_index,
+            fixed_count
+        };
+        // every text section after .text comes with its relocations, the debug sections are only written for -g
+        bool debug = false;
+        for(const ObjectCode::Text& text : code.texts)
+            debug = debug || !text.lines.empty();
+        bool ranges = debug && code.texts.size() > 1;
+        uint16_t sections = fixed_count;
+        std::vector<uint16_t> text_indexes = {text_index};
+        for(size_t i = 1; i < code.texts.size(); i++){
+            text_indexes.emplace_back(sections);
+            sections += 2;
+        }
+        const uint16_t debug_abbrev_index = debug ? sections++ : 0;
+        const uint16_t debug_info_index = debug ? sections++ : 0;
+        const uint16_t rela_debug_info_index = debug ? sections++ : 0;
+        const uint16_t debug_line_index = debug ? sections++ : 0;
+        const uint16_t rela_debug_line_index = debug ? sections++ : 0;
+        const uint16_t debug_ranges_index = ranges ? sections++ : 0;
+        const uint16_t rela_debug_ranges_index = ranges ? sections++ : 0;
+
+        StringTable strtab;
+        StringTable shstrtab;
+
+        /// Symbol table, locals have to come before the globals
+        Buffer symtab;
+        std::unordered_map<std::string, uint32_t> symbol_index;
+        uint32_t symbol_count = 0;
+
+        auto put_symbol = [&](uint32_t name, uint8_t bind, uint8_t type, uint16_t section, uint64_t value){
+            symtab.Put32(name);
+            symtab.Put8((bind << 4) | type);
+            symtab.Put8(0);
+            symtab.Put16(section);
+            symtab.Put64(value);
+            symtab.Put64(0);
+            symbol_count++;
+        };
+        auto section_of = [&](const ObjectCode::Symbol& symbol) -> uint16_t {
+            switch(symbol.section){
+                case ObjectCode::Section::text: return text_indexes.at(symbol.text);
+                case ObjectCode::Section::data: return data_index;
+                case ObjectCode::Section::bss: return bss_index;
+                case ObjectCode::Section::undefined: return SHN_UNDEF;
+            }
+            return SHN_UNDEF;
+        };
+
+        put_symbol(0, STB_LOCAL, STT_NOTYPE, SHN_UNDEF, 0);
+        put_symbol(strtab.Add(source_name), STB_LOCAL, STT_FILE, SHN_ABS, 0);
+        // code in one of the text sections reaches the others through their section symbols
+        DebugSymbols debug_symbols{};
+        for(size_t i = 0; i < code.texts.size(); i++){
+            symbol_index[code.texts.at(i).name] = symbol_count;
+            debug_symbols.texts.emplace_back(symbol_count);
+            put_symbol(0, STB_LOCAL, STT_SECTION, text_indexes.at(i), 0);
+            if(i == 0){
+                put_symbol(0, STB_LOCAL, STT_SECTION, data_index, 0);
+                put_symbol(0, STB_LOCAL, STT_SECTION, bss_index, 0);
+            }
+        }
+        DebugSections debug_sections;
+        if(debug){
+            debug_symbols.abbrev = symbol_count;
+            put_symbol(0, STB_LOCAL, STT_SECTION, debug_abbrev_index, 0);
+            debug_symbols.line = symbol_count;
+            put_symbol(0, STB_LOCAL, STT_SECTION, debug_line_index, 0);
+            debug_symbols.ranges = symbol_count;
+            if(ranges)
+                put_symbol(0, STB_LOCAL, STT_SECTION, debug_ranges_index, 0);
+            WriteDebugSections(code, source_name, debug_symbols, debug_sections);
+        }
+
+        uint32_t first_global = 0; // sh_info of the symbol table
+        for(bool global : {false, true}){
+            if(global)
+                first_global = symbol_count;
+
+            for(const ObjectCode::Symbol& symbol : code.symbols){
+                if(symbol.global != global)
+                    continue;
+                symbol_index[symbol.name] = symbol_count;
+                put_symbol(strtab.Add(symbol.name), global ? STB_GLOBAL : STB_LOCAL, STT_NOTYPE, section_of(symbol),
+                           symbol.value);
+            }
+        }
+
+        auto write_relocs = [&](const std::vector<ObjectCode::Relocation>& relocs){
+            Buffer buf;
+            for(const ObjectCode::Relocation& reloc : relocs){
+                buf.Put64(reloc.offset);
+                buf.Put64((static_cast<uint64_t>(symbol_index.at(reloc.symbol)) << 32) | RelocTypeToElf(reloc.type));
+                buf.Put64(static_cast<uint64_t>(reloc.addend));
+            }
+            return buf;
+        };
+        std::vector<Buffer> rela_texts;
+        for(const ObjectCode::Text& text : code.texts)
+            rela_texts.emplace_back(write_relocs(text.relocs));
+        Buffer rela_data = write_relocs(code.data_relocs);
+
+        std::vector<SectionHeader> headers(sections);
+        headers[text_index] = {shstrtab.Add(".text"), SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0,
+                               code.texts.at(0).bytes.size(), 0, 0, 16, 0};
+        headers[data_index] = {shstrtab.Add(".data"), SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, 0, code.data.size(), 0, 0, 16, 0};
+        headers[bss_index] = {shstrtab.Add(".bss"), SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 0, 0, code.bss_size, 0, 0, 16, 0};
+        headers[rela_text_index] = {shstrtab.Add(".rela.text"), SHT_RELA, SHF_INFO_LINK, 0, 0, rela_texts.at(0).Size(),
+                                    symtab_index, text_index, 8, RELA_SIZE};
+        headers[rela_data_index] = {shstrtab.Add(".rela.data"), SHT_RELA, SHF_INFO_LINK, 0, 0, rela_data.Size(),
+                                    symtab_index, data_index, 8, RELA_SIZE};
+        // an empty .note.GNU-stack tells the linker that the stack does not have to be executable
+        headers[note_stack_index] = {shstrtab.Add(".note.GNU-stack"), SHT_PROGBITS, 0, 0, 0, 0, 0, 0, 1, 0};
+        headers[symtab_index] = {shstrtab.Add(".symtab"), SHT_SYMTAB, 0, 0, 0, symtab.Size(), strtab_index, first_global, 8,
+                                 SYMBOL_SIZE};
+        headers[strtab_index] = {shstrtab.Add(".strtab"), SHT_STRTAB, 0, 0, 0, strtab.Data().size(), 0, 0, 1, 0};
+        headers[shstrtab_index] = {shstrtab.Add(".shstrtab"), SHT_STRTAB, 0, 0, 0, 0, 0, 0, 1, 0};
+        for(size_t i = 1; i < code.texts.size(); i++){
+            const ObjectCode::Text& text = code.texts.at(i);
+            uint16_t index = text_indexes.at(i);
+            headers[index] = {shstrtab.Add(text.name), SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0, text.bytes.size(), 0, 0, 16, 0};
+            headers[index + 1] = {shstrtab.Add(".rela" + text.name), SHT_RELA, SHF_INFO_LINK, 0, 0, rela_texts.at(i).Size(),
+                                  symtab_index, index, 8, RELA_SIZE};
+        }
+        if(debug){
+            headers[debug_abbrev_index] = {shstrtab.Add(".debug_abbrev"), SHT_PROGBITS, 0, 0, 0,
+                                           debug_sections.abbrev.Size(), 0, 0, 1, 0};
+            headers[debug_info_index] = {shstrtab.Add(".debug_info"), SHT_PROGBITS, 0, 0, 0,
+                                         debug_sections.info.Size(), 0, 0, 1, 0};
+            headers[rela_debug_info_index] = {shstrtab.Add(".rela.debug_info"), SHT_RELA, SHF_INFO_LINK, 0, 0,
+                                              debug_sections.rela_info.Size(), symtab_index, debug_info_index, 8, RELA_SIZE};
+            headers[debug_line_index] = {shstrtab.Add(".debug_line"), SHT_PROGBITS, 0, 0, 0,
+                                         debug_sections.line.Size(), 0, 0, 1, 0};
+            headers[rela_debug_line_index] = {shstrtab.Add(".rela.debug_line"), SHT_RELA, SHF_INFO_LINK, 0, 0,
+                                              debug_sections.rela_line.Size(), symtab_index, debug_line_index, 8, RELA_SIZE};
+        }
+        if(ranges){
+            headers[debug_ranges_index] = {shstrtab.Add(".debug_ranges"), SHT_PROGBITS, 0, 0, 0,
+                                           debug_sections.ranges.Size(), 0, 0, 1, 0};
+            headers[rela_debug_ranges_index] = {shstrtab.Add(".rela.debug_ranges"), SHT_RELA, SHF_INFO_LINK, 0, 0,
+                                                debug_sections.rela_ranges.Size(), symtab_index, debug_ranges_index, 8, RELA_SIZE};
+        }
+        headers[shstrtab_index].size = shstrtab.Data().size();
+
+        /// The contents of the sections, in the same order as the headers
+        Buffer file;
+        file.Bytes().resize(HEADER_SIZE, 0);
+
+        auto place = [&](uint16_t index, const std::vector<uint8_t>& bytes){
+            file.Align(headers[index].addralign);
+            headers[index].offset = file.Size();
+            file.PutBytes(bytes);
+        };
+
+        place(text_index, code.texts.at(0).bytes);
+        place(data_index, code.data);
+        headers[bss_index].offset = file.Size();
+        place(rela_text_index, rela_texts.at(0).Bytes());
+        place(rela_data_index, rela_data.Bytes());
+        headers[note_stack_index].offset = file.Size();
+        place(symtab_index, symtab.Bytes());
+        place(strtab_index, strtab.Data());
+        place(shstrtab_index, shstrtab.Data());
+        for(size_t i = 1; i < code.texts.size(); i++){
+            place(text_indexes.at(i), code.texts.at(i).bytes);
+            place(text_indexes.at(i) + 1, rela_texts.at(i).Bytes());
+        }
+        if(debug){
+            place(debug_abbrev_index, debug_sections.abbrev.Bytes());
+            place(debug_info_index, debug_sections.info.Bytes());
+            place(rela_debug_info_index, debug_sections.rela_info.Bytes());
+            place(debug_line_index, debug_sections.line.Bytes());
+            place(rela_debug_line_index, debug_sections.rela_line.Bytes());
+        }
+        if(ranges){
+            place(debug_ranges_index, debug_sections.ranges.Bytes());
+            place(rela_debug_ranges_index, debug_sections.rela_ranges.Bytes());
+        }
+
+        file.Align(8);
+        uint64_t shoff = file.Size();
+        for(const SectionHeader& section_header : headers)
+            WriteSectionHeader(file, section_header);
+
+        Buffer header;
+        WriteHeader(header, ET_REL, 0, 0, 0, shoff, sections, shstrtab_index);
+        std::copy(header.Bytes().begin(), header.Bytes().end(), file.Bytes().begin());
+
+        return file.Bytes();
+    }
+
+    bool WriteFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+        std::ofstream file(path, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return file.good();
+    }
+}
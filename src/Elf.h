@@ -0,0 +1,143 @@
+#pragma once
+
+#include "PCH.h"
+#include "Encoder.h"
+
+/// Writes ELF64 files for x86-64, the structures are written field by field so <elf.h> is not needed
+namespace Elf{
+    constexpr uint16_t ET_REL = 1;
+    constexpr uint16_t ET_EXEC = 2;
+    constexpr uint16_t EM_X86_64 = 62;
+
+    constexpr uint32_t SHT_NULL = 0;
+    constexpr uint32_t SHT_PROGBITS = 1;
+    constexpr uint32_t SHT_SYMTAB = 2;
+    constexpr uint32_t SHT_STRTAB = 3;
+    constexpr uint32_t SHT_RELA = 4;
+    constexpr uint32_t SHT_NOBITS = 8;
+    constexpr uint32_t SHT_INIT_ARRAY = 14;
+    constexpr uint32_t SHT_FINI_ARRAY = 15;
+    constexpr uint32_t SHT_PREINIT_ARRAY = 16;
+
+    constexpr uint64_t SHF_WRITE = 0x1;
+    constexpr uint64_t SHF_ALLOC = 0x2;
+    constexpr uint64_t SHF_EXECINSTR = 0x4;
+    constexpr uint64_t SHF_INFO_LINK = 0x40;
+    constexpr uint64_t SHF_TLS = 0x400;
+    constexpr uint64_t SHF_GNU_RETAIN = 0x200000;
+
+    constexpr uint32_t PT_LOAD = 1;
+    constexpr uint32_t PT_GNU_STACK = 0x6474e551;
+    constexpr uint32_t PF_X = 0x1;
+    constexpr uint32_t PF_W = 0x2;
+    constexpr uint32_t PF_R = 0x4;
+
+    constexpr uint8_t STB_LOCAL = 0;
+    constexpr uint8_t STB_GLOBAL = 1;
+    constexpr uint8_t STB_WEAK = 2;
+    constexpr uint8_t STT_NOTYPE = 0;
+    constexpr uint8_t STT_OBJECT = 1;
+    constexpr uint8_t STT_FUNC = 2;
+    constexpr uint8_t STT_SECTION = 3;
+    constexpr uint8_t STT_FILE = 4;
+    constexpr uint8_t STT_TLS = 6;
+    constexpr uint8_t STT_GNU_IFUNC = 10;
+    constexpr uint16_t SHN_UNDEF = 0;
+    constexpr uint16_t SHN_ABS = 0xFFF1;
+    constexpr uint16_t SHN_COMMON = 0xFFF2;
+
+    constexpr uint32_t R_X86_64_NONE = 0;
+    constexpr uint32_t R_X86_64_64 = 1;
+    constexpr uint32_t R_X86_64_PC32 = 2;
+    constexpr uint32_t R_X86_64_PLT32 = 4;
+    constexpr uint32_t R_X86_64_GOTPCREL = 9;
+    constexpr uint32_t R_X86_64_32 = 10;
+    constexpr uint32_t R_X86_64_32S = 11;
+    constexpr uint32_t R_X86_64_PC64 = 24;
+    constexpr uint32_t R_X86_64_GOTOFF64 = 25;
+    constexpr uint32_t R_X86_64_GOTPC32 = 26;
+    constexpr uint32_t R_X86_64_GOTPCRELX = 41;
+    constexpr uint32_t R_X86_64_REX_GOTPCRELX = 42;
+
+    constexpr uint64_t HEADER_SIZE = 64;
+    constexpr uint64_t SECTION_HEADER_SIZE = 64;
+    constexpr uint64_t SYMBOL_SIZE = 24;
+    constexpr uint64_t RELA_SIZE = 24;
+    constexpr uint64_t PROGRAM_HEADER_SIZE = 56;
+
+    /// Little endian byte buffer used to build the file
+    class Buffer{
+    public:
+        inline void Put8(uint8_t value){ bytes.emplace_back(value); }
+        inline void Put16(uint16_t value){ PutN(value, 2); }
+        inline void Put32(uint32_t value){ PutN(value, 4); }
+        inline void Put64(uint64_t value){ PutN(value, 8); }
+        inline void PutBytes(const std::vector<uint8_t>& data){ bytes.insert(bytes.end(), data.begin(), data.end()); }
+        inline void PutString(const std::string& str){ bytes.insert(bytes.end(), str.begin(), str.end()); bytes.emplace_back(0); }
+        /// LEB128 numbers of DWARF, 7 bits per byte and the high bit set on every byte but the last
+        inline void PutUleb(uint64_t value){
+            do{
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                bytes.emplace_back(value ? byte | 0x80 : byte);
+            } while(value);
+        }
+        inline void PutSleb(int64_t value){
+            bool more = true;
+            while(more){
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                more = !((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)));
+                bytes.emplace_back(more ? byte | 0x80 : byte);
+            }
+        }
+        inline void Patch32(uint64_t at, uint32_t value){
+            for(uint8_t i = 0; i < 4; i++)
+                bytes.at(at + i) = static_cast<uint8_t>(value >> (i * 8));
+        }
+        inline void Align(uint64_t align){ while(bytes.size() % align) bytes.emplace_back(0); }
+        inline uint64_t Size(){ return bytes.size(); }
+        inline std::vector<uint8_t>& Bytes(){ return bytes; }
+
+    private:
+        inline void PutN(uint64_t value, uint8_t n){
+            for(uint8_t i = 0; i < n; i++)
+                bytes.emplace_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+
+        std::vector<uint8_t> bytes;
+    };
+
+    struct SectionHeader{
+        uint32_t name;
+        uint32_t type;
+        uint64_t flags;
+        uint64_t addr;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t link;
+        uint32_t info;
+        uint64_t addralign;
+        uint64_t entsize;
+    };
+
+    struct ProgramHeader{
+        uint32_t type;
+        uint32_t flags;
+        uint64_t offset;
+        uint64_t vaddr;
+        uint64_t filesz;
+        uint64_t memsz;
+        uint64_t align;
+    };
+
+    void WriteHeader(Buffer& buf, uint16_t type, uint64_t entry, uint64_t phoff, uint16_t phnum,
+                     uint64_t shoff, uint16_t shnum, uint16_t shstrndx);
+    void WriteSectionHeader(Buffer& buf, const SectionHeader& header);
+    void WriteProgramHeader(Buffer& buf, const ProgramHeader& header);
+    uint32_t RelocTypeToElf(ObjectCode::RelocType type);
+
+    /// Builds a relocatable object file (.o) out of the encoded code, with a DWARF line table when it has lines
+    std::vector<uint8_t> WriteObject(const ObjectCode& code, const std::string& source_name);
+    bool WriteFile(const std::string& path, const std::vector<uint8_t>& bytes);
+}
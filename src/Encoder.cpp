@@ -0,0 +1,979 @@
+#include "Encoder.h"
+#include "Profiler.h"
+
+static inline uint8_t RegId(Asm::Reg reg){
+    return static_cast<uint8_t>(reg);
+}
+
+static inline bool FitsInt8(int64_t value){
+    return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+static inline bool FitsInt32(int64_t value){
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static uint8_t ConditionCode(Asm::Op op){
+    switch(op){
+        case Asm::Op::je: return 0x4;
+        case Asm::Op::jne: return 0x5;
+        case Asm::Op::jg: return 0xF;
+        case Asm::Op::jge: return 0xD;
+        case Asm::Op::jl: return 0xC;
+        case Asm::Op::jle: return 0xE;
+        case Asm::Op::ja: return 0x7;
+        case Asm::Op::jae: return 0x3;
+        case Asm::Op::jb: return 0x2;
+        case Asm::Op::jbe: return 0x6;
+        default: return 0;
+    }
+}
+
+/// The operand size of an instruction, taken from the register operands first
+static uint8_t OperandSize(const Asm::Instr& instr){
+    if(instr.dst.kind == Asm::Operand::Kind::reg)
+        return instr.dst.size;
+    if(instr.src.kind == Asm::Operand::Kind::reg)
+        return instr.src.size;
+    if(instr.dst.size)
+        return instr.dst.size;
+    return instr.src.size;
+}
+
+bool Encoder::Fail(const Asm::Instr& instr, const std::string& msg) {
+    error = msg + " `" + Asm::InstrToString(instr) + "`";
+    return false;
+}
+
+void Encoder::EmitPrefixes(Fragment& frag, uint8_t size, uint8_t reg, bool reg_byte, const Asm::Operand* rm, bool default64) {
+    if(size == 2)
+        frag.bytes.emplace_back(0x66);
+
+    uint8_t rex = 0;
+    bool force = false;
+
+    if(size == 8 && !default64)
+        rex |= 0x08;
+    if(reg >= 8)
+        rex |= 0x04;
+    if(reg_byte && reg >= 4 && reg < 8)
+        force = true; // spl, bpl, sil and dil are only reachable with a REX prefix
+
+    if(rm){
+        if(rm->kind == Asm::Operand::Kind::mem){
+            if(rm->scale && RegId(rm->index) >= 8)
+                rex |= 0x02;
+            if(rm->base && !rm->rip && RegId(rm->reg) >= 8)
+                rex |= 0x01;
+        }
+        else if(rm->kind == Asm::Operand::Kind::reg){
+            if(RegId(rm->reg) >= 8)
+                rex |= 0x01;
+            if(rm->size == 1 && RegId(rm->reg) >= 4 && RegId(rm->reg) < 8)
+                force = true;
+        }
+    }
+
+    if(rex || force)
+        frag.bytes.emplace_back(0x40 | rex);
+}
+
+void Encoder::EmitImm(Fragment& frag, int64_t value, uint8_t size) {
+    for(uint8_t i = 0; i < size; i++)
+        frag.bytes.emplace_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+}
+
+void Encoder::EmitModRM(Fragment& frag, uint8_t reg, const Asm::Operand& rm, uint8_t trailing) {
+    uint8_t r = (reg & 7) << 3;
+
+    if(rm.kind == Asm::Operand::Kind::reg){
+        frag.bytes.emplace_back(0xC0 | r | (RegId(rm.reg) & 7));
+        return;
+    }
+
+    auto disp32 = [&](ObjectCode::RelocType type, int64_t addend){
+        if(!rm.name.empty()){
+            frag.fixups.emplace_back(Fixup{static_cast<uint32_t>(frag.bytes.size()), type, rm.name, addend});
+            EmitImm(frag, 0, 4);
+        }
+        else
+            EmitImm(frag, rm.value, 4);
+    };
+
+    uint8_t scale_bits = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+
+    if(rm.rip){
+        frag.bytes.emplace_back(0x05 | r);
+        // the cpu adds the displacement to the address of the next instruction
+        disp32(ObjectCode::RelocType::pc32, rm.value - 4 - trailing);
+        return;
+    }
+
+    if(!rm.base){
+        frag.bytes.emplace_back(0x04 | r);
+        if(rm.scale)
+            frag.bytes.emplace_back((scale_bits << 6) | ((RegId(rm.index) & 7) << 3) | 5);
+        else
+            frag.bytes.emplace_back(0x25);
+        disp32(ObjectCode::RelocType::abs32s, rm.value);
+        return;
+    }
+
+    uint8_t base = RegId(rm.reg) & 7;
+    bool sib = rm.scale || base == 4; // rsp and r12 can only be a base through the sib byte
+
+    uint8_t mod;
+    if(!rm.name.empty())
+        mod = 2;
+    else if(rm.value == 0 && base != 5) // rbp and r13 need a displacement
+        mod = 0;
+    else if(FitsInt8(rm.value))
+        mod = 1;
+    else
+        mod = 2;
+
+    frag.bytes.emplace_back((mod << 6) | r | (sib ? 4 : base));
+    if(sib){
+        uint8_t index = rm.scale ? (RegId(rm.index) & 7) : 4;
+        frag.bytes.emplace_back((scale_bits << 6) | (index << 3) | base);
+    }
+
+    if(mod == 1)
+        EmitImm(frag, rm.value, 1);
+    else if(mod == 2)
+        disp32(ObjectCode::RelocType::abs32s, rm.value);
+}
+
+bool Encoder::EncodeMov(const Asm::Instr& instr, Fragment& frag) {
+    using Kind = Asm::Operand::Kind;
+    const Asm::Operand& dst = instr.dst;
+    const Asm::Operand& src = instr.src;
+    uint8_t size = OperandSize(instr);
+
+    if(dst.kind == Kind::reg && src.kind == Kind::reg){
+        if(dst.size != src.size)
+            return Fail(instr, "Mismatched register sizes");
+        EmitPrefixes(frag, size, RegId(src.reg), size == 1, &dst);
+        frag.bytes.emplace_back(size == 1 ? 0x88 : 0x89);
+        EmitModRM(frag, RegId(src.reg), dst, 0);
+        return true;
+    }
+    if(dst.kind == Kind::reg && src.kind == Kind::mem){
+        EmitPrefixes(frag, size, RegId(dst.reg), size == 1, &src);
+        frag.bytes.emplace_back(size == 1 ? 0x8A : 0x8B);
+        EmitModRM(frag, RegId(dst.reg), src, 0);
+        return true;
+    }
+    if(dst.kind == Kind::mem && src.kind == Kind::reg){
+        EmitPrefixes(frag, size, RegId(src.reg), size == 1, &dst);
+        frag.bytes.emplace_back(size == 1 ? 0x88 : 0x89);
+        EmitModRM(frag, RegId(src.reg), dst, 0);
+        return true;
+    }
+    if(dst.kind == Kind::reg && src.kind == Kind::imm){
+        uint8_t id = RegId(dst.reg);
+        int64_t value = src.value;
+
+        if(size == 8){
+            if(value >= 0 && value <= UINT32_MAX){
+                // writing the 32-bit register clears the upper half, same as nasm does
+                EmitPrefixes(frag, 4, 0, false, &dst);
+                frag.bytes.emplace_back(0xB8 + (id & 7));
+                EmitImm(frag, value, 4);
+            }
+            else if(FitsInt32(value)){
+                EmitPrefixes(frag, 8, 0, false, &dst);
+                frag.bytes.emplace_back(0xC7);
+                EmitModRM(frag, 0, dst, 4);
+                EmitImm(frag, value, 4);
+            }
+            else{
+                EmitPrefixes(frag, 8, 0, false, &dst);
+                frag.bytes.emplace_back(0xB8 + (id & 7));
+                EmitImm(frag, value, 8);
+            }
+            return true;
+        }
+
+        EmitPrefixes(frag, size, 0, false, &dst);
+        frag.bytes.emplace_back((size == 1 ? 0xB0 : 0xB8) + (id & 7));
+        EmitImm(frag, value, size);
+        return true;
+    }
+    if(dst.kind == Kind::reg && src.kind == Kind::label){
+        if(size != 8 && size != 4)
+            return Fail(instr, "A symbol address needs a 32 or 64-bit register");
+
+        EmitPrefixes(frag, size, 0, false, &dst);
+        frag.bytes.emplace_back(0xB8 + (RegId(dst.reg) & 7));
+        frag.fixups.emplace_back(Fixup{static_cast<uint32_t>(frag.bytes.size()),
+                                       size == 8 ? ObjectCode::RelocType::abs64 : ObjectCode::RelocType::abs32,
+                                       src.name, 0});
+        EmitImm(frag, 0, size);
+        return true;
+    }
+    if(dst.kind == Kind::mem && (src.kind == Kind::imm || src.kind == Kind::label)){
+        if(!size)
+            return Fail(instr, "Operation size not specified");
+
+        uint8_t imm_size = size == 8 ? 4 : size;
+        EmitPrefixes(frag, size, 0, false, &dst);
+        frag.bytes.emplace_back(size == 1 ? 0xC6 : 0xC7);
+        EmitModRM(frag, 0, dst, imm_size);
+
+        if(src.kind == Kind::label){
+            if(imm_size != 4)
+                return Fail(instr, "A symbol address needs a 32 or 64-bit operand");
+            frag.fixups.emplace_back(Fixup{static_cast<uint32_t>(frag.bytes.size()),
+                                           size == 8 ? ObjectCode::RelocType::abs32s : ObjectCode::RelocType::abs32,
+                                           src.name, 0});
+            EmitImm(frag, 0, 4);
+            return true;
+        }
+
+        if(size == 8 && !FitsInt32(src.value))
+            return Fail(instr, "Immediate does not fit in a signed 32-bit value");
+        EmitImm(frag, src.value, imm_size);
+        return true;
+    }
+
+    return Fail(instr, "Invalid combination of operands");
+}
+
+bool Encoder::EncodeAlu(const Asm::Instr& instr, Fragment& frag, uint8_t ext) {
+    using Kind = Asm::Operand::Kind;
+    const Asm::Operand& dst = instr.dst;
+    const Asm::Operand& src = instr.src;
+    uint8_t size = OperandSize(instr);
+    uint8_t base = ext * 8;
+
+    if(!size)
+        return Fail(instr, "Operation size not specified");
+
+    if((dst.kind == Kind::reg || dst.kind == Kind::mem) && src.kind == Kind::reg){
+        if(dst.kind == Kind::reg && dst.size != src.size)
+            return Fail(instr, "Mismatched register sizes");
+        EmitPrefixes(frag, size, RegId(src.reg), size == 1, &dst);
+        frag.bytes.emplace_back(base + (size == 1 ? 0 : 1));
+        EmitModRM(frag, RegId(src.reg), dst, 0);
+        return true;
+    }
+    if(dst.kind == Kind::reg && src.kind == Kind::mem){
+        EmitPrefixes(frag, size, RegId(dst.reg), size == 1, &src);
+        frag.bytes.emplace_back(base + (size == 1 ? 2 : 3));
+        EmitModRM(frag, RegId(dst.reg), src, 0);
+        return true;
+    }
+    if((dst.kind == Kind::reg || dst.kind == Kind::mem) && src.kind == Kind::imm){
+        int64_t value = src.value;
+
+        if(size == 1){
+            EmitPrefixes(frag, size, 0, false, &dst);
+            frag.bytes.emplace_back(0x80);
+            EmitModRM(frag, ext, dst, 1);
+            EmitImm(frag, value, 1);
+            return true;
+        }
+        if(FitsInt8(value)){
+            EmitPrefixes(frag, size, 0, false, &dst);
+            frag.bytes.emplace_back(0x83);
+            EmitModRM(frag, ext, dst, 1);
+            EmitImm(frag, value, 1);
+            return true;
+        }
+        if(size == 8 && !FitsInt32(value))
+            return Fail(instr, "Immediate does not fit in a signed 32-bit value");
+
+        uint8_t imm_size = size == 2 ? 2 : 4;
+        if(dst.kind == Kind::reg && dst.reg == Asm::Reg::rax){
+            // the accumulator has a form without a modrm byte
+            EmitPrefixes(frag, size, 0, false, nullptr);
+            frag.bytes.emplace_back(base + 5);
+        }
+        else{
+            EmitPrefixes(frag, size, 0, false, &dst);
+            frag.bytes.emplace_back(0x81);
+            EmitModRM(frag, ext, dst, imm_size);
+        }
+        EmitImm(frag, value, imm_size);
+        return true;
+    }
+
+    return Fail(instr, "Invalid combination of operands");
+}
+
+bool Encoder::EncodeUnary(const Asm::Instr& instr, Fragment& frag, uint8_t ext) {
+    const Asm::Operand& dst = instr.dst;
+    if(dst.kind != Asm::Operand::Kind::reg && dst.kind != Asm::Operand::Kind::mem)
+        return Fail(instr, "Invalid operand");
+    if(!dst.size)
+        return Fail(instr, "Operation size not specified");
+
+    EmitPrefixes(frag, dst.size, 0, false, &dst);
+    frag.bytes.emplace_back(dst.size == 1 ? 0xF6 : 0xF7);
+    EmitModRM(frag, ext, dst, 0);
+    return true;
+}
+
+bool Encoder::EncodeShift(const Asm::Instr& instr, Fragment& frag, uint8_t ext) {
+    using Kind = Asm::Operand::Kind;
+    const Asm::Operand& dst = instr.dst;
+    const Asm::Operand& src = instr.src;
+    if(dst.kind != Kind::reg && dst.kind != Kind::mem)
+        return Fail(instr, "Invalid operand");
+    if(!dst.size)
+        return Fail(instr, "Operation size not specified");
+
+    bool byte = dst.size == 1;
+    if(src.kind == Kind::reg){
+        if(src.reg != Asm::Reg::rcx || src.size != 1)
+            return Fail(instr, "The shift count has to be an immediate or `cl`");
+        EmitPrefixes(frag, dst.size, 0, false, &dst);
+        frag.bytes.emplace_back(byte ? 0xD2 : 0xD3);
+        EmitModRM(frag, ext, dst, 0);
+        return true;
+    }
+    if(src.kind != Kind::imm || src.value < 0 || src.value > 255)
+        return Fail(instr, "The shift count has to be an immediate or `cl`");
+
+    EmitPrefixes(frag, dst.size, 0, false, &dst);
+    if(src.value == 1){
+        frag.bytes.emplace_back(byte ? 0xD0 : 0xD1);
+        EmitModRM(frag, ext, dst, 0);
+        return true;
+    }
+    frag.bytes.emplace_back(byte ? 0xC0 : 0xC1);
+    EmitModRM(frag, ext, dst, 1);
+    EmitImm(frag, src.value, 1);
+    return true;
+}
+
+bool Encoder::EncodeBitCount(const Asm::Instr& instr, Fragment& frag, uint8_t prefix, uint8_t opcode) {
+    using Kind = Asm::Operand::Kind;
+    const Asm::Operand& dst = instr.dst;
+    const Asm::Operand& src = instr.src;
+    if(dst.kind != Kind::reg || dst.size == 1 || (src.kind != Kind::reg && src.kind != Kind::mem))
+        return Fail(instr, "Invalid combination of operands");
+    if(src.kind == Kind::reg && src.size != dst.size)
+        return Fail(instr, "Mismatched register sizes");
+
+    // the mandatory prefix goes between the operand size prefix and REX, like the assemblers put it
+    if(dst.size == 2)
+        frag.bytes.emplace_back(0x66);
+    if(prefix)
+        frag.bytes.emplace_back(prefix);
+    EmitPrefixes(frag, dst.size == 2 ? 4 : dst.size, RegId(dst.reg), false, &src);
+    frag.bytes.emplace_back(0x0F);
+    frag.bytes.emplace_back(opcode);
+    EmitModRM(frag, RegId(dst.reg), src, 0);
+    return true;
+}
+
+bool Encoder::EncodeVex(const Asm::Instr& instr, Fragment& frag, uint8_t pp, uint8_t opcode,
+                        const Asm::Operand& reg, const Asm::Operand& vvvv, const Asm::Operand& rm) {
+    using Kind = Asm::Operand::Kind;
+    if(reg.kind != Kind::reg || vvvv.kind != Kind::reg || (rm.kind != Kind::reg && rm.kind != Kind::mem))
+        return Fail(instr, "Invalid combination of operands");
+    if((reg.size != 4 && reg.size != 8) || vvvv.size != reg.size || (rm.kind == Kind::reg && rm.size != reg.size))
+        return Fail(instr, "Only 32 and 64-bit registers can be used");
+
+    // the three byte VEX prefix holds the inverted REX bits, the 0F38 opcode map, W and the inverted vvvv register
+    uint8_t r = RegId(reg.reg) >= 8, x = 0, b = 0;
+    if(rm.kind == Kind::reg)
+        b = RegId(rm.reg) >= 8;
+    else{
+        x = rm.scale && RegId(rm.index) >= 8;
+        b = rm.base && !rm.rip && RegId(rm.reg) >= 8;
+    }
+    frag.bytes.emplace_back(0xC4);
+    frag.bytes.emplace_back(static_cast<uint8_t>((!r << 7) | (!x << 6) | (!b << 5) | 0x02));
+    frag.bytes.emplace_back(static_cast<uint8_t>((reg.size == 8 ? 0x80 : 0) | ((~RegId(vvvv.reg) & 15) << 3) | pp));
+    frag.bytes.emplace_back(opcode);
+    EmitModRM(frag, RegId(reg.reg), rm, 0);
+    return true;
+}
+
+bool Encoder::EncodePacked(const Asm::Instr& instr, Fragment& frag, uint8_t prefix, bool map38, uint8_t opcode, uint8_t store) {
+    using Kind = Asm::Operand::Kind;
+    bool vex = Asm::IsVex(instr);
+    bool to_memory = instr.dst.kind == Kind::mem;
+    if(to_memory && (!store || instr.src2.kind != Kind::none))
+        return Fail(instr, "Invalid combination of operands");
+
+    // the three operand form takes the first source in vvvv, the others have no vvvv operand
+    const Asm::Operand& reg = to_memory ? instr.src : instr.dst;
+    const Asm::Operand* vvvv = vex && instr.src2.kind != Kind::none ? &instr.src : nullptr;
+    const Asm::Operand& rm = to_memory ? instr.dst : vvvv ? instr.src2 : instr.src;
+    if(reg.kind != Kind::reg || (rm.kind != Kind::reg && rm.kind != Kind::mem) || (vvvv && vvvv->kind != Kind::reg))
+        return Fail(instr, "Invalid combination of operands");
+    if((reg.size != 16 && reg.size != 32) || (rm.kind == Kind::reg && rm.size != reg.size) || (vvvv && vvvv->size != reg.size))
+        return Fail(instr, "Only xmm and ymm registers can be used");
+    uint8_t code = to_memory ? store : opcode;
+
+    if(!vex){
+        // the mandatory prefix goes before REX
+        frag.bytes.emplace_back(prefix);
+        EmitPrefixes(frag, 4, RegId(reg.reg), false, &rm);
+        frag.bytes.emplace_back(0x0F);
+        if(map38)
+            frag.bytes.emplace_back(0x38);
+        frag.bytes.emplace_back(code);
+        EmitModRM(frag, RegId(reg.reg), rm, 0);
+        return true;
+    }
+
+    // the three byte VEX prefix, the inverted REX bits and the map, then the inverted vvvv, L for ymm and the prefix
+    uint8_t r = RegId(reg.reg) >= 8, x = 0, b = 0;
+    if(rm.kind == Kind::reg)
+        b = RegId(rm.reg) >= 8;
+    else{
+        x = rm.scale && RegId(rm.index) >= 8;
+        b = rm.base && !rm.rip && RegId(rm.reg) >= 8;
+    }
+    uint8_t pp = prefix == 0x66 ? 1 : prefix == 0xF3 ? 2 : 0;
+    uint8_t v = vvvv ? RegId(vvvv->reg) : 0;
+    frag.bytes.emplace_back(0xC4);
+    frag.bytes.emplace_back(static_cast<uint8_t>((!r << 7) | (!x << 6) | (!b << 5) | (map38 ? 0x02 : 0x01)));
+    frag.bytes.emplace_back(static_cast<uint8_t>(((~v & 15) << 3) | (reg.size == 32 ? 0x04 : 0) | pp));
+    frag.bytes.emplace_back(code);
+    EmitModRM(frag, RegId(reg.reg), rm, 0);
+    return true;
+}
+
+bool Encoder::EncodeInstr(const Asm::Instr& instr, Fragment& frag) {
+    using Kind = Asm::Operand::Kind;
+    const Asm::Operand& dst = instr.dst;
+    const Asm::Operand& src = instr.src;
+
+    switch(instr.op){
+        case Asm::Op::mov:
+            return EncodeMov(instr, frag);
+
+        case Asm::Op::add: return EncodeAlu(instr, frag, 0);
+        case Asm::Op::_or: return EncodeAlu(instr, frag, 1);
+        case Asm::Op::_and: return EncodeAlu(instr, frag, 4);
+        case Asm::Op::sub: return EncodeAlu(instr, frag, 5);
+        case Asm::Op::_xor: return EncodeAlu(instr, frag, 6);
+        case Asm::Op::cmp: return EncodeAlu(instr, frag, 7);
+
+        case Asm::Op::_not: return EncodeUnary(instr, frag, 2);
+        case Asm::Op::neg: return EncodeUnary(instr, frag, 3);
+        case Asm::Op::mul: return EncodeUnary(instr, frag, 4);
+        case Asm::Op::div: return EncodeUnary(instr, frag, 6);
+        case Asm::Op::idiv: return EncodeUnary(instr, frag, 7);
+
+        case Asm::Op::shl: return EncodeShift(instr, frag, 4);
+        case Asm::Op::shr: return EncodeShift(instr, frag, 5);
+        case Asm::Op::sar: return EncodeShift(instr, frag, 7);
+
+        case Asm::Op::bsf: return EncodeBitCount(instr, frag, 0, 0xBC);
+        case Asm::Op::bsr: return EncodeBitCount(instr, frag, 0, 0xBD);
+        case Asm::Op::popcnt: return EncodeBitCount(instr, frag, 0xF3, 0xB8);
+        case Asm::Op::tzcnt: return EncodeBitCount(instr, frag, 0xF3, 0xBC);
+        case Asm::Op::lzcnt: return EncodeBitCount(instr, frag, 0xF3, 0xBD);
+
+        // andn and mulx take the first source in vvvv, the shifts take the count in it
+        case Asm::Op::andn: return EncodeVex(instr, frag, 0, 0xF2, dst, src, instr.src2);
+        case Asm::Op::mulx: return EncodeVex(instr, frag, 3, 0xF6, dst, src, instr.src2);
+        case Asm::Op::shlx: return EncodeVex(instr, frag, 1, 0xF7, dst, instr.src2, src);
+        case Asm::Op::sarx: return EncodeVex(instr, frag, 2, 0xF7, dst, instr.src2, src);
+        case Asm::Op::shrx: return EncodeVex(instr, frag, 3, 0xF7, dst, instr.src2, src);
+
+        case Asm::Op::movdqa: return EncodePacked(instr, frag, 0x66, false, 0x6F, 0x7F);
+        case Asm::Op::movdqu: return EncodePacked(instr, frag, 0xF3, false, 0x6F, 0x7F);
+        case Asm::Op::paddb: return EncodePacked(instr, frag, 0x66, false, 0xFC);
+        case Asm::Op::paddw: return EncodePacked(instr, frag, 0x66, false, 0xFD);
+        case Asm::Op::paddd: return EncodePacked(instr, frag, 0x66, false, 0xFE);
+        case Asm::Op::paddq: return EncodePacked(instr, frag, 0x66, false, 0xD4);
+        case Asm::Op::psubb: return EncodePacked(instr, frag, 0x66, false, 0xF8);
+        case Asm::Op::psubw: return EncodePacked(instr, frag, 0x66, false, 0xF9);
+        case Asm::Op::psubd: return EncodePacked(instr, frag, 0x66, false, 0xFA);
+        case Asm::Op::psubq: return EncodePacked(instr, frag, 0x66, false, 0xFB);
+        case Asm::Op::pand: return EncodePacked(instr, frag, 0x66, false, 0xDB);
+        case Asm::Op::por: return EncodePacked(instr, frag, 0x66, false, 0xEB);
+        case Asm::Op::pxor: return EncodePacked(instr, frag, 0x66, false, 0xEF);
+        case Asm::Op::pmullw: return EncodePacked(instr, frag, 0x66, false, 0xD5);
+        case Asm::Op::pmulld: return EncodePacked(instr, frag, 0x66, true, 0x40);
+        case Asm::Op::vzeroupper:
+            frag.bytes.insert(frag.bytes.end(), {0xC5, 0xF8, 0x77});
+            return true;
+
+        case Asm::Op::imul: {
+            if(src.kind == Kind::none)
+                return EncodeUnary(instr, frag, 5);
+            if(dst.kind != Kind::reg || dst.size == 1)
+                return Fail(instr, "Invalid combination of operands");
+
+            if(instr.src2.kind == Kind::imm){
+                // imul r, r/m, imm, rdx and the other registers are left alone
+                if(src.kind != Kind::reg && src.kind != Kind::mem)
+                    return Fail(instr, "Invalid combination of operands");
+                if(!FitsInt32(instr.src2.value))
+                    return Fail(instr, "Immediate does not fit in a signed 32-bit value");
+                bool small = FitsInt8(instr.src2.value);
+                uint8_t imm_size = small ? 1 : (dst.size == 2 ? 2 : 4);
+                EmitPrefixes(frag, dst.size, RegId(dst.reg), false, &src);
+                frag.bytes.emplace_back(small ? 0x6B : 0x69);
+                EmitModRM(frag, RegId(dst.reg), src, imm_size);
+                EmitImm(frag, instr.src2.value, imm_size);
+                return true;
+            }
+            if(src.kind == Kind::imm){
+                // imul r, r, imm with the destination as the source
+                if(!FitsInt32(src.value))
+                    return Fail(instr, "Immediate does not fit in a signed 32-bit value");
+                bool small = FitsInt8(src.value);
+                EmitPrefixes(frag, dst.size, RegId(dst.reg), false, &dst);
+                frag.bytes.emplace_back(small ? 0x6B : 0x69);
+                EmitModRM(frag, RegId(dst.reg), dst, small ? 1 : (dst.size == 2 ? 2 : 4));
+                EmitImm(frag, src.value, small ? 1 : (dst.size == 2 ? 2 : 4));
+                return true;
+            }
+
+            EmitPrefixes(frag, dst.size, RegId(dst.reg), false, &src);
+            frag.bytes.emplace_back(0x0F);
+            frag.bytes.emplace_back(0xAF);
+            EmitModRM(frag, RegId(dst.reg), src, 0);
+            return true;
+        }
+
+        case Asm::Op::test: {
+            uint8_t size = OperandSize(instr);
+            if(src.kind == Kind::reg){
+                EmitPrefixes(frag, size, RegId(src.reg), size == 1, &dst);
+                frag.bytes.emplace_back(size == 1 ? 0x84 : 0x85);
+                EmitModRM(frag, RegId(src.reg), dst, 0);
+                return true;
+            }
+            if(src.kind == Kind::imm && size){
+                uint8_t imm_size = size == 1 ? 1 : size == 2 ? 2 : 4;
+                EmitPrefixes(frag, size, 0, false, &dst);
+                frag.bytes.emplace_back(size == 1 ? 0xF6 : 0xF7);
+                EmitModRM(frag, 0, dst, imm_size);
+                EmitImm(frag, src.value, imm_size);
+                return true;
+            }
+            return Fail(instr, "Invalid combination of operands");
+        }
+
+        case Asm::Op::lea:
+            if(dst.kind != Kind::reg || src.kind != Kind::mem || dst.size == 1)
+                return Fail(instr, "Invalid combination of operands");
+            EmitPrefixes(frag, dst.size, RegId(dst.reg), false, &src);
+            frag.bytes.emplace_back(0x8D);
+            EmitModRM(frag, RegId(dst.reg), src, 0);
+            return true;
+
+        case Asm::Op::movzx:
+        case Asm::Op::movsx: {
+            if(dst.kind != Kind::reg || (src.kind != Kind::reg && src.kind != Kind::mem) || src.size >= dst.size)
+                return Fail(instr, "Invalid combination of operands");
+
+            EmitPrefixes(frag, dst.size, RegId(dst.reg), false, &src);
+            if(src.size == 4){
+                if(instr.op == Asm::Op::movzx)
+                    return Fail(instr, "Invalid combination of operands"); // a 32-bit mov already zero extends
+                frag.bytes.emplace_back(0x63);
+            }
+            else{
+                frag.bytes.emplace_back(0x0F);
+                uint8_t opcode = instr.op == Asm::Op::movzx ? 0xB6 : 0xBE;
+                frag.bytes.emplace_back(opcode + (src.size == 2 ? 1 : 0));
+            }
+            EmitModRM(frag, RegId(dst.reg), src, 0);
+            return true;
+        }
+
+        case Asm::Op::push:
+        case Asm::Op::pop: {
+            bool push = instr.op == Asm::Op::push;
+            if(dst.kind == Kind::reg){
+                if(dst.size != 8)
+                    return Fail(instr, "Only 64-bit registers can be pushed or popped");
+                if(RegId(dst.reg) >= 8)
+                    frag.bytes.emplace_back(0x41);
+                frag.bytes.emplace_back((push ? 0x50 : 0x58) + (RegId(dst.reg) & 7));
+                return true;
+            }
+            if(dst.kind == Kind::imm && push){
+                if(FitsInt8(dst.value)){
+                    frag.bytes.emplace_back(0x6A);
+                    EmitImm(frag, dst.value, 1);
+                }
+                else if(FitsInt32(dst.value)){
+                    frag.bytes.emplace_back(0x68);
+                    EmitImm(frag, dst.value, 4);
+                }
+                else
+                    return Fail(instr, "Immediate does not fit in a signed 32-bit value");
+                return true;
+            }
+            if(dst.kind == Kind::mem){
+                EmitPrefixes(frag, 8, 0, false, &dst, true);
+                frag.bytes.emplace_back(push ? 0xFF : 0x8F);
+                EmitModRM(frag, push ? 6 : 0, dst, 0);
+                return true;
+            }
+            return Fail(instr, "Invalid operand");
+        }
+
+        case Asm::Op::call:
+            if(dst.kind == Kind::label){
+                frag.bytes.emplace_back(0xE8);
+                frag.fixups.emplace_back(Fixup{1, ObjectCode::RelocType::plt32, dst.name, -4});
+                EmitImm(frag, 0, 4);
+                return true;
+            }
+            if(dst.kind == Kind::reg || dst.kind == Kind::mem){
+                EmitPrefixes(frag, 8, 0, false, &dst, true);
+                frag.bytes.emplace_back(0xFF);
+                EmitModRM(frag, 2, dst, 0);
+                return true;
+            }
+            return Fail(instr, "Invalid operand");
+
+        case Asm::Op::ret:
+            frag.bytes.emplace_back(0xC3);
+            return true;
+        case Asm::Op::syscall:
+            frag.bytes.emplace_back(0x0F);
+            frag.bytes.emplace_back(0x05);
+            return true;
+        case Asm::Op::cqo:
+            frag.bytes.emplace_back(0x48);
+            frag.bytes.emplace_back(0x99);
+            return true;
+        case Asm::Op::cdq:
+            frag.bytes.emplace_back(0x99);
+            return true;
+        case Asm::Op::nop:
+            frag.bytes.emplace_back(0x90);
+            return true;
+        case Asm::Op::ud2:
+            frag.bytes.emplace_back(0x0F);
+            frag.bytes.emplace_back(0x0B);
+            return true;
+
+        case Asm::Op::jmp:
+        case Asm::Op::je:
+        case Asm::Op::jne:
+        case Asm::Op::jg:
+        case Asm::Op::jge:
+        case Asm::Op::jl:
+        case Asm::Op::jle:
+        case Asm::Op::ja:
+        case Asm::Op::jae:
+        case Asm::Op::jb:
+        case Asm::Op::jbe:
+            if(dst.kind == Kind::label || dst.kind == Kind::local){
+                // the size is picked during the layout
+                frag.jump = instr.op;
+                if(dst.kind == Kind::local)
+                    frag.local_target = static_cast<uint32_t>(dst.value);
+                else
+                    frag.target = dst.name;
+                return true;
+            }
+            if(instr.op == Asm::Op::jmp && (dst.kind == Kind::reg || dst.kind == Kind::mem)){
+                EmitPrefixes(frag, 8, 0, false, &dst, true);
+                frag.bytes.emplace_back(0xFF);
+                EmitModRM(frag, 4, dst, 0);
+                return true;
+            }
+            return Fail(instr, "Invalid operand");
+
+        case Asm::Op::label:
+            if(dst.kind == Kind::local)
+                frag.local = static_cast<uint32_t>(dst.value);
+            else
+                frag.label = dst.name;
+            return true;
+
+        case Asm::Op::section:
+        case Asm::Op::raw:
+            return Fail(instr, "Unexpected raw assembly");
+    }
+
+    return Fail(instr, "Unknown instruction");
+}
+
+const Encoder::Fragment* Encoder::FindTarget(const Fragment& frag) {
+    if(frag.local_target != NO_LOCAL)
+        return &fragments.at(local_labels.at(Label::GetIndex(frag.local_target)));
+
+    auto label = text_labels.find(frag.target);
+    return label != text_labels.end() ? &fragments.at(label->second) : nullptr;
+}
+
+void Encoder::Layout() {
+    // jumps start short and only grow, so this always settles. A jump out of its section is relocated, the
+    // linker decides how far apart the text sections are
+    for(Fragment& frag : fragments){
+        const Fragment* target = frag.jump != Asm::Op::nop ? FindTarget(frag) : nullptr;
+        if(frag.jump != Asm::Op::nop && (!target || target->text != frag.text))
+            frag.near = true;
+    }
+
+    auto jump_size = [](const Fragment& frag) -> uint64_t {
+        if(!frag.near)
+            return 2;
+        return frag.jump == Asm::Op::jmp ? 5 : 6;
+    };
+
+    bool changed = true;
+    while(changed){
+        std::vector<uint64_t> sizes(texts.size(), 0);
+        for(Fragment& frag : fragments){
+            frag.offset = sizes.at(frag.text);
+            sizes.at(frag.text) += frag.jump != Asm::Op::nop ? jump_size(frag) : frag.bytes.size();
+        }
+
+        changed = false;
+        for(Fragment& frag : fragments){
+            if(frag.jump == Asm::Op::nop || frag.near)
+                continue;
+
+            int64_t target = static_cast<int64_t>(FindTarget(frag)->offset);
+            if(!FitsInt8(target - static_cast<int64_t>(frag.offset + 2))){
+                frag.near = true;
+                changed = true;
+            }
+        }
+    }
+
+    for(Fragment& frag : fragments){
+        if(frag.jump == Asm::Op::nop)
+            continue;
+
+        const Fragment* target_frag = FindTarget(frag);
+        bool local = target_frag != nullptr && target_frag->text == frag.text;
+        int64_t target = local ? static_cast<int64_t>(target_frag->offset) : 0;
+        int64_t next = static_cast<int64_t>(frag.offset + jump_size(frag));
+
+        if(!frag.near){
+            frag.bytes.emplace_back(frag.jump == Asm::Op::jmp ? 0xEB : 0x70 + ConditionCode(frag.jump));
+            EmitImm(frag, target - next, 1);
+            continue;
+        }
+
+        if(frag.jump == Asm::Op::jmp)
+            frag.bytes.emplace_back(0xE9);
+        else{
+            frag.bytes.emplace_back(0x0F);
+            frag.bytes.emplace_back(0x80 + ConditionCode(frag.jump));
+        }
+
+        if(local)
+            EmitImm(frag, target - next, 4);
+        else if(target_frag){
+            frag.fixups.emplace_back(Fixup{static_cast<uint32_t>(frag.bytes.size()), ObjectCode::RelocType::pc32,
+                                           texts.at(target_frag->text),
+                                           static_cast<int64_t>(target_frag->offset) - 4});
+            EmitImm(frag, 0, 4);
+        }
+        else{
+            frag.fixups.emplace_back(Fixup{static_cast<uint32_t>(frag.bytes.size()), ObjectCode::RelocType::pc32,
+                                           frag.target, -4});
+            EmitImm(frag, 0, 4);
+        }
+    }
+}
+
+bool Encoder::EncodeData(const std::vector<std::string>& lines, bool bss, std::vector<std::string>& globals, ObjectCode& out) {
+    for(const std::string& line : lines){
+        AsmParser::DataLine data;
+        if(!parser.ParseData(line, data, globals)){
+            error = parser.GetError();
+            return false;
+        }
+
+        uint64_t offset = bss ? out.bss_size : out.data.size();
+        while(offset % data.align)
+            offset++;
+
+        if(!data.label.empty())
+            out.symbols.emplace_back(ObjectCode::Symbol{data.label, bss ? ObjectCode::Section::bss : ObjectCode::Section::data,
+                                                        offset, false});
+
+        if(bss){
+            if(!data.bytes.empty()){
+                error = "Initialized data in the bss section `" + line + "`";
+                return false;
+            }
+            out.bss_size = offset + data.reserve;
+            continue;
+        }
+
+        out.data.resize(offset, 0);
+        for(const AsmParser::SymbolRef& ref : data.refs)
+            out.data_relocs.emplace_back(ObjectCode::Relocation{offset + ref.offset,
+                                         ref.size == 8 ? ObjectCode::RelocType::abs64 : ObjectCode::RelocType::abs32,
+                                         ref.symbol, 0});
+        out.data.insert(out.data.end(), data.bytes.begin(), data.bytes.end());
+        out.data.resize(out.data.size() + data.reserve, 0);
+    }
+
+    return true;
+}
+
+bool Encoder::Encode(const Asm::Module& module, ObjectCode& out) {
+    Profiler::Scope scope("encode");
+    std::vector<std::string> globals = module.globals;
+
+    if(!EncodeData(module.data, false, globals, out) || !EncodeData(module.bss, true, globals, out))
+        return false;
+
+    // the fragment every line of the source starts at, where it is in the text is only known after the layout
+    std::vector<std::pair<size_t, const Asm::SourceLine*>> line_starts;
+    size_t next_line = 0;
+    texts = {ObjectCode::text_section};
+    uint32_t text = 0;
+    auto encode = [&](const Asm::Instr& instr){
+        if(instr.op == Asm::Op::section){
+            auto it = std::find(texts.begin(), texts.end(), instr.dst.name);
+            text = static_cast<uint32_t>(it - texts.begin());
+            if(it == texts.end())
+                texts.emplace_back(instr.dst.name);
+            return true;
+        }
+        fragments.emplace_back();
+        fragments.back().text = text;
+        return EncodeInstr(instr, fragments.back());
+    };
+    for(size_t i = 0; i < module.text.size(); i++){
+        const Asm::Instr& instr = module.text.at(i);
+        for(; next_line < module.lines.size() && module.lines.at(next_line).instr <= i; next_line++)
+            line_starts.emplace_back(fragments.size(), &module.lines.at(next_line));
+
+        if(instr.op == Asm::Op::raw){
+            std::vector<Asm::Instr> parsed;
+            if(!parser.ParseText(instr.text, parsed, globals)){
+                error = parser.GetError();
+                return false;
+            }
+            for(const Asm::Instr& line : parsed){
+                if(!encode(line))
+                    return false;
+            }
+            continue;
+        }
+        if(!encode(instr))
+            return false;
+    }
+
+    // numbered labels are found by their index, only the named ones need a lookup by name
+    local_labels.assign(module.locals, SIZE_MAX);
+    for(size_t i = 0; i < fragments.size(); i++){
+        const Fragment& frag = fragments.at(i);
+        if(frag.local != NO_LOCAL){
+            uint32_t index = Label::GetIndex(frag.local);
+            if(index >= local_labels.size())
+                local_labels.resize(index + 1, SIZE_MAX);
+            if(local_labels.at(index) != SIZE_MAX){
+                error = "Label `" + Label::GetName(frag.local) + "` was defined more than once";
+                return false;
+            }
+            local_labels.at(index) = i;
+        }
+        if(frag.label.empty())
+            continue;
+        if(!text_labels.emplace(frag.label, i).second){
+            error = "Label `" + frag.label + "` was defined more than once";
+            return false;
+        }
+    }
+    for(const Fragment& frag : fragments){
+        if(frag.local_target == NO_LOCAL)
+            continue;
+        uint32_t index = Label::GetIndex(frag.local_target);
+        if(index >= local_labels.size() || local_labels.at(index) == SIZE_MAX){
+            error = "Label `" + Label::GetName(frag.local_target) + "` is never defined";
+            return false;
+        }
+    }
+
+    Layout();
+
+    for(const std::string& name : texts)
+        out.texts.emplace_back(ObjectCode::Text{name});
+    for(const Fragment& frag : fragments){
+        std::vector<uint8_t>& bytes = out.texts.at(frag.text).bytes;
+        size_t start = bytes.size();
+        bytes.insert(bytes.end(), frag.bytes.begin(), frag.bytes.end());
+
+        for(const Fixup& fixup : frag.fixups){
+            uint64_t place = frag.offset + fixup.offset;
+            auto label = text_labels.find(fixup.symbol);
+            bool relative = fixup.type == ObjectCode::RelocType::pc32 || fixup.type == ObjectCode::RelocType::plt32;
+            std::vector<ObjectCode::Relocation>& relocs = out.texts.at(frag.text).relocs;
+
+            if(relative && label != text_labels.end()){
+                const Fragment& target = fragments.at(label->second);
+                if(target.text != frag.text){
+                    relocs.emplace_back(ObjectCode::Relocation{place, ObjectCode::RelocType::pc32, texts.at(target.text),
+                                                               static_cast<int64_t>(target.offset) + fixup.addend});
+                    continue;
+                }
+                int64_t value = static_cast<int64_t>(target.offset) + fixup.addend - static_cast<int64_t>(place);
+                for(uint8_t i = 0; i < 4; i++)
+                    bytes.at(start + fixup.offset + i) = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8));
+            }
+            else
+                relocs.emplace_back(ObjectCode::Relocation{place, fixup.type, fixup.symbol, fixup.addend});
+        }
+    }
+
+    out.files = module.files;
+    for(const auto& [fragment, line] : line_starts){
+        // a line after the last instruction is at the end of the section the code ended in
+        uint32_t in = fragment < fragments.size() ? fragments.at(fragment).text : fragments.empty() ? 0 : fragments.back().text;
+        std::vector<ObjectCode::Line>& lines = out.texts.at(in).lines;
+        uint64_t offset = fragment < fragments.size() ? fragments.at(fragment).offset : out.texts.at(in).bytes.size();
+        if(!lines.empty() && lines.back().offset == offset)
+            lines.pop_back(); // a line without any code
+        lines.emplace_back(ObjectCode::Line{offset, line->file, line->line});
+    }
+
+    for(const auto& [name, index] : text_labels){
+        const Fragment& frag = fragments.at(index);
+        out.symbols.emplace_back(ObjectCode::Symbol{name, ObjectCode::Section::text, frag.offset, false, frag.text});
+    }
+
+    // keeps the symbol table in the order the labels were written
+    std::sort(out.symbols.begin(), out.symbols.end(), [](const ObjectCode::Symbol& a, const ObjectCode::Symbol& b){
+        if(a.section != b.section)
+            return a.section < b.section;
+        if(a.text != b.text)
+            return a.text < b.text;
+        return a.value < b.value;
+    });
+
+    std::unordered_map<std::string, bool> defined;
+    for(const std::string& name : texts)
+        defined[name] = true;
+    for(ObjectCode::Symbol& symbol : out.symbols){
+        symbol.global = std::find(globals.begin(), globals.end(), symbol.name) != globals.end();
+        defined[symbol.name] = true;
+    }
+
+    for(const std::string& name : module.externs){
+        if(defined.find(name) == defined.end()){
+            out.symbols.emplace_back(ObjectCode::Symbol{name, ObjectCode::Section::undefined, 0, true});
+            defined[name] = true;
+        }
+    }
+
+    std::vector<const std::vector<ObjectCode::Relocation>*> all_relocs = {&out.data_relocs};
+    for(const ObjectCode::Text& text_section : out.texts)
+        all_relocs.emplace_back(&text_section.relocs);
+    for(const auto& relocs : all_relocs){
+        for(const ObjectCode::Relocation& reloc : *relocs){
+            if(defined.find(reloc.symbol) == defined.end()){
+                error = "Symbol `" + reloc.symbol + "` is not defined, use #extern to declare it";
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
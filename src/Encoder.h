@@ -0,0 +1,119 @@
+#pragma once
+
+#include "PCH.h"
+#include "Core.h"
+#include "Instruction.h"
+#include "AsmParser.h"
+
+/// Machine code and the information needed to write an object file, independent of the object format
+struct ObjectCode{
+    enum class Section : uint8_t {
+        text, data, bss, undefined
+    };
+
+    enum class RelocType : uint8_t {
+        abs64, abs32, abs32s, pc32, plt32
+    };
+
+    struct Relocation{
+        uint64_t offset;
+        RelocType type;
+        std::string symbol;
+        int64_t addend;
+    };
+
+    struct Symbol{
+        std::string name;
+        Section section;
+        uint64_t value;
+        bool global;
+        uint32_t text = 0; // which of the text sections a symbol in Section::text is in
+    };
+
+    /// The code of `line` starts at `offset` in the text and goes up to the next line
+    struct Line{
+        uint64_t offset;
+        uint32_t file;
+        uint32_t line;
+    };
+
+    /// A section of code, code in one text section reaches another through a relocation against its name
+    struct Text{
+        std::string name;
+        std::vector<uint8_t> bytes;
+        std::vector<Relocation> relocs;
+        std::vector<Line> lines; // -g
+    };
+
+    static constexpr const char* text_section = ".text";
+
+    std::vector<Text> texts; // .text first, then the other sections in the order the code first used them
+    std::vector<uint8_t> data;
+    uint64_t bss_size = 0;
+    std::vector<Relocation> data_relocs;
+    std::vector<Symbol> symbols;
+    std::vector<std::string> files; // -g, the sources of the lines
+};
+
+/// Encodes the generator's instruction stream into x86-64 machine code
+class Encoder{
+public:
+    inline static bool SupportsTarget(const int target){ return target == PLATFORM_LINUX64; }
+
+    /// Returns false when something in the module can not be encoded, GetError tells what
+    bool Encode(const Asm::Module& module, ObjectCode& out);
+    inline const std::string& GetError(){ return error; }
+
+private:
+
+    struct Fixup{
+        uint32_t offset; // offset of the field in the fragment
+        ObjectCode::RelocType type;
+        std::string symbol;
+        int64_t addend;
+    };
+
+    static constexpr uint32_t NO_LOCAL = UINT32_MAX;
+
+    struct Fragment{
+        std::vector<uint8_t> bytes;
+        std::vector<Fixup> fixups;
+        std::string label;  // set when the fragment only defines a label
+        uint32_t local = NO_LOCAL; // or the numbered label it defines
+        Asm::Op jump = Asm::Op::nop;
+        std::string target; // the label of a jump that is relaxed during layout
+        uint32_t local_target = NO_LOCAL; // or its numbered label
+        bool near = false;
+        uint32_t text = 0; // the index of its text section, the offset is from the start of it
+        uint64_t offset = 0;
+    };
+
+    bool EncodeInstr(const Asm::Instr& instr, Fragment& frag);
+    bool EncodeData(const std::vector<std::string>& lines, bool bss, std::vector<std::string>& globals, ObjectCode& out);
+    void EmitPrefixes(Fragment& frag, uint8_t size, uint8_t reg, bool reg_byte, const Asm::Operand* rm, bool default64 = false);
+    void EmitModRM(Fragment& frag, uint8_t reg, const Asm::Operand& rm, uint8_t trailing);
+    void EmitImm(Fragment& frag, int64_t value, uint8_t size);
+    bool EncodeAlu(const Asm::Instr& instr, Fragment& frag, uint8_t ext);
+    bool EncodeUnary(const Asm::Instr& instr, Fragment& frag, uint8_t ext);
+    bool EncodeMov(const Asm::Instr& instr, Fragment& frag);
+    bool EncodeShift(const Asm::Instr& instr, Fragment& frag, uint8_t ext);
+    /// popcnt, lzcnt and tzcnt with the F3 `prefix`, bsf and bsr without one
+    bool EncodeBitCount(const Asm::Instr& instr, Fragment& frag, uint8_t prefix, uint8_t opcode);
+    /// The BMI instructions, `pp` is the implied prefix of the VEX prefix and `vvvv` the operand it encodes
+    bool EncodeVex(const Asm::Instr& instr, Fragment& frag, uint8_t pp, uint8_t opcode,
+                   const Asm::Operand& reg, const Asm::Operand& vvvv, const Asm::Operand& rm);
+    /// The SSE instructions with their mandatory 66 or F3 `prefix` and `opcode` in the 0F map, or 0F38 with `map38`,
+    /// and their AVX forms. A move to memory uses `store`, 0 for the others
+    bool EncodePacked(const Asm::Instr& instr, Fragment& frag, uint8_t prefix, bool map38, uint8_t opcode, uint8_t store = 0);
+    /// The fragment a jump goes to, nullptr when the label is not in the text like an extern function
+    const Fragment* FindTarget(const Fragment& frag);
+    void Layout();
+    bool Fail(const Asm::Instr& instr, const std::string& msg);
+
+    std::vector<Fragment> fragments;
+    std::unordered_map<std::string, size_t> text_labels; // label name to fragment index
+    std::vector<size_t> local_labels; // index of a numbered label to fragment index
+    std::vector<std::string> texts; // the names of the text sections
+    AsmParser parser;
+    std::string error;
+};
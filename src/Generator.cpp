@@ -1,10 +1,11 @@
 #include "Generator.h"
+#include "Profiler.h"
 
-void Generator::GenTerm(const Node::Term *term, const std::string reg) {
+void Generator::GenTerm(const Node::Term *term, const Asm::Operand& reg) {
     if(std::holds_alternative<Node::LitInt*>(term->term)){
-        std::string value = std::get<Node::LitInt*>(term->term)->value;
+        int64_t value = std::get<Node::LitInt*>(term->term)->GetValue();
 
-        code.text << "mov " << reg << ", " << value << '\n';
+        Emit(Asm::Op::mov, reg, Asm::Imm(value));
     }
     else if(std::holds_alternative<Node::Ident*>(term->term)){
         auto ident = std::get<Node::Ident*>(term->term);
@@ -14,12 +15,518 @@ void Generator::GenTerm(const Node::Term *term, const std::string reg) {
             exit(1);
         }
 
-        code.text << "mov " << reg << ", [" << bit << "sp + " << storage.GetStackPosition(ident->value) << "]\n";
+        GenLoad(ident->value, reg);
+    }
+    else if(std::holds_alternative<Node::TermIndex*>(term->term)){
+        auto element = std::get<Node::TermIndex*>(term->term);
+        GenLoad(GenElement(element->ident, element->index, reg), storage.GetType(element->ident->value), reg);
     }
     else if(std::holds_alternative<Node::TermParen*>(term->term)){
         auto paren = std::get<Node::TermParen*>(term->term);
         GenExpr(paren->expr, reg);
     }
+    else if(std::holds_alternative<Node::TermNot*>(term->term)){
+        GenTerm(std::get<Node::TermNot*>(term->term)->term, reg);
+        Emit(Asm::Op::_not, reg);
+    }
+    else if(std::holds_alternative<Node::TermBuiltin*>(term->term)){
+        GenBuiltin(std::get<Node::TermBuiltin*>(term->term));
+        if(reg.reg != Asm::Reg::rax)
+            Emit(Asm::Op::mov, reg, Asm::R(Asm::Reg::rax, reg.size));
+    }
+}
+
+void Generator::GenLoad(const std::string& ident, const Asm::Operand& reg) {
+    GenLoad(Stack(storage.GetStackPosition(ident)), storage.GetType(ident), reg);
+}
+
+void Generator::GenLoad(Asm::Operand mem, VarType type, const Asm::Operand& reg) {
+    uint8_t width = GetWidth(type);
+    if(width >= reg.size)
+        Emit(Asm::Op::mov, reg, mem);
+    else if(!IsUnsigned(type)){
+        mem.size = width;
+        Emit(Asm::Op::movsx, reg, mem);
+    }
+    else if(width == 4)
+        Emit(Asm::Op::mov, Asm::R(reg.reg, 4), mem); // writing the dword clears the rest of the register
+    else{
+        mem.size = width;
+        Emit(Asm::Op::movzx, reg, mem);
+    }
+}
+
+Asm::Operand Generator::GenElement(const Node::Ident* ident, const Node::IntExpr* index, const Asm::Operand& reg) {
+    uint64_t length = storage.GetLength(ident->value);
+    uint8_t width = GetWidth(storage.GetType(ident->value));
+
+    // a literal index is checked here and is a part of the displacement
+    int64_t literal;
+    bool is_literal = Node::GetLiteral(index, literal);
+    if(is_literal && (literal < 0 || static_cast<uint64_t>(literal) >= length)){
+        Log::Error("Index " + std::to_string(literal) + " is out of bounds of `" + ident->value + "`, it has " +
+                   std::to_string(length) + " elements");
+        exit(1);
+    }
+    if(!is_literal){
+        GenExpr(index, reg);
+        if(bounds_checks && safe_indexes.find(index) == safe_indexes.end()){
+            // a negative index is a huge unsigned one, one comparison checks both ends
+            if(bounds_label == NO_LABEL)
+                bounds_label = labels.NewLabel(Label::LabelTypes::_main);
+            Emit(Asm::Op::cmp, reg, Asm::Imm(static_cast<int64_t>(length)));
+            Emit(Asm::Op::jae, Asm::Local(bounds_label));
+        }
+    }
+
+    Asm::Operand element;
+    auto array = arrays.find(ident->value);
+    if(storage.IsStatic(ident->value) && array != arrays.end()){
+        Asm::Operand address = Asm::Mem(Asm::Reg::rax, 0);
+        address.base = false;
+        address.rip = true;
+        address.name = array->second;
+        Emit(Asm::Op::lea, Reg(Asm::Reg::rdx), address);
+        element = Asm::Mem(Asm::Reg::rdx, 0, width);
+    }
+    else
+        element = Stack(storage.GetStackPosition(ident->value), width);
+
+    if(is_literal)
+        element.value += literal * width;
+    else{
+        element.index = reg.reg;
+        element.scale = width;
+    }
+    return element;
+}
+
+void Generator::GenArray(const Node::Variable* stmt) {
+    uint8_t width = GetWidth(stmt->type);
+    if(width > word){
+        Log::Error("You cant have an long/int64/uint64 array in a 32-bit program");
+        exit(1);
+    }
+
+    // arrays outside of every scope live as long as the program, in the bss that starts zeroed
+    if(storage.IsTopLevel() && word == 8){
+        std::string name = "__gx_array_" + std::to_string(module_index) + "_" + std::to_string(arrays.size()) + "_" +
+                           stmt->ident->value;
+        static const char* reserve[] = {"", "resb", "resw", "", "resd", "", "", "", "resq"};
+        module.bss.emplace_back("alignb 16");
+        module.bss.emplace_back(name + ": " + reserve[width] + " " + std::to_string(stmt->length));
+        arrays[stmt->ident->value] = name;
+        storage.StoreArray(stmt->ident->value, stmt->type, stmt->length, 0);
+        return;
+    }
+
+    // the elements are whole 16 byte blocks, padded below so the first one is 16 byte aligned
+    uint64_t size = (stmt->length * width + 15) / 16 * 16;
+    uint64_t padding = GetPadding();
+    storage.StoreArray(stmt->ident->value, stmt->type, stmt->length, size + padding);
+    Emit(Asm::Op::sub, Reg(Asm::Reg::rsp), Asm::Imm(static_cast<int64_t>(size + padding)));
+
+    // zeroed every time the declaration runs, what was on the stack before can't leak into it
+    Emit(Asm::Op::_xor, Asm::R(Asm::Reg::rax, 4), Asm::R(Asm::Reg::rax, 4));
+    if(size / word <= 8){
+        for(uint64_t offset = 0; offset < size; offset += word)
+            Emit(Asm::Op::mov, Stack(offset), Reg(Asm::Reg::rax));
+        return;
+    }
+    uint32_t loop = labels.NewLabel(Label::LabelTypes::_loop);
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rcx), Asm::Imm(static_cast<int64_t>(size / word)));
+    EmitLabel(loop);
+    Asm::Operand slot = Stack(0);
+    slot.value -= word;
+    slot.index = Asm::Reg::rcx;
+    slot.scale = word;
+    Emit(Asm::Op::mov, slot, Reg(Asm::Reg::rax));
+    Emit(Asm::Op::sub, Reg(Asm::Reg::rcx), Asm::Imm(1));
+    Emit(Asm::Op::jne, Asm::Local(loop));
+}
+
+Asm::Operand Generator::GetVectorConstant(const Vectorizer::Side& side, uint8_t width) {
+    static const char* define[] = {"", "db", "dw", "", "dd", "", "", "", "dq"};
+    std::string values;
+    for(int64_t value : side.values){
+        // only the bits of a lane are kept, like storing the value in a variable
+        uint64_t bits = width == 8 ? static_cast<uint64_t>(value) : static_cast<uint64_t>(value) & ((1ull << (width * 8)) - 1);
+        values += (values.empty() ? " " : ", ") + (width == 8 ? std::to_string(value) : std::to_string(bits));
+    }
+    std::string line = std::string(define[width]) + values;
+
+    auto it = vector_constants.find(line);
+    if(it == vector_constants.end()){
+        std::string name = "__gx_vector_" + std::to_string(module_index) + "_" + std::to_string(vector_constants.size());
+        module.data.emplace_back("align 16");
+        module.data.emplace_back(name + ": " + line);
+        it = vector_constants.emplace(line, name).first;
+    }
+
+    Asm::Operand constant = Asm::Mem(Asm::Reg::rax, 0, static_cast<uint8_t>(side.values.size() * width));
+    constant.base = false;
+    constant.rip = true;
+    constant.name = it->second;
+    return constant;
+}
+
+bool Generator::GenPack(const Vectorizer::Pack& pack, size_t line) {
+    auto bytes = static_cast<uint8_t>(pack.width * pack.lanes);
+    uint64_t misalign = entry == Entry::start ? 0 : word;
+
+    // the layout the vectorizer planned, checked against where the variables really are
+    auto get_side = [&](const Vectorizer::Side& side, bool read, Asm::Operand& operand){
+        if(side.idents.empty()){
+            operand = GetVectorConstant(side, pack.width);
+            return true;
+        }
+        uint64_t first = storage.GetStackPosition(side.idents.front()->value);
+        if((misalign + first + 16 - storage.GetStackSize() % 16) % 16 != 0)
+            return false;
+        for(size_t lane = 0; lane < side.idents.size(); lane++){
+            const std::string& ident = side.idents.at(lane)->value;
+            if(storage.GetStackPosition(ident) != first + lane * pack.width || GetWidth(storage.GetType(ident)) != pack.width ||
+               storage.GetLength(ident) != 0 || (read && !storage.IsIdentInit(ident)))
+                return false;
+        }
+        operand = Stack(first, bytes);
+        return true;
+    };
+    Asm::Operand dst, lhs, rhs;
+    if(!get_side(pack.dst, false, dst) || !get_side(pack.lhs, true, lhs) || !get_side(pack.rhs, true, rhs))
+        return false;
+
+    static const Asm::Op ops[][4] = {
+            {Asm::Op::paddb, Asm::Op::paddw, Asm::Op::paddd, Asm::Op::paddq},
+            {Asm::Op::psubb, Asm::Op::psubw, Asm::Op::psubd, Asm::Op::psubq},
+            {Asm::Op::nop, Asm::Op::pmullw, Asm::Op::pmulld, Asm::Op::nop},
+    };
+    uint8_t column = pack.width == 1 ? 0 : pack.width == 2 ? 1 : pack.width == 4 ? 2 : 3;
+    Asm::Op op;
+    switch(pack.op){
+        case Node::BinOp::add: op = ops[0][column]; break;
+        case Node::BinOp::sub: op = ops[1][column]; break;
+        case Node::BinOp::mul: op = ops[2][column]; break;
+        case Node::BinOp::_and: op = Asm::Op::pand; break;
+        case Node::BinOp::_or: op = Asm::Op::por; break;
+        default: op = Asm::Op::pxor; break;
+    }
+
+    // the blocks are only 16 byte aligned, the AVX forms don't need them to be 32 byte aligned
+    MarkLine(line);
+    if(bytes == 16 && upper_dirty){
+        Emit(Asm::Op::vzeroupper);
+        upper_dirty = false;
+    }
+    Asm::Operand vector = Asm::R(Asm::Reg::rax, bytes);
+    Asm::Op move = bytes == 32 ? Asm::Op::movdqu : Asm::Op::movdqa;
+    Emit(move, vector, lhs);
+    if(bytes == 32){
+        Emit(op, vector, vector, rhs);
+        upper_dirty = true;
+    }
+    else
+        Emit(op, vector, rhs);
+    Emit(move, dst, vector);
+    return true;
+}
+
+void Generator::GenBuiltin(const Node::TermBuiltin* builtin) {
+    Asm::Operand rax = Reg(Asm::Reg::rax);
+    Asm::Operand rcx = Reg(Asm::Reg::rcx);
+    Asm::Operand rdx = Reg(Asm::Reg::rdx);
+    GenExpr(builtin->expr, rax);
+
+    switch(builtin->builtin){
+        case Node::Builtin::popcount: {
+            if(level >= Asm::Level::v2){
+                Emit(Asm::Op::popcnt, rax, rax);
+                break;
+            }
+            // adds up the bits in pairs, nibbles and bytes, the multiply sums the bytes into the top one
+            auto mask = [this](uint8_t byte){
+                uint64_t value = byte * 0x0101010101010101ull;
+                return Asm::Imm(static_cast<int64_t>(word == 8 ? value : value & 0xFFFFFFFF));
+            };
+            Emit(Asm::Op::mov, rcx, rax);
+            Emit(Asm::Op::shr, rcx, Asm::Imm(1));
+            Emit(Asm::Op::mov, rdx, mask(0x55));
+            Emit(Asm::Op::_and, rcx, rdx);
+            Emit(Asm::Op::sub, rax, rcx);
+            Emit(Asm::Op::mov, rdx, mask(0x33));
+            Emit(Asm::Op::mov, rcx, rax);
+            Emit(Asm::Op::shr, rax, Asm::Imm(2));
+            Emit(Asm::Op::_and, rcx, rdx);
+            Emit(Asm::Op::_and, rax, rdx);
+            Emit(Asm::Op::add, rax, rcx);
+            Emit(Asm::Op::mov, rcx, rax);
+            Emit(Asm::Op::shr, rcx, Asm::Imm(4));
+            Emit(Asm::Op::add, rax, rcx);
+            Emit(Asm::Op::mov, rdx, mask(0x0F));
+            Emit(Asm::Op::_and, rax, rdx);
+            Emit(Asm::Op::mov, rdx, mask(0x01));
+            Emit(Asm::Op::imul, rax, rdx);
+            Emit(Asm::Op::shr, rax, Asm::Imm(word * 8 - 8));
+            break;
+        }
+        case Node::Builtin::clz:
+        case Node::Builtin::ctz: {
+            bool leading = builtin->builtin == Node::Builtin::clz;
+            if(level >= Asm::Level::v3){
+                Emit(leading ? Asm::Op::lzcnt : Asm::Op::tzcnt, rax, rax);
+                break;
+            }
+            // bsf and bsr set the zero flag for 0 and leave the result undefined, it gets what gives the width.
+            // bsr is the index of the highest set bit, the leading zeros are width - 1 - index
+            uint32_t found = labels.NewLabel(Label::LabelTypes::_main);
+            Emit(leading ? Asm::Op::bsr : Asm::Op::bsf, rax, rax);
+            Emit(Asm::Op::jne, Asm::Local(found));
+            Emit(Asm::Op::mov, rax, Asm::Imm(leading ? -1 : word * 8));
+            EmitLabel(found);
+            if(leading){
+                Emit(Asm::Op::neg, rax);
+                Emit(Asm::Op::add, rax, Asm::Imm(word * 8 - 1));
+            }
+            break;
+        }
+    }
+}
+
+/// Calculates lhs into rax and rhs into rcx, lhs waits on the stack so calculating rhs can't overwrite it
+void Generator::GenBinOperands(const Node::IntExpr* lhs, const Node::IntExpr* rhs) {
+    GenExpr(lhs, Reg(Asm::Reg::rax));
+    Emit(Asm::Op::push, Reg(Asm::Reg::rax));
+    pushed += word;
+    GenExpr(rhs, Reg(Asm::Reg::rcx));
+    Emit(Asm::Op::pop, Reg(Asm::Reg::rax));
+    pushed -= word;
+}
+
+void Generator::GenBinOperands(const Node::IntExpr* lhs, const Node::Term* rhs) {
+    GenExpr(lhs, Reg(Asm::Reg::rax));
+    Emit(Asm::Op::push, Reg(Asm::Reg::rax));
+    pushed += word;
+    GenTerm(rhs, Reg(Asm::Reg::rcx));
+    Emit(Asm::Op::pop, Reg(Asm::Reg::rax));
+    pushed -= word;
+}
+
+/// The `~` of `expr` when it is one
+static const Node::TermNot* GetNot(const Node::IntExpr* expr){
+    if(!std::holds_alternative<Node::Term*>(expr->var))
+        return nullptr;
+    const Node::Term* term = std::get<Node::Term*>(expr->var);
+    return std::holds_alternative<Node::TermNot*>(term->term) ? std::get<Node::TermNot*>(term->term) : nullptr;
+}
+
+void Generator::GenBitwise(Asm::Op op, const Node::IntExpr* lhs, const Node::IntExpr* rhs) {
+    // all of them are commutative, so a literal on either side becomes the immediate
+    int64_t value;
+    if(Node::GetLiteral(lhs, value) && !Node::GetLiteral(rhs, value))
+        std::swap(lhs, rhs);
+    if(Node::GetLiteral(rhs, value) && value >= INT32_MIN && value <= INT32_MAX){
+        GenExpr(lhs, Reg(Asm::Reg::rax));
+        Emit(op, Reg(Asm::Reg::rax), Asm::Imm(value));
+        return;
+    }
+
+    if(op == Asm::Op::_and && level >= Asm::Level::v3 && (GetNot(lhs) || GetNot(rhs))){
+        if(GetNot(lhs) && !GetNot(rhs))
+            std::swap(lhs, rhs);
+        // andn is the first source inverted and the second, without a separate not
+        GenBinOperands(lhs, GetNot(rhs)->term);
+        Emit(Asm::Op::andn, Reg(Asm::Reg::rax), Reg(Asm::Reg::rcx), Reg(Asm::Reg::rax));
+        return;
+    }
+
+    GenBinOperands(lhs, rhs);
+    Emit(op, Reg(Asm::Reg::rax), Reg(Asm::Reg::rcx));
+}
+
+void Generator::GenShift(Asm::Op op, const Node::IntExpr* lhs, const Node::IntExpr* rhs) {
+    int64_t count;
+    if(Node::GetLiteral(rhs, count)){
+        GenExpr(lhs, Reg(Asm::Reg::rax));
+        // the cpu only uses the low bits of the count, a literal count is cut the same way
+        count &= word * 8 - 1;
+        if(count)
+            Emit(op, Reg(Asm::Reg::rax), Asm::Imm(count));
+        return;
+    }
+
+    GenBinOperands(lhs, rhs);
+    if(level >= Asm::Level::v3){
+        // shlx and sarx take the count from any register and leave the flags alone
+        Asm::Op bmi = op == Asm::Op::shl ? Asm::Op::shlx : op == Asm::Op::shr ? Asm::Op::shrx : Asm::Op::sarx;
+        Emit(bmi, Reg(Asm::Reg::rax), Reg(Asm::Reg::rax), Reg(Asm::Reg::rcx));
+        return;
+    }
+    Emit(op, Reg(Asm::Reg::rax), Asm::R(Asm::Reg::rcx, 1));
+}
+
+void Generator::GenMul(const Node::IntExpr* lhs, const Node::IntExpr* rhs) {
+    Asm::Operand rax = Reg(Asm::Reg::rax);
+    // multiplying is commutative, so a literal on either side becomes the immediate
+    int64_t value;
+    if(Node::GetLiteral(lhs, value) && !Node::GetLiteral(rhs, value))
+        std::swap(lhs, rhs);
+    if(!Node::GetLiteral(rhs, value) || value < INT32_MIN || value > INT32_MAX){
+        GenBinOperands(lhs, rhs);
+        Emit(Asm::Op::imul, rax, Reg(Asm::Reg::rcx));
+        return;
+    }
+
+    if(value > 0 && (value & (value - 1)) == 0){
+        GenExpr(lhs, rax);
+        int64_t shift = 0;
+        while((int64_t{1} << shift) < value)
+            shift++;
+        if(shift)
+            Emit(Asm::Op::shl, rax, Asm::Imm(shift));
+        return;
+    }
+
+    // a variable as wide as the word is multiplied straight from its slot
+    const Node::Ident* ident = Node::GetIdent(lhs);
+    if(ident && storage.IsIdentInit(ident->value) && GetWidth(storage.GetType(ident->value)) == word){
+        Emit(Asm::Op::imul, rax, Stack(storage.GetStackPosition(ident->value)), Asm::Imm(value));
+        return;
+    }
+    GenExpr(lhs, rax);
+    Emit(Asm::Op::imul, rax, rax, Asm::Imm(value));
+}
+
+bool Generator::FitsIn(const Node::IntExpr* expr, uint8_t bytes, bool is_unsigned) {
+    if(!std::holds_alternative<Node::Term*>(expr->var))
+        return false;
+    const Node::Term* term = std::get<Node::Term*>(expr->var);
+    // ~x is -x - 1, which is in the signed range x is in
+    while(std::holds_alternative<Node::TermNot*>(term->term)){
+        if(is_unsigned)
+            return false;
+        term = std::get<Node::TermNot*>(term->term)->term;
+    }
+
+    if(std::holds_alternative<Node::LitInt*>(term->term)){
+        int64_t value = std::get<Node::LitInt*>(term->term)->GetValue();
+        int64_t limit = int64_t{1} << (bytes * 8 - (is_unsigned ? 0 : 1));
+        return value >= (is_unsigned ? 0 : -limit) && value < limit;
+    }
+    if(std::holds_alternative<Node::Ident*>(term->term) || std::holds_alternative<Node::TermIndex*>(term->term)){
+        VarType type = storage.GetType(std::holds_alternative<Node::Ident*>(term->term) ?
+                                       std::get<Node::Ident*>(term->term)->value :
+                                       std::get<Node::TermIndex*>(term->term)->ident->value);
+        if(IsUnsigned(type) != is_unsigned)
+            return IsUnsigned(type) && GetWidth(type) < bytes; // a zero extended number only fits in a wider signed one
+        return GetWidth(type) <= bytes;
+    }
+    if(std::holds_alternative<Node::TermParen*>(term->term))
+        return FitsIn(std::get<Node::TermParen*>(term->term)->expr, bytes, is_unsigned);
+    return true; // the builtins count at most 64 bits
+}
+
+void Generator::GenDiv(const Node::IntExpr* lhs, const Node::IntExpr* rhs, bool mod) {
+    // idiv faults when the smallest number is divided by -1, in 32 bits that can only happen when the divisor can be
+    // -1 and the dividend can be below the range of 16 bits
+    int64_t divisor;
+    bool literal = Node::GetLiteral(rhs, divisor);
+    bool narrow = word == 8 && FitsIn(lhs, 4) && FitsIn(rhs, 4) && ((literal && divisor != -1) || FitsIn(lhs, 2));
+
+    if(literal){
+        GenExpr(lhs, Reg(Asm::Reg::rax));
+        Emit(Asm::Op::mov, Reg(Asm::Reg::rcx), Asm::Imm(divisor));
+    }
+    else
+        GenBinOperands(lhs, rhs);
+
+    if(narrow){
+        // the 32-bit idiv is the faster one, its result is sign extended back to the word
+        Emit(Asm::Op::cdq);
+        Emit(Asm::Op::idiv, Asm::R(Asm::Reg::rcx, 4));
+        Emit(Asm::Op::movsx, Reg(Asm::Reg::rax), Asm::R(mod ? Asm::Reg::rdx : Asm::Reg::rax, 4));
+        return;
+    }
+    Emit(word == 8 ? Asm::Op::cqo : Asm::Op::cdq);
+    Emit(Asm::Op::idiv, Reg(Asm::Reg::rcx));
+    if(mod)
+        Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Reg(Asm::Reg::rdx));
+}
+
+void Generator::GenUnsignedDiv(const Node::IntExpr* lhs, const Node::IntExpr* rhs, bool mod) {
+    Asm::Operand rax = Reg(Asm::Reg::rax);
+    Asm::Operand rcx = Reg(Asm::Reg::rcx);
+    Asm::Operand rdx = Reg(Asm::Reg::rdx);
+
+    int64_t value;
+    if(Node::GetLiteral(rhs, value) && value > 0 && (word == 8 || value <= UINT32_MAX)){
+        auto divisor = static_cast<uint64_t>(value);
+        GenExpr(lhs, rax);
+        int bits = 0; // the log2 of the divisor rounded up
+        while((uint64_t{1} << bits) < divisor)
+            bits++;
+
+        if((divisor & (divisor - 1)) == 0){
+            if(mod && divisor - 1 <= INT32_MAX)
+                Emit(Asm::Op::_and, rax, Asm::Imm(value - 1));
+            else if(mod){
+                Emit(Asm::Op::mov, rcx, Asm::Imm(value - 1));
+                Emit(Asm::Op::_and, rax, rcx);
+            }
+            else if(bits)
+                Emit(Asm::Op::shr, rax, Asm::Imm(bits));
+            return;
+        }
+
+        // Granlund and Montgomery's division by invariant integers: with t the high half of n * magic the quotient
+        // is (t + (n - t) / 2) >> (bits - 1), which can't overflow like (n * magic) >> bits with a wider magic would
+        unsigned __int128 below = (uint64_t{1} << bits) - divisor;
+        auto magic = static_cast<uint64_t>((below << (word * 8)) / divisor + 1);
+        if(level >= Asm::Level::v3){
+            // mulx with both halves to rdx keeps the high one and leaves n in rax, only the remainder needs a copy
+            if(mod)
+                Emit(Asm::Op::mov, rcx, rax);
+            Emit(Asm::Op::mov, rdx, Asm::Imm(static_cast<int64_t>(magic)));
+            Emit(Asm::Op::mulx, rdx, rdx, rax);
+        }
+        else{
+            Emit(Asm::Op::mov, rcx, rax);
+            Emit(Asm::Op::mov, rdx, Asm::Imm(static_cast<int64_t>(magic)));
+            Emit(Asm::Op::mul, rdx);
+            Emit(Asm::Op::mov, rax, rcx);
+        }
+        Emit(Asm::Op::sub, rax, rdx);
+        Emit(Asm::Op::shr, rax, Asm::Imm(1));
+        Emit(Asm::Op::add, rax, rdx);
+        if(bits > 1)
+            Emit(Asm::Op::shr, rax, Asm::Imm(bits - 1));
+        if(mod){
+            // n - quotient * divisor
+            if(value <= INT32_MAX)
+                Emit(Asm::Op::imul, rax, rax, Asm::Imm(value));
+            else{
+                Emit(Asm::Op::mov, rdx, Asm::Imm(value));
+                Emit(Asm::Op::imul, rax, rdx);
+            }
+            Emit(Asm::Op::sub, rcx, rax);
+            Emit(Asm::Op::mov, rax, rcx);
+        }
+        return;
+    }
+
+    bool narrow = word == 8 && FitsIn(lhs, 4, true) && FitsIn(rhs, 4, true);
+    GenBinOperands(lhs, rhs);
+    if(narrow){
+        // the 32-bit div is the faster one, writing eax clears the rest of rax
+        Emit(Asm::Op::_xor, Asm::R(Asm::Reg::rdx, 4), Asm::R(Asm::Reg::rdx, 4));
+        Emit(Asm::Op::div, Asm::R(Asm::Reg::rcx, 4));
+        if(mod)
+            Emit(Asm::Op::mov, Asm::R(Asm::Reg::rax, 4), Asm::R(Asm::Reg::rdx, 4));
+        return;
+    }
+    Emit(Asm::Op::_xor, rdx, rdx);
+    Emit(Asm::Op::div, rcx);
+    if(mod)
+        Emit(Asm::Op::mov, rax, rdx);
 }
 
 void Generator::GenBinExpr(const Node::BinExpr* expr) {
@@ -27,40 +534,36 @@ void Generator::GenBinExpr(const Node::BinExpr* expr) {
         Generator& gen;
         BinExprVisitor(Generator& generator) : gen(generator) {}
 
-        void operator()(const Node::BinExprMul* expr){
-            gen.GenExpr(expr->lhs, gen.bit + "ax");
-            gen.GenExpr(expr->rhs, gen.bit + "cx");
-            gen.code.text << "mul " << gen.bit << "cx\n";
-        }
-
+        void operator()(const Node::BinExprMul* expr){ gen.GenMul(expr->lhs, expr->rhs); }
         void operator()(const Node::BinExprDiv* expr){
-            gen.GenExpr(expr->lhs, gen.bit + "ax");
-            gen.code.text << "xor " << gen.bit << "dx, " << gen.bit << "dx\n";
-            gen.GenExpr(expr->rhs, gen.bit + "cx");
-            gen.code.text << "div " << gen.bit << "cx\n";
+            if(expr->lhs->is_unsigned || expr->rhs->is_unsigned)
+                gen.GenUnsignedDiv(expr->lhs, expr->rhs, false);
+            else
+                gen.GenDiv(expr->lhs, expr->rhs, false);
+        }
+        void operator()(const Node::BinExprMod* expr){
+            if(expr->lhs->is_unsigned || expr->rhs->is_unsigned)
+                gen.GenUnsignedDiv(expr->lhs, expr->rhs, true);
+            else
+                gen.GenDiv(expr->lhs, expr->rhs, true);
         }
 
         void operator()(const Node::BinExprAdd* expr){
-            gen.GenExpr(expr->lhs, gen.bit + "ax");
-            gen.code.text << "mov " << gen.bit << "bx, " << gen.bit << "ax\n";
-            gen.GenExpr(expr->rhs, gen.bit + "ax");
-            gen.code.text << "add " << gen.bit << "ax, " << gen.bit << "bx\n";
+            gen.GenBinOperands(expr->lhs, expr->rhs);
+            gen.Emit(Asm::Op::add, gen.Reg(Asm::Reg::rax), gen.Reg(Asm::Reg::rcx));
         }
 
         void operator()(const Node::BinExprSub* expr){
-            gen.GenExpr(expr->lhs, gen.bit + "ax");
-            gen.code.text << "mov " << gen.bit << "bx, " << gen.bit << "ax\n";
-            gen.GenExpr(expr->rhs, gen.bit + "ax");
-            gen.code.text << "sub " << gen.bit << "bx, " << gen.bit << "ax\n";
-            gen.code.text << "mov " << gen.bit << "ax, " << gen.bit << "bx\n";
+            gen.GenBinOperands(expr->lhs, expr->rhs);
+            gen.Emit(Asm::Op::sub, gen.Reg(Asm::Reg::rax), gen.Reg(Asm::Reg::rcx));
         }
 
-        void operator()(const Node::BinExprMod* expr){
-            gen.GenExpr(expr->lhs, gen.bit + "ax");
-            gen.code.text << "xor " << gen.bit << "dx, " << gen.bit << "dx\n";
-            gen.GenExpr(expr->rhs, gen.bit + "cx");
-            gen.code.text << "div " << gen.bit << "cx\n";
-            gen.code.text << "mov " << gen.bit << "ax, " << gen.bit << "dx\n";
+        void operator()(const Node::BinExprAnd* expr){ gen.GenBitwise(Asm::Op::_and, expr->lhs, expr->rhs); }
+        void operator()(const Node::BinExprOr* expr){ gen.GenBitwise(Asm::Op::_or, expr->lhs, expr->rhs); }
+        void operator()(const Node::BinExprXor* expr){ gen.GenBitwise(Asm::Op::_xor, expr->lhs, expr->rhs); }
+        void operator()(const Node::BinExprShl* expr){ gen.GenShift(Asm::Op::shl, expr->lhs, expr->rhs); }
+        void operator()(const Node::BinExprShr* expr){
+            gen.GenShift(expr->lhs->is_unsigned ? Asm::Op::shr : Asm::Op::sar, expr->lhs, expr->rhs);
         }
     };
 
@@ -68,124 +571,110 @@ void Generator::GenBinExpr(const Node::BinExpr* expr) {
     std::visit(visitor, expr->expr);
 }
 
-void Generator::GenExpr(const Node::IntExpr* expr, const std::string reg) {
+void Generator::GenExpr(const Node::IntExpr* expr, const Asm::Operand& reg) {
     if(std::holds_alternative<Node::Term*>(expr->var))
         GenTerm(std::get<Node::Term*>(expr->var), reg);
 
     else if(std::holds_alternative<Node::BinExpr*>(expr->var)) {
         GenBinExpr(std::get<Node::BinExpr *>(expr->var));
-        code.text << "mov " << reg << ", " << bit << "ax\n";
+        // the result is already in the lower part of rax when reg is al, ax or eax
+        if(reg.reg != Asm::Reg::rax)
+            Emit(Asm::Op::mov, reg, Asm::R(Asm::Reg::rax, reg.size));
     }
 }
 
 
-void Generator::GenBoolTerm(const Node::BoolTerm *term, const std::string reg) {
+void Generator::GenBoolTerm(const Node::BoolTerm *term, const Asm::Operand& reg) {
+    // jumps to the bool label when the comparison is true and to the end label when its false
+    uint32_t end_label = 0;
+    auto gen_jumps = [this, &end_label](std::initializer_list<Asm::Op> true_jumps){
+        uint32_t true_label = labels.NewLabel(Label::LabelTypes::_bool);
+        end_label = labels.NewLabel(Label::LabelTypes::_main);
+        for(Asm::Op jump : true_jumps)
+            Emit(jump, Asm::Local(true_label));
+        Emit(Asm::Op::jmp, Asm::Local(end_label));
+        EmitLabel(true_label);
+    };
+
     if(std::holds_alternative<Node::BoolTermInt*>(term->term)){
         auto int_term = std::get<Node::BoolTermInt*>(term->term);
 
-        GenExpr(int_term->lhs, bit + "12");
-        GenExpr(int_term->lhs, bit + "13");
+        GenExpr(int_term->lhs, Reg(Asm::Reg::r12));
+        GenExpr(int_term->rhs, Reg(Asm::Reg::r13));
 
-        code.text << "mov " << bit << "ax, 0\n";
-        code.text << "cmp " << bit << "12, " << bit << "13\n";
+        Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(0));
+        Emit(Asm::Op::cmp, Reg(Asm::Reg::r12), Reg(Asm::Reg::r13));
 
+        // unsigned numbers are ordered by the carry flag, above and below instead of greater and less
+        bool is_unsigned = int_term->lhs->is_unsigned || int_term->rhs->is_unsigned;
+        Asm::Op greater = is_unsigned ? Asm::Op::ja : Asm::Op::jg;
+        Asm::Op less = is_unsigned ? Asm::Op::jb : Asm::Op::jl;
         switch(int_term->comp){
             case Node::Comparison::equal:
-                code.text << "je " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({Asm::Op::je});
                 break;
             case Node::Comparison::not_equal:
-                code.text << "jne " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({Asm::Op::jne});
                 break;
             case Node::Comparison::greater:
-                code.text << "jg " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({greater});
                 break;
             case Node::Comparison::greater_equal:
-                code.text << "jg " << labels.GetBoolLabel() << '\n';
-                code.text << "je " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({greater, Asm::Op::je});
                 break;
             case Node::Comparison::less:
-                code.text << "jl " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({less});
                 break;
             case Node::Comparison::less_equal:
-                code.text << "jl " << labels.GetBoolLabel() << '\n';
-                code.text << "je " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({less, Asm::Op::je});
                 break;
+            default:
+                Log::Error("Expected a comparison operator in the boolean expression");
+                exit(1);
         }
     }
 
     else if(std::holds_alternative<Node::BoolTermBool*>(term->term)){
         auto bool_term = std::get<Node::BoolTermBool*>(term->term);
 
-        /// Left hand side
-        if(std::holds_alternative<Node::LitBool>(bool_term->lhs)){
-            if(std::get<Node::LitBool>(bool_term->lhs) == Node::LitBool::_true)
-                code.text << "mov " << bit << "12, 1\n";
-            else
-                code.text << "mov " << bit << "12, 0\n";
-        }
-        else if(std::holds_alternative<Node::Ident*>(bool_term->lhs)){
-            auto ident = std::get<Node::Ident*>(bool_term->lhs)->value;
-
-            if(!storage.IsIdentInit(ident)){
-                Log::Error("Identifier \'" + ident + "\' was never initialized");
-                exit(1);
+        auto gen_side = [this](const std::variant<Node::LitBool, Node::Ident*>& side, const Asm::Operand& side_reg){
+            if(std::holds_alternative<Node::LitBool>(side)){
+                if(std::get<Node::LitBool>(side) == Node::LitBool::_true)
+                    Emit(Asm::Op::mov, side_reg, Asm::Imm(1));
+                else
+                    Emit(Asm::Op::mov, side_reg, Asm::Imm(0));
             }
+            else if(std::holds_alternative<Node::Ident*>(side)){
+                auto ident = std::get<Node::Ident*>(side)->value;
 
-            code.text << "mov " << bit << "12, [" << bit << "sp + " << storage.GetStackPosition(ident) << "]\n";
-        }
+                if(!storage.IsIdentInit(ident)){
+                    Log::Error("Identifier \'" + ident + "\' was never initialized");
+                    exit(1);
+                }
 
-        /// Right hand side
-        if(std::holds_alternative<Node::LitBool>(bool_term->rhs)){
-            if(std::get<Node::LitBool>(bool_term->rhs) == Node::LitBool::_true)
-                code.text << "mov " << bit << "13, 1\n";
-            else
-                code.text << "mov " << bit << "13, 0\n";
-        }
-        else if(std::holds_alternative<Node::Ident*>(bool_term->rhs)){
-            auto ident = std::get<Node::Ident*>(bool_term->rhs)->value;
-
-            if(!storage.IsIdentInit(ident)){
-                Log::Error("Identifier \'" + ident + "\' was never initialized");
-                exit(1);
+                GenLoad(ident, side_reg);
             }
+        };
 
-            code.text << "mov " << bit << "13, [" << bit << "sp + " << storage.GetStackPosition(ident) << "]\n";
-        }
+        /// Left hand side
+        gen_side(bool_term->lhs, Reg(Asm::Reg::r12));
+        /// Right hand side
+        gen_side(bool_term->rhs, Reg(Asm::Reg::r13));
 
-        code.text << "mov " << bit << "ax, 0\n";
-        code.text << "cmp " << bit << "12, " << bit << "13\n";
+        Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(0));
+        Emit(Asm::Op::cmp, Reg(Asm::Reg::r12), Reg(Asm::Reg::r13));
         switch(bool_term->comp){
             case Node::Comparison::equal:
-                code.text << "je " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({Asm::Op::je});
                 break;
 
             case Node::Comparison::not_equal:
-                code.text << "jne " << labels.GetBoolLabel() << '\n';
-                code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-                code.text << labels.GetBoolLabel() << ":\n";
-                labels.AddLabel(Label::LabelTypes::_bool, true);
+                gen_jumps({Asm::Op::jne});
                 break;
+
+            default:
+                Log::Error("Booleans can only be compared with `==` or `!=`");
+                exit(1);
         }
     }
     else{
@@ -193,120 +682,314 @@ void Generator::GenBoolTerm(const Node::BoolTerm *term, const std::string reg) {
         return;
     }
 
-    code.text << "mov " << bit << "ax, 1\n";
-    labels.EndLabel();
-
-    code.text << "jmp " << labels.GetCurrentLabel() << '\n';
-    code.text << labels.GetCurrentLabel() << ":\n";
-    labels.AddLabel(labels.GetCurrentLabelType(), true);
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(1));
+    Emit(Asm::Op::jmp, Asm::Local(end_label));
+    EmitLabel(end_label);
 
-    if(reg != bit + "ax")
-        code.text << "mov " << reg << ", " << bit << "ax\n";
+    if(reg.reg != Asm::Reg::rax)
+        Emit(Asm::Op::mov, reg, Reg(Asm::Reg::rax));
 }
 
 /// Puts 0 in the argument `reg` if false and 1 if its true
-void Generator::GenBoolExpr(const Node::BoolExpr *expr, const std::string reg, const bool continue_last_label) {
+void Generator::GenBoolExpr(const Node::BoolExpr *expr, const Asm::Operand& reg) {
     struct BoolExprVisitor{
         Generator& gen;
         BoolExprVisitor(Generator& generator) : gen(generator) {}
 
+        void GenSide(const std::variant<Node::BoolTerm*, Node::BoolExpr*>& side){
+            if(std::holds_alternative<Node::BoolTerm*>(side))
+                gen.GenBoolTerm(std::get<Node::BoolTerm*>(side), gen.Reg(Asm::Reg::rax));
+            else
+                gen.GenBoolExpr(std::get<Node::BoolExpr*>(side), gen.Reg(Asm::Reg::rax));
+        }
+
         void operator()(const Node::BoolTerm* term){
-            gen.GenBoolTerm(term, gen.bit + "ax");
+            gen.GenBoolTerm(term, gen.Reg(Asm::Reg::rax));
         }
 
+        /// the right hand side is only calculated when the left hand side does not decide the result
         void operator()(const Node::BoolExprAnd* expr){
-            if(std::holds_alternative<Node::BoolTerm*>(expr->lhs))
-                gen.GenBoolTerm(std::get<Node::BoolTerm*>(expr->lhs), gen.bit + "12");
-            else
-                gen.GenBoolExpr(std::get<Node::BoolExpr*>(expr->lhs), gen.bit + "12");
+            uint32_t end_label = gen.labels.NewLabel(Label::LabelTypes::_bool);
 
-            if(std::holds_alternative<Node::BoolTerm*>(expr->rhs))
-                gen.GenBoolTerm(std::get<Node::BoolTerm*>(expr->rhs), gen.bit + "13");
-            else
-                gen.GenBoolExpr(std::get<Node::BoolExpr*>(expr->rhs), gen.bit + "13");
+            GenSide(expr->lhs);
+            gen.Emit(Asm::Op::cmp, gen.Reg(Asm::Reg::rax), Asm::Imm(0));
+            gen.Emit(Asm::Op::je, Asm::Local(end_label));
+            GenSide(expr->rhs);
+            gen.EmitLabel(end_label);
+        }
 
-            gen.code.text << "cmp " << gen.bit << "12, 0\n";
-            gen.code.text << "je " << gen.labels.GetCurrentLabel() << '\n';
-            gen.code.text << "cmp " << gen.bit << "13, 0\n";
-            gen.code.text << "je " << gen.labels.GetCurrentLabel() << '\n';
-            gen.code.text << "mov " << gen.bit << "ax, 1\n";
-            gen.code.text << "jmp " << gen.labels.GetCurrentLabel() << '\n';
+        void operator()(const Node::BoolExprOr* expr){
+            uint32_t end_label = gen.labels.NewLabel(Label::LabelTypes::_bool);
 
-            gen.code.text << gen.labels.GetCurrentLabel() << ":\n";
-            gen.labels.AddLabel(gen.labels.GetCurrentLabelType(), true);
+            GenSide(expr->lhs);
+            gen.Emit(Asm::Op::cmp, gen.Reg(Asm::Reg::rax), Asm::Imm(0));
+            gen.Emit(Asm::Op::jne, Asm::Local(end_label));
+            GenSide(expr->rhs);
+            gen.EmitLabel(end_label);
         }
     };
+
+    BoolExprVisitor visitor(*this);
+    std::visit(visitor, expr->expr);
+
+    if(reg.reg != Asm::Reg::rax)
+        Emit(Asm::Op::mov, reg, Reg(Asm::Reg::rax));
+}
+
+void Generator::GenScope(const Node::Scope* scope) {
+    storage.CreateScope();
+
+    GenStmts(scope->stmts);
+
+    uint64_t scope_size = storage.EndScope();
+    if(scope_size > 0)
+        Emit(Asm::Op::add, Reg(Asm::Reg::rsp), Asm::Imm(static_cast<int64_t>(scope_size)));
+}
+
+/// The ident and the value of an `x == 5` or `5 == x` condition, false for every other condition
+static bool GetEqualsLiteral(const Node::BoolExpr* expr, std::string& ident, int64_t& value){
+    auto term = std::get_if<Node::BoolTerm*>(&expr->expr);
+    if(!term)
+        return false;
+    auto compare = std::get_if<Node::BoolTermInt*>(&(*term)->term);
+    if(!compare || (*compare)->comp != Node::Comparison::equal)
+        return false;
+
+    auto get_term = [](const Node::IntExpr* side) -> const Node::Term* {
+        auto side_term = std::get_if<Node::Term*>(&side->var);
+        return side_term ? *side_term : nullptr;
+    };
+    const Node::Term* lhs = get_term((*compare)->lhs);
+    const Node::Term* rhs = get_term((*compare)->rhs);
+    if(!lhs || !rhs)
+        return false;
+    if(std::holds_alternative<Node::LitInt*>(lhs->term))
+        std::swap(lhs, rhs);
+    if(!std::holds_alternative<Node::Ident*>(lhs->term) || !std::holds_alternative<Node::LitInt*>(rhs->term))
+        return false;
+
+    ident = std::get<Node::Ident*>(lhs->term)->value;
+    value = std::get<Node::LitInt*>(rhs->term)->GetValue();
+    return true;
+}
+
+/// True when at most one condition of the chain can be true, every one compares the same ident with another value
+static bool IsExclusive(const std::vector<const Node::Stmt*>& chain){
+    std::string ident;
+    std::vector<int64_t> values;
+    for(const Node::Stmt* stmt : chain){
+        const Node::BoolExpr* expr;
+        if(std::holds_alternative<Node::If*>(stmt->stmt))
+            expr = std::get<Node::If*>(stmt->stmt)->expr;
+        else if(std::holds_alternative<Node::Elif*>(stmt->stmt))
+            expr = std::get<Node::Elif*>(stmt->stmt)->expr;
+        else
+            continue;
+
+        std::string arm_ident;
+        int64_t value;
+        if(!GetEqualsLiteral(expr, arm_ident, value) || (!ident.empty() && arm_ident != ident) ||
+           std::find(values.begin(), values.end(), value) != values.end())
+            return false;
+        ident = arm_ident;
+        values.emplace_back(value);
+    }
+    return values.size() > 1;
+}
+
+/// A branch ending in `exit` with a literal other than 0, the error paths of a program
+static bool IsErrorExit(const Node::Scope* scope){
+    if(scope->stmts.empty() || !std::holds_alternative<Node::Exit*>(scope->stmts.back()->stmt))
+        return false;
+    auto term = std::get_if<Node::Term*>(&std::get<Node::Exit*>(scope->stmts.back()->stmt)->expr->var);
+    return term && std::holds_alternative<Node::LitInt*>((*term)->term) &&
+           std::get<Node::LitInt*>((*term)->term)->value.find_first_not_of('0') != std::string::npos;
+}
+
+/// The node and the counter of how often a branch of a chain is taken
+static std::pair<const void*, uint32_t> GetArmCounter(const Node::Stmt* stmt){
+    if(std::holds_alternative<Node::If*>(stmt->stmt))
+        return {std::get<Node::If*>(stmt->stmt), 1}; // the first counter of an if is how often the chain runs
+    if(std::holds_alternative<Node::Elif*>(stmt->stmt))
+        return {std::get<Node::Elif*>(stmt->stmt), 0};
+    return {std::get<Node::Else*>(stmt->stmt), 0};
+}
+
+void Generator::GenCold(uint32_t label, const Node::Scope* scope, uint32_t back, size_t line) {
+    size_t start = module.text.size();
+    EmitLabel(label);
+    GenScope(scope);
+    MarkLine(line);
+    Emit(Asm::Op::jmp, Asm::Local(back));
+
+    auto first = std::find_if(module.lines.begin(), module.lines.end(), [start](const Asm::SourceLine& source){
+        return source.instr >= start;
+    });
+    for(auto it = first; it != module.lines.end(); it++)
+        cold_lines.emplace_back(Asm::SourceLine{static_cast<uint32_t>(it->instr - start + cold.size()), it->file, it->line});
+    module.lines.erase(first, module.lines.end());
+
+    cold.insert(cold.end(), std::make_move_iterator(module.text.begin() + static_cast<ptrdiff_t>(start)),
+                std::make_move_iterator(module.text.end()));
+    module.text.resize(start);
+}
+
+/// Generates an if statement together with the else if and else statements that follow it
+void Generator::GenIfChain(const std::vector<const Node::Stmt*>& written) {
+    uint32_t end_label = labels.NewLabel(Label::LabelTypes::_main);
+
+    const Node::If* first = std::get<Node::If*>(written.front()->stmt);
+    MarkLine(written.front()->line);
+    CountBranch(first);
+    uint64_t runs = GetCount(first);
+
+    // only one condition of an exclusive chain can be true, testing the most taken first changes nothing but the speed
+    std::vector<const Node::Stmt*> chain = written;
+    if(profiling == Profiling::use && IsExclusive(chain)){
+        auto tests_end = std::holds_alternative<Node::Else*>(chain.back()->stmt) ? chain.end() - 1 : chain.end();
+        std::stable_sort(chain.begin(), tests_end, [this](const Node::Stmt* a, const Node::Stmt* b){
+            auto [a_node, a_counter] = GetArmCounter(a);
+            auto [b_node, b_counter] = GetArmCounter(b);
+            return GetCount(a_node, a_counter) > GetCount(b_node, b_counter);
+        });
+    }
+
+    for(size_t i = 0; i < chain.size(); i++){
+        const Node::Stmt* stmt = chain.at(i);
+        bool last = i == chain.size() - 1;
+        auto [node, counter] = GetArmCounter(stmt);
+        MarkLine(stmt->line);
+
+        // the profile decides when the chain ran in it, error paths are cold without one
+        auto is_cold = [&](const Node::Scope* scope){
+            if(profiling == Profiling::generate)
+                return false;
+            return runs > 0 ? IsCold(GetCount(node, counter), runs) : IsErrorExit(scope);
+        };
+
+        if(std::holds_alternative<Node::Else*>(stmt->stmt)){
+            const Node::Scope* scope = std::get<Node::Else*>(stmt->stmt)->stmt;
+            if(is_cold(scope)){
+                uint32_t cold_label = labels.NewLabel(Label::LabelTypes::_if);
+                Emit(Asm::Op::jmp, Asm::Local(cold_label));
+                GenCold(cold_label, scope, end_label);
+            }
+            else{
+                CountBranch(node, counter);
+                GenScope(scope);
+            }
+            break;
+        }
+
+        Node::BoolExpr* expr;
+        Node::Scope* scope;
+        if(std::holds_alternative<Node::If*>(stmt->stmt)){
+            expr = std::get<Node::If*>(stmt->stmt)->expr;
+            scope = std::get<Node::If*>(stmt->stmt)->stmt;
+        }
+        else{
+            expr = std::get<Node::Elif*>(stmt->stmt)->expr;
+            scope = std::get<Node::Elif*>(stmt->stmt)->stmt;
+        }
+
+        GenBoolExpr(expr, Reg(Asm::Reg::rax));
+        Emit(Asm::Op::cmp, Reg(Asm::Reg::rax), Asm::Imm(0));
+
+        // a cold branch is only jumped to, the test of the next branch follows the test of this one
+        if(is_cold(scope)){
+            uint32_t cold_label = labels.NewLabel(Label::LabelTypes::_if);
+            Emit(Asm::Op::jne, Asm::Local(cold_label));
+            GenCold(cold_label, scope, end_label);
+            continue;
+        }
+
+        uint32_t next_label = last ? end_label : labels.NewLabel(Label::LabelTypes::_if);
+        Emit(Asm::Op::je, Asm::Local(next_label)); // its 0/false
+
+        CountBranch(node, counter);
+        GenScope(scope);
+
+        if(!last){
+            Emit(Asm::Op::jmp, Asm::Local(end_label));
+            EmitLabel(next_label);
+        }
+    }
+
+    EmitLabel(end_label);
+}
+
+void Generator::GenStmts(const std::vector<Node::Stmt*>& stmts) {
+    for(size_t i = 0; i < stmts.size(); i++){
+        auto pack = vectors.packs.find(stmts.at(i));
+        if(pack != vectors.packs.end() && GenPack(pack->second, stmts.at(i)->line)){
+            i += pack->second.lanes - 1;
+            continue;
+        }
+        if(upper_dirty){
+            Emit(Asm::Op::vzeroupper);
+            upper_dirty = false;
+        }
+
+        if(!std::holds_alternative<Node::If*>(stmts.at(i)->stmt)){
+            Generate(stmts.at(i));
+            continue;
+        }
+
+        std::vector<const Node::Stmt*> chain = {stmts.at(i)};
+        while(i + 1 < stmts.size()){
+            const Node::Stmt* next = stmts.at(i + 1);
+            if(!std::holds_alternative<Node::Elif*>(next->stmt) && !std::holds_alternative<Node::Else*>(next->stmt))
+                break;
+
+            chain.emplace_back(next);
+            i++;
+            if(std::holds_alternative<Node::Else*>(next->stmt))
+                break;
+        }
+
+        GenIfChain(chain);
+    }
+
+    if(upper_dirty){
+        Emit(Asm::Op::vzeroupper);
+        upper_dirty = false;
+    }
 }
-//            gen.code.text << "cmp " << gen.bit << "8, 0" << '\n';
-//            gen.code.text << "je " << gen.labels.getCurrentLabel(false) << '\n';
-//            gen.code.text << "cmp " << gen.bit << "9, 0" << '\n';
-//            gen.code.text << "je " << gen.labels.getCurrentLabel(false) << '\n';
-//            gen.code.text << "jmp " << gen.labels.getBoolLabel(false) << '\n';
-//
-//            gen.code.text << gen.labels.getBoolLabel() << ":\n";
-//            gen.code.text << "mov " << gen.bit << "ax, 1\n";
-//            gen.code.text << "jmp " << gen.labels.getLastLabel(false) << '\n';
-//            gen.labels.addBoolLabel();
-//        }
-//
-//        void operator()(const Node::BoolExprOr* expr){
-//            if(std::holds_alternative<Node::BoolTerm*>(expr->lhs))
-//                gen.GenBoolTerm(std::get<Node::BoolTerm*>(expr->lhs), gen.bit + "8");
-//            else
-//                gen.GenBoolExpr(std::get<Node::BoolExpr*>(expr->lhs), gen.bit + "8");
-//
-//            if(std::holds_alternative<Node::BoolTerm*>(expr->rhs))
-//                gen.GenBoolTerm(std::get<Node::BoolTerm*>(expr->rhs), gen.bit + "9");
-//            else
-//                gen.GenBoolExpr(std::get<Node::BoolExpr*>(expr->rhs), gen.bit + "9");
-//
-//            gen.code.text << "cmp " << gen.bit << "8, 1" << '\n';
-//            gen.code.text << "je " << gen.labels.getBoolLabel(false) << '\n';
-//            gen.code.text << "cmp " << gen.bit << "9, 1" << '\n';
-//            gen.code.text << "je " << gen.labels.getBoolLabel(false) << '\n';
-//            gen.code.text << "jmp " << gen.labels.getCurrentLabel(false) << '\n';
-//
-//            gen.code.text << gen.labels.getBoolLabel() << ":\n";
-//            gen.code.text << "mov " << gen.bit << "ax, 1\n";
-//            gen.code.text << "jmp " << gen.labels.getLastLabel(false) << '\n';
-//            gen.labels.addBoolLabel();
-//        }
-//    };
-//
-//    BoolExprVisitor visitor(*this);
-//    std::visit(visitor, expr->expr);
-//
-//    if(continue_last_label) {
-//        code.text << labels.getLastLabel() << ":\n";
-//        labels.addCurrentLabel();
-//    }
-//
-//    if(reg != bit + "ax")
-//        code.text << "mov " << reg << ", " << bit << "ax\n";
-//}
 
 void Generator::Generate(const Node::Stmt* stmt) {
 
     struct ProgVisitor {
         Generator& gen;
-        ProgVisitor(Generator& generator) : gen(generator) {}
+        size_t line;
+        ProgVisitor(Generator& generator, size_t stmt_line) : gen(generator), line(stmt_line) {}
 
         void operator()(const Node::Exit* stmt){
-            gen.GenExpr(stmt->expr, gen.bit + "ax");
+            gen.GenExpr(stmt->expr, gen.Reg(Asm::Reg::rax));
             if(gen.storage.GetStackSize() > 0){
-                gen.code.text << "add " << gen.bit << "sp, " << gen.storage.GetStackSize() << '\n';
+                gen.Emit(Asm::Op::add, gen.Reg(Asm::Reg::rsp), Asm::Imm(static_cast<int64_t>(gen.storage.GetStackSize())));
+            }
+            if(gen.profiling == Profiling::generate){
+                gen.Emit(Asm::Op::push, gen.Reg(Asm::Reg::rax));
+                gen.Emit(Asm::Op::call, Asm::Label("__gx_profile_dump"));
+                gen.Emit(Asm::Op::pop, gen.Reg(Asm::Reg::rax));
+            }
+
+            // the jit gets the exit code back as the return value instead of the process ending
+            if(gen.entry == Entry::call){
+                gen.Emit(Asm::Op::ret);
+                return;
             }
 
             switch(gen.target) {
                 case PLATFORM_WIN32:
                 case PLATFORM_WIN64:
-                    gen.code.text << "ret\n";
+                    gen.Emit(Asm::Op::ret);
                     break;
                 case PLATFORM_LINUX32:
                 case PLATFORM_LINUX64:
-                    gen.code.text << "mov " << gen.bit << "di, " << gen.bit << "ax\n";
-                    gen.code.text << "mov " <<  gen.bit << "ax, 60\n";
-                    gen.code.text << "syscall\n";
+                    gen.Emit(Asm::Op::mov, gen.Reg(Asm::Reg::rdi), gen.Reg(Asm::Reg::rax));
+                    gen.Emit(Asm::Op::mov, gen.Reg(Asm::Reg::rax), Asm::Imm(60));
+                    gen.Emit(Asm::Op::syscall);
                     break;
             }
         }
@@ -316,227 +999,471 @@ void Generator::Generate(const Node::Stmt* stmt) {
         }
 
         void operator()(const Node::Variable* stmt){
-            gen.storage.StoreVariable(stmt->ident->value, gen.isExprInit(stmt->expr), stmt->type);
+            if(stmt->length != 0){
+                gen.GenArray(stmt);
+                return;
+            }
 
+            int64_t slot;
             switch(stmt->type){
                 case VarType::_char:
-                    gen.GenExpr(std::get<Node::IntExpr*>(stmt->expr->expr), "al");
-                    gen.code.text << "sub " << gen.bit << "sp, 8\n";
-                    gen.code.text << "mov [" << gen.bit << "sp], al\n";
+                case VarType::_uchar:
+                case VarType::_bool:
+                    slot = 8;
                     break;
                 case VarType::_short:
-                    gen.GenExpr(std::get<Node::IntExpr*>(stmt->expr->expr), "ax");
-                    gen.code.text << "sub " << gen.bit << "sp, 16\n";
-                    gen.code.text << "mov [" << gen.bit << "sp], ax\n";
+                case VarType::_ushort:
+                    slot = 16;
                     break;
                 case VarType::_int:
-                    gen.GenExpr(std::get<Node::IntExpr*>(stmt->expr->expr), "eax");
-                    gen.code.text << "sub " << gen.bit << "sp, 32\n";
-                    gen.code.text << "mov [" << gen.bit << "sp], eax\n";
+                case VarType::_uint:
+                    slot = 32;
                     break;
                 case VarType::_long:
-                    if(gen.bit != "r"){
-                        Log::Error("You cant have an long/int64 in a 32-bit program");
+                case VarType::_ulong:
+                    if(gen.word != 8){
+                        Log::Error("You cant have an long/int64/uint64 in a 32-bit program");
                         exit(1);
                     }
-                    gen.GenExpr(std::get<Node::IntExpr*>(stmt->expr->expr), "rax");
-                    gen.code.text << "sub rsp, 64\n";
-                    gen.code.text << "mov [rsp], rax\n";
-                    break;
-                case VarType::_bool:
-                    gen.GenBoolExpr(std::get<Node::BoolExpr*>(stmt->expr->expr), gen.bit + "ax");
-                    gen.code.text << "sub " << gen.bit << "sp, 8\n";
-                    gen.code.text << "mov [" << gen.bit << "sp], " << gen.bit << "ax\n";
+                    slot = 64;
                     break;
             }
+
+            // the value is calculated before the variable exists so the stack positions of the expression stay correct
+            bool init = gen.isExprInit(stmt->expr);
+            if(init && stmt->type == VarType::_bool)
+                gen.GenBoolExpr(std::get<Node::BoolExpr*>(stmt->expr->expr), gen.Reg(Asm::Reg::rax));
+            else if(init)
+                gen.GenExpr(std::get<Node::IntExpr*>(stmt->expr->expr), gen.Reg(Asm::Reg::rax));
+
+            // a variable of a pack goes in the block of its side, the first one declared makes room for all of them
+            auto packed = gen.vectors.slots.find(stmt);
+            if(packed != gen.vectors.slots.end()){
+                const Vectorizer::Slot& place = packed->second;
+                uint64_t size = 0;
+                if(place.first){
+                    size = (place.width * place.lanes + 15) / 16 * 16 + gen.GetPadding();
+                    gen.Emit(Asm::Op::sub, gen.Reg(Asm::Reg::rsp), Asm::Imm(static_cast<int64_t>(size)));
+                }
+                gen.storage.StorePacked(stmt->ident->value, init, stmt->type, size, place.lane * place.width);
+            }
+            else{
+                gen.storage.StoreVariable(stmt->ident->value, init, stmt->type);
+                gen.Emit(Asm::Op::sub, gen.Reg(Asm::Reg::rsp), Asm::Imm(slot));
+            }
+            // only the bytes of the type are stored, loading them sign extends them back to the word
+            if(init)
+                gen.Emit(Asm::Op::mov, gen.Stack(gen.storage.GetStackPosition(stmt->ident->value)),
+                         Asm::R(Asm::Reg::rax, gen.GetWidth(stmt->type)));
         }
 
         void operator()(const Node::Reassign* stmt){
-            gen.GenExpr(stmt->expr, gen.bit + "ax");
+            gen.GenExpr(stmt->expr, gen.Reg(Asm::Reg::rax));
 
             uint64_t pos = gen.storage.GetStackPosition(stmt->ident->value);
-            gen.code.text << "mov [" << gen.bit << "sp + " << pos << "], " << gen.bit << "ax\n";
+            uint8_t width = gen.GetWidth(gen.storage.GetType(stmt->ident->value));
+            gen.Emit(Asm::Op::mov, gen.Stack(pos), Asm::R(Asm::Reg::rax, width));
         }
 
-        void operator()(const Node::Scope* stmt){
-            gen.storage.CreateScope();
+        void operator()(const Node::IndexAssign* stmt){
+            Asm::Operand rax = gen.Reg(Asm::Reg::rax);
+            gen.GenExpr(stmt->expr, rax);
 
-            for(Node::Stmt* stmts : stmt->stmts)
-                gen.Generate(stmts);
+            // a literal or a variable index is found without touching rax, others need the value saved
+            int64_t literal;
+            bool simple = Node::GetLiteral(stmt->index, literal) || Node::GetIdent(stmt->index);
+            if(!simple){
+                gen.Emit(Asm::Op::push, rax);
+                gen.pushed += gen.word;
+            }
+            Asm::Operand element = gen.GenElement(stmt->ident, stmt->index, gen.Reg(Asm::Reg::rcx));
+            if(!simple){
+                gen.Emit(Asm::Op::pop, rax);
+                gen.pushed -= gen.word;
+                if(element.reg == Asm::Reg::rsp)
+                    element.value -= gen.word;
+            }
+            gen.Emit(Asm::Op::mov, element, Asm::R(Asm::Reg::rax, element.size));
+        }
 
-            uint64_t scope_size = gen.storage.EndScope();
-            if(scope_size > 0)
-                gen.code.text << "add " << gen.bit << "sp, " << scope_size << '\n';
+        void operator()(const Node::Scope* stmt){
+            gen.GenScope(stmt);
         }
 
+        // the imported module is generated on its own and put before this program
+        void operator()(const Node::Import* stmt){}
+
         void operator()(const Node::Assembly* stmt){
             switch(stmt->section){
                 case Node::Asm_Section::external:
-                    gen.code.external << "extern " << stmt->code->value << '\n';
+                    gen.module.externs.emplace_back(stmt->code->value);
                     break;
-                case Node::Asm_Section::text:
-                    gen.code.text << stmt->code->value << '\n';
+                case Node::Asm_Section::text: {
+                    Asm::Instr instr{Asm::Op::raw};
+                    instr.text = stmt->code->value;
+                    gen.module.text.emplace_back(instr);
                     break;
+                }
                 case Node::Asm_Section::data:
-                    gen.code.data << stmt->code->value << '\n';
+                    gen.module.data.emplace_back(stmt->code->value);
                     break;
                 case Node::Asm_Section::bss:
-                    gen.code.bbs << stmt->code->value << '\n';
+                    gen.module.bss.emplace_back(stmt->code->value);
                     break;
             }
         }
 
         void operator()(const Node::If* stmt) {
-            if (gen.isNextNodeIfChain()) {
-                gen.GenBoolExpr(stmt->expr, gen.bit + "ax");
-                gen.code.text << "cmp " << gen.bit << "ax, 0\n";
-                gen.code.text << "je " << gen.labels.getIfLabel(false) << '\n';    // if false
-                gen.code.text << "jmp " << gen.labels.getChainLabel(false) << '\n'; // if true
-
-                gen.code.text << gen.labels.getChainLabel() << ":\n";
-                gen.labels.addChainLabel();
-                uint64_t if_label_amount = gen.labels.getLabelAmount(Label::LabelType::_if);
-                gen.labels.addIfLabel();
-
-                Node::Stmt* send_stmt = new Node::Stmt();
-                send_stmt->stmt = stmt->stmt;
-                gen.Generate(send_stmt); // generates the scope
-                free(send_stmt);
-
-                gen.code.text << "if" << if_label_amount << ":\n";
-                gen.labels.setLabelAsCurrent(Label::LabelType::_if);
-                gen.labels.addIfLabel();
-
-                gen.index++;
-                gen.Generate(gen.prg->prg.at(gen.index));
-            }
-            else{
-                gen.GenBoolExpr(stmt->expr, gen.bit + "ax");
-                gen.code.text << "cmp " << gen.bit << "ax, 0\n";
-                gen.code.text << "je " << gen.labels.getCurrentLabel(false) << '\n'; // its 0/false
-                gen.code.text << "jmp " << gen.labels.getIfLabel(false) << '\n';
-
-                gen.code.text << gen.labels.getIfLabel() << ":\n";
-                gen.labels.addIfLabel();
-
-                Node::Stmt* send_stmt = new Node::Stmt();
-                send_stmt->stmt = stmt->stmt;
-                gen.Generate(send_stmt); // generates the scope
-                free(send_stmt);
+            Node::Stmt wrapped_stmt;
+            wrapped_stmt.stmt = const_cast<Node::If*>(stmt);
+            gen.GenIfChain({&wrapped_stmt});
+        }
 
-                gen.code.text << "jmp " << gen.labels.getCurrentLabel(false) << '\n';
+        void operator()(const Node::Elif* stmt) {
+            Log::Error("An if statement is required before an else if condition statement");
+            exit(1);
+        }
 
-                gen.code.text << gen.labels.getCurrentLabel() << ":\n";
-                gen.labels.addCurrentLabel();
-            }
+        void operator()(const Node::Else* stmt){
+            Log::Error("An if statement is required before an else condition statement");
+            exit(1);
         }
 
-        void operator()(const Node::Elif* stmt) {
-            if (!std::holds_alternative<Node::If*>(gen.prg->prg.at(gen.index - 1)->stmt) &&
-                !std::holds_alternative<Node::Elif*>(gen.prg->prg.at(gen.index - 1)->stmt)) {
-                Log::Error("An if statement is required before an else if condition statement");
-                exit(1);
+        void operator()(const Node::While* stmt){
+            uint32_t calculation_label = gen.labels.NewLabel(Label::LabelTypes::_loop);
+            uint32_t end_label = gen.labels.NewLabel(Label::LabelTypes::_main);
+            uint64_t entries = gen.GetCount(stmt);
+            uint64_t iterations = gen.GetCount(stmt, 1);
+            gen.CountBranch(stmt);
+
+            auto gen_test = [&](Asm::Op jump, uint32_t target){
+                gen.GenBoolExpr(stmt->expr, gen.Reg(Asm::Reg::rax));
+                gen.Emit(Asm::Op::cmp, gen.Reg(Asm::Reg::rax), Asm::Imm(0));
+                gen.Emit(jump, Asm::Local(target));
+            };
+
+            // a body that almost never runs is moved out of line, what's left of the loop is its test
+            if(stmt->scope.has_value() && gen.IsCold(iterations, entries)){
+                uint32_t body_label = gen.labels.NewLabel(Label::LabelTypes::_loop);
+                gen.EmitLabel(calculation_label);
+                gen_test(Asm::Op::jne, body_label);
+                gen.GenCold(body_label, stmt->scope.value(), calculation_label, line);
+                return;
             }
 
-            if (gen.isNextNodeIfChain()) {
-                gen.GenBoolExpr(stmt->expr, gen.bit + "ax");
-                gen.code.text << "cmp " << gen.bit << "ax, 0\n";
-                gen.code.text << "je " << gen.labels.getIfLabel(false) << '\n';    // if false
-                gen.code.text << "jmp " << gen.labels.getChainLabel(false) << '\n'; // if true
-                gen.code.text << gen.labels.getChainLabel() << ":\n";
-                gen.labels.addChainLabel();
-                uint64_t if_label_amount = gen.labels.getLabelAmount(Label::LabelType::_if);
-                gen.labels.addIfLabel();
-
-                Node::Stmt* send_stmt = new Node::Stmt();
-                send_stmt->stmt = stmt->stmt;
-                gen.Generate(send_stmt); // generates the scope
-                free(send_stmt);
-
-                gen.code.text << "if" << if_label_amount << ":\n";
-                gen.labels.setLabelAsCurrent(Label::LabelType::_if);
-                gen.labels.addIfLabel();
-
-                gen.index++;
-                gen.Generate(gen.prg->prg.at(gen.index));
-            }
-            else{
-                gen.GenBoolExpr(stmt->expr, gen.bit + "ax");
-                gen.code.text << "cmp " << gen.bit << "ax, 0\n";
-                gen.code.text << "je " << gen.labels.getMainLabel(false) << '\n'; // its 0/false
-                gen.code.text << "jmp " << gen.labels.getChainLabel(false) << '\n';
-
-                gen.code.text << gen.labels.getChainLabel() << ":\n";
-                gen.labels.addChainLabel();
-
-                Node::Stmt* send_stmt = new Node::Stmt();
-                send_stmt->stmt = stmt->stmt;
-                gen.Generate(send_stmt); // generates the scope
-                free(send_stmt);
-
-                gen.code.text << "jmp " << gen.labels.getMainLabel(false) << '\n';
-                gen.code.text << gen.labels.getMainLabel() << ":\n";
-                gen.labels.addMainLabel();
+            // a body that runs more often than the loop starts is tested at its bottom, then every run of it
+            // takes one jump instead of the jump back and the test's jump past the body
+            if(gen.profiling == Profiling::use && iterations > entries){
+                uint32_t body_label = gen.labels.NewLabel(Label::LabelTypes::_loop);
+                gen.Emit(Asm::Op::jmp, Asm::Local(calculation_label));
+                gen.EmitLabel(body_label);
+                if(stmt->scope.has_value())
+                    gen.GenScope(stmt->scope.value());
+                gen.MarkLine(line);
+                gen.EmitLabel(calculation_label);
+                gen_test(Asm::Op::jne, body_label);
+                return;
             }
+
+            gen.EmitLabel(calculation_label);
+            gen_test(Asm::Op::je, end_label);
+            gen.CountBranch(stmt, 1);
+
+            if(stmt->scope.has_value())
+                gen.GenScope(stmt->scope.value());
+
+            // going back to the condition is the loop's own code, not of the last statement in it
+            gen.MarkLine(line);
+            gen.Emit(Asm::Op::jmp, Asm::Local(calculation_label));
+            gen.EmitLabel(end_label);
         }
+    };
 
-        void operator()(const Node::Else* stmt){
-            if(!std::holds_alternative<Node::If*>(gen.prg->prg.at(gen.index - 1)->stmt) &&
-               !std::holds_alternative<Node::Elif*>(gen.prg->prg.at(gen.index - 1)->stmt)){
-                Log::Error("An if statement is required before an else condition statement");
-                exit(1);
-            }
+    MarkLine(stmt->line);
+    ProgVisitor visitor(*this, stmt->line);
+    std::visit(visitor, stmt->stmt);
+}
 
-            gen.code.text << "jmp " << gen.labels.getChainLabel(false) << '\n';
+const Asm::Module& Generator::GenerateBody() {
+    if(generated_body)
+        return module;
+    generated_body = true;
 
-            gen.code.text << gen.labels.getChainLabel() << ":\n";
-            gen.labels.addChainLabel();
+    if(bounds_checks){
+        Profiler::Scope scope("range analysis");
+        safe_indexes = RangeAnalysis().FindSafeIndexes(prg->prg);
+    }
+    // the packed instructions need 64-bit targets, the stack of 32-bit ones isn't kept 16 byte aligned
+    if(vectorize && word == 8){
+        Profiler::Scope scope("vectorize");
+        vectors = Vectorizer(level).Vectorize(prg->prg);
+    }
+    GenStmts(prg->prg);
 
-            Node::Stmt* send_stmt = new Node::Stmt();
-            send_stmt->stmt = stmt->stmt;
-            gen.Generate(send_stmt); // generates the scope
-            free(send_stmt);
+    if(storage.GetStackSize() > 0)
+        Emit(Asm::Op::add, Reg(Asm::Reg::rsp), Asm::Imm(static_cast<int64_t>(storage.GetStackSize())));
 
-            gen.code.text << "jmp " << gen.labels.getMainLabel(false) << '\n';
-            gen.code.text << gen.labels.getMainLabel() << ":\n";
-            gen.labels.addMainLabel();
-        }
+    // an index out of bounds stops the program with an invalid instruction, where it happened is in the core dump
+    if(bounds_label != NO_LABEL){
+        cold.push_back(Asm::Instr{Asm::Op::label, Asm::Local(bounds_label)});
+        cold.push_back(Asm::Instr{Asm::Op::ud2});
+    }
 
-        void operator()(const Node::While* stmt){
-            std::string calculation_label = gen.labels.getBoolLabel();
-            gen.labels.addBoolLabel();
+    // the cold branches come after the module's code in their own section, nothing runs into them
+    if(!cold.empty()){
+        Emit(Asm::Op::section, Asm::Label(Asm::COLD_SECTION));
+        auto offset = static_cast<uint32_t>(module.text.size());
+        for(const Asm::SourceLine& line : cold_lines)
+            module.lines.emplace_back(Asm::SourceLine{line.instr + offset, line.file, line.line});
+        module.text.insert(module.text.end(), std::make_move_iterator(cold.begin()), std::make_move_iterator(cold.end()));
+        cold.clear();
+        cold_lines.clear();
+    }
+
+    module.locals = labels.GetCount();
+    return module;
+}
 
-            std::string scope_label = gen.labels.getLoopLabel(false);
-            gen.labels.addLoopLabel();
+/// Where the cold code of a module's body starts, after the end of the text when it has none
+static size_t FindCold(const Asm::Module& module){
+    for(size_t i = module.text.size(); i-- > 0;){
+        const Asm::Instr& instr = module.text.at(i);
+        if(instr.op == Asm::Op::section && instr.dst.name == Asm::COLD_SECTION)
+            return i;
+    }
+    return module.text.size();
+}
+
+/// Appends the instructions from `begin` to `end` of `other` and their lines, its numbered labels are moved up
+/// by `offset` so they don't clash with the labels of other modules
+static void AppendRange(Asm::Module& module, const Asm::Module& other, size_t begin, size_t end, uint32_t offset){
+    std::vector<uint32_t> indexes;
+    for(const std::string& file : other.files){
+        auto it = std::find(module.files.begin(), module.files.end(), file);
+        indexes.emplace_back(static_cast<uint32_t>(it - module.files.begin()));
+        if(it == module.files.end())
+            module.files.emplace_back(file);
+    }
+    auto moved = static_cast<int64_t>(module.text.size()) - static_cast<int64_t>(begin);
+    for(const Asm::SourceLine& line : other.lines){
+        if(line.instr >= begin && line.instr < end)
+            module.lines.emplace_back(Asm::SourceLine{static_cast<uint32_t>(line.instr + moved), indexes.at(line.file), line.line});
+    }
+
+    module.text.reserve(module.text.size() + end - begin);
+    for(size_t i = begin; i < end; i++){
+        module.text.emplace_back(other.text.at(i));
+        for(Asm::Operand* op : {&module.text.back().dst, &module.text.back().src}){
+            if(op->kind == Asm::Operand::Kind::local)
+                op->value += static_cast<int64_t>(offset) << 2;
+        }
+    }
+}
 
-            std::string end_label = gen.labels.getLastLabel(false);
-            Label::LabelType end_label_type = gen.labels.LastLabel;
-            gen.labels.addLastLabel();
+const Asm::Module& Generator::GenerateInstructions(const std::vector<Generator*>& imports) {
+    if(generated)
+        return module;
+    generated = true;
+
+    GenerateBody();
+    Asm::Module body;
+    body.text = std::move(module.text);
+    body.lines = std::move(module.lines);
+    body.files = std::move(module.files);
+    module.text.clear();
+    module.lines.clear();
+    module.files.clear();
+
+    EmitLabel(GetEntryName());
+
+    // the hot code of every module first and their cold code after all of it
+    uint32_t locals = 0;
+    for(Generator* import : imports){
+        const Asm::Module& other = import->GenerateBody();
+        AppendRange(module, other, 0, FindCold(other), locals);
+        locals += other.locals;
+
+        for(const std::string& name : other.externs){
+            if(std::find(module.externs.begin(), module.externs.end(), name) == module.externs.end())
+                module.externs.emplace_back(name);
+        }
+        module.data.insert(module.data.end(), other.data.begin(), other.data.end());
+        module.bss.insert(module.bss.end(), other.bss.begin(), other.bss.end());
+        for(const std::string& link : import->prg_links){
+            if(std::find(prg_links.begin(), prg_links.end(), link) == prg_links.end())
+                prg_links.emplace_back(link);
+        }
+    }
 
-            gen.code.text << "jmp " << calculation_label << "\n";
+    AppendRange(module, body, 0, FindCold(body), locals);
+    uint32_t body_offset = locals;
+    locals += labels.GetCount();
+
+    if(!profile_path.empty())
+        Emit(Asm::Op::call, Asm::Label("__gx_profile_dump"));
+    // there is nothing to return to from _start, the process has to end itself
+    if(entry == Entry::start){
+        Emit(Asm::Op::mov, Reg(Asm::Reg::rdi), Asm::Imm(0));
+        Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(60));
+        Emit(Asm::Op::syscall);
+    }
+    else{
+        Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(0));
+        Emit(Asm::Op::ret);
+    }
+    // functions get a section each, so the linker can drop the ones nothing calls
+    if(!profile_path.empty()){
+        Emit(Asm::Op::section, Asm::Label(".text.__gx_profile_dump"));
+        GenProfileDump(imports);
+    }
 
-            gen.code.text << calculation_label << ":\n";
-            gen.GenBoolExpr(stmt->expr, gen.bit + "ax");
-            gen.code.text << "cmp " << gen.bit << "ax, 0\n";
-            gen.code.text << "je " << end_label << '\n';
-            gen.code.text << "jmp " << scope_label << '\n';
+    // the cold code of every module after all of the other code, without the section instructions of the modules
+    Emit(Asm::Op::section, Asm::Label(Asm::COLD_SECTION));
+    size_t cold_start = module.text.size();
+    uint32_t offset = 0;
+    for(Generator* import : imports){
+        const Asm::Module& other = import->GenerateBody();
+        AppendRange(module, other, std::min(FindCold(other) + 1, other.text.size()), other.text.size(), offset);
+        offset += other.locals;
+    }
+    AppendRange(module, body, std::min(FindCold(body) + 1, body.text.size()), body.text.size(), body_offset);
+    if(module.text.size() == cold_start)
+        module.text.pop_back();
 
-            if(stmt->scope.has_value()){
-                auto wrapped_stmt = new Node::Stmt();
-                wrapped_stmt->stmt = stmt->scope.value();
-                gen.Generate(wrapped_stmt);
+    module.locals = locals;
+    return module;
+}
 
-                free(wrapped_stmt);
-            }
-            gen.code.text << "jmp " << calculation_label << '\n';
+size_t Generator::NumberBranches() {
+    if(!numbered){
+        numbered = true;
+        NumberBranches(prg->prg);
+    }
+    return counter_count;
+}
 
-            gen.code.text << end_label << ":\n";
-            gen.labels.setLabelAsCurrent(end_label_type);
+void Generator::NumberBranches(const std::vector<Node::Stmt*>& stmts) {
+    // an if counts how often its chain runs and how often it's taken, a while how often it starts and its body runs
+    for(const Node::Stmt* stmt : stmts){
+        if(auto node = std::get_if<Node::If*>(&stmt->stmt)){
+            branches[*node] = static_cast<uint32_t>(counter_count);
+            counter_count += 2;
+            NumberBranches((*node)->stmt->stmts);
+        }
+        else if(auto node = std::get_if<Node::Elif*>(&stmt->stmt)){
+            branches[*node] = static_cast<uint32_t>(counter_count++);
+            NumberBranches((*node)->stmt->stmts);
+        }
+        else if(auto node = std::get_if<Node::Else*>(&stmt->stmt)){
+            branches[*node] = static_cast<uint32_t>(counter_count++);
+            NumberBranches((*node)->stmt->stmts);
         }
+        else if(auto node = std::get_if<Node::While*>(&stmt->stmt)){
+            branches[*node] = static_cast<uint32_t>(counter_count);
+            counter_count += 2;
+            if((*node)->scope.has_value())
+                NumberBranches((*node)->scope.value()->stmts);
+        }
+        else if(auto node = std::get_if<Node::Scope*>(&stmt->stmt))
+            NumberBranches((*node)->stmts);
+    }
+}
+
+void Generator::EnableProfileGenerate(uint32_t index) {
+    NumberBranches();
+    profiling = Profiling::generate;
+    profile_index = index;
+}
+
+void Generator::EnableProfileUse(std::vector<uint64_t> counts) {
+    NumberBranches();
+    profiling = Profiling::use;
+    profile_counts = std::move(counts);
+}
+
+void Generator::SetProfileOutput(const std::string& path, uint64_t hash) {
+    profile_path = path;
+    profile_hash = hash;
+}
+
+void Generator::CountBranch(const void* node, uint32_t counter) {
+    if(profiling != Profiling::generate)
+        return;
+    // add instead of inc, it doesn't wait on the flags of the code before it
+    Asm::Operand count = Asm::Mem(Asm::Reg::rax, 8 * static_cast<int64_t>(branches.at(node) + counter), 8);
+    count.base = false;
+    count.rip = true;
+    count.name = GetCountersName(profile_index);
+    Emit(Asm::Op::add, count, Asm::Imm(1));
+}
+
+uint64_t Generator::GetCount(const void* node, uint32_t counter) {
+    if(profiling != Profiling::use)
+        return 0;
+    return profile_counts.at(branches.at(node) + counter);
+}
+
+void Generator::GenProfileDump(const std::vector<Generator*>& imports) {
+    std::vector<const Generator*> generators(imports.begin(), imports.end());
+    generators.emplace_back(this);
+    size_t total = 0;
+    for(const Generator* generator : generators)
+        total += generator->counter_count;
+
+    auto address = [](const std::string& name){
+        Asm::Operand op = Asm::Mem(Asm::Reg::rax, 0);
+        op.base = false;
+        op.rip = true;
+        op.name = name;
+        return op;
     };
 
-    ProgVisitor visitor(*this);
-    std::visit(visitor, stmt->stmt);
+    // open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644), one write of the header and every counter, close
+    EmitLabel("__gx_profile_dump");
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(2));
+    Emit(Asm::Op::lea, Reg(Asm::Reg::rdi), address("__gx_profile_path"));
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rsi), Asm::Imm(01 | 0100 | 01000));
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rdx), Asm::Imm(0644));
+    Emit(Asm::Op::syscall);
+    Emit(Asm::Op::cmp, Reg(Asm::Reg::rax), Asm::Imm(0));
+    Emit(Asm::Op::jl, Asm::Label("__gx_profile_done"));
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rdi), Reg(Asm::Reg::rax));
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(1));
+    Emit(Asm::Op::lea, Reg(Asm::Reg::rsi), address("__gx_profile"));
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rdx), Asm::Imm(static_cast<int64_t>(8 * (3 + total))));
+    Emit(Asm::Op::syscall);
+    Emit(Asm::Op::mov, Reg(Asm::Reg::rax), Asm::Imm(3));
+    Emit(Asm::Op::syscall);
+    EmitLabel("__gx_profile_done");
+    Emit(Asm::Op::ret);
+
+    // the header and the counters of the modules in order are one block, the layout of the profile file
+    std::stringstream header;
+    header << "__gx_profile: dq 0x" << std::hex << Profile::magic << ", 0x" << profile_hash << std::dec << ", " << total;
+    module.data.emplace_back("align 8");
+    module.data.emplace_back(header.str());
+    for(const Generator* generator : generators){
+        for(size_t i = 0; i < generator->counter_count; i += 16){
+            std::string line = i == 0 ? GetCountersName(generator->profile_index) + ": dq 0" : "dq 0";
+            for(size_t j = i + 1; j < std::min(i + 16, generator->counter_count); j++)
+                line += ", 0";
+            module.data.emplace_back(line);
+        }
+    }
+    // as numbers, a quote in the path can't end the string early
+    std::string path = "__gx_profile_path: db ";
+    for(unsigned char c : profile_path)
+        path += std::to_string(c) + ", ";
+    module.data.emplace_back(path + "0");
+}
+
+const OutputBuffer& Generator::GenerateCode() {
+    GenerateInstructions();
+    Profiler::Scope scope("emit assembly");
+
+    code.Clear();
+    Asm::WriteModule(code, module);
+    return code;
 }
 
 std::vector<std::string> Generator::GetLinkPrograms() {
@@ -545,4 +1472,4 @@ std::vector<std::string> Generator::GetLinkPrograms() {
 
 bool Generator::isExprInit(const Node::Expr *expr) {
     return expr != NULL;
-}
\ No newline at end of file
+}
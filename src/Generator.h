@@ -8,79 +8,204 @@
 #include "Log.h"
 #include "Storage.h"
 #include "Labels.h"
+#include "Instruction.h"
+#include "Profile.h"
+#include "RangeAnalysis.h"
+#include "Vectorizer.h"
 
 class Generator{
 public:
-    inline Generator(Node::Program* p, const int t) : prg(p), target(t) {
+    /// How the program is started and how `exit` ends it
+    enum class Entry : uint8_t {
+        main,  // main is called by the C runtime
+        start, // --freestanding, _start without a C runtime
+        call   // main is called in-process by the jit, exit returns the code
+    };
+    /// What the counters of the branches are used for
+    enum class Profiling : uint8_t {
+        none,
+        generate, // -fprofile-generate, the program counts how often every branch runs
+        use       // -fprofile-use, the branches are laid out by the counts of a profile
+    };
+
+    inline Generator(Node::Program* p, const int t, const Entry e = Entry::main) : prg(p), target(t), entry(e) {
         switch(target){
             case PLATFORM_LINUX32:
             case PLATFORM_WIN32:
-                bit = 'e';
+                word = 4;
                 break;
             case PLATFORM_WIN64:
             case PLATFORM_LINUX64:
-                bit = 'r';
+                word = 8;
                 break;
         }
 
-        code.data << "section .data\n";
-        code.bbs << "section .bss\n";
-        code.text << "section .text\n";
-
         /// TEMPORARY
-        code.text << "global main\n";
-        code.text << "main:\n";
+        module.globals.emplace_back(GetEntryName());
     }
 
     std::vector<std::string> GetLinkPrograms();
-    inline std::string GenerateCode() {
-        for(index = 0; index <= prg->prg.size() - 1; index++)
-            Generate(prg->prg.at(index));
-
-        code.text << "add " << bit << "sp, " << storage.GetStackSize() << '\n';
-        code.text << "mov " << bit << "ax, 0\n";
-        code.text << "ret\n";
-
-        return code.external.str() + code.data.str() + code.bbs.str() + code.text.str();
-    };
+    /// -g, remembers which line of `file` every statement's code came from
+    inline void EnableLineInfo(const std::string& file){ module.files = {file}; }
+    /// Numbers every if, else if, else and while in the order they are written, returns how many counters they have
+    size_t NumberBranches();
+    /// -fprofile-generate, the counters are at `__gx_profile_<index>`, `index` is the module's place in the program
+    void EnableProfileGenerate(uint32_t index);
+    /// -fprofile-use, `counts` are the counters in the order NumberBranches numbered them
+    void EnableProfileUse(std::vector<uint64_t> counts);
+    /// The program writes the counters of every module to `path` when it ends, only for the generator of the program
+    void SetProfileOutput(const std::string& path, uint64_t hash);
+    /// -march, the instructions above the level are never used
+    inline void SetLevel(Asm::Level l){ level = l; }
+    /// -fbounds-check, an index of an array that isn't surely in bounds is checked when the program runs
+    inline void SetBoundsChecks(bool checks){ bounds_checks = checks; }
+    /// -fno-slp-vectorize turns it off, statements doing the same to variables next to each other become packed instructions
+    inline void SetVectorize(bool enable){ vectorize = enable; }
+    /// The module's place in the program, the names of its arrays in the bss have it
+    inline void SetModuleIndex(uint32_t index){ module_index = index; }
+    /// Freestanding programs start at _start without a C runtime calling main
+    inline std::string GetEntryName(){ return entry == Entry::start ? "_start" : "main"; }
+    /// The program as nasm assembly text, valid until the generator is gone
+    const OutputBuffer& GenerateCode();
+    /// The program as an instruction stream, used for encoding it without nasm.
+    /// The bodies of `imports` run first in their order, each module keeps its variables to itself
+    const Asm::Module& GenerateInstructions(const std::vector<Generator*>& imports = {});
+    /// Only the statements of the program without the entry label and the end of the program, for importing it
+    const Asm::Module& GenerateBody();
 
 private:
 
-    struct AsmStructure{
-        std::stringstream external;
-        std::stringstream data;
-        std::stringstream bbs;
-        std::stringstream text;
-    };
-
-    void GenTerm(const Node::Term* term, const std::string reg);
-    void GenExpr(const Node::IntExpr* expr, const std::string reg);
+    void GenTerm(const Node::Term* term, const Asm::Operand& reg);
+    /// Loads the variable into `reg`, a variable narrower than `reg` is sign extended with movsx or zero extended
+    /// when it is unsigned
+    void GenLoad(const std::string& ident, const Asm::Operand& reg);
+    void GenLoad(Asm::Operand mem, VarType type, const Asm::Operand& reg);
+    /// Calculates the index into `reg` and returns the element of the array, the base of one in the bss is in rdx
+    Asm::Operand GenElement(const Node::Ident* ident, const Node::IntExpr* index, const Asm::Operand& reg);
+    /// Declares the array in the bss outside of scopes, otherwise on the stack with its first element 16 byte aligned
+    void GenArray(const Node::Variable* stmt);
+    /// The statements of the pack as packed instructions in xmm0 or ymm0, false when the variables of a side aren't next
+    /// to each other in a 16 byte aligned block on the stack, then the statements are generated one by one
+    bool GenPack(const Vectorizer::Pack& pack, size_t line);
+    /// The literals of a side of a pack in the data, every vector once
+    Asm::Operand GetVectorConstant(const Vectorizer::Side& side, uint8_t width);
+    /// Counts the bits of the argument in rax with the instructions of the level or the baseline ones
+    void GenBuiltin(const Node::TermBuiltin* builtin);
+    void GenExpr(const Node::IntExpr* expr, const Asm::Operand& reg);
     void GenBinExpr(const Node::BinExpr* expr);
-    void GenBoolExpr(const Node::BoolExpr* expr, const std::string reg, const bool continue_last_label = true);
-    void GenBoolTerm(const Node::BoolTerm* term, const std::string reg);
+    void GenBinOperands(const Node::IntExpr* lhs, const Node::IntExpr* rhs);
+    void GenBinOperands(const Node::IntExpr* lhs, const Node::Term* rhs);
+    /// `&`, `|` and `^`, with the literal side as an immediate and `a & ~b` as andn from x86-64-v3
+    void GenBitwise(Asm::Op op, const Node::IntExpr* lhs, const Node::IntExpr* rhs);
+    /// `<<` and `>>`, a literal count is an immediate and a variable one uses shlx and sarx from x86-64-v3
+    void GenShift(Asm::Op op, const Node::IntExpr* lhs, const Node::IntExpr* rhs);
+    /// `*`, a power of two is a shift and another literal the three operand imul, which leaves rdx alone
+    void GenMul(const Node::IntExpr* lhs, const Node::IntExpr* rhs);
+    /// `/` and `%` with the signed idiv, in 32 bits when both sides surely fit in them
+    void GenDiv(const Node::IntExpr* lhs, const Node::IntExpr* rhs, bool mod);
+    /// `/` and `%` of unsigned numbers, a literal divisor is a shift, a mask or a multiply by its reciprocal
+    void GenUnsignedDiv(const Node::IntExpr* lhs, const Node::IntExpr* rhs, bool mod);
+    /// Whether the value of `expr` is surely in the signed range of `bytes` bytes, or the unsigned one
+    bool FitsIn(const Node::IntExpr* expr, uint8_t bytes, bool is_unsigned = false);
+    void GenBoolExpr(const Node::BoolExpr* expr, const Asm::Operand& reg);
+    void GenBoolTerm(const Node::BoolTerm* term, const Asm::Operand& reg);
     bool isExprInit(const Node::Expr* expr);
     void Generate(const Node::Stmt* stmt);
-    inline bool isNextNodeIfChain() {
-        if (isLastNode()) {
-            return false;
-        }
-        if (!std::holds_alternative<Node::Elif*>(prg->prg.at(index + 1)->stmt) &&
-            !std::holds_alternative<Node::Else*>(prg->prg.at(index + 1)->stmt)) {
-            return false;
+    void GenStmts(const std::vector<Node::Stmt*>& stmts);
+    void GenScope(const Node::Scope* scope);
+    void GenIfChain(const std::vector<const Node::Stmt*>& chain);
+    /// Emits `label`, the scope and a jump to `back` and moves them out of line, where only a jump to `label` reaches them
+    void GenCold(uint32_t label, const Node::Scope* scope, uint32_t back, size_t line = 0);
+
+    void NumberBranches(const std::vector<Node::Stmt*>& stmts);
+    /// Counts that the branch of `node` ran, `counter` is which of its counters
+    void CountBranch(const void* node, uint32_t counter = 0);
+    /// How often the branch of `node` ran in the profile, 0 without one
+    uint64_t GetCount(const void* node, uint32_t counter = 0);
+    /// A branch that ran in less than a tenth of the `runs` of the code around it
+    inline bool IsCold(uint64_t count, uint64_t runs){
+        return profiling == Profiling::use && runs > 0 && count * 10 < runs;
+    }
+    /// `__gx_profile_dump`, writes the counters of the whole program to the profile, the program calls it when it ends
+    void GenProfileDump(const std::vector<Generator*>& imports);
+    inline std::string GetCountersName(uint32_t index){ return "__gx_profile_" + std::to_string(index); }
+
+    inline void Emit(Asm::Op op, const Asm::Operand& dst = {}, const Asm::Operand& src = {}, const Asm::Operand& src2 = {}){
+        module.text.emplace_back(Asm::Instr{op, dst, src, src2});
+    }
+    /// The code emitted from here on is of `line`, nothing is recorded without -g or for statements without a line
+    inline void MarkLine(size_t line){
+        if(module.files.empty() || line == 0)
+            return;
+        auto instr = static_cast<uint32_t>(module.text.size());
+        if(!module.lines.empty() && module.lines.back().instr == instr)
+            module.lines.pop_back();
+        if(module.lines.empty() || module.lines.back().line != line)
+            module.lines.emplace_back(Asm::SourceLine{instr, 0, static_cast<uint32_t>(line)});
+    }
+    inline void EmitLabel(const std::string& label){
+        Emit(Asm::Op::label, Asm::Label(label));
+    }
+    inline void EmitLabel(uint32_t label){
+        Emit(Asm::Op::label, Asm::Local(label));
+    }
+    /// The register in the word size of the target, rax or eax
+    inline Asm::Operand Reg(Asm::Reg reg){
+        return Asm::R(reg, word);
+    }
+    /// The bytes of a variable of `type` that are stored, a bool is stored as a whole word
+    inline uint8_t GetWidth(VarType type){
+        switch(type){
+            case VarType::_char: case VarType::_uchar: return 1;
+            case VarType::_short: case VarType::_ushort: return 2;
+            case VarType::_int: case VarType::_uint: return 4;
+            case VarType::_long: case VarType::_ulong: return 8;
+            case VarType::_bool: break;
         }
-        return true;
+        return word;
+    }
+    /// The bytes to make room for on the stack so the next variable starts 16 byte aligned. main is called with the
+    /// return address making the stack 8 off and _start starts it aligned
+    inline uint64_t GetPadding(){
+        uint64_t misalign = entry == Entry::start ? 0 : word;
+        return (misalign + 16 - (storage.GetStackSize() + pushed) % 16) % 16;
     }
-    inline bool isLastNode() {
-        return index >= prg->prg.size() - 1;
+    inline Asm::Operand Stack(uint64_t position, uint8_t size = 0){
+        return Asm::Mem(Asm::Reg::rsp, static_cast<int64_t>(position + pushed), size);
     }
 
     Node::Program* prg;
     std::vector<std::string> prg_links;
-    AsmStructure code;
+    OutputBuffer code;
+    Asm::Module module;
     Storage storage;
     Label labels;
-    std::string bit;
+    uint8_t word;
+    uint64_t pushed = 0; // bytes of temporary values pushed on top of the variables
     int target;
+    Entry entry;
+    Asm::Level level = Asm::Level::v1;
+    bool generated = false;
+    bool generated_body = false;
 
-    uint64_t index;
-};
\ No newline at end of file
+    Profiling profiling = Profiling::none;
+    std::unordered_map<const void*, uint32_t> branches; // the first counter of every if, else if, else and while
+    size_t counter_count = 0;
+    bool numbered = false;
+    uint32_t profile_index = 0;
+    std::vector<uint64_t> profile_counts;
+    std::string profile_path; // empty unless the program writes the profile
+    uint64_t profile_hash = 0;
+    bool bounds_checks = false;
+    std::unordered_set<const Node::IntExpr*> safe_indexes; // the indexes RangeAnalysis found in bounds
+    static constexpr uint32_t NO_LABEL = UINT32_MAX;
+    uint32_t bounds_label = NO_LABEL; // where an index out of bounds jumps to, made by the first check
+    uint32_t module_index = 0;
+    std::unordered_map<std::string, std::string> arrays; // the bss symbols of the arrays outside of scopes
+    bool vectorize = true;
+    Vectorizer::Plan vectors;
+    std::unordered_map<std::string, std::string> vector_constants; // the data line of every constant and its symbol
+    bool upper_dirty = false; // ymm registers were used, vzeroupper goes before other code so SSE code stays fast
+    std::vector<Asm::Instr> cold; // the code of cold branches, put after the module's code
+    std::vector<Asm::SourceLine> cold_lines;
+};
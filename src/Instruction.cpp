@@ -0,0 +1,327 @@
+#include "Instruction.h"
+
+namespace Asm{
+    const char* RegName(Reg reg, uint8_t size){
+        static const char* vectors[2][16] = {
+                {"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                 "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"},
+                {"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+                 "ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15"},
+        };
+        if(size == 16 || size == 32)
+            return vectors[size == 32][static_cast<uint8_t>(reg)];
+
+        static const char* names[16][4] = {
+                {"al", "ax", "eax", "rax"},
+                {"cl", "cx", "ecx", "rcx"},
+                {"dl", "dx", "edx", "rdx"},
+                {"bl", "bx", "ebx", "rbx"},
+                {"spl", "sp", "esp", "rsp"},
+                {"bpl", "bp", "ebp", "rbp"},
+                {"sil", "si", "esi", "rsi"},
+                {"dil", "di", "edi", "rdi"},
+                {"r8b", "r8w", "r8d", "r8"},
+                {"r9b", "r9w", "r9d", "r9"},
+                {"r10b", "r10w", "r10d", "r10"},
+                {"r11b", "r11w", "r11d", "r11"},
+                {"r12b", "r12w", "r12d", "r12"},
+                {"r13b", "r13w", "r13d", "r13"},
+                {"r14b", "r14w", "r14d", "r14"},
+                {"r15b", "r15w", "r15d", "r15"},
+        };
+
+        int column;
+        switch(size){
+            case 1: column = 0; break;
+            case 2: column = 1; break;
+            case 4: column = 2; break;
+            default: column = 3; break;
+        }
+
+        return names[static_cast<uint8_t>(reg)][column];
+    }
+
+    Level HostLevel(){
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        // every cpu with avx2 and bmi2 also has lzcnt and movbe, the rest of x86-64-v3
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") &&
+           __builtin_cpu_supports("fma"))
+            return Level::v3;
+        if(__builtin_cpu_supports("popcnt") && __builtin_cpu_supports("sse4.2"))
+            return Level::v2;
+#endif
+        return Level::v1;
+    }
+
+    const char* LevelName(Level level){
+        switch(level){
+            case Level::v1: return "x86-64-v1";
+            case Level::v2: return "x86-64-v2";
+            case Level::v3: return "x86-64-v3";
+        }
+        return "";
+    }
+
+    std::string RegToString(Reg reg, uint8_t size){
+        return RegName(reg, size);
+    }
+
+    std::string OpToString(Op op){
+        return OpName(op);
+    }
+
+    const char* OpName(Op op){
+        switch(op){
+            case Op::mov: return "mov";
+            case Op::movzx: return "movzx";
+            case Op::movsx: return "movsx";
+            case Op::lea: return "lea";
+            case Op::add: return "add";
+            case Op::sub: return "sub";
+            case Op::_and: return "and";
+            case Op::_or: return "or";
+            case Op::_xor: return "xor";
+            case Op::cmp: return "cmp";
+            case Op::test: return "test";
+            case Op::mul: return "mul";
+            case Op::div: return "div";
+            case Op::imul: return "imul";
+            case Op::idiv: return "idiv";
+            case Op::neg: return "neg";
+            case Op::_not: return "not";
+            case Op::shl: return "shl";
+            case Op::shr: return "shr";
+            case Op::sar: return "sar";
+            case Op::bsf: return "bsf";
+            case Op::bsr: return "bsr";
+            case Op::popcnt: return "popcnt";
+            case Op::lzcnt: return "lzcnt";
+            case Op::tzcnt: return "tzcnt";
+            case Op::andn: return "andn";
+            case Op::shlx: return "shlx";
+            case Op::shrx: return "shrx";
+            case Op::sarx: return "sarx";
+            case Op::mulx: return "mulx";
+            case Op::movdqa: return "movdqa";
+            case Op::movdqu: return "movdqu";
+            case Op::paddb: return "paddb";
+            case Op::paddw: return "paddw";
+            case Op::paddd: return "paddd";
+            case Op::paddq: return "paddq";
+            case Op::psubb: return "psubb";
+            case Op::psubw: return "psubw";
+            case Op::psubd: return "psubd";
+            case Op::psubq: return "psubq";
+            case Op::pand: return "pand";
+            case Op::por: return "por";
+            case Op::pxor: return "pxor";
+            case Op::pmullw: return "pmullw";
+            case Op::pmulld: return "pmulld";
+            case Op::vzeroupper: return "vzeroupper";
+            case Op::push: return "push";
+            case Op::pop: return "pop";
+            case Op::call: return "call";
+            case Op::ret: return "ret";
+            case Op::syscall: return "syscall";
+            case Op::cqo: return "cqo";
+            case Op::cdq: return "cdq";
+            case Op::nop: return "nop";
+            case Op::ud2: return "ud2";
+            case Op::jmp: return "jmp";
+            case Op::je: return "je";
+            case Op::jne: return "jne";
+            case Op::jg: return "jg";
+            case Op::jge: return "jge";
+            case Op::jl: return "jl";
+            case Op::jle: return "jle";
+            case Op::ja: return "ja";
+            case Op::jae: return "jae";
+            case Op::jb: return "jb";
+            case Op::jbe: return "jbe";
+            case Op::label:
+            case Op::section:
+            case Op::raw:
+                return "";
+        }
+
+        return "";
+    }
+
+    // std::string gets the same Append calls as an OutputBuffer so both share one renderer
+    struct StringSink{
+        std::string& str;
+
+        inline void Append(char c){ str += c; }
+        inline void Append(std::string_view text){ str.append(text); }
+        inline void AppendInt(int64_t value){
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            str.append(digits, static_cast<size_t>(result.ptr - digits));
+        }
+    };
+
+    template<typename Out>
+    static void WriteOperand(Out& out, const Operand& op, bool size_prefix){
+        switch(op.kind){
+            case Operand::Kind::none:
+                return;
+            case Operand::Kind::reg:
+                out.Append(RegName(op.reg, op.size));
+                return;
+            case Operand::Kind::imm:
+                out.AppendInt(op.value);
+                return;
+            case Operand::Kind::label:
+                out.Append(op.name);
+                return;
+            case Operand::Kind::local:
+                out.Append(Label::GetPrefix(static_cast<uint32_t>(op.value)));
+                out.AppendInt(Label::GetIndex(static_cast<uint32_t>(op.value)));
+                return;
+            case Operand::Kind::mem: {
+                if(size_prefix){
+                    switch(op.size){
+                        case 1: out.Append("byte "); break;
+                        case 2: out.Append("word "); break;
+                        case 4: out.Append("dword "); break;
+                        case 8: out.Append("qword "); break;
+                    }
+                }
+
+                out.Append(op.rip ? "[rel " : "[");
+                bool first = true;
+                if(op.base){
+                    out.Append(RegName(op.reg, 8));
+                    first = false;
+                }
+                if(op.scale){
+                    if(!first)
+                        out.Append(" + ");
+                    out.Append(RegName(op.index, 8));
+                    out.Append(" * ");
+                    out.AppendInt(op.scale);
+                    first = false;
+                }
+                if(!op.name.empty()){
+                    if(!first)
+                        out.Append(" + ");
+                    out.Append(op.name);
+                    first = false;
+                }
+                if(op.value != 0 || first){
+                    if(first)
+                        out.AppendInt(op.value);
+                    else{
+                        out.Append(op.value < 0 ? " - " : " + ");
+                        out.AppendInt(op.value < 0 ? -op.value : op.value);
+                    }
+                }
+                out.Append(']');
+                return;
+            }
+        }
+    }
+
+    template<typename Out>
+    static void WriteInstrTo(Out& out, const Instr& instr){
+        if(instr.op == Op::raw){
+            out.Append(instr.text);
+            return;
+        }
+        if(instr.op == Op::label){
+            WriteOperand(out, instr.dst, false);
+            out.Append(':');
+            return;
+        }
+        if(instr.op == Op::section){
+            out.Append("section ");
+            out.Append(instr.dst.name);
+            out.Append(" progbits alloc exec nowrite align=16");
+            return;
+        }
+
+        // nasm only sign extends a dword with movsxd
+        if(instr.op == Op::movsx && instr.src.size == 4)
+            out.Append("movsxd");
+        else if(IsVex(instr)){
+            out.Append('v');
+            out.Append(OpName(instr.op));
+        }
+        else
+            out.Append(OpName(instr.op));
+        if(instr.dst.kind == Operand::Kind::none)
+            return;
+
+        // nasm needs the size of a memory operand when no register operand tells it
+        bool size_prefix = instr.src.kind != Operand::Kind::reg && instr.dst.kind != Operand::Kind::reg;
+        if(instr.op == Op::movzx || instr.op == Op::movsx)
+            size_prefix = true;
+
+        out.Append(' ');
+        WriteOperand(out, instr.dst, size_prefix);
+        if(instr.src.kind != Operand::Kind::none){
+            out.Append(", ");
+            WriteOperand(out, instr.src, size_prefix);
+        }
+        if(instr.src2.kind != Operand::Kind::none){
+            out.Append(", ");
+            WriteOperand(out, instr.src2, size_prefix);
+        }
+    }
+
+    std::string InstrToString(const Instr& instr){
+        std::string str;
+        StringSink sink{str};
+        WriteInstrTo(sink, instr);
+        return str;
+    }
+
+    void WriteInstr(OutputBuffer& out, const Instr& instr){
+        WriteInstrTo(out, instr);
+    }
+
+    void WriteModule(OutputBuffer& out, const Module& module){
+        out.SetSection(OutputBuffer::Section::external);
+        for(const std::string& name : module.externs){
+            out.Append("extern ");
+            out.Append(name);
+            out.Append('\n');
+        }
+
+        out.SetSection(OutputBuffer::Section::data);
+        out.Append("section .data\n");
+        for(const std::string& line : module.data){
+            out.Append(line);
+            out.Append('\n');
+        }
+
+        out.SetSection(OutputBuffer::Section::bss);
+        out.Append("section .bss\n");
+        for(const std::string& line : module.bss){
+            out.Append(line);
+            out.Append('\n');
+        }
+
+        out.SetSection(OutputBuffer::Section::text);
+        out.Append("section .text\n");
+        for(const std::string& name : module.globals){
+            out.Append("global ");
+            out.Append(name);
+            out.Append('\n');
+        }
+        size_t next_line = 0;
+        for(size_t i = 0; i < module.text.size(); i++){
+            for(; next_line < module.lines.size() && module.lines.at(next_line).instr <= i; next_line++){
+                const SourceLine& line = module.lines.at(next_line);
+                out.Append("%line ");
+                out.AppendInt(line.line);
+                out.Append("+0 ");
+                out.Append(module.files.at(line.file));
+                out.Append('\n');
+            }
+            WriteInstrTo(out, module.text.at(i));
+            out.Append('\n');
+        }
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "PCH.h"
+#include "OutputBuffer.h"
+#include "Labels.h"
+
+/// The instruction stream the generator produces, it is either rendered as nasm text or encoded directly
+namespace Asm{
+    enum class Reg : uint8_t {
+        rax = 0, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+        r8, r9, r10, r11, r12, r13, r14, r15
+    };
+
+    enum class Op : uint8_t {
+        mov, movzx, movsx, lea,
+        add, sub, _and, _or, _xor, cmp, test,
+        mul, div, imul, idiv, neg, _not,
+        shl, shr, sar, bsf, bsr,
+        popcnt, lzcnt, tzcnt,      // popcnt from x86-64-v2, lzcnt and tzcnt from x86-64-v3
+        andn, shlx, shrx, sarx, mulx, // BMI1 and BMI2 of x86-64-v3, they take a third operand
+        // SSE2 on xmm registers, with ymm registers or a third operand they are the AVX2 forms written with a v
+        movdqa, movdqu, paddb, paddw, paddd, paddq, psubb, psubw, psubd, psubq, pand, por, pxor, pmullw,
+        pmulld,     // SSE4.1 of x86-64-v2
+        vzeroupper, // AVX of x86-64-v3, clears the upper halves of the ymm registers
+        push, pop, call, ret, syscall, cqo, cdq, nop, ud2,
+        jmp, je, jne, jg, jge, jl, jle, ja, jae, jb, jbe,
+        label,   // defines the label in `dst`
+        section, // the code that follows goes in the code section named by the label in `dst`
+        raw,     // a line of assembly written by the user with `_asm_text`
+    };
+
+    /// The x86-64 microarchitecture levels of -march, every level has the instructions of the ones below it
+    enum class Level : uint8_t {
+        v1 = 1, // the baseline every x86-64 cpu has
+        v2,     // adds popcnt and pmulld
+        v3      // adds lzcnt, tzcnt, andn, shlx, shrx, sarx, mulx and the 32 byte vectors of AVX2
+    };
+
+    /// The section of the rarely run code, the linker puts it after all the other code
+    inline constexpr const char* COLD_SECTION = ".text.cold";
+
+    struct Operand{
+        enum class Kind : uint8_t {
+            none, reg, imm, mem, label,
+            local // a label numbered by the generator, `value` is its number from Label
+        };
+
+        Kind kind = Kind::none;
+        uint8_t size = 0; // in bytes, 1, 2, 4 or 8, 16 for xmm and 32 for ymm registers, 0 when it does not matter
+        Reg reg = Reg::rax; // the register or the base of the memory operand
+        Reg index = Reg::rax;
+        uint8_t scale = 0;  // 0 when the memory operand has no index register
+        bool base = true;   // false for memory operands without a base register like [msg] or [rel msg]
+        bool rip = false;   // [rel msg]
+        int64_t value = 0;  // the immediate or the displacement of the memory operand
+        std::string name;   // the label or the symbol, for memory operands the symbol added to the displacement
+    };
+
+    struct Instr{
+        Op op;
+        Operand dst;
+        Operand src;
+        Operand src2;     // the last operand of the three operand instructions
+        std::string text; // only used by Op::raw
+    };
+
+    /// The code of `line` in `Module::files[file]` starts at the instruction `instr` and goes up to the next one
+    struct SourceLine{
+        uint32_t instr;
+        uint32_t file;
+        uint32_t line;
+    };
+
+    /// Everything the generator outputs, the extern names and the user written data and bss lines
+    struct Module{
+        std::vector<std::string> externs;
+        std::vector<std::string> globals;
+        std::vector<std::string> data;
+        std::vector<std::string> bss;
+        std::vector<Instr> text;
+        uint32_t locals = 0; // how many labels the generator numbered
+        std::vector<std::string> files; // -g, the sources the lines are in
+        std::vector<SourceLine> lines;  // in the order of the text, empty without -g
+    };
+
+    inline Operand R(Reg reg, uint8_t size){
+        Operand op;
+        op.kind = Operand::Kind::reg;
+        op.reg = reg;
+        op.size = size;
+        return op;
+    }
+
+    inline Operand Imm(int64_t value){
+        Operand op;
+        op.kind = Operand::Kind::imm;
+        op.value = value;
+        return op;
+    }
+
+    inline Operand Mem(Reg base, int64_t disp, uint8_t size = 0){
+        Operand op;
+        op.kind = Operand::Kind::mem;
+        op.reg = base;
+        op.value = disp;
+        op.size = size;
+        return op;
+    }
+
+    inline Operand Label(const std::string& name){
+        Operand op;
+        op.kind = Operand::Kind::label;
+        op.name = name;
+        return op;
+    }
+
+    inline Operand Local(uint32_t label){
+        Operand op;
+        op.kind = Operand::Kind::local;
+        op.value = label;
+        return op;
+    }
+
+    inline bool IsJump(Op op){
+        return op >= Op::jmp && op <= Op::jbe;
+    }
+
+    inline bool IsVector(Op op){
+        return op >= Op::movdqa && op <= Op::pmulld;
+    }
+
+    /// A vector instruction in its VEX form, one with ymm registers or three operands
+    inline bool IsVex(const Instr& instr){
+        return IsVector(instr.op) && (instr.src2.kind != Operand::Kind::none || instr.dst.size == 32 || instr.src.size == 32);
+    }
+
+    /// The highest level the machine the compiler runs on supports, for -march=native
+    Level HostLevel();
+    /// x86-64-v1, x86-64-v2 or x86-64-v3
+    const char* LevelName(Level level);
+
+    const char* RegName(Reg reg, uint8_t size);
+    const char* OpName(Op op);
+    std::string RegToString(Reg reg, uint8_t size);
+    std::string OpToString(Op op);
+    std::string InstrToString(const Instr& instr);
+    void WriteInstr(OutputBuffer& out, const Instr& instr);
+    /// Writes the module as a nasm file, each part into its own section of `out`. The lines of the source
+    /// are written as %line directives, nasm -g turns them into debug information
+    void WriteModule(OutputBuffer& out, const Module& module);
+}
@@ -0,0 +1,249 @@
+#include "Interpreter.h"
+
+#include <bitset>
+
+// computed goto is a GNU extension, other compilers get a switch in a loop
+#if defined(__GNUC__) || defined(__clang__)
+    #define THREADED_DISPATCH
+#endif
+
+/// The zero bits above the highest set bit or below the lowest one, 64 for 0 like lzcnt and tzcnt
+static int64_t CountZeros(uint64_t value, bool leading){
+    int64_t zeros = 0;
+    for(uint64_t bit = leading ? 1ull << 63 : 1; bit && !(value & bit); bit = leading ? bit >> 1 : bit << 1)
+        zeros++;
+    return zeros;
+}
+
+bool Interpreter::Run(const Bytecode::Program& program, int64_t& exit_code) {
+    using Bytecode::Op;
+
+    registers.assign(program.registers, 0);
+    int64_t* r = registers.data();
+    memory.assign(program.memory, 0);
+    int64_t* m = memory.data();
+    const Bytecode::Array* arrays = program.arrays.data();
+    const Bytecode::Instr* code = program.code.data();
+    const Bytecode::Instr* ip = code;
+    uint64_t count = 0;
+
+#ifdef THREADED_DISPATCH
+    // in the same order as Bytecode::Op
+    static void* const handlers[] = {
+        &&op_load_imm, &&op_move, &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_mod, &&op_udiv, &&op_umod,
+        &&op_popcount, &&op_clz, &&op_ctz,
+        &&op_bit_and, &&op_bit_or, &&op_bit_xor, &&op_bit_not, &&op_shl, &&op_sar, &&op_shr, &&op_sext, &&op_zext,
+        &&op_cmp_eq, &&op_cmp_ne, &&op_cmp_gt, &&op_cmp_ge, &&op_cmp_lt, &&op_cmp_le,
+        &&op_cmp_ugt, &&op_cmp_uge, &&op_cmp_ult, &&op_cmp_ule,
+        &&op_array_clear, &&op_array_load, &&op_array_store,
+        &&op_jump, &&op_jump_zero, &&op_jump_not_zero, &&op_exit, &&op_halt
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == static_cast<size_t>(Op::count),
+                  "every bytecode op needs a handler");
+
+    #define CASE(name) op_##name:
+    #define NEXT() count++; goto *handlers[static_cast<uint8_t>(ip->op)]
+    #define BEGIN() NEXT();
+    #define END()
+#else
+    #define CASE(name) case Op::name:
+    #define NEXT() continue
+    #define BEGIN() for(;;){ count++; switch(ip->op){
+    #define END() default: break; } }
+#endif
+
+    BEGIN()
+        CASE(load_imm)
+            r[ip->dst] = ip->imm;
+            ip++;
+            NEXT();
+        CASE(move)
+            r[ip->dst] = r[ip->lhs];
+            ip++;
+            NEXT();
+        CASE(add)
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) + static_cast<uint64_t>(r[ip->rhs]));
+            ip++;
+            NEXT();
+        CASE(sub)
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) - static_cast<uint64_t>(r[ip->rhs]));
+            ip++;
+            NEXT();
+        CASE(mul)
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) * static_cast<uint64_t>(r[ip->rhs]));
+            ip++;
+            NEXT();
+        CASE(div)
+            if(r[ip->rhs] == 0)
+                goto division_by_zero;
+            if(r[ip->lhs] == INT64_MIN && r[ip->rhs] == -1)
+                goto division_overflow;
+            r[ip->dst] = r[ip->lhs] / r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(mod)
+            if(r[ip->rhs] == 0)
+                goto division_by_zero;
+            // idiv faults on the quotient, so the remainder of it does too
+            if(r[ip->lhs] == INT64_MIN && r[ip->rhs] == -1)
+                goto division_overflow;
+            r[ip->dst] = r[ip->lhs] % r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(udiv)
+            if(r[ip->rhs] == 0)
+                goto division_by_zero;
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) / static_cast<uint64_t>(r[ip->rhs]));
+            ip++;
+            NEXT();
+        CASE(umod)
+            if(r[ip->rhs] == 0)
+                goto division_by_zero;
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) % static_cast<uint64_t>(r[ip->rhs]));
+            ip++;
+            NEXT();
+        CASE(popcount)
+            r[ip->dst] = static_cast<int64_t>(std::bitset<64>(static_cast<uint64_t>(r[ip->lhs])).count());
+            ip++;
+            NEXT();
+        CASE(clz)
+            r[ip->dst] = CountZeros(static_cast<uint64_t>(r[ip->lhs]), true);
+            ip++;
+            NEXT();
+        CASE(ctz)
+            r[ip->dst] = CountZeros(static_cast<uint64_t>(r[ip->lhs]), false);
+            ip++;
+            NEXT();
+        CASE(bit_and)
+            r[ip->dst] = r[ip->lhs] & r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(bit_or)
+            r[ip->dst] = r[ip->lhs] | r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(bit_xor)
+            r[ip->dst] = r[ip->lhs] ^ r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(bit_not)
+            r[ip->dst] = ~r[ip->lhs];
+            ip++;
+            NEXT();
+        CASE(shl)
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) << (r[ip->rhs] & 63));
+            ip++;
+            NEXT();
+        CASE(sar)
+            // the sign bits are shifted in, like the right shift of a signed number on every compiler we build with
+            r[ip->dst] = r[ip->lhs] >> (r[ip->rhs] & 63);
+            ip++;
+            NEXT();
+        CASE(shr)
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) >> (r[ip->rhs] & 63));
+            ip++;
+            NEXT();
+        CASE(sext)
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) << (64 - ip->imm)) >> (64 - ip->imm);
+            ip++;
+            NEXT();
+        CASE(zext)
+            r[ip->dst] = static_cast<int64_t>(static_cast<uint64_t>(r[ip->lhs]) & ((uint64_t{1} << ip->imm) - 1));
+            ip++;
+            NEXT();
+        CASE(cmp_eq)
+            r[ip->dst] = r[ip->lhs] == r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(cmp_ne)
+            r[ip->dst] = r[ip->lhs] != r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(cmp_gt)
+            r[ip->dst] = r[ip->lhs] > r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(cmp_ge)
+            r[ip->dst] = r[ip->lhs] >= r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(cmp_lt)
+            r[ip->dst] = r[ip->lhs] < r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(cmp_le)
+            r[ip->dst] = r[ip->lhs] <= r[ip->rhs];
+            ip++;
+            NEXT();
+        CASE(cmp_ugt)
+            r[ip->dst] = static_cast<uint64_t>(r[ip->lhs]) > static_cast<uint64_t>(r[ip->rhs]);
+            ip++;
+            NEXT();
+        CASE(cmp_uge)
+            r[ip->dst] = static_cast<uint64_t>(r[ip->lhs]) >= static_cast<uint64_t>(r[ip->rhs]);
+            ip++;
+            NEXT();
+        CASE(cmp_ult)
+            r[ip->dst] = static_cast<uint64_t>(r[ip->lhs]) < static_cast<uint64_t>(r[ip->rhs]);
+            ip++;
+            NEXT();
+        CASE(cmp_ule)
+            r[ip->dst] = static_cast<uint64_t>(r[ip->lhs]) <= static_cast<uint64_t>(r[ip->rhs]);
+            ip++;
+            NEXT();
+        CASE(array_clear)
+            std::fill_n(m + arrays[ip->imm].offset, arrays[ip->imm].length, 0);
+            ip++;
+            NEXT();
+        CASE(array_load)
+            // negative indexes are huge as unsigned numbers, one comparison checks both ends
+            if(static_cast<uint64_t>(r[ip->lhs]) >= arrays[ip->imm].length)
+                goto out_of_bounds;
+            r[ip->dst] = m[arrays[ip->imm].offset + static_cast<uint64_t>(r[ip->lhs])];
+            ip++;
+            NEXT();
+        CASE(array_store)
+            if(static_cast<uint64_t>(r[ip->rhs]) >= arrays[ip->imm].length)
+                goto out_of_bounds;
+            m[arrays[ip->imm].offset + static_cast<uint64_t>(r[ip->rhs])] = r[ip->lhs];
+            ip++;
+            NEXT();
+        CASE(jump)
+            ip = code + ip->imm;
+            NEXT();
+        CASE(jump_zero)
+            ip = r[ip->lhs] == 0 ? code + ip->imm : ip + 1;
+            NEXT();
+        CASE(jump_not_zero)
+            ip = r[ip->lhs] != 0 ? code + ip->imm : ip + 1;
+            NEXT();
+        CASE(exit)
+            exit_code = r[ip->lhs];
+            executed = count;
+            return true;
+        CASE(halt)
+            exit_code = 0;
+            executed = count;
+            return true;
+    END()
+
+#undef CASE
+#undef NEXT
+#undef BEGIN
+#undef END
+
+    division_by_zero:
+    executed = count;
+    error = "Division by zero at bytecode " + std::to_string(ip - code) + " `" + Bytecode::InstrToString(*ip) + "`";
+    return false;
+
+    out_of_bounds:
+    executed = count;
+    error = "Index out of bounds at bytecode " + std::to_string(ip - code) + " `" + Bytecode::InstrToString(*ip) + "`";
+    return false;
+
+    division_overflow:
+    executed = count;
+    error = "Division overflow at bytecode " + std::to_string(ip - code) + " `" + Bytecode::InstrToString(*ip) + "`";
+    return false;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "PCH.h"
+#include "Bytecode.h"
+
+/// Runs bytecode with threaded dispatch, every handler jumps straight to the handler of the next instruction
+class Interpreter{
+public:
+    /// Puts the exit code of the program in `exit_code`, false on a runtime error like a division by zero
+    bool Run(const Bytecode::Program& program, int64_t& exit_code);
+    inline const std::string& GetError(){ return error; }
+    /// How many instructions the last Run executed
+    inline uint64_t GetExecuted(){ return executed; }
+
+private:
+
+    std::vector<int64_t> registers;
+    std::vector<int64_t> memory; // the elements of the arrays
+    uint64_t executed = 0;
+    std::string error;
+};
@@ -0,0 +1,260 @@
+#include "Jit.h"
+#include "Log.h"
+
+#include <filesystem>
+
+#if defined(__linux__) && defined(__x86_64__)
+    #define JIT_SUPPORTED
+    #include <sys/mman.h>
+    #include <dlfcn.h>
+    #include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+/// Saves the registers the generated code uses but the caller expects to be kept, then calls main
+static const std::string ENTER_LABEL = "__jit_enter";
+
+bool Jit::Fail(const std::string& msg) {
+    error = msg;
+    return false;
+}
+
+bool Jit::SupportsHost() {
+#ifdef JIT_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef JIT_SUPPORTED
+
+static inline uint64_t AlignTo(uint64_t value, uint64_t align){
+    return (value + align - 1) / align * align;
+}
+
+bool Jit::LoadLibraries(const std::vector<std::string>& links) {
+    for(const std::string& link : links){
+        // libc is already loaded into the compiler, and libc.so is a linker script dlopen can't read
+        if(link == "c")
+            continue;
+
+        std::string name = "lib" + link + ".so";
+        void* library = dlopen(name.c_str(), RTLD_NOW | RTLD_GLOBAL);
+        if(!library)
+            return Fail("Failed to load `" + name + "`, " + dlerror());
+        libraries.emplace_back(library);
+    }
+    return true;
+}
+
+bool Jit::Load(const ObjectCode& code) {
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+    // externs are called through a `jmp [rip]` stub next to the code because they can be further than 2GB away
+    std::vector<std::string> externs;
+    for(const ObjectCode::Symbol& symbol : code.symbols){
+        if(symbol.section != ObjectCode::Section::undefined)
+            continue;
+        void* address = dlsym(RTLD_DEFAULT, symbol.name.c_str());
+        if(!address)
+            return Fail("Extern `" + symbol.name + "` was not found, #link the library that defines it");
+        symbols[symbol.name] = reinterpret_cast<uint64_t>(address);
+        externs.emplace_back(symbol.name);
+    }
+
+    constexpr uint64_t stub_size = 16;
+    uint64_t text_end = 0;
+    text_offsets.clear();
+    for(const ObjectCode::Text& text : code.texts){
+        text_offsets.emplace_back(AlignTo(text_end, 16));
+        text_end = text_offsets.back() + text.bytes.size();
+    }
+    uint64_t stubs_offset = AlignTo(text_end, stub_size);
+    uint64_t data_offset = AlignTo(stubs_offset + externs.size() * stub_size, page);
+    uint64_t bss_offset = AlignTo(data_offset + code.data.size(), 16);
+    memory_size = AlignTo(bss_offset + code.bss_size + 1, page);
+
+    // MAP_32BIT keeps the absolute 32-bit addresses the encoder uses for labels valid
+    void* mapped = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if(mapped == MAP_FAILED){
+        memory = nullptr;
+        return Fail("Failed to map memory for the program");
+    }
+    memory = static_cast<uint8_t*>(mapped);
+    auto base = reinterpret_cast<uint64_t>(memory);
+
+    for(size_t i = 0; i < code.texts.size(); i++)
+        std::copy(code.texts.at(i).bytes.begin(), code.texts.at(i).bytes.end(), memory + text_offsets.at(i));
+    std::copy(code.data.begin(), code.data.end(), memory + data_offset);
+
+    std::unordered_map<std::string, uint64_t> stubs;
+    for(size_t i = 0; i < externs.size(); i++){
+        uint8_t* stub = memory + stubs_offset + i * stub_size;
+        const uint8_t jump[] = {0xFF, 0x25, 0, 0, 0, 0};
+        std::copy(jump, jump + sizeof(jump), stub);
+        uint64_t target = symbols.at(externs.at(i));
+        for(uint8_t b = 0; b < 8; b++)
+            stub[sizeof(jump) + b] = static_cast<uint8_t>(target >> (b * 8));
+        stubs[externs.at(i)] = reinterpret_cast<uint64_t>(stub);
+    }
+
+    // code in one of the text sections reaches the others through their names
+    for(size_t i = 0; i < code.texts.size(); i++)
+        symbols[code.texts.at(i).name] = base + text_offsets.at(i);
+    for(const ObjectCode::Symbol& symbol : code.symbols){
+        switch(symbol.section){
+            case ObjectCode::Section::text:
+                symbols[symbol.name] = base + text_offsets.at(symbol.text) + symbol.value;
+                break;
+            case ObjectCode::Section::data:
+                symbols[symbol.name] = base + data_offset + symbol.value;
+                break;
+            case ObjectCode::Section::bss:
+                symbols[symbol.name] = base + bss_offset + symbol.value;
+                break;
+            case ObjectCode::Section::undefined:
+                break;
+        }
+    }
+
+    auto relocate = [&](const std::vector<ObjectCode::Relocation>& relocs, uint64_t section_offset){
+        for(const ObjectCode::Relocation& reloc : relocs){
+            auto s = static_cast<int64_t>(symbols.at(reloc.symbol));
+            auto p = static_cast<int64_t>(base + section_offset + reloc.offset);
+            if(reloc.type == ObjectCode::RelocType::plt32 && stubs.find(reloc.symbol) != stubs.end())
+                s = static_cast<int64_t>(stubs.at(reloc.symbol));
+
+            int64_t value = s + reloc.addend;
+            uint8_t size = 4;
+            bool fits = true;
+            switch(reloc.type){
+                case ObjectCode::RelocType::abs64:
+                    size = 8;
+                    break;
+                case ObjectCode::RelocType::abs32:
+                    fits = value == static_cast<uint32_t>(value);
+                    break;
+                case ObjectCode::RelocType::abs32s:
+                    fits = value == static_cast<int32_t>(value);
+                    break;
+                case ObjectCode::RelocType::pc32:
+                case ObjectCode::RelocType::plt32:
+                    value -= p;
+                    fits = value == static_cast<int32_t>(value);
+                    break;
+            }
+            if(!fits)
+                return Fail("`" + reloc.symbol + "` is too far away from the code to be reached");
+
+            for(uint8_t b = 0; b < size; b++)
+                memory[section_offset + reloc.offset + b] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (b * 8));
+        }
+        return true;
+    };
+    for(size_t i = 0; i < code.texts.size(); i++){
+        if(!relocate(code.texts.at(i).relocs, text_offsets.at(i)))
+            return false;
+    }
+    if(!relocate(code.data_relocs, data_offset))
+        return false;
+
+    if(mprotect(memory, data_offset, PROT_READ | PROT_EXEC) != 0)
+        return Fail("Failed to make the program executable");
+    return true;
+}
+
+bool Jit::Run(const Asm::Module& module, int& exit_code) {
+    Asm::Module program = module;
+    auto reg = [](Asm::Reg r){ return Asm::R(r, 8); };
+
+    // rsp is 8 off from 16 bytes when called, 6 pushes and 8 more make the call to main aligned again
+    const Asm::Reg saved[] = {Asm::Reg::rbx, Asm::Reg::rbp, Asm::Reg::r12, Asm::Reg::r13, Asm::Reg::r14, Asm::Reg::r15};
+    program.text.push_back({Asm::Op::label, Asm::Label(ENTER_LABEL), {}});
+    for(Asm::Reg r : saved)
+        program.text.push_back({Asm::Op::push, reg(r), {}});
+    program.text.push_back({Asm::Op::sub, reg(Asm::Reg::rsp), Asm::Imm(8)});
+    program.text.push_back({Asm::Op::call, Asm::Label("main"), {}});
+    program.text.push_back({Asm::Op::add, reg(Asm::Reg::rsp), Asm::Imm(8)});
+    for(auto it = std::rbegin(saved); it != std::rend(saved); it++)
+        program.text.push_back({Asm::Op::pop, reg(*it), {}});
+    program.text.push_back({Asm::Op::ret, {}, {}});
+
+    Encoder encoder;
+    ObjectCode code;
+    if(!encoder.Encode(program, code))
+        return Fail(encoder.GetError());
+    if(!Load(code))
+        return false;
+    if(perf_map)
+        WritePerfMap(code);
+
+    auto enter = reinterpret_cast<int64_t(*)()>(symbols.at(ENTER_LABEL));
+    exit_code = static_cast<int>(enter());
+
+    // the program may have written through stdio of this process
+    fflush(stdout);
+    return true;
+}
+
+void Jit::WritePerfMap(const ObjectCode& code) {
+    // every line is its own symbol, code before the first line and after the last one is named by its label
+    struct Range{
+        uint64_t start;
+        std::string name;
+    };
+    std::vector<Range> ranges;
+    for(size_t i = 0; i < code.texts.size(); i++){
+        for(const ObjectCode::Line& line : code.texts.at(i).lines)
+            ranges.push_back({text_offsets.at(i) + line.offset,
+                              fs::path(code.files.at(line.file)).filename().string() + ":" + std::to_string(line.line)});
+    }
+    for(const ObjectCode::Symbol& symbol : code.symbols){
+        if(symbol.section == ObjectCode::Section::text)
+            ranges.push_back({text_offsets.at(symbol.text) + symbol.value, symbol.name});
+    }
+    // a line and a label at the same place is the line, the lines were added first
+    std::stable_sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b){ return a.start < b.start; });
+    ranges.erase(std::unique(ranges.begin(), ranges.end(), [](const Range& a, const Range& b){ return a.start == b.start; }),
+                 ranges.end());
+
+    std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    std::ofstream file(path);
+    auto base = reinterpret_cast<uint64_t>(memory);
+    for(size_t i = 0; i < ranges.size(); i++){
+        // the gap after a text section ends the last range in it
+        size_t text = std::upper_bound(text_offsets.begin(), text_offsets.end(), ranges.at(i).start) - text_offsets.begin() - 1;
+        uint64_t section_end = text_offsets.at(text) + code.texts.at(text).bytes.size();
+        uint64_t end = i + 1 < ranges.size() ? std::min(ranges.at(i + 1).start, section_end) : section_end;
+        if(end > ranges.at(i).start)
+            file << std::hex << base + ranges.at(i).start << ' ' << end - ranges.at(i).start << std::dec << ' '
+                 << ranges.at(i).name << '\n';
+    }
+    if(!file.good())
+        Log::Warning("Failed to write the perf map `" + path + "`");
+}
+
+void Jit::Unload() {
+    if(memory)
+        munmap(memory, memory_size);
+    memory = nullptr;
+
+    for(void* library : libraries)
+        dlclose(library);
+    libraries.clear();
+}
+
+#else
+
+bool Jit::LoadLibraries(const std::vector<std::string>&) {
+    return Fail("The jit only runs on x86-64 linux");
+}
+
+bool Jit::Run(const Asm::Module&, int&) {
+    return Fail("The jit only runs on x86-64 linux");
+}
+
+void Jit::Unload() {}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "PCH.h"
+#include "Core.h"
+#include "Instruction.h"
+#include "Encoder.h"
+
+/// Runs a program inside the compiler's own process, the code is encoded into executable memory and called directly
+class Jit{
+public:
+    inline ~Jit(){ Unload(); }
+
+    /// The jit can only run code built for the machine the compiler runs on
+    static bool SupportsHost();
+
+    /// Loads the shared libraries from #link so their functions can be found as externs
+    bool LoadLibraries(const std::vector<std::string>& links);
+    /// Runs main of the module and puts its exit code in `exit_code`, false when it could not be loaded
+    bool Run(const Asm::Module& module, int& exit_code);
+    /// -g, writes /tmp/perf-<pid>.map before the program runs so perf names its code by the source lines
+    inline void EnablePerfMap(){ perf_map = true; }
+    void Unload();
+    inline const std::string& GetError(){ return error; }
+
+private:
+
+    bool Load(const ObjectCode& code);
+    void WritePerfMap(const ObjectCode& code);
+    bool Fail(const std::string& msg);
+
+    uint8_t* memory = nullptr;
+    size_t memory_size = 0;
+    std::vector<uint64_t> text_offsets; // where every text section is in memory, one after the other
+    std::unordered_map<std::string, uint64_t> symbols;
+    std::vector<void*> libraries;
+    std::string error;
+    bool perf_map = false;
+};
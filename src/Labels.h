@@ -1,69 +1,33 @@
+#pragma once
+
 #include "PCH.h"
 
+/// Numbers the labels the generator jumps to, every type shares one counter and the type is kept in the low bits.
+/// A name is only made when a label is written as assembly text, the encoder works with the numbers
 class Label{
 public:
-    enum class LabelTypes{
+    enum class LabelTypes : uint8_t {
         _main, _bool, _if, _loop
     };
 
-    inline Label(){
-        m_LastLabels.emplace_back(LabelTypes::_main);
+    /// Returns an unused label of the type
+    inline uint32_t NewLabel(LabelTypes type){
+        return m_Labels++ << 2 | static_cast<uint32_t>(type);
     }
-
-    inline LabelTypes GetCurrentLabelType(){ return m_LastLabels.at(m_LastLabels.size() - 1); }
-    inline LabelTypes GetLastLabelType(int labels_ago = 1){ return m_LastLabels.at(m_LastLabels.size() - labels_ago - 1); }
-
-    inline std::string GetMainLabel(){ return "main" + std::to_string(m_MainLabels); }
-    inline std::string GetBoolLabel(){ return "bool" + std::to_string(m_BoolLabels); }
-    inline std::string GetIfLabel(){ return "if" + std::to_string(m_IfLabels); }
-    inline std::string GetLoopLabel(){ return "loop" + std::to_string(m_LoopLabels); }
-    inline std::string GetLabelStringByType(LabelTypes type){
-        switch(type){
-            case LabelTypes::_main:
-                return GetMainLabel();
-            case LabelTypes::_bool:
-                return GetBoolLabel();
-            case LabelTypes::_if:
-                return GetIfLabel();
-            case LabelTypes::_loop:
-                return GetLoopLabel();
-        }
+    /// How many labels were made, the index of every label is below it
+    inline uint32_t GetCount() const { return m_Labels; }
+
+    inline static uint32_t GetIndex(uint32_t label){ return label >> 2; }
+    inline static LabelTypes GetType(uint32_t label){ return static_cast<LabelTypes>(label & 3); }
+    inline static const char* GetPrefix(uint32_t label){
+        static const char* prefixes[] = {"main", "bool", "if", "loop"};
+        return prefixes[label & 3];
     }
-    inline std::string GetCurrentLabel(){
-        return GetLabelStringByType(GetCurrentLabelType());
-    }
-
-    inline void AddLabel(LabelTypes type, bool define_label = false){
-        if(define_label && m_LastLabels.at(m_LastLabels.size() - 1) != type){
-            m_LastLabels.emplace_back(type);
-        }
-
-        switch(type){
-            case LabelTypes::_main:
-                m_MainLabels++;
-                break;
-            case LabelTypes::_bool:
-                m_BoolLabels++;
-                break;
-            case LabelTypes::_if:
-                m_IfLabels++;
-                break;
-            case LabelTypes::_loop:
-                m_LoopLabels++;
-                break;
-        }
-    }
-
-    inline void EndLabel(){
-        m_LastLabels.pop_back();
+    inline static std::string GetName(uint32_t label){
+        return GetPrefix(label) + std::to_string(GetIndex(label));
     }
 
 private:
 
-    uint64_t m_MainLabels = 0;
-    uint64_t m_BoolLabels = 0;
-    uint64_t m_IfLabels = 0;
-    uint64_t m_LoopLabels = 0;
-
-    std::vector<LabelTypes> m_LastLabels;
+    uint32_t m_Labels = 0;
 };
@@ -0,0 +1,708 @@
+#include "Linker.h"
+#include "Elf.h"
+#include "Encoder.h"
+#include "Log.h"
+
+#include <sys/stat.h>
+
+static constexpr uint64_t BASE_ADDRESS = 0x400000;
+static constexpr uint64_t PAGE_SIZE = 0x1000;
+
+/// Defined by the linker itself, it points to the start of the GOT
+static const std::string GOT_SYMBOL = "_GLOBAL_OFFSET_TABLE_";
+
+static inline uint64_t AlignTo(uint64_t value, uint64_t align){
+    if(align <= 1)
+        return value;
+    return (value + align - 1) / align * align;
+}
+
+/// Reads a little endian value, false when it is out of the buffer
+template<typename T>
+static bool Read(const std::vector<uint8_t>& bytes, uint64_t offset, T& value){
+    if(offset > bytes.size() || bytes.size() - offset < sizeof(T))
+        return false;
+    value = 0;
+    for(size_t i = 0; i < sizeof(T); i++)
+        value |= static_cast<T>(static_cast<uint64_t>(bytes.at(offset + i)) << (i * 8));
+    return true;
+}
+
+static uint64_t ReadBigEndian(const std::vector<uint8_t>& bytes, uint64_t offset, uint8_t size){
+    uint64_t value = 0;
+    for(uint8_t i = 0; i < size; i++)
+        value = (value << 8) | bytes.at(offset + i);
+    return value;
+}
+
+/// DWARF of -g objects, kept like ld keeps it so the executable can be debugged and profiled by line
+static bool IsDebugSection(const std::string& name){
+    return name.compare(0, 7, ".debug_") == 0;
+}
+
+/// .text.cold of GalaxiC and gcc's .text.unlikely, gcc names the split parts of functions .text.unlikely.<name>
+static bool IsColdSection(const std::string& name){
+    return name == Asm::COLD_SECTION || name.compare(0, 14, ".text.unlikely") == 0;
+}
+
+static std::string ReadString(const std::vector<uint8_t>& bytes, uint64_t offset){
+    std::string str;
+    while(offset < bytes.size() && bytes.at(offset) != 0)
+        str += static_cast<char>(bytes.at(offset++));
+    return str;
+}
+
+static bool ReadFile(const std::string& path, std::vector<uint8_t>& bytes){
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open())
+        return false;
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool Linker::Fail(const std::string& msg) {
+    error = msg;
+    return false;
+}
+
+std::string Linker::FindArchive(const std::string& name) {
+    static const char* directories[] = {
+        ".", "/usr/local/lib", "/usr/lib/x86_64-linux-gnu", "/lib/x86_64-linux-gnu", "/usr/lib64", "/usr/lib"
+    };
+
+    for(const char* directory : directories){
+        std::string path = std::string(directory) + "/lib" + name + ".a";
+        struct stat info;
+        if(stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+            return path;
+    }
+    return "";
+}
+
+bool Linker::ParseObject(const std::vector<uint8_t>& bytes, const std::string& name, InputObject& out) {
+    out.name = name;
+
+    uint16_t type, machine, shentsize, shnum, shstrndx;
+    uint64_t shoff;
+    if(bytes.size() < Elf::HEADER_SIZE || bytes.at(0) != 0x7F || bytes.at(1) != 'E' || bytes.at(2) != 'L' ||
+       bytes.at(3) != 'F' || bytes.at(4) != 2 || bytes.at(5) != 1)
+        return Fail("`" + name + "` is not a 64-bit little endian ELF file");
+
+    Read(bytes, 16, type);
+    Read(bytes, 18, machine);
+    Read(bytes, 40, shoff);
+    Read(bytes, 58, shentsize);
+    Read(bytes, 60, shnum);
+    Read(bytes, 62, shstrndx);
+    if(type != Elf::ET_REL || machine != Elf::EM_X86_64)
+        return Fail("`" + name + "` is not an x86-64 relocatable object");
+    if(shentsize != Elf::SECTION_HEADER_SIZE || shoff + static_cast<uint64_t>(shnum) * shentsize > bytes.size())
+        return Fail("`" + name + "` has broken section headers");
+
+    std::vector<Elf::SectionHeader> headers(shnum);
+    for(uint16_t i = 0; i < shnum; i++){
+        uint64_t at = shoff + static_cast<uint64_t>(i) * shentsize;
+        Elf::SectionHeader& header = headers.at(i);
+        Read(bytes, at, header.name);
+        Read(bytes, at + 4, header.type);
+        Read(bytes, at + 8, header.flags);
+        Read(bytes, at + 16, header.addr);
+        Read(bytes, at + 24, header.offset);
+        Read(bytes, at + 32, header.size);
+        Read(bytes, at + 40, header.link);
+        Read(bytes, at + 44, header.info);
+        Read(bytes, at + 48, header.addralign);
+        Read(bytes, at + 56, header.entsize);
+
+        if(header.type != Elf::SHT_NOBITS && header.offset + header.size > bytes.size())
+            return Fail("Section " + std::to_string(i) + " of `" + name + "` is outside of the file");
+    }
+
+    uint64_t names = shstrndx < shnum ? headers.at(shstrndx).offset : 0;
+    out.sections.resize(shnum);
+    for(uint16_t i = 0; i < shnum; i++){
+        const Elf::SectionHeader& header = headers.at(i);
+        InputSection& section = out.sections.at(i);
+        section.name = ReadString(bytes, names + header.name);
+        section.type = header.type;
+        section.flags = header.flags;
+        section.align = header.addralign ? header.addralign : 1;
+        section.size = header.size;
+        if(header.type != Elf::SHT_NOBITS && ((header.flags & Elf::SHF_ALLOC) || IsDebugSection(section.name)))
+            section.data.assign(bytes.begin() + header.offset, bytes.begin() + header.offset + header.size);
+    }
+
+    for(uint16_t i = 0; i < shnum; i++){
+        const Elf::SectionHeader& header = headers.at(i);
+
+        if(header.type == Elf::SHT_SYMTAB){
+            uint64_t strings = headers.at(header.link).offset;
+            for(uint64_t at = header.offset; at + Elf::SYMBOL_SIZE <= header.offset + header.size; at += Elf::SYMBOL_SIZE){
+                InputSymbol symbol;
+                uint32_t symbol_name;
+                uint8_t info;
+                Read(bytes, at, symbol_name);
+                Read(bytes, at + 4, info);
+                Read(bytes, at + 6, symbol.section);
+                Read(bytes, at + 8, symbol.value);
+                Read(bytes, at + 16, symbol.size);
+                symbol.name = ReadString(bytes, strings + symbol_name);
+                symbol.bind = info >> 4;
+                symbol.type = info & 0xF;
+                out.symbols.emplace_back(symbol);
+            }
+        }
+        else if(header.type == Elf::SHT_RELA && header.info < shnum){
+            InputSection& target = out.sections.at(header.info);
+            for(uint64_t at = header.offset; at + Elf::RELA_SIZE <= header.offset + header.size; at += Elf::RELA_SIZE){
+                Relocation reloc;
+                uint64_t info;
+                Read(bytes, at, reloc.offset);
+                Read(bytes, at + 8, info);
+                Read(bytes, at + 16, reloc.addend);
+                reloc.type = static_cast<uint32_t>(info);
+                reloc.symbol = static_cast<uint32_t>(info >> 32);
+                target.relocs.emplace_back(reloc);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Linker::AddInput(InputObject&& object) {
+    size_t index = objects.size();
+
+    for(size_t i = 0; i < object.symbols.size(); i++){
+        const InputSymbol& symbol = object.symbols.at(i);
+        if(symbol.bind == Elf::STB_LOCAL || symbol.section == Elf::SHN_UNDEF)
+            continue;
+        if(symbol.type == Elf::STT_TLS || symbol.type == Elf::STT_GNU_IFUNC)
+            return Fail("Symbol `" + symbol.name + "` in `" + object.name + "` needs a dynamic loader");
+
+        if(symbol.section == Elf::SHN_COMMON){
+            commons[symbol.name] = std::max(commons[symbol.name], symbol.size);
+            continue;
+        }
+
+        bool weak = symbol.bind == Elf::STB_WEAK;
+        auto it = globals.find(symbol.name);
+        if(it == globals.end() || (it->second.weak && !weak))
+            globals[symbol.name] = Definition{index, i, weak};
+        else if(!it->second.weak && !weak)
+            return Fail("Symbol `" + symbol.name + "` is defined in both `" + objects.at(it->second.object).name +
+                        "` and `" + object.name + "`");
+    }
+
+    objects.emplace_back(std::move(object));
+    return true;
+}
+
+bool Linker::AddObject(const std::vector<uint8_t>& bytes, const std::string& name) {
+    InputObject object;
+    if(!ParseObject(bytes, name, object))
+        return false;
+    return AddInput(std::move(object));
+}
+
+bool Linker::AddArchive(const std::string& path) {
+    Archive archive;
+    archive.path = path;
+    if(!ReadFile(path, archive.bytes))
+        return Fail("Failed to open the archive `" + path + "`");
+
+    const std::string magic = "!<arch>\n";
+    if(archive.bytes.size() < magic.size() || std::string(archive.bytes.begin(), archive.bytes.begin() + 8) != magic)
+        return Fail("`" + path + "` is not a static archive");
+
+    // the first member is the symbol table, `/` with 32-bit or `/SYM64/` with 64-bit offsets
+    uint64_t at = magic.size();
+    if(at + 60 > archive.bytes.size())
+        return true;
+    std::string member(archive.bytes.begin() + at, archive.bytes.begin() + at + 16);
+    uint64_t size = std::stoull(std::string(archive.bytes.begin() + at + 48, archive.bytes.begin() + at + 58));
+    uint8_t width = member.rfind("/SYM64/", 0) == 0 ? 8 : member.rfind("/ ", 0) == 0 ? 4 : 0;
+    if(width == 0)
+        return Fail("`" + path + "` has no symbol index, run ranlib on it");
+
+    uint64_t table = at + 60;
+    uint64_t count = ReadBigEndian(archive.bytes, table, width);
+    uint64_t strings = table + width + count * width;
+    for(uint64_t i = 0; i < count && strings < table + size; i++){
+        std::string name = ReadString(archive.bytes, strings);
+        archive.index.emplace(name, ReadBigEndian(archive.bytes, table + width + i * width, width));
+        strings += name.size() + 1;
+    }
+
+    archives.emplace_back(std::move(archive));
+    return true;
+}
+
+/// Loads the archive members that define undefined symbols until nothing new is needed
+bool Linker::ResolveArchives() {
+    bool changed = true;
+    while(changed){
+        changed = false;
+
+        std::vector<std::string> undefined;
+        for(const InputObject& object : objects)
+            for(const InputSymbol& symbol : object.symbols)
+                if(symbol.bind == Elf::STB_GLOBAL && symbol.section == Elf::SHN_UNDEF && symbol.name != GOT_SYMBOL &&
+                   globals.find(symbol.name) == globals.end() && commons.find(symbol.name) == commons.end())
+                    undefined.emplace_back(symbol.name);
+
+        for(const std::string& name : undefined){
+            if(globals.find(name) != globals.end())
+                continue;
+
+            for(Archive& archive : archives){
+                auto it = archive.index.find(name);
+                if(it == archive.index.end())
+                    continue;
+                if(std::find(archive.loaded.begin(), archive.loaded.end(), it->second) != archive.loaded.end())
+                    continue;
+                archive.loaded.emplace_back(it->second);
+
+                uint64_t header = it->second;
+                if(header + 60 > archive.bytes.size())
+                    return Fail("Broken member offset in `" + archive.path + "`");
+                uint64_t size = std::stoull(std::string(archive.bytes.begin() + header + 48,
+                                                        archive.bytes.begin() + header + 58));
+                if(header + 60 + size > archive.bytes.size())
+                    return Fail("Broken member size in `" + archive.path + "`");
+
+                std::vector<uint8_t> member(archive.bytes.begin() + header + 60, archive.bytes.begin() + header + 60 + size);
+                InputObject object;
+                if(!ParseObject(member, archive.path + "(" + name + ")", object) || !AddInput(std::move(object)))
+                    return false;
+
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    for(const InputObject& object : objects)
+        for(const InputSymbol& symbol : object.symbols)
+            if(symbol.bind == Elf::STB_GLOBAL && symbol.section == Elf::SHN_UNDEF && symbol.name != GOT_SYMBOL &&
+               globals.find(symbol.name) == globals.end() && commons.find(symbol.name) == commons.end())
+                return Fail("Undefined symbol `" + symbol.name + "` in `" + object.name + "`");
+
+    return true;
+}
+
+/// Without a C runtime nothing calls main, so a _start that calls it and exits with its return value is added
+bool Linker::AddStartStub() {
+    if(globals.find("_start") != globals.end())
+        return true;
+    if(globals.find("main") == globals.end())
+        return Fail("There is no `main` or `_start` to start the program from");
+
+    Asm::Module stub;
+    stub.globals.emplace_back("_start");
+    stub.externs.emplace_back("main");
+    stub.text = {
+        {Asm::Op::label, Asm::Label("_start")},
+        {Asm::Op::call, Asm::Label("main")},
+        {Asm::Op::mov, Asm::R(Asm::Reg::rdi, 8), Asm::R(Asm::Reg::rax, 8)},
+        {Asm::Op::mov, Asm::R(Asm::Reg::rax, 8), Asm::Imm(60)},
+        {Asm::Op::syscall},
+    };
+
+    Encoder encoder;
+    ObjectCode code;
+    if(!encoder.Encode(stub, code))
+        return Fail(encoder.GetError());
+    return AddObject(Elf::WriteObject(code, "_start"), "_start");
+}
+
+bool Linker::CollectGarbage() {
+    removed_bytes = 0;
+    if(!gc_sections)
+        return true;
+
+    for(InputObject& object : objects)
+        for(InputSection& section : object.sections)
+            section.live = false;
+
+    std::vector<std::pair<size_t, uint16_t>> work;
+    auto mark = [&](size_t object, uint16_t index){
+        std::vector<InputSection>& object_sections = objects.at(object).sections;
+        if(index == Elf::SHN_UNDEF || index >= object_sections.size() || object_sections.at(index).live)
+            return;
+        object_sections.at(index).live = true;
+        work.emplace_back(object, index);
+    };
+    // a global is marked where it is defined, which may be another object than the one that refers to it
+    auto mark_symbol = [&](size_t object, uint32_t index){
+        const InputSymbol& symbol = objects.at(object).symbols.at(index);
+        if(symbol.bind != Elf::STB_LOCAL){
+            auto it = globals.find(symbol.name);
+            if(it != globals.end())
+                mark(it->second.object, objects.at(it->second.object).symbols.at(it->second.symbol).section);
+            return;
+        }
+        mark(object, symbol.section);
+    };
+
+    mark(globals.at("_start").object, objects.at(globals.at("_start").object).symbols.at(globals.at("_start").symbol).section);
+    for(size_t i = 0; i < objects.size(); i++){
+        for(size_t s = 0; s < objects.at(i).sections.size(); s++){
+            InputSection& section = objects.at(i).sections.at(s);
+            // the unwind tables refer to every function, they are kept without keeping the functions
+            if(!(section.flags & Elf::SHF_ALLOC) || section.name == ".eh_frame")
+                section.live = true;
+            else if(section.flags & Elf::SHF_GNU_RETAIN)
+                mark(i, static_cast<uint16_t>(s));
+        }
+    }
+
+    while(!work.empty()){
+        auto [object, index] = work.back();
+        work.pop_back();
+        for(const Relocation& reloc : objects.at(object).sections.at(index).relocs)
+            mark_symbol(object, reloc.symbol);
+    }
+
+    for(const InputObject& object : objects){
+        for(const InputSection& section : object.sections){
+            if(section.live || section.size == 0)
+                continue;
+            removed_bytes += section.size;
+            if(print_gc_sections)
+                Log::Info("Removed unused section `" + section.name + "` of `" + object.name + "`, " +
+                          std::to_string(section.size) + " bytes");
+        }
+    }
+    if(print_gc_sections)
+        Log::Info("gc-sections removed " + std::to_string(removed_bytes) + " bytes of code and data");
+    return true;
+}
+
+void Linker::Place(InputSection& section) {
+    OutputSection& output = sections[section.output];
+    output.align = std::max(output.align, section.align);
+    section.offset = AlignTo(output.size, section.align);
+    output.size = section.offset + section.size;
+    if(section.type != Elf::SHT_NOBITS){
+        output.data.resize(section.offset, section.output == out_text ? 0x90 : 0);
+        output.data.insert(output.data.end(), section.data.begin(), section.data.end());
+    }
+}
+
+bool Linker::Layout() {
+    sections[out_text] = {".text", Elf::SHT_PROGBITS, Elf::SHF_ALLOC | Elf::SHF_EXECINSTR};
+    sections[out_rodata] = {".rodata", Elf::SHT_PROGBITS, Elf::SHF_ALLOC};
+    sections[out_data] = {".data", Elf::SHT_PROGBITS, Elf::SHF_ALLOC | Elf::SHF_WRITE};
+    sections[out_bss] = {".bss", Elf::SHT_NOBITS, Elf::SHF_ALLOC | Elf::SHF_WRITE};
+
+    debug.clear();
+    std::vector<InputSection*> cold;
+    for(InputObject& object : objects){
+        for(InputSection& section : object.sections){
+            if(!(section.flags & Elf::SHF_ALLOC) && section.type == Elf::SHT_PROGBITS && IsDebugSection(section.name)){
+                auto it = std::find_if(debug.begin(), debug.end(), [&](const OutputSection& output){
+                    return output.name == section.name;
+                });
+                if(it == debug.end()){
+                    debug.push_back({section.name, Elf::SHT_PROGBITS, 0});
+                    it = debug.end() - 1;
+                }
+                // the units of every object follow each other, their offsets are relocated against the section
+                section.output = static_cast<int>(out_count + (it - debug.begin()));
+                section.offset = it->size;
+                it->size += section.size;
+                it->data.insert(it->data.end(), section.data.begin(), section.data.end());
+                continue;
+            }
+            if(!(section.flags & Elf::SHF_ALLOC))
+                continue;
+            if(section.flags & Elf::SHF_TLS)
+                return Fail("`" + object.name + "` uses thread local storage, which needs a C runtime");
+            if(section.type == Elf::SHT_INIT_ARRAY || section.type == Elf::SHT_FINI_ARRAY ||
+               section.type == Elf::SHT_PREINIT_ARRAY || section.name == ".ctors" || section.name == ".dtors")
+                return Fail("`" + object.name + "` has constructors, which need a C runtime to run them");
+
+            if(!section.live)
+                continue;
+
+            if(section.flags & Elf::SHF_EXECINSTR){
+                // rarely run code goes after all the other code, so it doesn't take room in the cache between hot code
+                if(IsColdSection(section.name)){
+                    cold.push_back(&section);
+                    continue;
+                }
+                section.output = out_text;
+            }
+            else if(section.type == Elf::SHT_NOBITS)
+                section.output = out_bss;
+            else if(section.flags & Elf::SHF_WRITE)
+                section.output = out_data;
+            else
+                section.output = out_rodata;
+            Place(section);
+        }
+    }
+    for(InputSection* section : cold){
+        section->output = out_text;
+        Place(*section);
+    }
+
+    // GOT entries hold the absolute address of their symbol, they go at the end of .data
+    for(const InputObject& object : objects){
+        for(const InputSection& section : object.sections){
+            if(section.output == -1)
+                continue;
+            for(const Relocation& reloc : section.relocs){
+                if(reloc.type != Elf::R_X86_64_GOTPCREL && reloc.type != Elf::R_X86_64_GOTPCRELX &&
+                   reloc.type != Elf::R_X86_64_REX_GOTPCRELX)
+                    continue;
+                const InputSymbol& symbol = object.symbols.at(reloc.symbol);
+                std::string key = symbol.bind == Elf::STB_LOCAL ? object.name + ":" + std::to_string(reloc.symbol) : symbol.name;
+                if(got.find(key) == got.end())
+                    got[key] = 0;
+            }
+        }
+    }
+    OutputSection& data = sections[out_data];
+    data.align = std::max<uint64_t>(data.align, 8);
+    got_offset = AlignTo(data.size, 8);
+    uint64_t got_index = 0;
+    for(auto& [name, offset] : got)
+        offset = got_offset + 8 * got_index++;
+    data.size = got_offset + 8 * got.size();
+    data.data.resize(data.size, 0);
+
+    OutputSection& bss = sections[out_bss];
+    for(const auto& [name, size] : commons){
+        if(globals.find(name) != globals.end())
+            continue;
+        bss.align = std::max<uint64_t>(bss.align, 16);
+        uint64_t offset = AlignTo(bss.size, 16);
+        common_addresses[name] = offset;
+        bss.size = offset + size;
+    }
+
+    /// The read only segment holds the headers, .text and .rodata, the writable one .data and .bss
+    uint64_t offset = Elf::HEADER_SIZE + 3 * Elf::PROGRAM_HEADER_SIZE;
+    for(uint8_t i = 0; i < out_count; i++){
+        OutputSection& section = sections[i];
+        if(i == out_data)
+            offset = AlignTo(offset, PAGE_SIZE);
+        offset = AlignTo(offset, section.align);
+        section.offset = offset;
+        section.address = BASE_ADDRESS + offset;
+        if(section.type != Elf::SHT_NOBITS)
+            offset += section.size;
+    }
+    for(OutputSection& section : debug){
+        section.offset = offset;
+        offset += section.size;
+    }
+    // .bss takes no space in the file but still needs its own addresses after .data
+    sections[out_bss].address = AlignTo(sections[out_data].address + sections[out_data].size, sections[out_bss].align);
+    sections[out_bss].offset = sections[out_bss].address - BASE_ADDRESS;
+
+    for(auto& [name, address] : common_addresses)
+        address += sections[out_bss].address;
+
+    return true;
+}
+
+uint64_t Linker::SymbolAddress(size_t object_index, uint32_t symbol_index) {
+    const InputObject& object = objects.at(object_index);
+    const InputSymbol& symbol = object.symbols.at(symbol_index);
+
+    if(symbol.bind != Elf::STB_LOCAL && symbol.section == Elf::SHN_UNDEF){
+        auto it = globals.find(symbol.name);
+        if(it != globals.end())
+            return SymbolAddress(it->second.object, static_cast<uint32_t>(it->second.symbol));
+        auto common = common_addresses.find(symbol.name);
+        if(common != common_addresses.end())
+            return common->second;
+        if(symbol.name == GOT_SYMBOL)
+            return sections[out_data].address + got_offset;
+        return 0; // undefined weak symbols are zero
+    }
+    if(symbol.section == Elf::SHN_COMMON){
+        auto it = globals.find(symbol.name);
+        if(it != globals.end())
+            return SymbolAddress(it->second.object, static_cast<uint32_t>(it->second.symbol));
+        return common_addresses.at(symbol.name);
+    }
+    if(symbol.section == Elf::SHN_ABS)
+        return symbol.value;
+    if(symbol.section >= object.sections.size())
+        return 0;
+    if(symbol.bind != Elf::STB_LOCAL){
+        // a weak definition can be replaced by a strong one from another object
+        const Definition& definition = globals.at(symbol.name);
+        if(definition.object != object_index || definition.symbol != symbol_index)
+            return SymbolAddress(definition.object, static_cast<uint32_t>(definition.symbol));
+    }
+
+    const InputSection& section = object.sections.at(symbol.section);
+    if(section.output == -1)
+        return 0;
+    return GetOutput(section.output).address + section.offset + symbol.value;
+}
+
+bool Linker::ApplyRelocations() {
+    for(auto& [key, offset] : got){
+        uint64_t address = 0;
+        size_t colon = key.rfind(':');
+        bool found = false;
+        // local symbols are keyed by object name and symbol index, globals by name
+        for(size_t i = 0; i < objects.size() && !found && colon != std::string::npos; i++){
+            if(key.compare(0, colon, objects.at(i).name) == 0 && colon == objects.at(i).name.size()){
+                address = SymbolAddress(i, static_cast<uint32_t>(std::stoul(key.substr(colon + 1))));
+                found = true;
+            }
+        }
+        if(!found){
+            auto it = globals.find(key);
+            if(it != globals.end())
+                address = SymbolAddress(it->second.object, static_cast<uint32_t>(it->second.symbol));
+            else if(common_addresses.find(key) != common_addresses.end())
+                address = common_addresses.at(key);
+        }
+        for(uint8_t i = 0; i < 8; i++)
+            sections[out_data].data.at(offset + i) = static_cast<uint8_t>(address >> (i * 8));
+    }
+
+    for(size_t i = 0; i < objects.size(); i++){
+        const InputObject& object = objects.at(i);
+        for(const InputSection& section : object.sections){
+            if(section.output == -1 || section.type == Elf::SHT_NOBITS)
+                continue;
+
+            OutputSection& output = GetOutput(section.output);
+            for(const Relocation& reloc : section.relocs){
+                if(reloc.offset >= section.size)
+                    return Fail("Relocation outside of section `" + section.name + "` in `" + object.name + "`");
+
+                const InputSymbol& symbol = object.symbols.at(reloc.symbol);
+                int64_t s = static_cast<int64_t>(SymbolAddress(i, reloc.symbol));
+                int64_t p = static_cast<int64_t>(output.address + section.offset + reloc.offset);
+                int64_t value;
+                uint8_t size = 4;
+
+                switch(reloc.type){
+                    case Elf::R_X86_64_NONE:
+                        continue;
+                    case Elf::R_X86_64_64:
+                        value = s + reloc.addend;
+                        size = 8;
+                        break;
+                    case Elf::R_X86_64_PC64:
+                        value = s + reloc.addend - p;
+                        size = 8;
+                        break;
+                    case Elf::R_X86_64_PC32:
+                    case Elf::R_X86_64_PLT32:
+                        value = s + reloc.addend - p;
+                        if(value != static_cast<int32_t>(value))
+                            return Fail("Relocation to `" + symbol.name + "` is out of range");
+                        break;
+                    case Elf::R_X86_64_32:
+                        value = s + reloc.addend;
+                        if(value != static_cast<uint32_t>(value))
+                            return Fail("Relocation to `" + symbol.name + "` is out of range");
+                        break;
+                    case Elf::R_X86_64_32S:
+                        value = s + reloc.addend;
+                        if(value != static_cast<int32_t>(value))
+                            return Fail("Relocation to `" + symbol.name + "` is out of range");
+                        break;
+                    case Elf::R_X86_64_GOTPC32:
+                        value = static_cast<int64_t>(sections[out_data].address + got_offset) + reloc.addend - p;
+                        break;
+                    case Elf::R_X86_64_GOTOFF64:
+                        value = s + reloc.addend - static_cast<int64_t>(sections[out_data].address + got_offset);
+                        size = 8;
+                        break;
+                    case Elf::R_X86_64_GOTPCREL:
+                    case Elf::R_X86_64_GOTPCRELX:
+                    case Elf::R_X86_64_REX_GOTPCRELX: {
+                        std::string key = symbol.bind == Elf::STB_LOCAL ? object.name + ":" + std::to_string(reloc.symbol) : symbol.name;
+                        value = static_cast<int64_t>(sections[out_data].address + got.at(key)) + reloc.addend - p;
+                        break;
+                    }
+                    default:
+                        return Fail("Unsupported relocation type " + std::to_string(reloc.type) + " in `" + object.name + "`");
+                }
+
+                uint64_t at = section.offset + reloc.offset;
+                for(uint8_t b = 0; b < size; b++)
+                    output.data.at(at + b) = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (b * 8));
+            }
+        }
+    }
+
+    entry = SymbolAddress(globals.at("_start").object, static_cast<uint32_t>(globals.at("_start").symbol));
+    return true;
+}
+
+bool Linker::Write(const std::string& output_path) {
+    Elf::Buffer file;
+    file.Bytes().resize(Elf::HEADER_SIZE, 0);
+
+    const OutputSection& text = sections[out_text];
+    const OutputSection& rodata = sections[out_rodata];
+    const OutputSection& data = sections[out_data];
+    const OutputSection& bss = sections[out_bss];
+
+    uint64_t read_only_end = rodata.size ? rodata.offset + rodata.size : text.offset + text.size;
+    Elf::WriteProgramHeader(file, {Elf::PT_LOAD, Elf::PF_R | Elf::PF_X, 0, BASE_ADDRESS, read_only_end, read_only_end, PAGE_SIZE});
+    Elf::WriteProgramHeader(file, {Elf::PT_LOAD, Elf::PF_R | Elf::PF_W, data.offset, data.address, data.size,
+                                   bss.address + bss.size - data.address, PAGE_SIZE});
+    Elf::WriteProgramHeader(file, {Elf::PT_GNU_STACK, Elf::PF_R | Elf::PF_W, 0, 0, 0, 0, 16});
+
+    for(const OutputSection& section : {text, rodata, data}){
+        file.Bytes().resize(section.offset, 0);
+        file.PutBytes(section.data);
+    }
+    for(const OutputSection& section : debug){
+        file.Bytes().resize(section.offset, 0);
+        file.PutBytes(section.data);
+    }
+
+    // section headers are not needed to run the program but let objdump and gdb read it
+    std::vector<uint8_t> shstrtab = {0};
+    auto add_name = [&shstrtab](const std::string& name){
+        auto offset = static_cast<uint32_t>(shstrtab.size());
+        shstrtab.insert(shstrtab.end(), name.begin(), name.end());
+        shstrtab.emplace_back(0);
+        return offset;
+    };
+
+    std::vector<Elf::SectionHeader> headers = {{}};
+    for(const OutputSection& section : sections)
+        headers.push_back({add_name(section.name), section.type, section.flags, section.address, section.offset,
+                           section.size, 0, 0, section.align, 0});
+    for(const OutputSection& section : debug)
+        headers.push_back({add_name(section.name), section.type, 0, 0, section.offset, section.size, 0, 0, 1, 0});
+    headers.push_back({add_name(".shstrtab"), Elf::SHT_STRTAB, 0, 0, file.Size(), 0, 0, 0, 1, 0});
+    headers.back().size = shstrtab.size();
+    file.PutBytes(shstrtab);
+
+    file.Align(8);
+    uint64_t shoff = file.Size();
+    for(const Elf::SectionHeader& header : headers)
+        Elf::WriteSectionHeader(file, header);
+
+    Elf::Buffer header;
+    Elf::WriteHeader(header, Elf::ET_EXEC, entry, Elf::HEADER_SIZE, 3, shoff, static_cast<uint16_t>(headers.size()),
+                     static_cast<uint16_t>(headers.size() - 1));
+    std::copy(header.Bytes().begin(), header.Bytes().end(), file.Bytes().begin());
+
+    std::remove(output_path.c_str());
+    if(!Elf::WriteFile(output_path, file.Bytes()))
+        return Fail("Failed to write `" + output_path + "`");
+    chmod(output_path.c_str(), 0755);
+    return true;
+}
+
+bool Linker::Link(const std::string& output_path) {
+    return AddStartStub() && ResolveArchives() && CollectGarbage() && Layout() && ApplyRelocations() && Write(output_path);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "PCH.h"
+#include "Core.h"
+
+/// Links relocatable ELF64 objects and static archives into a non-PIE executable, without gcc or ld
+class Linker{
+public:
+    inline static bool SupportsTarget(const int target){ return target == PLATFORM_LINUX64; }
+    /// Searches the usual library directories for lib<name>.a, empty when there is only a shared library
+    static std::string FindArchive(const std::string& name);
+
+    bool AddObject(const std::vector<uint8_t>& bytes, const std::string& name);
+    bool AddArchive(const std::string& path);
+    /// Drops the sections nothing reachable from _start refers to, `print` lists them and the bytes it saved
+    inline void SetGcSections(bool enable, bool print){ gc_sections = enable; print_gc_sections = print; }
+    /// Returns false when the inputs can't be linked statically, GetError tells why
+    bool Link(const std::string& output_path);
+    inline const std::string& GetError(){ return error; }
+    /// How many bytes of code and data gc-sections dropped
+    inline uint64_t GetRemovedBytes() const { return removed_bytes; }
+
+private:
+
+    struct Relocation{
+        uint64_t offset;
+        uint32_t type;
+        uint32_t symbol;
+        int64_t addend;
+    };
+
+    struct InputSection{
+        std::string name;
+        uint32_t type;
+        uint64_t flags;
+        uint64_t align;
+        uint64_t size;
+        std::vector<uint8_t> data;
+        std::vector<Relocation> relocs;
+        int output = -1; // index of the output section, -1 when it is not loaded
+        bool live = true; // false when gc-sections found that nothing uses it
+        uint64_t offset = 0; // offset in the output section
+    };
+
+    struct InputSymbol{
+        std::string name;
+        uint8_t bind;
+        uint8_t type;
+        uint16_t section;
+        uint64_t value;
+        uint64_t size;
+    };
+
+    struct InputObject{
+        std::string name;
+        std::vector<InputSection> sections;
+        std::vector<InputSymbol> symbols;
+    };
+
+    struct Archive{
+        std::string path;
+        std::vector<uint8_t> bytes;
+        std::unordered_map<std::string, uint64_t> index; // symbol name to member header offset
+        std::vector<uint64_t> loaded;
+    };
+
+    /// Where a global symbol is defined
+    struct Definition{
+        size_t object;
+        size_t symbol;
+        bool weak;
+    };
+
+    struct OutputSection{
+        std::string name;
+        uint32_t type;
+        uint64_t flags;
+        uint64_t align = 1;
+        uint64_t size = 0;
+        uint64_t address = 0;
+        uint64_t offset = 0; // file offset
+        std::vector<uint8_t> data;
+    };
+
+    enum : uint8_t { out_text, out_rodata, out_data, out_bss, out_count };
+
+    /// The loaded sections and after them the debug sections, which are not loaded and are at address 0
+    inline OutputSection& GetOutput(int index){ return index < out_count ? sections[index] : debug.at(index - out_count); }
+
+    bool ParseObject(const std::vector<uint8_t>& bytes, const std::string& name, InputObject& out);
+    bool AddInput(InputObject&& object);
+    bool ResolveArchives();
+    bool AddStartStub();
+    /// Marks the sections reachable from _start through relocations, the others are not loaded
+    bool CollectGarbage();
+    /// Appends the section to its output section
+    void Place(InputSection& section);
+    bool Layout();
+    uint64_t SymbolAddress(size_t object, uint32_t symbol);
+    bool ApplyRelocations();
+    bool Write(const std::string& output_path);
+    bool Fail(const std::string& msg);
+
+    std::vector<InputObject> objects;
+    std::vector<Archive> archives;
+    std::unordered_map<std::string, Definition> globals;
+    std::unordered_map<std::string, uint64_t> commons; // COMMON symbols to their size
+    std::unordered_map<std::string, uint64_t> common_addresses;
+    std::unordered_map<std::string, uint64_t> got; // symbols that need a GOT entry to the entry's offset in .data
+    uint64_t got_offset = 0;
+    OutputSection sections[out_count];
+    std::vector<OutputSection> debug; // every .debug_* section of the inputs, put together by name
+    uint64_t entry = 0;
+    bool gc_sections = false;
+    bool print_gc_sections = false;
+    uint64_t removed_bytes = 0;
+    std::string error;
+};
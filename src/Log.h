@@ -8,12 +8,12 @@ public:
         std::cout << "\033[92m" << msg << "\033[0m" << '\n';
     }
     inline static void Error(const std::string& msg){
-        std::cout << "\033[91m" << msg << "\033[0m" << '\n';
+        std::cerr << "\033[91m" << msg << "\033[0m" << '\n';
     }
     inline static void Info(const std::string& msg){
         std::cout << "\033[96m" << msg << "\033[0m" << '\n';
     }
     inline static void Warning(const std::string& msg){
-        std::cout << "\033[93m" << msg << "\033[0m" << '\n';
+        std::cerr << "\033[93m" << msg << "\033[0m" << '\n';
     }
 };
\ No newline at end of file
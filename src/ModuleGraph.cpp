@@ -0,0 +1,213 @@
+#include "ModuleGraph.h"
+#include "Tokenizer.h"
+#include "Profiler.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static std::string DisplayPath(const std::string& path){
+    std::error_code error;
+    fs::path relative = fs::relative(path, error);
+    return error || relative.empty() ? path : relative.string();
+}
+
+ThreadPool& ModuleGraph::GetPool() {
+    if(!pool)
+        pool = std::make_unique<ThreadPool>(thread_count);
+    return *pool;
+}
+
+void ModuleGraph::Load(const std::string& path, std::string source) {
+    Profiler::Scope scope("load modules");
+    auto module = std::make_unique<Module>();
+    module->path = fs::weakly_canonical(fs::absolute(path)).string();
+    module->source = std::move(source);
+    main = module.get();
+    modules.emplace(main->path, std::move(module));
+
+    LoadModule(main);
+    if(pool)
+        pool->Wait();
+
+    Order();
+}
+
+void ModuleGraph::LoadModule(Module* module) {
+    if(module != main){
+        Profiler::Scope scope("read module");
+        std::ifstream file(module->path, std::ios::binary);
+        if(!file.is_open()){
+            Log::Error("Failed to open the imported module `" + DisplayPath(module->path) + "`");
+            exit(1);
+        }
+        std::stringstream content;
+        content << file.rdbuf();
+        module->source = content.str() + ' ';
+    }
+
+    std::vector<Token> tokens;
+    {
+        Profiler::Scope scope("tokenize");
+        Tokenizer tokenizer(module->source);
+        tokens = tokenizer.tokenize();
+    }
+    Profiler::Count("source bytes", static_cast<int64_t>(module->source.size()));
+    Profiler::Count("tokens", static_cast<int64_t>(tokens.size()));
+
+    if(tokens.empty() && module == main){
+        Log::Error("Input file is empty");
+        exit(1);
+    }
+
+    {
+        Profiler::Scope scope("parse");
+        module->parser = std::make_unique<Parser>(std::move(tokens));
+        module->program = module->parser->parse();
+    }
+    const ArenaAllocator& arena = module->parser->GetArena();
+    Profiler::Count("nodes", static_cast<int64_t>(arena.GetAllocations()));
+    Profiler::Count("arena bytes used", static_cast<int64_t>(arena.GetBytesUsed()));
+    Profiler::Count("arena bytes reserved", static_cast<int64_t>(arena.GetBytesReserved()));
+
+    // the imports are relative to the file importing them, the ones nobody loaded yet are loaded at the same time
+    fs::path directory = fs::path(module->path).parent_path();
+    for(const Node::Stmt* stmt : module->program->prg){
+        if(!std::holds_alternative<Node::Import*>(stmt->stmt))
+            continue;
+
+        fs::path import = directory / std::get<Node::Import*>(stmt->stmt)->path->value;
+        if(import.extension() != ".gx")
+            import += ".gx";
+        std::string path = fs::weakly_canonical(import).string();
+        module->imports.emplace_back(path);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(modules.find(path) != modules.end())
+            continue;
+
+        auto imported = std::make_unique<Module>();
+        imported->path = path;
+        Module* next = imported.get();
+        modules.emplace(path, std::move(imported));
+        GetPool().Submit([this, next]{ LoadModule(next); });
+    }
+}
+
+void ModuleGraph::Order() {
+    enum class State : uint8_t { unvisited, visiting, done };
+    std::unordered_map<const Module*, State> states;
+    std::vector<const Module*> stack;
+
+    std::function<void(Module*)> visit = [&](Module* module){
+        states[module] = State::visiting;
+        stack.emplace_back(module);
+
+        for(const std::string& path : module->imports){
+            Module* import = modules.at(path).get();
+            if(states[import] == State::visiting){
+                std::string cycle;
+                auto first = std::find(stack.begin(), stack.end(), import);
+                for(auto it = first; it != stack.end(); it++)
+                    cycle += DisplayPath((*it)->path) + " -> ";
+                Log::Error("Modules can't import each other in a cycle, " + cycle + DisplayPath(import->path));
+                exit(1);
+            }
+            if(states[import] == State::unvisited)
+                visit(import);
+        }
+
+        stack.pop_back();
+        states[module] = State::done;
+        order.emplace_back(module);
+    };
+
+    order.clear();
+    visit(main);
+}
+
+std::vector<std::string> ModuleGraph::GetSources() const {
+    std::vector<std::string> sources;
+    for(const Module* module : order)
+        sources.emplace_back(module->source);
+    return sources;
+}
+
+std::vector<Node::Program*> ModuleGraph::GetPrograms() const {
+    std::vector<Node::Program*> programs;
+    for(const Module* module : order)
+        programs.emplace_back(module->program);
+    return programs;
+}
+
+Generator& ModuleGraph::Generate(int target, Generator::Entry entry, bool line_info) {
+    if(main->generator)
+        return *main->generator;
+    Profiler::Scope scope("generate");
+
+    for(size_t i = 0; i < order.size(); i++){
+        Module* module = order.at(i);
+        module->generator = std::make_unique<Generator>(module->program, target, entry);
+        module->generator->SetLevel(level);
+        module->generator->SetBoundsChecks(bounds_checks);
+        module->generator->SetVectorize(vectorize);
+        module->generator->SetModuleIndex(static_cast<uint32_t>(i));
+        if(line_info)
+            module->generator->EnableLineInfo(module->path);
+    }
+
+    if(profiling == Generator::Profiling::generate){
+        for(size_t i = 0; i < order.size(); i++)
+            order.at(i)->generator->EnableProfileGenerate(static_cast<uint32_t>(i));
+        main->generator->SetProfileOutput(profile_path, Profile::Hash(GetSources()));
+    }
+    else if(profiling == Generator::Profiling::use){
+        // the counters of the modules follow each other in the order they run
+        size_t count = 0;
+        for(Module* module : order)
+            count += module->generator->NumberBranches();
+
+        Profile profile;
+        if(!profile.Read(profile_path, Profile::Hash(GetSources())))
+            Log::Warning(profile.GetError() + ", compiling without it");
+        else if(profile.GetCounters().size() != count)
+            Log::Warning("The profile `" + profile_path + "` has other branches than the program, compiling without it");
+        else{
+            auto counter = profile.GetCounters().begin();
+            for(Module* module : order){
+                auto end = counter + static_cast<ptrdiff_t>(module->generator->NumberBranches());
+                module->generator->EnableProfileUse(std::vector<uint64_t>(counter, end));
+                counter = end;
+            }
+        }
+    }
+
+    std::vector<Generator*> imports;
+    if(order.size() > 1){
+        for(Module* module : order){
+            Generator* generator = module->generator.get();
+            GetPool().Submit([generator]{
+                Profiler::Scope scope("generate module");
+                generator->GenerateBody();
+            });
+            if(module != main)
+                imports.emplace_back(generator);
+        }
+        pool->Wait();
+    }
+
+    const Asm::Module& program = main->generator->GenerateInstructions(imports);
+    Profiler::Count("instructions", static_cast<int64_t>(program.text.size()));
+
+    // nothing runs on the threads after this, and `run` must not keep idle threads alive beside the program,
+    // a program leaving with the exit syscall only ends its own thread
+    pool.reset();
+    return *main->generator;
+}
+
+void ModuleGraph::Clear() {
+    for(const auto& [path, module] : modules){
+        if(module->parser)
+            module->parser->Clear();
+    }
+}
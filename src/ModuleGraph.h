@@ -0,0 +1,69 @@
+#pragma once
+
+#include "PCH.h"
+#include "Log.h"
+#include "Parser.h"
+#include "Generator.h"
+#include "ThreadPool.h"
+
+#include <memory>
+#include <mutex>
+
+/// A program and every module it imports. The modules are read, tokenized, parsed and generated on a thread pool
+/// and put together in import order, so the output never depends on which thread was faster
+class ModuleGraph{
+public:
+    struct Module{
+        std::string path; // absolute, an imported module is only loaded once
+        std::string source;
+        std::unique_ptr<Parser> parser;
+        Node::Program* program = nullptr;
+        std::vector<std::string> imports; // the absolute paths in the order they are written
+        std::unique_ptr<Generator> generator;
+    };
+
+    /// 0 threads uses one per core, the threads are only started when the program imports something
+    explicit ModuleGraph(unsigned threads = 0) : thread_count(threads) {}
+
+    /// Loads the program at `path`, which was already read into `source`, and every module it imports
+    void Load(const std::string& path, std::string source);
+    /// The sources of the modules in the order they run, the program itself last
+    std::vector<std::string> GetSources() const;
+    /// The parsed modules in the order they run, the program itself last
+    std::vector<Node::Program*> GetPrograms() const;
+    /// Generates every module at once, the returned generator has the whole program.
+    /// `line_info` is -g, the code keeps which line of which module it came from
+    Generator& Generate(int target, Generator::Entry entry, bool line_info = false);
+    /// -fprofile-generate or -fprofile-use of the profile at `path`, called before generating
+    inline void SetProfile(Generator::Profiling mode, const std::string& path){
+        profiling = mode;
+        profile_path = path;
+    }
+    /// -march, the level of the instructions every module's code may use, called before generating
+    inline void SetLevel(Asm::Level l){ level = l; }
+    /// -fbounds-check, indexes of arrays are checked when the program runs, called before generating
+    inline void SetBoundsChecks(bool checks){ bounds_checks = checks; }
+    /// -fno-slp-vectorize, no statements are packed into vector instructions, called before generating
+    inline void SetVectorize(bool enable){ vectorize = enable; }
+    /// Frees the memory of the parsers, the generated code stays
+    void Clear();
+
+private:
+
+    void LoadModule(Module* module);
+    /// Puts the modules in the order they run, every module after the modules it imports
+    void Order();
+    ThreadPool& GetPool();
+
+    std::mutex mutex; // guards `modules` while modules are loaded at once
+    std::unordered_map<std::string, std::unique_ptr<Module>> modules;
+    Module* main = nullptr;
+    std::vector<Module*> order;
+    std::unique_ptr<ThreadPool> pool;
+    unsigned thread_count;
+    Generator::Profiling profiling = Generator::Profiling::none;
+    std::string profile_path;
+    Asm::Level level = Asm::Level::v1;
+    bool bounds_checks = false;
+    bool vectorize = true;
+};
@@ -6,7 +6,7 @@
 
 namespace Node{
     enum class BinOp {
-        none = 0, add, sub, mul, div, rest
+        none = 0, add, sub, mul, div, rest, _and, _or, _xor, shl, shr
     };
 
     struct IntExpr;
@@ -17,6 +17,8 @@ namespace Node{
 
     struct LitInt{
         std::string value;
+        /// Numbers above the largest long are the bits of the uint64 they are, 18446744073709551615 is -1
+        inline int64_t GetValue() const { return static_cast<int64_t>(std::stoull(value)); }
     };
 
     struct Ident{
@@ -27,8 +29,32 @@ namespace Node{
         IntExpr* expr;
     };
 
+    /// `popcount(x)` counts the set bits, `clz(x)` and `ctz(x)` the zero bits above and below the set ones,
+    /// all of them of the whole word so the count of 0 is its width
+    enum class Builtin {
+        popcount, clz, ctz
+    };
+
+    struct TermBuiltin{
+        Builtin builtin;
+        IntExpr* expr;
+    };
+
+    struct Term;
+
+    /// `~term`, every bit flipped
+    struct TermNot{
+        Term* term;
+    };
+
+    /// `arr[index]`, an element of an array
+    struct TermIndex{
+        Ident* ident;
+        IntExpr* index;
+    };
+
     struct Term{
-        std::variant<LitInt*, Ident*, TermParen*> term;
+        std::variant<LitInt*, Ident*, TermParen*, TermBuiltin*, TermNot*, TermIndex*> term;
     };
 
     struct BinExprAdd{
@@ -56,13 +82,61 @@ namespace Node{
         IntExpr* rhs;
     };
 
+    struct BinExprAnd{
+        IntExpr* lhs;
+        IntExpr* rhs;
+    };
+
+    struct BinExprOr{
+        IntExpr* lhs;
+        IntExpr* rhs;
+    };
+
+    struct BinExprXor{
+        IntExpr* lhs;
+        IntExpr* rhs;
+    };
+
+    /// `<<`, the count is taken modulo the width of the word like the cpu does
+    struct BinExprShl{
+        IntExpr* lhs;
+        IntExpr* rhs;
+    };
+
+    /// `>>`, an arithmetic shift that keeps the sign, a logical one when lhs is unsigned
+    struct BinExprShr{
+        IntExpr* lhs;
+        IntExpr* rhs;
+    };
+
     struct BinExpr{
-        std::variant<BinExprAdd*, BinExprSub*, BinExprMul*, BinExprDiv*, BinExprMod*> expr;
+        std::variant<BinExprAdd*, BinExprSub*, BinExprMul*, BinExprDiv*, BinExprMod*,
+                     BinExprAnd*, BinExprOr*, BinExprXor*, BinExprShl*, BinExprShr*> expr;
     };
 
     struct IntExpr{
         std::variant<Term*, BinExpr*> var;
-    };
+        /// An unsigned variable is in it (for `<<` and `>>` in their lhs), it is calculated as an unsigned number
+        /// so `/`, `%`, `>>` and comparisons of it are unsigned
+        bool is_unsigned = false;
+    };
+
+    /// The value of `expr` when it is an integer literal
+    inline bool GetLiteral(const IntExpr* expr, int64_t& value){
+        auto term = std::get_if<Term*>(&expr->var);
+        if(!term || !std::holds_alternative<LitInt*>((*term)->term))
+            return false;
+        value = std::get<LitInt*>((*term)->term)->GetValue();
+        return true;
+    }
+
+    /// The variable `expr` is when it is only one
+    inline const Ident* GetIdent(const IntExpr* expr){
+        auto term = std::get_if<Term*>(&expr->var);
+        if(!term || !std::holds_alternative<Ident*>((*term)->term))
+            return nullptr;
+        return std::get<Ident*>((*term)->term);
+    }
 
     struct BoolExpr;
 
@@ -114,6 +188,13 @@ namespace Node{
         IntExpr* expr;
     };
 
+    /// `arr[index] = expr;`, the value is truncated to the type of the elements
+    struct IndexAssign{
+        Ident* ident;
+        IntExpr* index;
+        IntExpr* expr;
+    };
+
     struct Exit{
         IntExpr* expr;
     };
@@ -126,6 +207,7 @@ namespace Node{
         VarType type;
         Expr* expr;
         Ident* ident;
+        uint64_t length = 0; // the number of elements of `int arr[length];`, 0 when it isn't an array
     };
 
     struct Link{
@@ -166,8 +248,13 @@ namespace Node{
         Asm_Section section;
     };
 
+    struct Import{
+        LitString* path;
+    };
+
     struct Stmt{
-        std::variant<Exit*, Link*, Variable*, Scope*, If*, Reassign*, Assembly*, Elif*, Else*, While*> stmt;
+        std::variant<Exit*, Link*, Variable*, Scope*, If*, Reassign*, Assembly*, Elif*, Else*, While*, Import*, IndexAssign*> stmt;
+        size_t line = 0; // where the statement starts in its file, 0 for statements the compiler made
     };
 
     struct Program{
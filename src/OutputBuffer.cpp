@@ -0,0 +1,114 @@
+#include "OutputBuffer.h"
+
+#ifdef _WIN32
+    #include <fstream>
+#else
+    #include <fcntl.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+    #include <cerrno>
+    #include <climits>
+#endif
+
+void OutputBuffer::NewChunk() {
+    current->push_back(Chunk{std::unique_ptr<char[]>(new char[CHUNK_SIZE]), 0});
+}
+
+void OutputBuffer::Append(const char* str, size_t length) {
+    while(length > 0){
+        if(current->empty() || current->back().used == CHUNK_SIZE)
+            NewChunk();
+
+        Chunk& chunk = current->back();
+        size_t count = std::min(length, CHUNK_SIZE - chunk.used);
+        std::copy(str, str + count, chunk.data.get() + chunk.used);
+        chunk.used += count;
+        str += count;
+        length -= count;
+    }
+}
+
+size_t OutputBuffer::Size() const {
+    size_t size = 0;
+    for(const std::vector<Chunk>& section : sections)
+        for(const Chunk& chunk : section)
+            size += chunk.used;
+    return size;
+}
+
+std::string OutputBuffer::Str() const {
+    std::string str;
+    str.reserve(Size());
+    for(const std::vector<Chunk>& section : sections)
+        for(const Chunk& chunk : section)
+            str.append(chunk.data.get(), chunk.used);
+    return str;
+}
+
+void OutputBuffer::Clear() {
+    for(std::vector<Chunk>& section : sections)
+        section.clear();
+}
+
+#ifdef _WIN32
+
+bool OutputBuffer::WriteFile(const std::string& path) const {
+    std::ofstream file;
+    if(path != "-")
+        file.open(path, std::ios::binary);
+    std::ostream& out = path == "-" ? std::cout : file;
+    if(path != "-" && !file.is_open())
+        return false;
+    for(const std::vector<Chunk>& section : sections)
+        for(const Chunk& chunk : section)
+            out.write(chunk.data.get(), static_cast<std::streamsize>(chunk.used));
+    out.flush();
+    return out.good();
+}
+
+#else
+
+bool OutputBuffer::WriteFile(const std::string& path) const {
+    if(path == "-"){
+        // the text is written around std::cout's buffer, so that has to be out first
+        std::cout.flush();
+        return WriteFd(STDOUT_FILENO);
+    }
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return false;
+    bool ok = WriteFd(fd);
+    return close(fd) == 0 && ok;
+}
+
+bool OutputBuffer::WriteFd(int fd) const {
+    std::vector<iovec> vectors;
+    for(const std::vector<Chunk>& section : sections)
+        for(const Chunk& chunk : section)
+            vectors.push_back(iovec{chunk.data.get(), chunk.used});
+
+    // one writev per IOV_MAX chunks, and again for whatever a short write left over
+    size_t first = 0;
+    while(first < vectors.size()){
+        int count = static_cast<int>(std::min<size_t>(vectors.size() - first, IOV_MAX));
+        ssize_t written = writev(fd, vectors.data() + first, count);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written < 0)
+            return false;
+
+        auto left = static_cast<size_t>(written);
+        while(first < vectors.size() && left >= vectors.at(first).iov_len){
+            left -= vectors.at(first).iov_len;
+            first++;
+        }
+        if(left > 0){
+            vectors.at(first).iov_base = static_cast<char*>(vectors.at(first).iov_base) + left;
+            vectors.at(first).iov_len -= left;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "PCH.h"
+
+#include <charconv>
+#include <memory>
+#include <string_view>
+
+/// Append-only text output split into the sections of an assembly file, each made of fixed-size chunks.
+/// Appending never moves what was written before and the file is written straight from the chunks
+class OutputBuffer{
+public:
+    enum class Section : uint8_t {
+        external, data, bss, text, count
+    };
+
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+    inline OutputBuffer(){ SetSection(Section::text); }
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    /// Everything appended after this goes to the end of `section`
+    inline void SetSection(Section section){ current = &sections[static_cast<uint8_t>(section)]; }
+
+    inline void Append(char c){
+        if(current->empty() || current->back().used == CHUNK_SIZE)
+            NewChunk();
+        Chunk& chunk = current->back();
+        chunk.data[chunk.used++] = c;
+    }
+    void Append(const char* str, size_t length);
+    inline void Append(std::string_view str){ Append(str.data(), str.size()); }
+
+    /// Formats without locales or temporary strings
+    inline void AppendInt(int64_t value){
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        Append(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+    size_t Size() const;
+    /// Writes the sections in order, false when the file can't be written. `-` is stdout
+    bool WriteFile(const std::string& path) const;
+#ifndef _WIN32
+    /// Writes the sections in order to an open file, a pipe or stdout
+    bool WriteFd(int fd) const;
+#endif
+    /// Joins everything into one string, only for when a string is really needed
+    std::string Str() const;
+    void Clear();
+
+private:
+
+    struct Chunk{
+        std::unique_ptr<char[]> data;
+        size_t used;
+    };
+
+    void NewChunk();
+
+    std::vector<Chunk> sections[static_cast<uint8_t>(Section::count)];
+    std::vector<Chunk>* current;
+};
@@ -9,5 +9,6 @@
 #include <cstdint>
 #include <optional>
 #include <variant>
+#include <algorithm>
 
 #include "Core.h"
\ No newline at end of file
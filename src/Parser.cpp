@@ -3,13 +3,35 @@
 Node::Term* Parser::parseTerm()  {
     checkIfLastToken("Expected an integer term");
     if(getNextToken() != TokenType::ident && getNextToken() != TokenType::lit_int &&
-    getNextToken() != TokenType::expr_open){
+    getNextToken() != TokenType::expr_open && getNextToken() != TokenType::tilde){
         Log::Error("Expected a term (identifier or integer literal) at " + getNextTokenPos());
         exit(1);
     }
     Node::Term* term = m_allocator.alloc<Node::Term>();
 
-    if(getNextToken() == TokenType::ident){
+    static const std::unordered_map<std::string, Node::Builtin> builtins = {
+            {"popcount", Node::Builtin::popcount}, {"clz", Node::Builtin::clz}, {"ctz", Node::Builtin::ctz}
+    };
+    if(isBuiltinCall()){
+        std::string name = tokens.at(index).value.value();
+        auto builtin = builtins.find(name);
+        if(builtin == builtins.end()){
+            Log::Error("Unknown builtin `" + name + "` at " + getNextTokenPos() + ", expected popcount, clz or ctz");
+            exit(1);
+        }
+        index += 2;
+        checkIfLastToken("Expected the argument of the builtin");
+        auto call = m_allocator.alloc<Node::TermBuiltin>();
+        call->builtin = builtin->second;
+        call->expr = parseIntExpr(0);
+        checkIfLastToken("Expected an `)` after the argument of `" + name + "`");
+        if(getNextToken() != TokenType::expr_close){
+            Log::Error("Expected an `)` after the argument of `" + name + "` at " + getNextTokenPos());
+            exit(1);
+        }
+        term->term = call;
+    }
+    else if(getNextToken() == TokenType::ident){
         std::string ident = tokens.at(index).value.value();
         if(!isIntIdent(ident)){
             Log::Error("Expected an int identifier at " + getNextTokenPos() + " but got a type " + VarTypeToString(
@@ -19,13 +41,27 @@ Node::Term* Parser::parseTerm()  {
 
         Node::Ident* id = m_allocator.alloc<Node::Ident>();
         id->value = tokens.at(index).value.value();
-        term->term = id;
+        if(getIdentLength(ident) != 0 || (index + 1 < tokens.size() && tokens.at(index + 1).type == TokenType::bracket_open)){
+            index++;
+            checkIfLastToken("Expected a `[` after the array `" + ident + "`");
+            term->term = parseIndex(id);
+            index--; // the term ends at the `]`
+        }
+        else
+            term->term = id;
     }
     else if(getNextToken() == TokenType::lit_int){
         Node::LitInt* litInt = m_allocator.alloc<Node::LitInt>();
         litInt->value = tokens.at(index).value.value();
         term->term = litInt;
     }
+    else if(getNextToken() == TokenType::tilde){
+        index++;
+        checkIfLastToken("Expected a term after `~`");
+        auto _not = m_allocator.alloc<Node::TermNot>();
+        _not->term = parseTerm();
+        term->term = _not;
+    }
     else if(getNextToken() == TokenType::expr_open){
         index++;
         auto expr = parseIntExpr(0);
@@ -45,18 +81,64 @@ Node::Term* Parser::parseTerm()  {
     return term;
 }
 
+bool Parser::isBuiltinCall() {
+    return index + 1 < tokens.size() && tokens.at(index).type == TokenType::ident &&
+           tokens.at(index + 1).type == TokenType::expr_open;
+}
+
 VarType Parser::getIdentType(const std::string &ident) {
-    for(Node::Stmt* stmt : program.prg){
-        if(!std::holds_alternative<Node::Variable*>(stmt->stmt) && std::get<Node::Variable*>(stmt->stmt)->ident->value != ident)
-            continue;
+    return getIdentVariable(ident)->type;
+}
 
-        return std::get<Node::Variable*>(stmt->stmt)->type;
+uint64_t Parser::getIdentLength(const std::string &ident) {
+    return getIdentVariable(ident)->length;
+}
+
+Node::Variable* Parser::getIdentVariable(const std::string &ident) {
+    // the innermost scope first and the newest declaration in it, like Storage and the interpreter find them, a
+    // variable of a scope hides the ones with its name outside of it
+    auto find = [&](const std::vector<Node::Stmt*>& stmts) -> Node::Variable* {
+        for(auto stmt = stmts.rbegin(); stmt != stmts.rend(); stmt++){
+            if(std::holds_alternative<Node::Variable*>((*stmt)->stmt) && std::get<Node::Variable*>((*stmt)->stmt)->ident->value == ident)
+                return std::get<Node::Variable*>((*stmt)->stmt);
+        }
+        return nullptr;
+    };
+    for(auto scope = scopes.rbegin(); scope != scopes.rend(); scope++){
+        if(Node::Variable* var = find((*scope)->stmts))
+            return var;
     }
+    if(Node::Variable* var = find(program.prg))
+        return var;
 
     Log::Error("Unknown identifier `" + ident + "` at " + getNextTokenPos());
     exit(1);
 }
 
+Node::TermIndex* Parser::parseIndex(Node::Ident* ident) {
+    if(getIdentLength(ident->value) == 0){
+        Log::Error("`" + ident->value + "` is not an array and can't be indexed at " + getNextTokenPos());
+        exit(1);
+    }
+    if(getNextToken() != TokenType::bracket_open){
+        Log::Error("Expected a `[` with the index of an element of the array `" + ident->value + "` at " + getNextTokenPos());
+        exit(1);
+    }
+    index++;
+    checkIfLastToken("Expected the index of an element of `" + ident->value + "`");
+
+    auto term = m_allocator.alloc<Node::TermIndex>();
+    term->ident = ident;
+    term->index = parseIntExpr();
+    checkIfLastToken("Expected a `]` after the index of `" + ident->value + "`");
+    if(getNextToken() != TokenType::bracket_close){
+        Log::Error("Expected a `]` after the index of `" + ident->value + "` at " + getNextTokenPos());
+        exit(1);
+    }
+    index++;
+    return term;
+}
+
 bool Parser::isLitBool(TokenType type) {
     return type == TokenType::_false || type == TokenType::_true;
 }
@@ -65,7 +147,20 @@ bool Parser::isIntIdent(const std::string &ident) {
     return
     getIdentType(tokens.at(index).value.value()) == VarType::_short ||
     getIdentType(tokens.at(index).value.value()) == VarType::_int ||
-    getIdentType(tokens.at(index).value.value()) == VarType::_long;
+    getIdentType(tokens.at(index).value.value()) == VarType::_long ||
+    IsUnsigned(getIdentType(tokens.at(index).value.value()));
+}
+
+bool Parser::isUnsignedTerm(const Node::Term* term) {
+    while(std::holds_alternative<Node::TermNot*>(term->term))
+        term = std::get<Node::TermNot*>(term->term)->term;
+    if(std::holds_alternative<Node::Ident*>(term->term))
+        return IsUnsigned(getIdentType(std::get<Node::Ident*>(term->term)->value));
+    if(std::holds_alternative<Node::TermIndex*>(term->term))
+        return IsUnsigned(getIdentType(std::get<Node::TermIndex*>(term->term)->ident->value));
+    if(std::holds_alternative<Node::TermParen*>(term->term))
+        return std::get<Node::TermParen*>(term->term)->expr->is_unsigned;
+    return false;
 }
 
 Node::Comparison Parser::parseComparison() {
@@ -131,7 +226,7 @@ Node::BoolTerm* Parser::parseBoolTerm() {
     auto term = m_allocator.alloc<Node::BoolTerm>();
     Token curr_token = tokens.at(index);
 
-    if(isLitBool(curr_token.type) || (curr_token.type == TokenType::ident && getIdentType(curr_token.value.value()) == VarType::_bool)){
+    if(isLitBool(curr_token.type) || (curr_token.type == TokenType::ident && !isBuiltinCall() && getIdentType(curr_token.value.value()) == VarType::_bool)){
         auto bool_term = m_allocator.alloc<Node::BoolTermBool>();
 
         if(curr_token.type == TokenType::ident){
@@ -176,7 +271,8 @@ Node::BoolTerm* Parser::parseBoolTerm() {
 
         term->term = bool_term;
     }
-    else if(curr_token.type == TokenType::lit_int || (curr_token.type == TokenType::ident && isIntIdent(curr_token.value.value()))){
+    else if(curr_token.type == TokenType::lit_int || curr_token.type == TokenType::tilde || isBuiltinCall() ||
+            (curr_token.type == TokenType::ident && isIntIdent(curr_token.value.value()))){
         auto int_expr = m_allocator.alloc<Node::BoolTermInt>();
 
         int_expr->lhs = parseIntExpr();
@@ -250,15 +346,25 @@ Node::BoolExpr* Parser::parseBoolExpr(){
     return expr;
 }
 
+/// The same order as in C, `|` binds the loosest and `*`, `/` and `%` the tightest
 int Parser::getBinPrec(const TokenType type) {
     switch(type) {
+        case TokenType::_or:
+            return 0;
+        case TokenType::caret:
+            return 1;
+        case TokenType::_and:
+            return 2;
+        case TokenType::shift_left:
+        case TokenType::shift_right:
+            return 3;
         case TokenType::plus:
         case TokenType::minus:
-            return 0;
+            return 4;
         case TokenType::star:
         case TokenType::slash:
         case TokenType::percent:
-            return 1;
+            return 5;
         default:
             return -1;
     }
@@ -271,6 +377,11 @@ bool Parser::isBinOp(const TokenType type) {
         case TokenType::star:
         case TokenType::slash:
         case TokenType::percent:
+        case TokenType::_and:
+        case TokenType::_or:
+        case TokenType::caret:
+        case TokenType::shift_left:
+        case TokenType::shift_right:
             return true;
         default:
             return false;
@@ -281,11 +392,16 @@ Node::IntExpr* Parser::parseIntExpr(const int min_prec)  {
     Node::Term* term_lhs = parseTerm();
     auto expr_lhs = m_allocator.alloc<Node::IntExpr>();
     expr_lhs->var = term_lhs;
+    expr_lhs->is_unsigned = isUnsignedTerm(term_lhs);
     index++;
 
     while (true) {
         if (index >= tokens.size() || !isBinOp(getNextToken()))
             break;
+        // `&&` and `||` join conditions, they end the expression
+        if ((getNextToken() == TokenType::_and || getNextToken() == TokenType::_or) &&
+            index + 1 < tokens.size() && tokens.at(index + 1).type == getNextToken())
+            break;
 
         checkIfLastToken("Expected a binary operator");
 
@@ -303,6 +419,7 @@ Node::IntExpr* Parser::parseIntExpr(const int min_prec)  {
         auto lhs = m_allocator.alloc<Node::IntExpr>();
 
         lhs->var = expr_lhs->var;
+        lhs->is_unsigned = expr_lhs->is_unsigned;
 
         if (op == TokenType::plus) {
             auto add = m_allocator.alloc<Node::BinExprAdd>();
@@ -329,6 +446,31 @@ Node::IntExpr* Parser::parseIntExpr(const int min_prec)  {
             modulo->lhs = lhs;
             modulo->rhs = expr_rhs;
             expr->expr = modulo;
+        } else if (op == TokenType::_and) {
+            auto _and = m_allocator.alloc<Node::BinExprAnd>();
+            _and->lhs = lhs;
+            _and->rhs = expr_rhs;
+            expr->expr = _and;
+        } else if (op == TokenType::_or) {
+            auto _or = m_allocator.alloc<Node::BinExprOr>();
+            _or->lhs = lhs;
+            _or->rhs = expr_rhs;
+            expr->expr = _or;
+        } else if (op == TokenType::caret) {
+            auto _xor = m_allocator.alloc<Node::BinExprXor>();
+            _xor->lhs = lhs;
+            _xor->rhs = expr_rhs;
+            expr->expr = _xor;
+        } else if (op == TokenType::shift_left) {
+            auto shl = m_allocator.alloc<Node::BinExprShl>();
+            shl->lhs = lhs;
+            shl->rhs = expr_rhs;
+            expr->expr = shl;
+        } else if (op == TokenType::shift_right) {
+            auto shr = m_allocator.alloc<Node::BinExprShr>();
+            shr->lhs = lhs;
+            shr->rhs = expr_rhs;
+            expr->expr = shr;
         } else {
             Log::Error("Failed to parse the int expression at " + getNextTokenPos());
             exit(1);
@@ -337,6 +479,9 @@ Node::IntExpr* Parser::parseIntExpr(const int min_prec)  {
         // Update expr_lhs to the newly created expression
         expr_lhs = m_allocator.alloc<Node::IntExpr>();
         expr_lhs->var = expr;
+        // like in C a shift has the type of what is shifted
+        bool shift = op == TokenType::shift_left || op == TokenType::shift_right;
+        expr_lhs->is_unsigned = lhs->is_unsigned || (!shift && expr_rhs->is_unsigned);
     }
 
     return expr_lhs;
@@ -369,7 +514,18 @@ void Parser::checkIfLastToken(const std::string& msg, bool add_pos) {
     }
 }
 
+/// Parses a statement and keeps the line it starts at, the statements in its scope keep their own
 std::optional<Node::Stmt*> Parser::parseStmt(){
+    getNextToken();
+    size_t line = tokens.at(index).line;
+
+    std::optional<Node::Stmt*> stmt = parseStmtKind();
+    if(stmt.has_value() && stmt.value()->line == 0)
+        stmt.value()->line = line;
+    return stmt;
+}
+
+std::optional<Node::Stmt*> Parser::parseStmtKind(){
     switch(getNextToken()) {
         /// EXIT
         case TokenType::exit: {
@@ -408,7 +564,11 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
             /// CREATING INT VARIABLES
         case TokenType::_int16:
         case TokenType::_int32:
-        case TokenType::_int64: {
+        case TokenType::_int64:
+        case TokenType::_uint8:
+        case TokenType::_uint16:
+        case TokenType::_uint32:
+        case TokenType::_uint64: {
 
             VarType type;
             switch (getNextToken()) {
@@ -421,6 +581,18 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                 case TokenType::_int64:
                     type = VarType::_long;
                     break;
+                case TokenType::_uint8:
+                    type = VarType::_uchar;
+                    break;
+                case TokenType::_uint16:
+                    type = VarType::_ushort;
+                    break;
+                case TokenType::_uint32:
+                    type = VarType::_uint;
+                    break;
+                case TokenType::_uint64:
+                    type = VarType::_ulong;
+                    break;
                 default:
                     exit(1); // unreachable
             }
@@ -433,6 +605,40 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                 index++;
                 checkIfLastToken("Expected a `;` or initialization of the ident");
 
+                // `int arr[16];`, the elements start at 0
+                if (getNextToken() == TokenType::bracket_open) {
+                    index++;
+                    checkIfLastToken("Expected the length of the array `" + ident->value + "`");
+                    if (getNextToken() != TokenType::lit_int || tokens.at(index).value.value().front() == '-' ||
+                        tokens.at(index).value.value().length() > 9 || std::stoull(tokens.at(index).value.value()) == 0) {
+                        Log::Error("Expected the length of the array `" + ident->value +
+                                   "` as an integer literal from 1 to 999999999 at " + getNextTokenPos());
+                        exit(1);
+                    }
+                    auto var = m_allocator.alloc<Node::Variable>();
+                    var->type = type;
+                    var->ident = ident;
+                    var->length = std::stoull(tokens.at(index).value.value());
+
+                    index++;
+                    checkIfLastToken("Expected a `]` after the length of the array");
+                    if (getNextToken() != TokenType::bracket_close) {
+                        Log::Error("Expected a `]` after the length of the array at " + getNextTokenPos());
+                        exit(1);
+                    }
+                    index++;
+                    checkIfLastToken("Expected a `;` after declaring an array");
+                    if (getNextToken() != TokenType::semi) {
+                        Log::Error("Expected a `;` after declaring an array, arrays can't be initialized at " +
+                                   getNextTokenPos());
+                        exit(1);
+                    }
+
+                    auto stmt = m_allocator.alloc<Node::Stmt>();
+                    stmt->stmt = var;
+                    return stmt;
+                }
+
                 if (getNextToken() == TokenType::semi) {
                     index++;
                     auto var = m_allocator.alloc<Node::Variable>();
@@ -588,10 +794,12 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
 
             auto scope = m_allocator.alloc<Node::Scope>();
             index++;
+            scopes.emplace_back(scope);
             while (auto stmt = parseStmt()) {
                 scope->stmts.emplace_back(stmt.value());
                 index++;
             }
+            scopes.pop_back();
 
             if (getNextToken() == TokenType::scope_close) {
                 auto stmt = m_allocator.alloc<Node::Stmt>();
@@ -778,6 +986,14 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
             ident->value = identValue;
             stmt->ident = ident;
 
+            // what is assigned, the variable or `arr[index]`, it is also the lhs of `+=` and the others
+            Node::Term *target = m_allocator.alloc<Node::Term>();
+            target->term = ident;
+            if (getIdentLength(identValue) != 0 || getNextToken() == TokenType::bracket_open) {
+                target->term = parseIndex(ident);
+                checkIfLastToken("Expected an assignment to an element of `" + identValue + "`");
+            }
+
             TokenType nextToken = getNextToken();
             switch (nextToken) {
                 case TokenType::plus:
@@ -794,7 +1010,7 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                         Node::LitInt *rhsInt = m_allocator.alloc<Node::LitInt>();
                         rhsInt->value = "1";
 
-                        lhsTerm->term = ident;
+                        lhsTerm->term = target->term;
                         rhsTerm->term = rhsInt;
                         lhs->var = lhsTerm;
                         rhs->var = rhsTerm;
@@ -812,7 +1028,7 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                         Node::BinExprAdd *binExprAdd = m_allocator.alloc<Node::BinExprAdd>();
                         Node::IntExpr *lhs = m_allocator.alloc<Node::IntExpr>();
                         Node::Term *lhsTerm = m_allocator.alloc<Node::Term>();
-                        lhsTerm->term = ident;
+                        lhsTerm->term = target->term;
                         lhs->var = lhsTerm;
                         Node::IntExpr *rhs = parseIntExpr();
                         binExprAdd->lhs = lhs;
@@ -842,7 +1058,7 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                         Node::LitInt *rhsInt = m_allocator.alloc<Node::LitInt>();
                         rhsInt->value = "1";
 
-                        lhsTerm->term = ident;
+                        lhsTerm->term = target->term;
                         rhsTerm->term = rhsInt;
                         lhs->var = lhsTerm;
                         rhs->var = rhsTerm;
@@ -860,7 +1076,7 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                         Node::BinExprSub *binExprSub = m_allocator.alloc<Node::BinExprSub>();
                         Node::IntExpr *lhs = m_allocator.alloc<Node::IntExpr>();
                         Node::Term *lhsTerm = m_allocator.alloc<Node::Term>();
-                        lhsTerm->term = ident;
+                        lhsTerm->term = target->term;
                         lhs->var = lhsTerm;
                         Node::IntExpr *rhs = parseIntExpr();
                         binExprSub->lhs = lhs;
@@ -885,7 +1101,7 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                         Node::BinExprMul *binExprMul = m_allocator.alloc<Node::BinExprMul>();
                         Node::IntExpr *lhs = m_allocator.alloc<Node::IntExpr>();
                         Node::Term *lhsTerm = m_allocator.alloc<Node::Term>();
-                        lhsTerm->term = ident;
+                        lhsTerm->term = target->term;
                         lhs->var = lhsTerm;
                         Node::IntExpr *rhs = parseIntExpr();
                         binExprMul->lhs = lhs;
@@ -910,7 +1126,7 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                         Node::BinExprDiv *binExprDiv = m_allocator.alloc<Node::BinExprDiv>();
                         Node::IntExpr *lhs = m_allocator.alloc<Node::IntExpr>();
                         Node::Term *lhsTerm = m_allocator.alloc<Node::Term>();
-                        lhsTerm->term = ident;
+                        lhsTerm->term = target->term;
                         lhs->var = lhsTerm;
                         Node::IntExpr *rhs = parseIntExpr();
                         binExprDiv->lhs = lhs;
@@ -935,7 +1151,7 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                         Node::BinExprMod *binExprMod = m_allocator.alloc<Node::BinExprMod>();
                         Node::IntExpr *lhs = m_allocator.alloc<Node::IntExpr>();
                         Node::Term *lhsTerm = m_allocator.alloc<Node::Term>();
-                        lhsTerm->term = ident;
+                        lhsTerm->term = target->term;
                         lhs->var = lhsTerm;
                         Node::IntExpr *rhs = parseIntExpr();
                         binExprMod->lhs = lhs;
@@ -962,13 +1178,31 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
                     exit(1);
             }
 
+            // `x += expr` and the others are `x + expr`, which is unsigned when x or expr is
+            if (nextToken != TokenType::equal) {
+                bool is_unsigned = IsUnsigned(getIdentType(identValue));
+                std::visit([&](auto* bin) {
+                    bin->lhs->is_unsigned = is_unsigned;
+                    stmt->expr->is_unsigned = is_unsigned || bin->rhs->is_unsigned;
+                }, std::get<Node::BinExpr*>(stmt->expr->var)->expr);
+            }
+
             if (getNextToken() != TokenType::semi) {
                 Log::Error("Expected a `;` at " + getNextTokenPos());
                 exit(1);
             }
 
             Node::Stmt *returnStmt = m_allocator.alloc<Node::Stmt>();
-            returnStmt->stmt = stmt;
+            if (std::holds_alternative<Node::TermIndex*>(target->term)) {
+                auto element = std::get<Node::TermIndex*>(target->term);
+                auto assign = m_allocator.alloc<Node::IndexAssign>();
+                assign->ident = ident;
+                assign->index = element->index;
+                assign->expr = stmt->expr;
+                returnStmt->stmt = assign;
+            }
+            else
+                returnStmt->stmt = stmt;
             return returnStmt;
         }
 
@@ -1028,6 +1262,38 @@ std::optional<Node::Stmt*> Parser::parseStmt(){
             return stmt;
         }
 
+            /// IMPORTING ANOTHER FILE
+            /// import "math.gx"; runs the module once before this file, its variables stay in the module
+        case TokenType::_import: {
+            if (!scopes.empty()) {
+                Log::Error("Modules can only be imported outside of scopes at " + getNextTokenPos());
+                exit(1);
+            }
+
+            index++;
+            checkIfLastToken("Expected the path of the module to import but reached the last token");
+            if (getNextToken() != TokenType::lit_string) {
+                Log::Error("Expected the path of the module to import as a literal string at " + getNextTokenPos());
+                exit(1);
+            }
+
+            auto path = m_allocator.alloc<Node::LitString>();
+            path->value = tokens.at(index).value.value();
+
+            index++;
+            if (getNextToken() != TokenType::semi) {
+                Log::Error("Expected a `;` after the import statement at " + getNextTokenPos());
+                exit(1);
+            }
+
+            auto import = m_allocator.alloc<Node::Import>();
+            import->path = path;
+
+            auto stmt = m_allocator.alloc<Node::Stmt>();
+            stmt->stmt = import;
+            return stmt;
+        }
+
         /// END OF TOKENS OR END OF SCOPE
         case TokenType::new_line:
         case TokenType::scope_close:
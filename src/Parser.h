@@ -13,18 +13,29 @@ public:
             : tokens(vector), m_allocator(1024 * 1024 * 10) // 10 MB
     {}
     inline void Clear(){ m_allocator.Delete(); }
+    inline const ArenaAllocator& GetArena() const { return m_allocator; }
     Node::Program* parse();
 
 private:
 
     Node::Term* parseTerm();
     std::optional<Node::Stmt*> parseStmt();
+    std::optional<Node::Stmt*> parseStmtKind();
     bool isBinOp(const TokenType type);
     bool isLitBool(TokenType type);
+    /// An identifier followed by `(`, there are no functions so it can only be a builtin
+    bool isBuiltinCall();
     bool isIntIdent(const std::string& ident);
+    /// Whether an int expression starting with `term` is unsigned
+    bool isUnsignedTerm(const Node::Term* term);
     int getBinPrec(TokenType type);
     Node::IntExpr* parseIntExpr(const int min_prec = 0);
     VarType getIdentType(const std::string& ident);
+    /// The number of elements of an array, 0 for every other variable
+    uint64_t getIdentLength(const std::string& ident);
+    Node::Variable* getIdentVariable(const std::string& ident);
+    /// `[index]` after the name of an array, the token after the `]` is next
+    Node::TermIndex* parseIndex(Node::Ident* ident);
     Node::BoolTerm* parseBoolTerm();
     Node::Comparison parseComparison();
     Node::BoolExpr* parseBoolExpr();
@@ -34,6 +45,7 @@ private:
 
     std::vector<Token> tokens;
     uint64_t index;
+    std::vector<Node::Scope*> scopes; // the scopes the parser is in, for finding the variables declared in them
     Node::Program program;
     ArenaAllocator m_allocator;
 };
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "Profile.h"
+#include "Sha256.h"
+
+#include <filesystem>
+
+uint64_t Profile::Hash(const std::vector<std::string>& sources) {
+    Sha256 hash;
+    for(const std::string& source : sources){
+        hash.Update("source " + std::to_string(source.size()) + '\n');
+        hash.Update(source);
+    }
+    return std::stoull(hash.HexDigest().substr(0, 16), nullptr, 16);
+}
+
+std::string Profile::DefaultPath(const std::string& input_file) {
+    std::string name = input_file == "-" ? "a" : input_file.substr(0, input_file.length() - 3);
+    std::error_code error;
+    return std::filesystem::absolute(name + ".gxprof", error).string();
+}
+
+bool Profile::Read(const std::string& path, uint64_t hash) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()){
+        error = "Failed to open the profile `" + path + "`";
+        return false;
+    }
+
+    auto read = [&file](uint64_t& value){
+        uint8_t bytes[8];
+        if(!file.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+            return false;
+        value = 0;
+        for(int i = 7; i >= 0; i--)
+            value = value << 8 | bytes[i];
+        return true;
+    };
+
+    uint64_t file_magic, file_hash, count;
+    if(!read(file_magic) || !read(file_hash) || !read(count) || file_magic != magic){
+        error = "`" + path + "` is not a GalaxiC profile";
+        return false;
+    }
+    if(file_hash != hash){
+        error = "The profile `" + path + "` is of a different version of the program";
+        return false;
+    }
+
+    // the counters are read one by one, a broken count can't make it allocate more than the file holds
+    for(uint64_t i = 0; i < count; i++){
+        uint64_t counter;
+        if(!read(counter)){
+            error = "The profile `" + path + "` ends early";
+            return false;
+        }
+        counters.emplace_back(counter);
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "PCH.h"
+
+/// The counts a program built with -fprofile-generate writes when it ends. The file is the magic, the hash of the
+/// program's sources, how many counters follow and the counters, every value a little endian 64-bit number
+class Profile{
+public:
+    static constexpr uint64_t magic = 0x0031464F52505847; // "GXPROF1"
+
+    /// The hash of the sources of every module, a profile of a changed program is not used
+    static uint64_t Hash(const std::vector<std::string>& sources);
+    /// <input>.gxprof next to the program, the file of -fprofile-generate and -fprofile-use without one
+    static std::string DefaultPath(const std::string& input_file);
+
+    /// Reads the profile at `path` of the program with `hash`
+    bool Read(const std::string& path, uint64_t hash);
+    inline const std::vector<uint64_t>& GetCounters() const { return counters; }
+    inline const std::string& GetError() const { return error; }
+
+private:
+
+    std::vector<uint64_t> counters;
+    std::string error;
+};
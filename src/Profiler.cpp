@@ -0,0 +1,168 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+static std::chrono::steady_clock::time_point epoch;
+static std::atomic<uint32_t> next_thread{0};
+static thread_local uint32_t thread_index = UINT32_MAX;
+static thread_local uint32_t depth = 0;
+
+int64_t Profiler::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+Profiler::Scope::Scope(const char* phase) : name(phase), start(-1) {
+    if(!IsEnabled())
+        return;
+    depth++;
+    start = Now();
+}
+
+Profiler::Scope::~Scope() {
+    if(start < 0)
+        return;
+    Record(name, start, Now());
+    depth--;
+}
+
+void Profiler::Enable(bool report, const std::string& trace_path) {
+    if(IsEnabled())
+        return;
+    epoch = std::chrono::steady_clock::now();
+    print_report = report;
+    trace_file = trace_path;
+    enabled = true;
+    std::atexit(Finish);
+}
+
+void Profiler::Record(const char* name, int64_t start, int64_t end) {
+    if(thread_index == UINT32_MAX)
+        thread_index = next_thread++;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(Event{name, start, end - start, thread_index, depth});
+}
+
+void Profiler::Count(const char* counter, int64_t value) {
+    if(!IsEnabled())
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& [name, total] : counters){
+        if(std::strcmp(name, counter) == 0){
+            total += value;
+            return;
+        }
+    }
+    counters.emplace_back(counter, value);
+}
+
+void Profiler::Finish() {
+    if(print_report)
+        Report();
+    if(!trace_file.empty() && !WriteTrace(trace_file))
+        std::cerr << "Failed to write the trace to `" << trace_file << "`\n";
+}
+
+void Profiler::Report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    double wall = static_cast<double>(Now()) / 1e6;
+
+    // a phase that ran more than once, like parsing every module, is one row in the order it first started.
+    // The module threads start without the phases of the main thread around them, so a row is as deep as it first was
+    struct Row{
+        const char* name;
+        uint32_t depth;
+        int64_t first;
+        int64_t total = 0;
+        size_t calls = 0;
+    };
+    std::vector<Row> rows;
+    for(const Event& event : events){
+        auto it = std::find_if(rows.begin(), rows.end(), [&](const Row& row){
+            return std::strcmp(row.name, event.name) == 0;
+        });
+        if(it == rows.end()){
+            rows.push_back(Row{event.name, event.depth, event.start});
+            it = rows.end() - 1;
+        }
+        if(event.start < it->first){
+            it->first = event.start;
+            it->depth = event.depth;
+        }
+        it->total += event.duration;
+        it->calls++;
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b){ return a.first < b.first; });
+
+    std::ostream& out = std::cerr;
+    out << std::fixed << std::setprecision(3);
+    out << "\n  phase                                   calls        ms      %\n";
+    for(const Row& row : rows){
+        std::string name = std::string(2 * (std::max(row.depth, 1u) - 1), ' ') + row.name;
+        double ms = static_cast<double>(row.total) / 1e6;
+        out << "  " << std::left << std::setw(36) << name << std::right << std::setw(7) << row.calls
+            << std::setw(12) << ms << std::setw(7) << std::setprecision(1) << (wall > 0 ? 100 * ms / wall : 0)
+            << std::setprecision(3) << '\n';
+    }
+    out << "  " << std::left << std::setw(36) << "total" << std::right << std::setw(19) << wall << '\n';
+
+    if(!counters.empty())
+        out << '\n';
+    for(const auto& [name, total] : counters)
+        out << "  " << std::left << std::setw(36) << name << std::right << std::setw(19) << total << '\n';
+
+    // the peak of nasm and gcc is separate, they never share memory with the compiler
+    rusage self{}, children{};
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    out << "\n  " << std::left << std::setw(36) << "peak rss (KB)" << std::right << std::setw(19) << self.ru_maxrss << '\n';
+    if(children.ru_maxrss > 0)
+        out << "  " << std::left << std::setw(36) << "peak rss of tools (KB)" << std::right << std::setw(19)
+            << children.ru_maxrss << '\n';
+    out.flush();
+}
+
+/// Names are written from string literals of the compiler, only quotes and backslashes need escaping
+static std::string JsonString(const char* str){
+    std::string escaped = "\"";
+    for(const char* c = str; *c; c++){
+        if(*c == '"' || *c == '\\')
+            escaped += '\\';
+        escaped += *c;
+    }
+    return escaped + '"';
+}
+
+bool Profiler::WriteTrace(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream file(path);
+    if(!file.is_open())
+        return false;
+
+    // complete events in microseconds, the counters are one counter event at the end of the compile
+    long pid = static_cast<long>(getpid());
+    file << "{\"traceEvents\":[\n";
+    file << std::fixed << std::setprecision(3);
+    for(size_t i = 0; i < events.size(); i++){
+        const Event& event = events.at(i);
+        file << "{\"name\":" << JsonString(event.name) << ",\"cat\":\"compile\",\"ph\":\"X\",\"ts\":"
+             << static_cast<double>(event.start) / 1e3 << ",\"dur\":" << static_cast<double>(event.duration) / 1e3
+             << ",\"pid\":" << pid << ",\"tid\":" << event.thread << "},\n";
+    }
+
+    rusage self{};
+    getrusage(RUSAGE_SELF, &self);
+    file << "{\"name\":\"counters\",\"ph\":\"C\",\"ts\":" << static_cast<double>(Now()) / 1e3 << ",\"pid\":" << pid
+         << ",\"tid\":0,\"args\":{\"peak rss (KB)\":" << self.ru_maxrss;
+    for(const auto& [name, total] : counters)
+        file << "," << JsonString(name) << ":" << total;
+    file << "}}\n]}\n";
+    return file.good();
+}
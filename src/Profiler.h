@@ -0,0 +1,56 @@
+#pragma once
+
+#include "PCH.h"
+
+#include <atomic>
+#include <mutex>
+
+/// Times the phases of a compile and counts what they worked on. Nothing is recorded until it is enabled with
+/// -ftime-report or --trace, a disabled scope only checks a flag
+class Profiler{
+public:
+    /// Times everything from its construction until it goes out of scope, scopes in scopes are sub-phases
+    class Scope{
+    public:
+        explicit Scope(const char* phase);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        int64_t start;
+    };
+
+    /// Starts recording, the report and the trace are written when the compiler exits, however it exits
+    static void Enable(bool report, const std::string& trace_path);
+    inline static bool IsEnabled(){ return enabled.load(std::memory_order_relaxed); }
+    /// Adds `value` to the counter, like the number of tokens or arena bytes
+    static void Count(const char* counter, int64_t value);
+
+    /// Prints every phase with its time and share of the whole compile, the counters and the peak memory
+    static void Report();
+    /// Writes the phases as Chrome trace events, open it in chrome://tracing or ui.perfetto.dev
+    static bool WriteTrace(const std::string& path);
+
+private:
+
+    struct Event{
+        const char* name;
+        int64_t start;    // ns since the profiler was enabled
+        int64_t duration;
+        uint32_t thread;
+        uint32_t depth;
+    };
+
+    static int64_t Now();
+    static void Record(const char* name, int64_t start, int64_t end);
+    static void Finish();
+
+    inline static std::atomic<bool> enabled{false};
+    inline static bool print_report = false;
+    inline static std::string trace_file;
+    inline static std::mutex mutex; // guards the events and counters, the module threads record at once
+    inline static std::vector<Event> events;
+    inline static std::vector<std::pair<const char*, int64_t>> counters;
+};
@@ -0,0 +1,315 @@
+#include "RangeAnalysis.h"
+
+/// Whether `stmt` may change `ident`, declaring another variable with its name or inline assembly count
+static bool Assigns(const Node::Stmt* stmt, const std::string& ident){
+    auto scope = [&](const Node::Scope* body){
+        return std::any_of(body->stmts.begin(), body->stmts.end(), [&](const Node::Stmt* inner){
+            return Assigns(inner, ident);
+        });
+    };
+
+    if(auto node = std::get_if<Node::Reassign*>(&stmt->stmt))
+        return (*node)->ident->value == ident;
+    if(auto node = std::get_if<Node::Variable*>(&stmt->stmt))
+        return (*node)->ident->value == ident;
+    if(auto node = std::get_if<Node::Assembly*>(&stmt->stmt))
+        return (*node)->section == Node::Asm_Section::text;
+    if(auto node = std::get_if<Node::Scope*>(&stmt->stmt))
+        return scope(*node);
+    if(auto node = std::get_if<Node::If*>(&stmt->stmt))
+        return scope((*node)->stmt);
+    if(auto node = std::get_if<Node::Elif*>(&stmt->stmt))
+        return scope((*node)->stmt);
+    if(auto node = std::get_if<Node::Else*>(&stmt->stmt))
+        return scope((*node)->stmt);
+    if(auto node = std::get_if<Node::While*>(&stmt->stmt))
+        return (*node)->scope.has_value() && scope((*node)->scope.value());
+    return false;
+}
+
+/// Adds up the literals the statements add to `ident` with `i = i + c`, false when anything else changes it
+static bool SumIncrements(const std::vector<Node::Stmt*>& stmts, const std::string& ident, uint64_t max, uint64_t& sum){
+    for(const Node::Stmt* stmt : stmts){
+        if(!Assigns(stmt, ident))
+            continue;
+
+        if(auto node = std::get_if<Node::Reassign*>(&stmt->stmt)){
+            // `i++` and `i += c` are parsed as `i = i + c`
+            auto bin = std::get_if<Node::BinExpr*>(&(*node)->expr->var);
+            auto add = bin ? std::get_if<Node::BinExprAdd*>(&(*bin)->expr) : nullptr;
+            if(!add)
+                return false;
+            const Node::IntExpr* other = (*add)->rhs;
+            if(!Node::GetIdent((*add)->lhs) || Node::GetIdent((*add)->lhs)->value != ident){
+                if(!Node::GetIdent((*add)->rhs) || Node::GetIdent((*add)->rhs)->value != ident)
+                    return false;
+                other = (*add)->lhs;
+            }
+            int64_t value;
+            if(!Node::GetLiteral(other, value) || value < 0 || static_cast<uint64_t>(value) > max - sum)
+                return false;
+            sum += static_cast<uint64_t>(value);
+        }
+        // an increment in a nested loop can run any number of times
+        else if(auto node = std::get_if<Node::Scope*>(&stmt->stmt)){
+            if(!SumIncrements((*node)->stmts, ident, max, sum))
+                return false;
+        }
+        else if(auto node = std::get_if<Node::If*>(&stmt->stmt)){
+            if(!SumIncrements((*node)->stmt->stmts, ident, max, sum))
+                return false;
+        }
+        else if(auto node = std::get_if<Node::Elif*>(&stmt->stmt)){
+            if(!SumIncrements((*node)->stmt->stmts, ident, max, sum))
+                return false;
+        }
+        else if(auto node = std::get_if<Node::Else*>(&stmt->stmt)){
+            if(!SumIncrements((*node)->stmt->stmts, ident, max, sum))
+                return false;
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+std::unordered_set<const Node::IntExpr*> RangeAnalysis::FindSafeIndexes(const std::vector<Node::Stmt*>& stmts) {
+    declarations.clear();
+    scopes.clear();
+    facts.clear();
+    safe.clear();
+    VisitStmts(stmts);
+    return std::move(safe);
+}
+
+const RangeAnalysis::Declaration* RangeAnalysis::Find(const std::string& ident) {
+    // the newest declaration, the one the generator uses, those of the scopes that ended are already gone
+    for(auto declaration = declarations.rbegin(); declaration != declarations.rend(); declaration++){
+        if(declaration->ident == ident)
+            return &*declaration;
+    }
+    return nullptr;
+}
+
+void RangeAnalysis::VisitStmts(const std::vector<Node::Stmt*>& stmts) {
+    for(size_t i = 0; i < stmts.size(); i++){
+        // what the statement assigns is not known to be in range anywhere in it, its loops run it again
+        for(Fact& fact : facts){
+            if(fact.live && Assigns(stmts.at(i), fact.ident))
+                fact.live = false;
+        }
+        VisitStmt(stmts, i);
+    }
+}
+
+void RangeAnalysis::VisitScope(const Node::Scope* scope) {
+    scopes.emplace_back(declarations.size());
+    VisitStmts(scope->stmts);
+    declarations.resize(scopes.back());
+    scopes.pop_back();
+}
+
+void RangeAnalysis::VisitStmt(const std::vector<Node::Stmt*>& stmts, size_t index) {
+    const Node::Stmt* stmt = stmts.at(index);
+
+    if(auto node = std::get_if<Node::Variable*>(&stmt->stmt)){
+        const Node::Variable* var = *node;
+        if(var->expr && std::holds_alternative<Node::IntExpr*>(var->expr->expr))
+            VisitExpr(std::get<Node::IntExpr*>(var->expr->expr));
+        else if(var->expr)
+            VisitBoolExpr(std::get<Node::BoolExpr*>(var->expr->expr));
+        declarations.emplace_back(Declaration{var->ident->value, var->type, var->length});
+    }
+    else if(auto node = std::get_if<Node::Reassign*>(&stmt->stmt))
+        VisitExpr((*node)->expr);
+    else if(auto node = std::get_if<Node::IndexAssign*>(&stmt->stmt)){
+        VisitExpr((*node)->expr);
+        VisitExpr((*node)->index);
+        VisitIndex((*node)->ident, (*node)->index);
+    }
+    else if(auto node = std::get_if<Node::Exit*>(&stmt->stmt))
+        VisitExpr((*node)->expr);
+    else if(auto node = std::get_if<Node::Scope*>(&stmt->stmt))
+        VisitScope(*node);
+    else if(auto node = std::get_if<Node::If*>(&stmt->stmt)){
+        VisitBoolExpr((*node)->expr);
+        VisitScope((*node)->stmt);
+    }
+    else if(auto node = std::get_if<Node::Elif*>(&stmt->stmt)){
+        VisitBoolExpr((*node)->expr);
+        VisitScope((*node)->stmt);
+    }
+    else if(auto node = std::get_if<Node::Else*>(&stmt->stmt))
+        VisitScope((*node)->stmt);
+    else if(auto node = std::get_if<Node::While*>(&stmt->stmt)){
+        const Node::While* loop = *node;
+        VisitBoolExpr(loop->expr);
+        if(!loop->scope.has_value())
+            return;
+
+        // the body only runs after the condition was true
+        std::vector<Fact> bounds;
+        FindBounds(loop->expr, bounds);
+        size_t outer = facts.size();
+        for(const Fact& bound : bounds){
+            if(StaysInRange(bound.ident, bound.bound, stmts, index))
+                facts.emplace_back(bound);
+        }
+        VisitScope(loop->scope.value());
+        facts.resize(outer);
+    }
+}
+
+void RangeAnalysis::VisitExpr(const Node::IntExpr* expr) {
+    if(auto bin = std::get_if<Node::BinExpr*>(&expr->var)){
+        std::visit([this](auto* side){
+            VisitExpr(side->lhs);
+            VisitExpr(side->rhs);
+        }, (*bin)->expr);
+        return;
+    }
+
+    const Node::Term* term = std::get<Node::Term*>(expr->var);
+    while(auto _not = std::get_if<Node::TermNot*>(&term->term))
+        term = (*_not)->term;
+    if(auto paren = std::get_if<Node::TermParen*>(&term->term))
+        VisitExpr((*paren)->expr);
+    else if(auto builtin = std::get_if<Node::TermBuiltin*>(&term->term))
+        VisitExpr((*builtin)->expr);
+    else if(auto element = std::get_if<Node::TermIndex*>(&term->term)){
+        VisitExpr((*element)->index);
+        VisitIndex((*element)->ident, (*element)->index);
+    }
+}
+
+void RangeAnalysis::VisitBoolTerm(const Node::BoolTerm* term) {
+    if(auto compare = std::get_if<Node::BoolTermInt*>(&term->term)){
+        VisitExpr((*compare)->lhs);
+        VisitExpr((*compare)->rhs);
+    }
+    else if(auto paren = std::get_if<Node::BoolTermParen*>(&term->term))
+        VisitBoolExpr((*paren)->expr);
+}
+
+void RangeAnalysis::VisitBoolExpr(const Node::BoolExpr* expr) {
+    auto side = [this](const std::variant<Node::BoolTerm*, Node::BoolExpr*>& side){
+        if(std::holds_alternative<Node::BoolTerm*>(side))
+            VisitBoolTerm(std::get<Node::BoolTerm*>(side));
+        else
+            VisitBoolExpr(std::get<Node::BoolExpr*>(side));
+    };
+
+    if(auto term = std::get_if<Node::BoolTerm*>(&expr->expr))
+        VisitBoolTerm(*term);
+    else if(auto _and = std::get_if<Node::BoolExprAnd*>(&expr->expr)){
+        side((*_and)->lhs);
+        side((*_and)->rhs);
+    }
+    else if(auto _or = std::get_if<Node::BoolExprOr*>(&expr->expr)){
+        side((*_or)->lhs);
+        side((*_or)->rhs);
+    }
+}
+
+void RangeAnalysis::VisitIndex(const Node::Ident* array, const Node::IntExpr* index) {
+    const Declaration* declaration = Find(array->value);
+    const Node::Ident* ident = Node::GetIdent(index);
+    if(!declaration || !ident)
+        return;
+
+    for(const Fact& fact : facts){
+        if(fact.live && fact.ident == ident->value && fact.bound <= declaration->length){
+            safe.insert(index);
+            return;
+        }
+    }
+}
+
+void RangeAnalysis::FindBounds(const Node::BoolExpr* expr, std::vector<Fact>& bounds) {
+    auto term_bound = [&](const Node::BoolTerm* term){
+        if(auto paren = std::get_if<Node::BoolTermParen*>(&term->term)){
+            FindBounds((*paren)->expr, bounds);
+            return;
+        }
+        auto compare = std::get_if<Node::BoolTermInt*>(&term->term);
+        if(!compare)
+            return;
+
+        // `i < n`, `i <= n`, `n > i` and `n >= i`
+        const Node::Ident* ident = Node::GetIdent((*compare)->lhs);
+        int64_t value;
+        bool literal = Node::GetLiteral((*compare)->rhs, value);
+        Node::Comparison comp = (*compare)->comp;
+        if(!ident || !literal){
+            ident = Node::GetIdent((*compare)->rhs);
+            literal = Node::GetLiteral((*compare)->lhs, value);
+            if(comp == Node::Comparison::greater)
+                comp = Node::Comparison::less;
+            else if(comp == Node::Comparison::greater_equal)
+                comp = Node::Comparison::less_equal;
+            else
+                return;
+        }
+        if(!ident || !literal || value < 0 || value >= INT32_MAX)
+            return;
+        if(comp == Node::Comparison::less)
+            bounds.emplace_back(Fact{ident->value, static_cast<uint64_t>(value), true});
+        else if(comp == Node::Comparison::less_equal)
+            bounds.emplace_back(Fact{ident->value, static_cast<uint64_t>(value) + 1, true});
+    };
+
+    // every condition of an `&&` chain is true in the body, one of an `||` may not be
+    if(auto term = std::get_if<Node::BoolTerm*>(&expr->expr))
+        term_bound(*term);
+    else if(auto _and = std::get_if<Node::BoolExprAnd*>(&expr->expr)){
+        for(const auto* side : {&(*_and)->lhs, &(*_and)->rhs}){
+            if(std::holds_alternative<Node::BoolTerm*>(*side))
+                term_bound(std::get<Node::BoolTerm*>(*side));
+            else
+                FindBounds(std::get<Node::BoolExpr*>(*side), bounds);
+        }
+    }
+}
+
+bool RangeAnalysis::StaysInRange(const std::string& ident, uint64_t bound, const std::vector<Node::Stmt*>& stmts,
+                                 size_t index) {
+    const Declaration* declaration = Find(ident);
+    if(!declaration || declaration->length != 0 || declaration->type == VarType::_bool)
+        return false;
+    // an unsigned `i < n` is compared unsigned, it can't be below 0
+    if(IsUnsigned(declaration->type))
+        return true;
+
+    uint64_t max = INT64_MAX;
+    switch(declaration->type){
+        case VarType::_char: max = INT8_MAX; break;
+        case VarType::_short: max = INT16_MAX; break;
+        case VarType::_int: max = INT32_MAX; break;
+        default: break;
+    }
+
+    // the body keeps i from n - 1 + what it adds, that has to fit in the type so it can't wrap around below 0
+    const Node::While* loop = std::get<Node::While*>(stmts.at(index)->stmt);
+    uint64_t sum = 0;
+    if(bound > max || !SumIncrements(loop->scope.value()->stmts, ident, max - bound, sum))
+        return false;
+
+    // the last statement before the loop that changes i has to make it a literal that is 0 or more
+    for(size_t i = index; i-- > 0;){
+        const Node::Stmt* stmt = stmts.at(i);
+        if(!Assigns(stmt, ident))
+            continue;
+
+        const Node::IntExpr* value = nullptr;
+        if(auto node = std::get_if<Node::Variable*>(&stmt->stmt)){
+            if((*node)->expr && std::holds_alternative<Node::IntExpr*>((*node)->expr->expr))
+                value = std::get<Node::IntExpr*>((*node)->expr->expr);
+        }
+        else if(auto node = std::get_if<Node::Reassign*>(&stmt->stmt))
+            value = (*node)->expr;
+
+        int64_t literal;
+        return value && Node::GetLiteral(value, literal) && literal >= 0 && static_cast<uint64_t>(literal) <= max;
+    }
+    return false;
+}
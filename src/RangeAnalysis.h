@@ -0,0 +1,50 @@
+#pragma once
+
+#include <unordered_set>
+
+#include "PCH.h"
+#include "Node.h"
+
+/// Finds the indexes of arrays that are surely in bounds, -fbounds-check doesn't check them.
+/// In the body of `while(i < n)` the index `i` is from 0 to n - 1 until i is assigned when
+///  - i is unsigned, or a signed i is 0 or more when the loop starts and the body only adds literals that are 0 or
+///    more to it without overflowing, outside of loops nested in the body
+///  - n is at most the length of the array and `i < n` is the condition or one of the conditions joined by `&&`
+class RangeAnalysis{
+public:
+    /// The index expressions of `arr[i]` and `arr[i] = x` in `stmts` that need no check
+    std::unordered_set<const Node::IntExpr*> FindSafeIndexes(const std::vector<Node::Stmt*>& stmts);
+
+private:
+
+    struct Declaration{
+        std::string ident;
+        VarType type;
+        uint64_t length;
+    };
+    /// `ident` is below `bound` and 0 or more
+    struct Fact{
+        std::string ident;
+        uint64_t bound;
+        bool live;
+    };
+
+    void VisitStmts(const std::vector<Node::Stmt*>& stmts);
+    void VisitScope(const Node::Scope* scope);
+    void VisitStmt(const std::vector<Node::Stmt*>& stmts, size_t index);
+    void VisitExpr(const Node::IntExpr* expr);
+    void VisitBoolExpr(const Node::BoolExpr* expr);
+    void VisitBoolTerm(const Node::BoolTerm* term);
+    void VisitIndex(const Node::Ident* array, const Node::IntExpr* index);
+    /// The `ident < literal` conditions of the `&&` chain of `expr`
+    void FindBounds(const Node::BoolExpr* expr, std::vector<Fact>& bounds);
+    /// Whether `ident` stays 0 or more in the loop of `stmts[index]`, whose body runs only while it is below `bound`
+    bool StaysInRange(const std::string& ident, uint64_t bound, const std::vector<Node::Stmt*>& stmts, size_t index);
+    /// The declaration `ident` is of, the innermost one that can be seen, nullptr when there is none
+    const Declaration* Find(const std::string& ident);
+
+    std::vector<Declaration> declarations;
+    std::vector<size_t> scopes; // how many declarations there were when the scope started
+    std::vector<Fact> facts;
+    std::unordered_set<const Node::IntExpr*> safe;
+};
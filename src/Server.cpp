@@ -0,0 +1,339 @@
+#include "Server.h"
+#include "Log.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+// a request is this header with the client's stdin, stdout and stderr attached, then `size` bytes of
+// nul terminated strings, the working directory, `args` arguments and the environment. The reply is the exit code
+struct RequestHeader{
+    uint32_t size;
+    uint32_t args;
+};
+
+static int signal_pipe = -1;
+static volatile sig_atomic_t stopping = 0;
+
+static void OnSignal(int signal){
+    if(signal != SIGCHLD)
+        stopping = 1;
+    int saved = errno;
+    char byte = 0;
+    (void)!write(signal_pipe, &byte, 1);
+    errno = saved;
+}
+
+static bool WriteAll(int fd, const void* data, size_t size){
+    auto bytes = static_cast<const char*>(data);
+    while(size > 0){
+        ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool ReadAll(int fd, void* data, size_t size){
+    auto bytes = static_cast<char*>(data);
+    while(size > 0){
+        ssize_t got = read(fd, bytes, size);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            return false;
+        bytes += got;
+        size -= got;
+    }
+    return true;
+}
+
+static bool MakeAddress(const std::string& path, sockaddr_un& address){
+    address = {};
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path))
+        return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/// Whether the process at the other end of `connection` runs as this user, the socket path can be bound by anyone
+/// who got to it first and a request hands over the environment, the working directory and stdin, stdout and stderr
+static bool IsOwnUser(int connection){
+    ucred peer{};
+    socklen_t size = sizeof(peer);
+    return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 && size == sizeof(peer) &&
+           peer.uid == getuid();
+}
+
+Server::~Server() {
+    if(listener < 0)
+        return;
+    close(listener);
+    unlink(path.c_str());
+}
+
+std::string Server::DefaultSocket() {
+    if(const char* socket = std::getenv("GALAXIC_SOCKET"))
+        return socket;
+    if(const char* runtime = std::getenv("XDG_RUNTIME_DIR"))
+        return std::string(runtime) + "/galaxic.sock";
+    return "/tmp/galaxic-" + std::to_string(getuid()) + ".sock";
+}
+
+bool Server::Fail(const std::string& msg) {
+    error = msg;
+    return false;
+}
+
+bool Server::Listen() {
+    sockaddr_un address{};
+    if(!MakeAddress(path, address))
+        return Fail("The socket path `" + path + "` is too long");
+
+    struct stat info{};
+    bool exists = lstat(path.c_str(), &info) == 0;
+    if(exists && info.st_uid != getuid())
+        return Fail("`" + path + "` belongs to another user");
+
+    // a socket file without a server behind it is left over from a server that was killed
+    int ignored;
+    if(Server::Request(path, {}, ignored))
+        return Fail("A server is already listening on `" + path + "`");
+    if(exists && S_ISSOCK(info.st_mode))
+        unlink(path.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listener < 0)
+        return Fail(std::string("Failed to create the socket, ") + strerror(errno));
+
+    // only the user starting the server can connect, every request runs with the server's permissions
+    mode_t mask = umask(0077);
+    int bound = bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    umask(mask);
+    if(bound != 0 || listen(listener, 128) != 0){
+        std::string reason = strerror(errno);
+        close(listener);
+        listener = -1;
+        return Fail("Failed to listen on `" + path + "`, " + reason);
+    }
+    return true;
+}
+
+void Server::Serve(const Handler& handler) {
+    int pipe_fds[2];
+    if(pipe2(pipe_fds, O_CLOEXEC | O_NONBLOCK) != 0){
+        Log::Error(std::string("Failed to create the signal pipe, ") + strerror(errno));
+        return;
+    }
+    signal_pipe = pipe_fds[1];
+
+    struct sigaction action{};
+    action.sa_handler = OnSignal;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::cout.flush();
+    while(!stopping){
+        pollfd fds[2] = {{listener, POLLIN, 0}, {pipe_fds[0], POLLIN, 0}};
+        if(poll(fds, 2, -1) < 0){
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+
+        if(fds[1].revents & POLLIN){
+            char drain[64];
+            while(read(pipe_fds[0], drain, sizeof(drain)) > 0){}
+            Reap();
+        }
+        if(!(fds[0].revents & POLLIN))
+            continue;
+
+        int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if(connection < 0)
+            continue;
+        if(!IsOwnUser(connection)){
+            close(connection);
+            continue;
+        }
+
+        pid_t pid = fork();
+        if(pid == 0){
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            RunRequest(connection, handler);
+        }
+        if(pid < 0){
+            int32_t failed = 1;
+            WriteAll(connection, &failed, sizeof(failed));
+            close(connection);
+            continue;
+        }
+        running.emplace(pid, connection);
+    }
+
+    // the compiles that already started still answer their clients
+    signal(SIGCHLD, SIG_DFL);
+    for(const auto& [pid, connection] : running){
+        int status = 0;
+        waitpid(pid, &status, 0);
+        int32_t code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        WriteAll(connection, &code, sizeof(code));
+        close(connection);
+    }
+    running.clear();
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    signal_pipe = -1;
+}
+
+void Server::Reap() {
+    int status = 0;
+    pid_t pid;
+    while((pid = waitpid(-1, &status, WNOHANG)) > 0){
+        auto it = running.find(pid);
+        if(it == running.end())
+            continue;
+        int32_t code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        WriteAll(it->second, &code, sizeof(code));
+        close(it->second);
+        running.erase(it);
+    }
+}
+
+void Server::RunRequest(int connection, const Handler& handler) {
+    close(listener);
+    listener = -1;
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+
+    RequestHeader header{};
+    int fds[3] = {-1, -1, -1};
+    char control[CMSG_SPACE(sizeof(fds))];
+    iovec vector{&header, sizeof(header)};
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if(recvmsg(connection, &message, MSG_CMSG_CLOEXEC) != sizeof(header))
+        _exit(1);
+
+    cmsghdr* fd_message = CMSG_FIRSTHDR(&message);
+    if(!fd_message || fd_message->cmsg_type != SCM_RIGHTS || fd_message->cmsg_len != CMSG_LEN(sizeof(fds)))
+        _exit(1);
+    std::memcpy(fds, CMSG_DATA(fd_message), sizeof(fds));
+
+    std::string payload(header.size, '\0');
+    if(!ReadAll(connection, payload.data(), payload.size()) || (!payload.empty() && payload.back() != '\0'))
+        _exit(1);
+
+    std::vector<char*> strings;
+    for(size_t i = 0; i < payload.size(); i = payload.find('\0', i) + 1)
+        strings.emplace_back(payload.data() + i);
+    if(strings.size() < header.args + 1)
+        _exit(1);
+    // an empty request only checks that the server is there
+    if(header.args == 0)
+        _exit(0);
+
+    for(int i = 0; i < 3; i++){
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+    if(chdir(strings.at(0)) != 0){
+        Log::Error(std::string("The server can't enter the directory `") + strings.at(0) + "`");
+        exit(1);
+    }
+    clearenv();
+    for(size_t i = header.args + 1; i < strings.size(); i++)
+        putenv(strings.at(i));
+
+    std::string name = "GalaxiC";
+    std::vector<char*> argv = {name.data()};
+    argv.insert(argv.end(), strings.begin() + 1, strings.begin() + 1 + header.args);
+    argv.emplace_back(nullptr);
+
+    int code = handler(static_cast<int>(argv.size() - 1), argv.data());
+    exit(code);
+}
+
+bool Server::Request(const std::string& socket_path, const std::vector<std::string>& args, int& exit_code) {
+    sockaddr_un address{};
+    if(!MakeAddress(socket_path, address))
+        return false;
+
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(connection < 0)
+        return false;
+    if(connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0){
+        close(connection);
+        return false;
+    }
+    // nothing goes to a server of another user, the compile runs here instead
+    if(!IsOwnUser(connection)){
+        close(connection);
+        Log::Warning("The server on `" + socket_path + "` is run by another user, it is not used");
+        return false;
+    }
+
+    std::string payload;
+    std::string directory = std::filesystem::current_path().string();
+    payload.append(directory.c_str(), directory.size() + 1);
+    for(const std::string& arg : args)
+        payload.append(arg.c_str(), arg.size() + 1);
+    for(char** env = environ; *env; env++)
+        payload.append(*env, strlen(*env) + 1);
+
+    RequestHeader header{static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(args.size())};
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))] = {};
+    iovec vector{&header, sizeof(header)};
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* fd_message = CMSG_FIRSTHDR(&message);
+    fd_message->cmsg_level = SOL_SOCKET;
+    fd_message->cmsg_type = SCM_RIGHTS;
+    fd_message->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(fd_message), fds, sizeof(fds));
+
+    // what the program prints goes straight to our stdout, anything still buffered has to be out first
+    std::cout.flush();
+    int32_t code = 1;
+    bool answered = sendmsg(connection, &message, MSG_NOSIGNAL) == sizeof(header) &&
+                    WriteAll(connection, payload.data(), payload.size()) &&
+                    ReadAll(connection, &code, sizeof(code));
+    close(connection);
+
+    if(!answered)
+        return false;
+    exit_code = code;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PCH.h"
+
+#include <functional>
+#include <sys/types.h>
+
+/// A compiler that stays running and compiles for clients on a unix socket. Every request is compiled in a fork
+/// of the server, so it starts with the server's warm process and an error in one compile only ends that fork.
+/// The client sends its working directory, arguments, environment and its stdin, stdout and stderr,
+/// so a compile through the server behaves like running the compiler in the client's place
+class Server{
+public:
+    /// Compiles like main with the arguments of one request and returns the exit code for the client
+    using Handler = std::function<int(int argc, char* argv[])>;
+
+    explicit Server(std::string socket_path) : path(std::move(socket_path)) {}
+    ~Server();
+
+    /// $GALAXIC_SOCKET, otherwise galaxic.sock in $XDG_RUNTIME_DIR or a socket only for the user in /tmp
+    static std::string DefaultSocket();
+
+    /// Binds the socket, fails when another server already listens on it
+    bool Listen();
+    /// Runs the requests until the server gets SIGINT or SIGTERM
+    void Serve(const Handler& handler);
+    inline const std::string& GetError(){ return error; }
+
+    /// Sends `args` to the server at `socket` and waits for the exit code of the compile, false when no server listens
+    /// or the one listening runs as another user
+    static bool Request(const std::string& socket, const std::vector<std::string>& args, int& exit_code);
+
+private:
+
+    /// Runs in the fork, sets up the client's process state and never returns
+    [[noreturn]] void RunRequest(int connection, const Handler& handler);
+    /// Sends the exit code of every finished fork to its client
+    void Reap();
+    bool Fail(const std::string& msg);
+
+    std::string path;
+    int listener = -1;
+    std::unordered_map<pid_t, int> running; // the forks and the connections of their clients
+    std::string error;
+};
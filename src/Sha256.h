@@ -0,0 +1,23 @@
+#pragma once
+
+#include "PCH.h"
+
+/// SHA-256, used to name cache entries after everything that decides their contents
+class Sha256{
+public:
+    Sha256();
+
+    void Update(const void* data, size_t length);
+    inline void Update(const std::string& str){ Update(str.data(), str.size()); }
+    /// Ends the hash, the object can't be updated after it
+    std::string HexDigest();
+
+private:
+
+    void Block(const uint8_t* block);
+
+    uint32_t state[8];
+    uint8_t buffer[64];
+    size_t buffered = 0;
+    uint64_t length = 0; // in bytes
+};
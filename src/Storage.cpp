@@ -4,22 +4,27 @@ void Storage::StoreVariable(const std::string& ident, bool init, VarType type) {
     Variable var;
     var.ident = ident;
     var.init = init;
+    var.type = type;
 
     switch(type){
         case VarType::_char: // db
+        case VarType::_uchar:
         case VarType::_bool:
             var.size = 8;
             stack_size += 8;
             break;
         case VarType::_short: // dw
+        case VarType::_ushort:
             var.size = 16;
             stack_size += 16;
             break;
         case VarType::_int: // dd
+        case VarType::_uint:
             var.size = 32;
             stack_size += 32;
             break;
         case VarType::_long: // dq
+        case VarType::_ulong:
             var.size = 64;
             stack_size += 64;
             break;
@@ -32,30 +37,75 @@ void Storage::StoreVariable(const std::string& ident, bool init, VarType type) {
 
     variables.emplace_back(var);
 }
-bool Storage::IsIdentInit(const std::string &ident) {
-    for(Variable var : variables) {
-        if (var.ident != ident)
-            continue;
-        return var.init;
+void Storage::StoreArray(const std::string& ident, VarType type, uint64_t length, uint64_t size) {
+    Variable var;
+    var.ident = ident;
+    var.init = true; // the elements start at 0
+    var.type = type;
+    var.size = size;
+    var.length = length;
+    stack_size += size;
+
+    if(scopes.size() > 0) {
+        scopes.at(scopes.size() - 1).size += var.size;
+        scopes.at(scopes.size() - 1).vars++;
     }
 
-    Log::Error("Ident name was not found in the variables in the isIdentInit function");
+    variables.emplace_back(var);
+}
+void Storage::StorePacked(const std::string& ident, bool init, VarType type, uint64_t size, uint64_t offset) {
+    Variable var;
+    var.ident = ident;
+    var.init = init;
+    var.type = type;
+    var.size = size;
+    var.offset = offset;
+    stack_size += size;
+
+    if(scopes.size() > 0) {
+        scopes.at(scopes.size() - 1).size += var.size;
+        scopes.at(scopes.size() - 1).vars++;
+    }
+
+    variables.emplace_back(var);
+}
+const Storage::Variable& Storage::Find(const std::string& ident, const char* function) {
+    // the newest variable with the name, a variable of a scope hides the ones with its name outside of it
+    for(auto var = variables.rbegin(); var != variables.rend(); var++) {
+        if(var->ident == ident)
+            return *var;
+    }
+
+    Log::Error(std::string("Ident was not found in the variables in function ") + function);
     exit(1);
 }
+bool Storage::IsIdentInit(const std::string &ident) {
+    return Find(ident, "IsIdentInit").init;
+}
 size_t Storage::GetStackPosition(const std::string &ident) {
-    size_t ret_value = stack_size;
+    // the variables declared after it are below it on the stack
+    size_t ret_value = 0;
 
-    for(const Variable& var : variables) {
-        ret_value -= var.size;
+    for(auto var = variables.rbegin(); var != variables.rend(); var++) {
+        if(var->ident == ident)
+            return ret_value + var->offset;
 
-        if(var.ident == ident) {
-            return ret_value;
-        }
+        ret_value += var->size;
     }
 
     Log::Error("Ident was not found in the variables in function GetStackPosition");
     exit(1);
 }
+VarType Storage::GetType(const std::string& ident) {
+    return Find(ident, "GetType").type;
+}
+uint64_t Storage::GetLength(const std::string& ident) {
+    return Find(ident, "GetLength").length;
+}
+bool Storage::IsStatic(const std::string& ident) {
+    const Variable& var = Find(ident, "IsStatic");
+    return var.length != 0 && var.size == 0;
+}
 void Storage::CreateScope() {
     scopes.emplace_back(Scope{0, 0});
 }
@@ -8,8 +8,20 @@
 class Storage{
 public:
     void StoreVariable(const std::string& ident, bool init, VarType type);
+    /// An array of `length` elements taking `size` bytes of the stack, 0 for one in the bss
+    void StoreArray(const std::string& ident, VarType type, uint64_t length, uint64_t size);
+    /// A variable in a block of variables next to each other, the first one declared takes the `size` bytes of the
+    /// whole block and the ones declared right after it 0, `offset` is where the variable is in the block
+    void StorePacked(const std::string& ident, bool init, VarType type, uint64_t size, uint64_t offset);
     bool IsIdentInit(const std::string& ident);
     uint64_t GetStackPosition(const std::string& ident);
+    VarType GetType(const std::string& ident);
+    /// The number of elements of an array, 0 for every other variable
+    uint64_t GetLength(const std::string& ident);
+    /// An array outside of every scope, it lives in the bss and not on the stack
+    bool IsStatic(const std::string& ident);
+    /// Outside of every scope, where the variables live as long as the module
+    inline bool IsTopLevel() { return scopes.empty(); }
     inline uint64_t GetStackSize() { return stack_size; }
     void CreateScope();
     uint64_t EndScope(); // returns the stack size from last scope
@@ -20,12 +32,17 @@ private:
         bool init;
         std::string ident;
         size_t size;
+        VarType type;
+        uint64_t length = 0;
+        uint64_t offset = 0;
     };
     struct Scope{
         uint64_t vars; // how many vars declared to pop of the variables vector
         uint64_t size;
     };
 
+    const Variable& Find(const std::string& ident, const char* function);
+
     std::vector<Scope> scopes;
     std::vector<Variable> variables;
     uint64_t stack_size = 0;
@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+
+// which pool and queue the current thread works for, tasks it submits stay on its own queue
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local unsigned current_queue = 0;
+
+ThreadPool::ThreadPool(unsigned count) {
+    if(count == 0)
+        count = std::max(1u, std::thread::hardware_concurrency());
+
+    for(unsigned i = 0; i < count; i++)
+        queues.emplace_back(std::make_unique<Queue>());
+    for(unsigned i = 0; i < count; i++)
+        threads.emplace_back(&ThreadPool::Work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread& thread : threads)
+        thread.join();
+}
+
+void ThreadPool::Submit(Task task) {
+    unsigned index;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index = current_pool == this ? current_queue : next_queue++ % queues.size();
+        queued++;
+        pending++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues.at(index)->mutex);
+        queues.at(index)->tasks.emplace_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]{ return pending == 0; });
+}
+
+bool ThreadPool::Pop(unsigned index, Task& task) {
+    for(size_t i = 0; i < queues.size(); i++){
+        bool own = i == 0;
+        Queue& queue = *queues.at((index + i) % queues.size());
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty())
+            continue;
+
+        // the newest task of its own queue is the one most likely still in the cache
+        if(own){
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else{
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::Work(unsigned index) {
+    current_pool = this;
+    current_queue = index;
+
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]{ return stopping || queued > 0; });
+            if(stopping)
+                return;
+            queued--;
+        }
+
+        // a task is counted before it is pushed, so it can be a moment until it is in a queue
+        Task task;
+        while(!Pop(index, task))
+            std::this_thread::yield();
+        task();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--pending == 0)
+            idle.notify_all();
+    }
+}
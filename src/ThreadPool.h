@@ -0,0 +1,49 @@
+#pragma once
+
+#include "PCH.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// A fixed set of worker threads with one task queue each. A worker runs the newest task of its own queue
+/// and takes the oldest task of another queue when its own is empty
+class ThreadPool{
+public:
+    using Task = std::function<void()>;
+
+    /// 0 threads uses one per core
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Tasks can submit more tasks, those go to the queue of the worker running them
+    void Submit(Task task);
+    /// Returns when every task is done, including the ones submitted by other tasks
+    void Wait();
+    inline unsigned GetThreadCount() const { return static_cast<unsigned>(threads.size()); }
+
+private:
+
+    struct Queue{
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Work(unsigned index);
+    bool Pop(unsigned index, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    size_t queued = 0;  // tasks in the queues
+    size_t pending = 0; // tasks submitted and not done yet
+    unsigned next_queue = 0; // where tasks submitted from outside of the pool go
+    bool stopping = false;
+};
@@ -5,12 +5,14 @@
 enum class TokenType{
     exit, _if, _else, _while, _true, _false, // keywords
     // data types, example: the keyword 'int'
-    _int16, _int32, _int64, _string, _void, _let, _bool,
+    _int16, _int32, _int64, _uint8, _uint16, _uint32, _uint64, _string, _void, _let, _bool,
     // literal values like 1432 or "string value"
     lit_int, lit_string,
     // single char tokens
     semi, expr_open, expr_close, coma, colon, dot, _and, _or, _not, qmark, less_then, greater_then,
-    percent, hash, plus, minus, star, slash, equal, scope_open, scope_close,
+    percent, hash, plus, minus, star, slash, equal, scope_open, scope_close, caret, tilde,
+    bracket_open, bracket_close, // `[` and `]` of an array
+    shift_left, shift_right, // `<<` and `>>`, a `<` or `>` right before another one
     new_line,
     // others
     _import, define, link,
@@ -56,7 +56,7 @@ std::vector<Token> Tokenizer::tokenize() {
                 if (isStringInteger(buffer)) {
                     tokens.emplace_back(Token{TokenType::lit_int, buffer, line, last_buffer_col});
                 } else if (isInTokenDict(buffer)) {
-                    TokenType type = TokenDict[buffer];
+                    TokenType type = TokenDict.at(buffer);
                     tokens.emplace_back(Token{type, buffer, line, last_buffer_col});
                 } else {
                     tokens.emplace_back(Token{TokenType::ident, buffer, line, last_buffer_col});
@@ -151,10 +151,26 @@ std::vector<Token> Tokenizer::tokenize() {
                     tokens.emplace_back(Token{TokenType::coma, {}, line, column});
                     break;
                 case '<':
-                    tokens.emplace_back(Token{TokenType::less_then, {}, line, column});
-                    break;
                 case '>':
-                    tokens.emplace_back(Token{TokenType::greater_then, {}, line, column});
+                    if (i + 1 < code.length() && code.at(i + 1) == c) {
+                        tokens.emplace_back(Token{c == '<' ? TokenType::shift_left : TokenType::shift_right, {}, line, column});
+                        i++;
+                        column++;
+                    } else {
+                        tokens.emplace_back(Token{c == '<' ? TokenType::less_then : TokenType::greater_then, {}, line, column});
+                    }
+                    break;
+                case '^':
+                    tokens.emplace_back(Token{TokenType::caret, {}, line, column});
+                    break;
+                case '~':
+                    tokens.emplace_back(Token{TokenType::tilde, {}, line, column});
+                    break;
+                case '[':
+                    tokens.emplace_back(Token{TokenType::bracket_open, {}, line, column});
+                    break;
+                case ']':
+                    tokens.emplace_back(Token{TokenType::bracket_close, {}, line, column});
                     break;
             }
             last_buffer_col = column;
@@ -21,7 +21,8 @@ private:
     bool isTokenInt(TokenType type);
     void removeComments();
 
-    std::unordered_map<std::string, TokenType> TokenDict = {
+    // built once for the whole process, every file of a batch shares it
+    inline static const std::unordered_map<std::string, TokenType> TokenDict = {
             {"exit", TokenType::exit},
             {"let", TokenType::_let},
             {"true", TokenType::_true},
@@ -33,6 +34,10 @@ private:
             {"int32", TokenType::_int32},
             {"int64", TokenType::_int64},
             {"long", TokenType::_int64},
+            {"uint8", TokenType::_uint8},
+            {"uint16", TokenType::_uint16},
+            {"uint32", TokenType::_uint32},
+            {"uint64", TokenType::_uint64},
             {"string", TokenType::_string},
             {"include", TokenType::_import},
             {"import", TokenType::_import},
@@ -48,10 +53,10 @@ private:
             {"extern", TokenType::_extern},
     };
 
-    char token_breakers[25] = {
+    char token_breakers[29] = {
             ' ', ';', '\n', '(', ')', '{', '}', '-', '*', '+', '=',
             '/', '#','!', '%', '&', ':', '?', '.', ',', '\"', '|',
-            '<', '>', '\0'
+            '<', '>', '^', '~', '[', ']', '\0'
     };
 
     std::string code;
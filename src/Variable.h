@@ -4,9 +4,14 @@
 #include "PCH.h"
 
 enum class VarType{
-    _char, _short, _int, _long, _bool
+    _char, _short, _int, _long, _bool,
+    _uchar, _ushort, _uint, _ulong // uint8, uint16, uint32 and uint64
 };
 
+inline bool IsUnsigned(VarType type){
+    return type == VarType::_uchar || type == VarType::_ushort || type == VarType::_uint || type == VarType::_ulong;
+}
+
 inline std::string VarTypeToString(const VarType& type){
     switch (type) {
         case VarType::_char:
@@ -19,6 +24,14 @@ inline std::string VarTypeToString(const VarType& type){
             return "long";
         case VarType::_bool:
             return "bool";
+        case VarType::_uchar:
+            return "uint8";
+        case VarType::_ushort:
+            return "uint16";
+        case VarType::_uint:
+            return "uint32";
+        case VarType::_ulong:
+            return "uint64";
     }
 
     exit(1);
@@ -0,0 +1,361 @@
+#include "Vectorizer.h"
+
+/// About what the scalar code of a statement costs, a load, a push and pop around the other side, the operation and
+/// the store. A literal of &, |, ^ and * is an immediate, which leaves the load and the store
+static constexpr int SCALAR_COST = 6;
+static constexpr int SCALAR_IMMEDIATE_COST = 3;
+/// A packed load, the operation with the other side in memory and the store
+static constexpr int VECTOR_COST = 3;
+/// Loading a vector right after scalar stores to its bytes can't take the value from the stores and waits until
+/// they are written, about a dozen cycles
+static constexpr int STORE_FORWARD_COST = 12;
+
+/// The width of the variables of `type` in bytes, 0 for bools, they never get packed
+static uint8_t GetWidth(VarType type){
+    switch(type){
+        case VarType::_char: case VarType::_uchar: return 1;
+        case VarType::_short: case VarType::_ushort: return 2;
+        case VarType::_int: case VarType::_uint: return 4;
+        case VarType::_long: case VarType::_ulong: return 8;
+        case VarType::_bool: break;
+    }
+    return 0;
+}
+
+/// The operation and the sides of `x op y`, false for every other expression
+static bool GetOperation(const Node::IntExpr* expr, Node::BinOp& op, const Node::IntExpr*& lhs, const Node::IntExpr*& rhs){
+    auto bin = std::get_if<Node::BinExpr*>(&expr->var);
+    if(!bin)
+        return false;
+
+    auto sides = [&](auto node, Node::BinOp bin_op){
+        op = bin_op;
+        lhs = node->lhs;
+        rhs = node->rhs;
+        return true;
+    };
+    if(auto node = std::get_if<Node::BinExprAdd*>(&(*bin)->expr))
+        return sides(*node, Node::BinOp::add);
+    if(auto node = std::get_if<Node::BinExprSub*>(&(*bin)->expr))
+        return sides(*node, Node::BinOp::sub);
+    if(auto node = std::get_if<Node::BinExprMul*>(&(*bin)->expr))
+        return sides(*node, Node::BinOp::mul);
+    if(auto node = std::get_if<Node::BinExprAnd*>(&(*bin)->expr))
+        return sides(*node, Node::BinOp::_and);
+    if(auto node = std::get_if<Node::BinExprOr*>(&(*bin)->expr))
+        return sides(*node, Node::BinOp::_or);
+    if(auto node = std::get_if<Node::BinExprXor*>(&(*bin)->expr))
+        return sides(*node, Node::BinOp::_xor);
+    return false;
+}
+
+/// Adds the variable or the literal `expr` is to the side, false when it is neither or the side has the other kind
+static bool AddToSide(const Node::IntExpr* expr, Vectorizer::Side& side, bool first){
+    auto term = std::get_if<Node::Term*>(&expr->var);
+    if(!term)
+        return false;
+    if(auto ident = std::get_if<Node::Ident*>(&(*term)->term)){
+        if(!first && side.idents.empty())
+            return false;
+        side.idents.emplace_back(*ident);
+        return true;
+    }
+    if(auto literal = std::get_if<Node::LitInt*>(&(*term)->term)){
+        if(!first && !side.idents.empty())
+            return false;
+        side.values.emplace_back((*literal)->GetValue());
+        return true;
+    }
+    return false;
+}
+
+/// The names of a side, empty for literals
+static std::vector<std::string> GetNames(const Vectorizer::Side& side){
+    std::vector<std::string> names;
+    for(const Node::Ident* ident : side.idents)
+        names.emplace_back(ident->value);
+    return names;
+}
+
+bool Vectorizer::IsSupported(Node::BinOp op, uint8_t width, Asm::Level level){
+    switch(op){
+        case Node::BinOp::add:
+        case Node::BinOp::sub:
+        case Node::BinOp::_and:
+        case Node::BinOp::_or:
+        case Node::BinOp::_xor:
+            return true;
+        case Node::BinOp::mul:
+            // pmullw is SSE2 and pmulld SSE4.1, there is no multiply of bytes or quadwords before AVX-512
+            return width == 2 || (width == 4 && level >= Asm::Level::v2);
+        default:
+            return false;
+    }
+}
+
+void Vectorizer::Declare(const std::vector<Node::Stmt*>& stmts){
+    for(size_t i = 0; i < stmts.size(); i++){
+        const Node::Stmt* stmt = stmts.at(i);
+        if(auto node = std::get_if<Node::Variable*>(&stmt->stmt)){
+            auto [it, added] = declarations.emplace((*node)->ident->value, Declaration{&stmts, i, *node, 0});
+            it->second.count++;
+        }
+        else if(auto node = std::get_if<Node::Scope*>(&stmt->stmt))
+            Declare((*node)->stmts);
+        else if(auto node = std::get_if<Node::If*>(&stmt->stmt))
+            Declare((*node)->stmt->stmts);
+        else if(auto node = std::get_if<Node::Elif*>(&stmt->stmt))
+            Declare((*node)->stmt->stmts);
+        else if(auto node = std::get_if<Node::Else*>(&stmt->stmt))
+            Declare((*node)->stmt->stmts);
+        else if(auto node = std::get_if<Node::While*>(&stmt->stmt)){
+            if((*node)->scope.has_value())
+                Declare((*node)->scope.value()->stmts);
+        }
+    }
+}
+
+uint8_t Vectorizer::GetBlockWidth(const std::vector<const Node::Ident*>& idents){
+    std::vector<size_t> indexes;
+    const std::vector<Node::Stmt*>* stmts = nullptr;
+    uint8_t width = 0;
+    for(const Node::Ident* ident : idents){
+        auto it = declarations.find(ident->value);
+        if(it == declarations.end() || it->second.count != 1 || it->second.var->length != 0)
+            return 0;
+        const Declaration& declaration = it->second;
+        if(stmts && declaration.stmts != stmts)
+            return 0;
+        uint8_t var_width = GetWidth(declaration.var->type);
+        if(var_width == 0 || (width && var_width != width))
+            return 0;
+        stmts = declaration.stmts;
+        width = var_width;
+        indexes.emplace_back(declaration.index);
+    }
+
+    // the declarations are statements in a row, every one of them declaring another variable of the side
+    std::sort(indexes.begin(), indexes.end());
+    for(size_t i = 1; i < indexes.size(); i++){
+        if(indexes.at(i) != indexes.at(i - 1) + 1)
+            return 0;
+    }
+    return width;
+}
+
+bool Vectorizer::MakePack(const std::vector<Node::Stmt*>& stmts, size_t index, uint8_t lanes, Pack& pack){
+    if(index + lanes > stmts.size())
+        return false;
+
+    pack = Pack{};
+    pack.lanes = lanes;
+    for(size_t i = index; i < index + lanes; i++){
+        auto node = std::get_if<Node::Reassign*>(&stmts.at(i)->stmt);
+        Node::BinOp op;
+        const Node::IntExpr* lhs;
+        const Node::IntExpr* rhs;
+        if(!node || !GetOperation((*node)->expr, op, lhs, rhs))
+            return false;
+        bool first = i == index;
+        if(!first && op != pack.op)
+            return false;
+        pack.op = op;
+        pack.dst.idents.emplace_back((*node)->ident);
+        if(!AddToSide(lhs, pack.lhs, first) || !AddToSide(rhs, pack.rhs, first))
+            return false;
+    }
+
+    // every lane reads its variables before any of them is written
+    for(size_t i = 0; i < lanes; i++){
+        for(size_t j = 0; j < lanes; j++){
+            const std::string& dst = pack.dst.idents.at(i)->value;
+            if(i == j)
+                continue;
+            if(dst == pack.dst.idents.at(j)->value)
+                return false;
+            for(const Side* side : {&pack.lhs, &pack.rhs}){
+                if(!side->idents.empty() && side->idents.at(j)->value == dst)
+                    return false;
+            }
+        }
+    }
+
+    pack.width = GetBlockWidth(pack.dst.idents);
+    if(pack.width == 0 || !IsSupported(pack.op, pack.width, level))
+        return false;
+    for(const Side* side : {&pack.lhs, &pack.rhs}){
+        if(!side->idents.empty() && GetBlockWidth(side->idents) != pack.width)
+            return false;
+    }
+    return true;
+}
+
+void Vectorizer::Find(const std::vector<Node::Stmt*>& stmts, std::vector<Place>& path, bool loop){
+    path.emplace_back(Place{&stmts, 0, loop});
+
+    for(size_t i = 0; i < stmts.size(); i++){
+        const Node::Stmt* stmt = stmts.at(i);
+        path.back().index = i;
+
+        if(auto node = std::get_if<Node::Reassign*>(&stmt->stmt)){
+            auto it = declarations.find((*node)->ident->value);
+            uint8_t width = it != declarations.end() ? GetWidth(it->second.var->type) : 0;
+            // the widest vector first, 32 bytes of ymm registers with AVX2
+            for(uint8_t bytes : {32, 16}){
+                Pack pack;
+                if(width == 0 || (bytes == 32 && level < Asm::Level::v3) || !MakePack(stmts, i, bytes / width, pack))
+                    continue;
+                Candidate candidate{pack, {}, path};
+                for(size_t lane = 0; lane < pack.lanes; lane++)
+                    candidate.stmts.emplace_back(stmts.at(i + lane));
+                candidates.emplace_back(candidate);
+                i += pack.lanes - 1;
+                break;
+            }
+        }
+        else if(auto node = std::get_if<Node::Scope*>(&stmt->stmt))
+            Find((*node)->stmts, path, false);
+        else if(auto node = std::get_if<Node::If*>(&stmt->stmt))
+            Find((*node)->stmt->stmts, path, false);
+        else if(auto node = std::get_if<Node::Elif*>(&stmt->stmt))
+            Find((*node)->stmt->stmts, path, false);
+        else if(auto node = std::get_if<Node::Else*>(&stmt->stmt))
+            Find((*node)->stmt->stmts, path, false);
+        else if(auto node = std::get_if<Node::While*>(&stmt->stmt)){
+            if((*node)->scope.has_value())
+                Find((*node)->scope.value()->stmts, path, true);
+        }
+    }
+
+    path.pop_back();
+}
+
+void Vectorizer::FindScalarWrites(const Node::Stmt* stmt, std::unordered_set<std::string>& names){
+    auto scope = [&](const Node::Scope* body){
+        for(const Node::Stmt* inner : body->stmts)
+            FindScalarWrites(inner, names);
+    };
+
+    if(auto node = std::get_if<Node::Reassign*>(&stmt->stmt)){
+        if(packed.find(stmt) == packed.end())
+            names.insert((*node)->ident->value);
+    }
+    else if(auto node = std::get_if<Node::Variable*>(&stmt->stmt))
+        names.insert((*node)->ident->value);
+    else if(auto node = std::get_if<Node::Scope*>(&stmt->stmt))
+        scope(*node);
+    else if(auto node = std::get_if<Node::If*>(&stmt->stmt))
+        scope((*node)->stmt);
+    else if(auto node = std::get_if<Node::Elif*>(&stmt->stmt))
+        scope((*node)->stmt);
+    else if(auto node = std::get_if<Node::Else*>(&stmt->stmt))
+        scope((*node)->stmt);
+    else if(auto node = std::get_if<Node::While*>(&stmt->stmt)){
+        if((*node)->scope.has_value())
+            scope((*node)->scope.value());
+    }
+}
+
+bool Vectorizer::IsProfitable(const Candidate& candidate){
+    const Pack& pack = candidate.pack;
+    bool immediate = pack.op == Node::BinOp::_and || pack.op == Node::BinOp::_or || pack.op == Node::BinOp::_xor ||
+                     pack.op == Node::BinOp::mul;
+    bool literal = pack.lhs.idents.empty() || pack.rhs.idents.empty();
+    int scalar = pack.lanes * (immediate && literal ? SCALAR_IMMEDIATE_COST : SCALAR_COST);
+
+    // pmulld is two uops with a latency of 10 cycles on most cpus, pmullw one of 5
+    int vector = VECTOR_COST;
+    if(pack.op == Node::BinOp::mul)
+        vector += pack.width == 4 ? 4 : 1;
+
+    // the scalar stores a load of the pack can see: in a loop every one in its body, they run between two runs of
+    // the pack, and outside of loops the ones before it
+    std::unordered_set<std::string> written;
+    auto loop = std::find_if(candidate.path.rbegin(), candidate.path.rend(), [](const Place& place){ return place.loop; });
+    if(loop != candidate.path.rend()){
+        for(const Node::Stmt* stmt : *loop->stmts)
+            FindScalarWrites(stmt, written);
+    }
+    else{
+        for(const Place& place : candidate.path){
+            for(size_t i = 0; i < place.index; i++)
+                FindScalarWrites(place.stmts->at(i), written);
+        }
+    }
+    for(const Side* side : {&pack.lhs, &pack.rhs}){
+        if(std::any_of(side->idents.begin(), side->idents.end(), [&](const Node::Ident* ident){
+            return written.find(ident->value) != written.end();
+        }))
+            vector += STORE_FORWARD_COST;
+    }
+
+    return vector < scalar;
+}
+
+Vectorizer::Plan Vectorizer::Vectorize(const std::vector<Node::Stmt*>& stmts){
+    Declare(stmts);
+    std::vector<Place> path;
+    Find(stmts, path, false);
+
+    // rejecting a pack makes its statements scalar stores that other packs may see, so it goes on until none is
+    std::unordered_map<std::string, std::vector<std::string>> sides; // every variable of a side and the whole side
+    bool changed = true;
+    while(changed){
+        changed = false;
+        sides.clear();
+        packed.clear();
+
+        for(Candidate& candidate : candidates){
+            if(candidate.rejected)
+                continue;
+
+            // a variable has one place, sides that share a variable have to be the same one
+            const Pack& pack = candidate.pack;
+            std::vector<std::vector<std::string>> names = {GetNames(pack.dst), GetNames(pack.lhs), GetNames(pack.rhs)};
+            auto place = [&](const std::string& name, const std::vector<std::string>& side){
+                auto it = sides.find(name);
+                if(it != sides.end())
+                    return it->second == side;
+                for(const std::vector<std::string>& other : names){
+                    if(other != side && std::find(other.begin(), other.end(), name) != other.end())
+                        return false;
+                }
+                return true;
+            };
+            if(!std::all_of(names.begin(), names.end(), [&](const std::vector<std::string>& side){
+                return std::all_of(side.begin(), side.end(), [&](const std::string& name){ return place(name, side); });
+            })){
+                candidate.rejected = true;
+                continue;
+            }
+            for(const std::vector<std::string>& side : names){
+                for(const std::string& name : side)
+                    sides[name] = side;
+            }
+            packed.insert(candidate.stmts.begin(), candidate.stmts.end());
+        }
+
+        for(Candidate& candidate : candidates){
+            if(!candidate.rejected && !IsProfitable(candidate)){
+                candidate.rejected = true;
+                changed = true;
+            }
+        }
+    }
+
+    Plan plan;
+    for(const Candidate& candidate : candidates){
+        if(!candidate.rejected)
+            plan.packs.emplace(candidate.stmts.front(), candidate.pack);
+    }
+    for(const auto& [name, names] : sides){
+        const Declaration& declaration = declarations.at(name);
+        auto lane = static_cast<uint8_t>(std::find(names.begin(), names.end(), name) - names.begin());
+        size_t first = SIZE_MAX;
+        for(const std::string& other : names)
+            first = std::min(first, declarations.at(other).index);
+        uint8_t width = GetWidth(declaration.var->type);
+        plan.slots.emplace(declaration.var, Slot{lane, width, static_cast<uint8_t>(names.size()), declaration.index == first});
+    }
+    return plan;
+}
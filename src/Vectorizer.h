@@ -0,0 +1,84 @@
+#pragma once
+
+#include <unordered_set>
+
+#include "PCH.h"
+#include "Node.h"
+#include "Instruction.h"
+
+/// Superword level parallelism, finds statements like `a0 = a0 + b0; a1 = a1 + b1; a2 = a2 + b2; a3 = a3 + b3;` that do
+/// the same thing to different variables and lays the variables of each side out next to each other, so one packed
+/// instruction does all of them. A pack is statements in a row that
+///  - are `d = x op y` with the same op of +, -, &, |, ^ or *, and x and y variables or literals
+///  - fill 16 bytes of lanes, or 32 with x86-64-v3, every variable in them has the width of a lane
+///  - don't read a variable another one of them writes
+/// The variables of a side (all d, all x or all y) have to be declared one after another in any order, and no
+/// variable can be in two different sides. Packs that aren't worth it by Cost are left as they are
+class Vectorizer{
+public:
+    /// The variable or the literal of every lane of one side of a pack
+    struct Side{
+        std::vector<const Node::Ident*> idents; // empty when the side is literals
+        std::vector<int64_t> values;
+    };
+    struct Pack{
+        Node::BinOp op;
+        uint8_t width; // of a lane, in bytes
+        uint8_t lanes;
+        Side dst, lhs, rhs;
+    };
+    /// Where a variable of a side goes
+    struct Slot{
+        uint8_t lane;
+        uint8_t width;
+        uint8_t lanes;
+        bool first; // the first declaration of the side, it makes room for all of them
+    };
+    struct Plan{
+        std::unordered_map<const Node::Stmt*, Pack> packs; // by the first statement of the pack
+        std::unordered_map<const Node::Variable*, Slot> slots;
+    };
+
+    explicit Vectorizer(Asm::Level level) : level(level) {}
+
+    Plan Vectorize(const std::vector<Node::Stmt*>& stmts);
+    /// Whether there is a packed instruction of `op` for lanes of `width` bytes at `level`
+    static bool IsSupported(Node::BinOp op, uint8_t width, Asm::Level level);
+
+private:
+
+    struct Declaration{
+        const std::vector<Node::Stmt*>* stmts;
+        size_t index;
+        const Node::Variable* var;
+        size_t count; // how often the name is declared, only a name declared once is laid out
+    };
+    /// Where a statement is, the statements it is in and the ones around them up to the program
+    struct Place{
+        const std::vector<Node::Stmt*>* stmts;
+        size_t index;
+        bool loop; // the statements are the body of a while
+    };
+    struct Candidate{
+        Pack pack;
+        std::vector<const Node::Stmt*> stmts;
+        std::vector<Place> path;
+        bool rejected = false;
+    };
+
+    void Declare(const std::vector<Node::Stmt*>& stmts);
+    void Find(const std::vector<Node::Stmt*>& stmts, std::vector<Place>& path, bool loop);
+    /// The pack of `lanes` statements from `stmts[index]`, false when they aren't one
+    bool MakePack(const std::vector<Node::Stmt*>& stmts, size_t index, uint8_t lanes, Pack& pack);
+    /// The width of the variables declared one after another, 0 when they aren't
+    uint8_t GetBlockWidth(const std::vector<const Node::Ident*>& idents);
+    /// Whether packing saves more than it costs, in about the instructions and cycles it takes
+    bool IsProfitable(const Candidate& candidate);
+    /// The variables the statements write with scalar stores, the ones in `packed` store vectors
+    void FindScalarWrites(const Node::Stmt* stmt, std::unordered_set<std::string>& names);
+
+    Asm::Level level;
+    std::unordered_map<std::string, Declaration> declarations;
+    std::vector<Candidate> candidates;
+    std::unordered_set<const Node::Stmt*> packed;
+};
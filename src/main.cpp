@@ -7,46 +7,90 @@
 #include "Parser.h"
 #include "Generator.h"
 #include "Assemble.h"
+#include "Arguments.h"
+#include "Encoder.h"
+#include "Jit.h"
+#include "Bytecode.h"
+#include "Interpreter.h"
+#include "Cache.h"
+#include "ModuleGraph.h"
+#include "Server.h"
+#include "Batch.h"
+#include "Profiler.h"
+#include "Profile.h"
 
-struct Arguments{
-    int target;
-    std::string input_file;
-    std::string output_file;
-};
+#include <cctype>
+#include <cerrno>
+#include <filesystem>
+
+/// The most threads -j takes, 0 is one per core
+static constexpr uint64_t MAX_THREADS = 1024;
+
+/// The value after the flag at argv[i], i is moved to it
+static std::string GetFlagValue(int argc, char* argv[], int& i){
+    std::string flag = argv[i];
+    if(++i >= argc){
+        Log::Error("`" + flag + "` needs a value");
+        exit(1);
+    }
+    return argv[i];
+}
+
+/// The value of `flag` as a whole number up to `max`
+static uint64_t ParseFlagNumber(const std::string& flag, const std::string& value, uint64_t max){
+    // strtoull takes a sign and leading spaces, only digits are a number here
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = std::strtoull(value.c_str(), &end, 10);
+    if(value.empty() || !std::isdigit(static_cast<unsigned char>(value.front())) || *end != '\0' || errno == ERANGE ||
+       number > max){
+        Log::Error("`" + flag + "` expects a whole number up to " + std::to_string(max) + ", got `" + value + "`");
+        exit(1);
+    }
+    return number;
+}
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wstring-compare"
 Arguments parseProgramArguments(int argc, char* argv[]){
     Arguments temp;
-    if(argc < 2){
+
+    // GalaxiC run test.gx runs the program in memory instead of building an executable
+    int first = 1;
+    if(argc > 1 && std::string(argv[1]) == "run"){
+        temp.jit = true;
+        first = 2;
+    }
+
+    if(argc < first + 1){
         Log::Error("Target input file was not specified");
         exit(1);
     }
 
-    temp.input_file = argv[1];
+    // `-` reads the program from stdin, its imports are relative to the working directory
+    temp.input_file = argv[first];
     unsigned int len = temp.input_file.length();
-    if(temp.input_file.substr(len - 3, len) != ".gx"){
+    if(temp.input_file != "-" && (len < 3 || temp.input_file.substr(len - 3, len) != ".gx")){
         Log::Error("Input program extension must be .gx");
         exit(1);
     }
 
-    for(int i = 2; i + 1 <= argc; i++){
+    for(int i = first + 1; i + 1 <= argc; i++){
         if(std::string(argv[i]) == "-o"){
-            i++;
-            temp.output_file = std::string(argv[i]);
+            temp.output_file = GetFlagValue(argc, argv, i);
         }
         else if(std::string(argv[i]) == "-p"){
-            i++;
-            if(std::string(argv[i]) == "win32"){
+            std::string platform = GetFlagValue(argc, argv, i);
+            if(platform == "win32"){
                 temp.target = PLATFORM_WIN32;
             }
-            else if(std::string(argv[i]) == "win64"){
+            else if(platform == "win64"){
                 temp.target = PLATFORM_WIN64;
             }
-            else if(std::string(argv[i]) == "linux32"){
+            else if(platform == "linux32"){
                 temp.target = PLATFORM_LINUX32;
             }
-            else if(std::string(argv[i]) == "linux64"){
+            else if(platform == "linux64"){
                 temp.target = PLATFORM_LINUX64;
             }
             else{
@@ -55,6 +99,87 @@ Arguments parseProgramArguments(int argc, char* argv[]){
                 exit(1);
             }
         }
+        else if(std::string(argv[i]) == "--via-nasm"){
+            temp.via_nasm = true;
+        }
+        else if(std::string(argv[i]) == "-c"){
+            temp.compile_only = true;
+        }
+        else if(std::string(argv[i]) == "-S"){
+            temp.assembly_file = GetFlagValue(argc, argv, i);
+        }
+        else if(std::string(argv[i]) == "--freestanding"){
+            temp.freestanding = true;
+        }
+        else if(std::string(argv[i]).rfind("-march=", 0) == 0){
+            std::string level = std::string(argv[i]).substr(7);
+            if(level == "x86-64" || level == "x86-64-v1")
+                temp.march = Asm::Level::v1;
+            else if(level == "x86-64-v2")
+                temp.march = Asm::Level::v2;
+            else if(level == "x86-64-v3")
+                temp.march = Asm::Level::v3;
+            else if(level == "native")
+                temp.march = Asm::HostLevel();
+            else{
+                Log::Error("Unknown -march level `" + level + "`, expected x86-64, x86-64-v2, x86-64-v3 or native");
+                exit(1);
+            }
+        }
+        else if(std::string(argv[i]) == "-fbounds-check"){
+            temp.bounds_checks = true;
+        }
+        else if(std::string(argv[i]) == "-fno-slp-vectorize"){
+            temp.vectorize = false;
+        }
+        else if(std::string(argv[i]) == "--interpret"){
+            temp.interpret = true;
+        }
+        else if(std::string(argv[i]) == "--check"){
+            temp.check = true;
+        }
+        else if(std::string(argv[i]) == "-g"){
+            temp.debug_info = true;
+        }
+        else if(std::string(argv[i]) == "--no-gc-sections"){
+            temp.gc_sections = false;
+        }
+        else if(std::string(argv[i]) == "--print-gc-sections"){
+            temp.print_gc_sections = true;
+        }
+        else if(std::string(argv[i]).rfind("-fprofile-generate", 0) == 0 ||
+                std::string(argv[i]).rfind("-fprofile-use", 0) == 0){
+            std::string arg = argv[i];
+            bool generate = arg.rfind("-fprofile-generate", 0) == 0;
+            std::string flag = generate ? "-fprofile-generate" : "-fprofile-use";
+            if(arg.length() > flag.length() && (arg.at(flag.length()) != '=' || arg.length() == flag.length() + 1)){
+                Log::Error("Unknown program argument flag name `" + arg + "`");
+                exit(1);
+            }
+            (generate ? temp.profile_generate : temp.profile_use) = true;
+            if(arg.length() > flag.length())
+                temp.profile_file = arg.substr(flag.length() + 1);
+        }
+        else if(std::string(argv[i]) == "-j"){
+            temp.threads = static_cast<unsigned>(ParseFlagNumber("-j", GetFlagValue(argc, argv, i), MAX_THREADS));
+        }
+        else if(std::string(argv[i]) == "-ftime-report"){
+            temp.time_report = true;
+        }
+        else if(std::string(argv[i]) == "--trace"){
+            temp.trace_file = GetFlagValue(argc, argv, i);
+        }
+        else if(std::string(argv[i]) == "--cache"){
+            temp.cache = true;
+        }
+        else if(std::string(argv[i]) == "--cache-dir"){
+            temp.cache = true;
+            temp.cache_dir = GetFlagValue(argc, argv, i);
+        }
+        else if(std::string(argv[i]) == "--cache-size"){
+            // in MB, the size in bytes has to fit
+            temp.cache_size = ParseFlagNumber("--cache-size", GetFlagValue(argc, argv, i), UINT64_MAX >> 20) << 20;
+        }
         else{
             std::string s = std::string(argv[i]);
             Log::Error("Unknown program argument flag name `" + s + "`");
@@ -62,6 +187,68 @@ Arguments parseProgramArguments(int argc, char* argv[]){
         }
     }
 
+    if((temp.interpret || temp.check) && !temp.jit){
+        Log::Error("--interpret and --check can only be used with `run`");
+        exit(1);
+    }
+
+    if(temp.jit && (!temp.interpret || temp.check) && (temp.target != PLATFORM_LINUX64 || !Jit::SupportsHost())){
+        Log::Error("`run` can only run linux64 programs on an x86-64 linux machine");
+        exit(1);
+    }
+
+    // the code runs right here, an instruction this machine doesn't have would only crash it
+    if(temp.jit && (!temp.interpret || temp.check) && temp.march > Asm::HostLevel()){
+        Log::Error("`run` can't use -march=" + std::string(Asm::LevelName(temp.march)) + ", this machine only supports " +
+                   Asm::LevelName(Asm::HostLevel()));
+        exit(1);
+    }
+
+    if(!temp.assembly_file.empty() && temp.jit){
+        Log::Error("-S can't be used with `run`, there is no assembly to write");
+        exit(1);
+    }
+    // the cache only keeps objects, writing the assembly is cheaper than looking one up
+    if(!temp.assembly_file.empty())
+        temp.cache = false;
+
+    if(temp.freestanding && temp.target != PLATFORM_LINUX64){
+        Log::Error("--freestanding is only supported for linux64 programs");
+        exit(1);
+    }
+
+    if(temp.profile_generate && temp.profile_use){
+        Log::Error("-fprofile-generate and -fprofile-use can't be used together");
+        exit(1);
+    }
+    // the counters are written with linux system calls
+    if(temp.profile_generate && temp.target != PLATFORM_LINUX64){
+        Log::Error("-fprofile-generate is only supported for linux64 programs");
+        exit(1);
+    }
+    if((temp.profile_generate || temp.profile_use) && temp.profile_file.empty())
+        temp.profile_file = Profile::DefaultPath(temp.input_file);
+    else if(temp.profile_generate){
+        std::error_code error;
+        temp.profile_file = std::filesystem::absolute(temp.profile_file, error).string();
+    }
+
+    if(temp.time_report || !temp.trace_file.empty())
+        Profiler::Enable(temp.time_report, temp.trace_file);
+
+    if(temp.cache_dir.empty())
+        temp.cache_dir = Cache::DefaultDirectory();
+
+    if(temp.output_file.empty()){
+        temp.output_file = temp.input_file == "-" ? "a" : temp.input_file.substr(0, len - 3);
+        if(temp.compile_only)
+            temp.output_file += ".o";
+        else if(temp.target == PLATFORM_WIN32 || temp.target == PLATFORM_WIN64)
+            temp.output_file += ".exe";
+        else if(temp.input_file == "-")
+            temp.output_file += ".out";
+    }
+
     return temp;
 }
 #pragma clang diagnostic pop
@@ -69,6 +256,11 @@ Arguments parseProgramArguments(int argc, char* argv[]){
 std::string readFile(std::string name){
     std::stringstream ret_value;
 
+    if(name == "-"){
+        ret_value << std::cin.rdbuf();
+        return ret_value.str();
+    }
+
     std::ifstream file(name);
     if(file.is_open()){
         ret_value << file.rdbuf();
@@ -78,37 +270,243 @@ std::string readFile(std::string name){
     exit(1);
 }
 
-// GalaxiC test.gx -p win64 -o test.exe
-int main(int argc, char* argv[]){
+/// Compiles a small program before the server or a batch forks, every fork then starts with the code
+/// of the compiler paged in, its symbols bound, the heap grown and the arena allocated
+static void WarmUp(){
+    ModuleGraph graph(1);
+    graph.Load("warmup.gx", "int a = 1;\nwhile(a < 3){\n    a = a + 1;\n}\nif(a == 3){\n    exit(a);\n}\n ");
+    Encoder encoder;
+    ObjectCode object;
+    encoder.Encode(graph.Generate(PLATFORM_LINUX64, Generator::Entry::main).GenerateInstructions(), object);
+    graph.Clear();
+}
+
+static int Compile(int argc, char* argv[]){
     Arguments args = parseProgramArguments(argc, argv);
 
-    std::string content = readFile(args.input_file);
-    content += ' ';
+    std::string content;
+    {
+        Profiler::Scope scope("read source");
+        content = readFile(args.input_file);
+        content += ' ';
+    }
+
+    // an unchanged program built with the same flags skips every stage up to linking
+    std::optional<Cache> cache;
+    std::string cache_key;
+    auto cache_lookup = [&](const std::vector<std::string>& sources){
+        Cache::Entry entry;
+        {
+            Profiler::Scope scope("cache lookup");
+            cache_key = Cache::Key(sources, args);
+            if(!cache->Lookup(cache_key, entry))
+                return false;
+        }
+        Assemble assemble(std::move(entry.object), entry.links, args);
+        return true;
+    };
+
+    // without imports the source alone decides the object, so it is looked up before anything is parsed
+    bool may_import = content.find("import") != std::string::npos || content.find("include") != std::string::npos;
+    if(args.cache && !args.jit){
+        cache.emplace(args.cache_dir, args.cache_size);
+        if(!may_import && cache_lookup({content}))
+            return 0;
+    }
 
-    std::vector<Token> tokens;
+    ModuleGraph graph(args.threads);
+    graph.Load(args.input_file, std::move(content));
+    if(args.profile_generate)
+        graph.SetProfile(Generator::Profiling::generate, args.profile_file);
+    else if(args.profile_use)
+        graph.SetProfile(Generator::Profiling::use, args.profile_file);
+    graph.SetLevel(args.march);
+    graph.SetBoundsChecks(args.bounds_checks);
+    graph.SetVectorize(args.vectorize);
+    if(cache && cache_key.empty() && cache_lookup(graph.GetSources()))
+        return 0;
 
     std::vector<std::string> links;
 
     {
-        Tokenizer tokenizer(content);
-        tokens = tokenizer.tokenize();
+        Generator::Entry entry = Generator::Entry::main;
+        if(args.jit)
+            entry = Generator::Entry::call;
+        else if(args.freestanding)
+            entry = Generator::Entry::start;
+
+        if(args.jit){
+            // the interpreter needs no native code at all, --check runs both and compares them
+            int64_t interpreted = 0;
+            if(args.interpret || args.check){
+                Bytecode::Program bytecode;
+                BytecodeCompiler compiler(graph.GetPrograms());
+                Interpreter interpreter;
+                {
+                    Profiler::Scope scope("compile bytecode");
+                    if(!compiler.Compile(bytecode)){
+                        Log::Error(compiler.GetError());
+                        exit(1);
+                    }
+                }
+                Profiler::Count("bytecodes", static_cast<int64_t>(bytecode.code.size()));
+                {
+                    Profiler::Scope scope("interpret");
+                    if(!interpreter.Run(bytecode, interpreted)){
+                        Log::Error(interpreter.GetError());
+                        exit(1);
+                    }
+                }
+                if(!args.check)
+                    return static_cast<int>(interpreted);
+            }
+
+            Jit jit;
+            int exit_code;
+            Generator& generator = graph.Generate(args.target, entry, args.debug_info);
+            if(args.debug_info)
+                jit.EnablePerfMap();
+            const Asm::Module& module = generator.GenerateInstructions();
+            Profiler::Scope scope("jit");
+            if(!jit.LoadLibraries(generator.GetLinkPrograms()) || !jit.Run(module, exit_code)){
+                Log::Error(jit.GetError());
+                exit(1);
+            }
+            if(args.check && static_cast<int>(interpreted) != exit_code){
+                Log::Error("The native code exited with " + std::to_string(exit_code) + " but the interpreter with " +
+                           std::to_string(static_cast<int>(interpreted)));
+                exit(1);
+            }
+            return exit_code;
+        }
+
+        Generator& generator = graph.Generate(args.target, entry, args.debug_info);
+        if(!args.assembly_file.empty()){
+            if(!generator.GenerateCode().WriteFile(args.assembly_file)){
+                Log::Error("Failed to write the assembly to `" + args.assembly_file + "`");
+                exit(1);
+            }
+            return 0;
+        }
+
+        if(!args.via_nasm && Encoder::SupportsTarget(args.target)){
+            Encoder encoder;
+            ObjectCode object;
+            if(encoder.Encode(generator.GenerateInstructions(), object)){
+                links = generator.GetLinkPrograms();
+                graph.Clear();
+                Assemble::ObjectCallback store;
+                if(cache)
+                    store = [&](const std::vector<uint8_t>& bytes){
+                        Profiler::Scope scope("cache store");
+                        cache->Store(cache_key, {bytes, links});
+                    };
+                Assemble assemble(object, links, args, store);
+                return 0;
+            }
+            Log::Warning("Falling back to nasm, " + encoder.GetError());
+        }
+
+        // the text is written straight from the generator's buffer, so it assembles while the generator lives
+        const OutputBuffer& code = generator.GenerateCode();
+        graph.Clear();
+        links = generator.GetLinkPrograms();
+        Assemble::ObjectCallback store;
+        if(cache)
+            store = [&](const std::vector<uint8_t>& bytes){
+                Profiler::Scope scope("cache store");
+                cache->Store(cache_key, {bytes, links});
+            };
+        Assemble assemble(code, links, args, store);
     }
 
-    if(!tokens.size()){
-        Log::Error("Input file is empty");
-        exit(1);
+    return 0;
+}
+
+// GalaxiC test.gx -p win64 -o test.exe
+// GalaxiC run test.gx
+// generate.sh | GalaxiC - -S -
+// GalaxiC --cache-stats
+// GalaxiC --batch -j 8 -c tests/*.gx @more_tests.txt
+// GalaxiC --server [--socket path]
+// GalaxiC --client [--socket path] test.gx -o test
+int main(int argc, char* argv[]){
+    if(argc > 1 && std::string(argv[1]) == "--cache-stats"){
+        std::string dir = argc > 3 && std::string(argv[2]) == "--cache-dir" ? argv[3] : Cache::DefaultDirectory();
+        Cache(dir, Arguments().cache_size).PrintStats();
+        return 0;
     }
 
-    {
-        Parser parser(tokens);
-        Node::Program* prg = parser.parse();
-        Generator generator(prg, args.target);
-        content = generator.GenerateCode();
-        parser.Clear();
-        links = generator.GetLinkPrograms();
+    if(argc > 1 && (std::string(argv[1]) == "--server" || std::string(argv[1]) == "--client")){
+        bool server = std::string(argv[1]) == "--server";
+        std::string socket = Server::DefaultSocket();
+        int first = 2;
+        if(argc > 3 && std::string(argv[2]) == "--socket"){
+            socket = argv[3];
+            first = 4;
+        }
+
+        if(server){
+            Server compiler(socket);
+            if(!compiler.Listen()){
+                Log::Error(compiler.GetError());
+                exit(1);
+            }
+            WarmUp();
+            Log::Info("Listening on " + socket);
+            compiler.Serve(Compile);
+            return 0;
+        }
+
+        // without a server the client compiles by itself, a build works the same either way
+        int exit_code;
+        std::vector<std::string> request(argv + first, argv + argc);
+        if(Server::Request(socket, request, exit_code))
+            return exit_code;
+        Log::Warning("No compile server is listening on " + socket + ", compiling without it");
+        argv[first - 1] = argv[0];
+        return Compile(argc - first + 1, argv + first - 1);
     }
 
-    Assemble assemble(content, links, args.output_file, args.target);
+    if(argc > 1 && std::string(argv[1]) == "--batch"){
+        std::vector<std::string> inputs, flags;
+        unsigned workers = 0;
+        std::vector<std::string> args = Batch::ExpandResponseFiles({argv + 2, argv + argc});
+        for(size_t i = 0; i < args.size(); i++){
+            const std::string& arg = args.at(i);
+            if(arg.empty()){
+                Log::Error("An empty argument was given to --batch");
+                exit(1);
+            }
+            bool has_value = arg == "-p" || arg == "-j" || arg == "--cache-dir" || arg == "--cache-size" || arg == "--trace";
+            if(has_value && i + 1 >= args.size()){
+                Log::Error("`" + arg + "` needs a value");
+                exit(1);
+            }
 
-    return 0;
-}
\ No newline at end of file
+            if(arg == "-o" || arg == "-S" || arg == "-" || arg == "run"){
+                Log::Error("`" + arg + "` can't be used with --batch, every program is written next to its source");
+                exit(1);
+            }
+            else if(arg == "-j")
+                workers = static_cast<unsigned>(ParseFlagNumber("-j", args.at(++i), MAX_THREADS));
+            else if(has_value){
+                flags.emplace_back(arg);
+                flags.emplace_back(args.at(++i));
+            }
+            else if(arg.front() == '-')
+                flags.emplace_back(arg);
+            else
+                inputs.emplace_back(arg);
+        }
+        // the workers already use every core, a file's imports are compiled on its worker's thread
+        flags.emplace_back("-j");
+        flags.emplace_back("1");
+
+        WarmUp();
+        Batch batch(std::move(inputs), std::move(flags), workers);
+        return batch.Run(Compile) == 0 ? 0 : 1;
+    }
+
+    return Compile(argc, argv);
+}
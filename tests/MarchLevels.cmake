@@ -0,0 +1,54 @@
+# Checks the instructions every -march level selects, run by ctest as
+# cmake -DGALAXIC=<compiler> -DPROGRAMS=<tests/march> -P MarchLevels.cmake
+#
+# Every case is a program in tests/march, the level its instruction needs, the instruction and what the
+# levels below it use instead. At the level and above the instruction has to be in the assembly and the
+# baseline sequence not, below it the other way around
+
+set(levels x86-64 x86-64-v2 x86-64-v3)
+set(cases
+        "popcount|1|popcnt |shr rax, 56"
+        "clz|2|lzcnt |bsr "
+        "ctz|2|tzcnt |bsf "
+        "andn|2|andn |not "
+        "shifts|2|shlx |shl rax, cl"
+        "shifts|2|sarx |sar rax, cl"
+        "mulx|2|mulx |mul rdx")
+
+set(failed 0)
+foreach(case IN LISTS cases)
+    string(REPLACE "|" ";" fields "${case}")
+    list(GET fields 0 program)
+    list(GET fields 1 needed)
+    list(GET fields 2 instruction)
+    list(GET fields 3 baseline)
+
+    foreach(index RANGE 2)
+        list(GET levels ${index} level)
+        execute_process(COMMAND ${GALAXIC} ${PROGRAMS}/${program}.gx -S - -march=${level}
+                OUTPUT_VARIABLE assembly ERROR_VARIABLE errors RESULT_VARIABLE result)
+        if(NOT result EQUAL 0)
+            message(SEND_ERROR "${program}.gx failed to compile at ${level}: ${errors}")
+            set(failed 1)
+            continue()
+        endif()
+
+        # an instruction is at the start of a line, so `mul rdx` doesn't match `mulx rdx`
+        set(assembly "\n${assembly}")
+        string(FIND "${assembly}" "\n${instruction}" has_instruction)
+        string(FIND "${assembly}" "\n${baseline}" has_baseline)
+        if(index GREATER_EQUAL needed)
+            if(has_instruction EQUAL -1 OR NOT has_baseline EQUAL -1)
+                message(SEND_ERROR "${program}.gx at ${level} should use `${instruction}` and not `${baseline}`")
+                set(failed 1)
+            endif()
+        elseif(NOT has_instruction EQUAL -1 OR has_baseline EQUAL -1)
+            message(SEND_ERROR "${program}.gx at ${level} should use `${baseline}` and not `${instruction}`")
+            set(failed 1)
+        endif()
+    endforeach()
+endforeach()
+
+if(failed)
+    message(FATAL_ERROR "the instructions of some levels are wrong")
+endif()
@@ -0,0 +1,34 @@
+# Runs the compiler once and checks how it ended, run by ctest as
+# cmake -DGALAXIC=<compiler> -DARGS=<arguments separated by |> -DEXPECTED=<result> [-DOUTPUT_MATCHES=<regex>]
+#       [-DOUTPUT_LACKS=<regex>] -P RunTest.cmake
+#
+# EXPECTED is the exit code of the compiler, with `run` the one of the program, or the signal that ended it like
+# "Illegal instruction". What it printed, the assembly of `-S -` included, has to match OUTPUT_MATCHES and not
+# OUTPUT_LACKS
+
+string(REPLACE "|" ";" args "${ARGS}")
+execute_process(COMMAND ${GALAXIC} ${args} OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+
+# ctest skips the test when it sees this, a machine without the level can't run it
+if(output MATCHES "this machine only supports")
+    message("${output}")
+    return()
+endif()
+
+set(failed 0)
+if(NOT "${result}" STREQUAL "${EXPECTED}")
+    message(SEND_ERROR "expected `${EXPECTED}` but got `${result}`")
+    set(failed 1)
+endif()
+if(NOT OUTPUT_MATCHES STREQUAL "" AND NOT output MATCHES "${OUTPUT_MATCHES}")
+    message(SEND_ERROR "the output doesn't have `${OUTPUT_MATCHES}`")
+    set(failed 1)
+endif()
+if(NOT OUTPUT_LACKS STREQUAL "" AND output MATCHES "${OUTPUT_LACKS}")
+    message(SEND_ERROR "the output has `${OUTPUT_LACKS}`")
+    set(failed 1)
+endif()
+
+if(failed)
+    message(FATAL_ERROR "GalaxiC ${args}\n${output}")
+endif()